@@ -0,0 +1,120 @@
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QFileInfo>
+#include <iostream>
+#include "batchProcessor.h"
+#include "pupilLog.h"
+
+// Command-line interface for the headless pupil detection of recorded image directories
+// Requires neither a camera SDK nor a display, thus can be used for batch processing of recordings on servers
+//
+// Usage: PupilEXT-cli [options] <directory> <output>
+// i.e. PupilEXT-cli --algorithm PuRe --parameters params.json --calibration calibration.xml /data/recording /data/recording.csv
+//
+// Binary pupil logs (.pxl) are converted into the CSV layout with: PupilEXT-cli --convert <log.pxl> <output.csv>
+//
+// Exit code is 0 on success, 1 on invalid arguments or input files, 2 if the output file could not be written
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("PupilEXT-cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless pupil detection of recorded image directories, writes the same CSV output as PupilEXT.");
+    parser.addHelpOption();
+
+    parser.addPositionalArgument("directory", "Image directory, either containing the images or the stereo directories 0 and 1.");
+    parser.addPositionalArgument("output", "Output CSV file, or binary pupil log if the extension is .pxl.");
+
+    QCommandLineOption algorithmOption(QStringList() << "a" << "algorithm", "Pupil detection algorithm: ElSe, ExCuSe, PuRe, PuReST, Starburst, Swirski2D. Default PuRe.", "name", "PuRe");
+    QCommandLineOption parametersOption(QStringList() << "p" << "parameters", "JSON algorithm parameter file.", "file");
+    QCommandLineOption calibrationOption(QStringList() << "c" << "calibration", "Camera calibration XML file, single or stereo according to the directory.", "file");
+    QCommandLineOption threadsOption(QStringList() << "t" << "threads", "Number of detection threads, only used for algorithms without state between images. Default all cores.", "count");
+    QCommandLineOption noConfidenceOption("no-outline-confidence", "Do not compute the additional outline confidence.");
+    QCommandLineOption forceOption(QStringList() << "f" << "force", "Overwrite the output file if it exists.");
+    QCommandLineOption convertOption("convert", "Convert the binary pupil log given instead of the directory into the CSV output file.");
+
+    parser.addOption(algorithmOption);
+    parser.addOption(parametersOption);
+    parser.addOption(calibrationOption);
+    parser.addOption(threadsOption);
+    parser.addOption(noConfidenceOption);
+    parser.addOption(forceOption);
+    parser.addOption(convertOption);
+
+    parser.process(a);
+
+    const QStringList args = parser.positionalArguments();
+    if(args.size() != 2) {
+        parser.showHelp(1);
+    }
+
+    QString outputFile = args.at(1);
+
+    // The DataWriter appends to existing files, which would mix the results of different runs
+    if(QFileInfo::exists(outputFile)) {
+        if(!parser.isSet(forceOption)) {
+            std::cerr << "Output file already exists, use --force to overwrite: " << outputFile.toStdString() << std::endl;
+            return 1;
+        }
+        if(!QFile::remove(outputFile)) {
+            std::cerr << "Could not remove existing output file: " << outputFile.toStdString() << std::endl;
+            return 2;
+        }
+    }
+
+    if(parser.isSet(convertOption)) {
+        qint64 converted = PupilLog::toCSV(args.at(0), outputFile);
+        if(converted < 0) {
+            return QFileInfo::exists(outputFile) ? 2 : 1;
+        }
+
+        std::cout << "Finished, " << converted << " records converted." << std::endl;
+        return 0;
+    }
+
+    BatchProcessor *processor;
+    try {
+        processor = new BatchProcessor(args.at(0));
+    } catch(std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if(!processor->setAlgorithm(parser.value(algorithmOption))) {
+        delete processor;
+        return 1;
+    }
+
+    if(parser.isSet(parametersOption) && !processor->loadParameters(parser.value(parametersOption))) {
+        delete processor;
+        return 1;
+    }
+
+    if(parser.isSet(calibrationOption) && !processor->loadCalibration(parser.value(calibrationOption))) {
+        delete processor;
+        return 1;
+    }
+
+    if(parser.isSet(threadsOption)) {
+        processor->setThreads(parser.value(threadsOption).toInt());
+    }
+
+    processor->enableOutlineConfidence(!parser.isSet(noConfidenceOption));
+
+    QObject::connect(processor, &BatchProcessor::progress, [](int processed, int total) {
+        std::cout << "Processed " << processed << " / " << total << " images" << std::endl;
+    });
+
+    int processed = processor->process(outputFile);
+    delete processor;
+
+    if(!QFileInfo::exists(outputFile)) {
+        std::cerr << "Could not write output file: " << outputFile.toStdString() << std::endl;
+        return 2;
+    }
+
+    std::cout << "Finished, " << processed << " images processed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,347 @@
+
+#include <QtConcurrent/QtConcurrent>
+#include <QtCore/QThread>
+#include <QtCore/QFileInfo>
+#include <opencv2/imgcodecs.hpp>
+#include <fstream>
+#include "batchProcessor.h"
+#include "dataWriter.h"
+#include "pupil-detection-methods/ElSe.h"
+#include "pupil-detection-methods/ExCuSe.h"
+#include "pupil-detection-methods/PuRe.h"
+#include "pupil-detection-methods/PuReST.h"
+#include "pupil-detection-methods/Starburst.h"
+#include "pupil-detection-methods/Swirski2D.h"
+
+#include "subwindows/pupil-detection-methods/json.h"
+// for convenience
+using json = nlohmann::json;
+
+// Creates a new batch processor for the given image directory
+// The directory is checked for a stereo structure with directories 0 and 1 for main and secondary camera, same as in the ImageReader
+BatchProcessor::BatchProcessor(const QString &directory, QObject *parent) :
+        QObject(parent),
+        imageDirectory(directory),
+        stereoMode(false),
+        useOutlineConfidence(true),
+        threads(std::max(1, QThread::idealThreadCount())),
+        algorithm("PuRe"),
+        singleCalibration(nullptr),
+        stereoCalibration(nullptr) {
+
+    if(!imageDirectory.exists()) {
+        throw std::invalid_argument( "Image Directory does not exists." );
+    }
+
+    if(imageDirectory.exists("0") && imageDirectory.exists("1")) {
+        stereoMode = true;
+
+        std::cout<<"BatchProcessor: Found stereo structure in directory, reading as stereo..." << std::endl;
+
+        // glob sorts the names alphabetically, so filenames without zeros like _19 come after _189
+        cv::glob(imageDirectory.filePath("0").toStdString(), filenames, false);
+        cv::glob(imageDirectory.filePath("1").toStdString(), filenamesSecondary, false);
+
+        if(filenames.size() != filenamesSecondary.size()) {
+            throw std::invalid_argument( "Stereo directories 0 and 1 contain a different number of images." );
+        }
+    } else {
+        cv::glob(imageDirectory.path().toStdString(), filenames, false);
+    }
+
+    std::cout<<"BatchProcessor: found " << filenames.size() << " images." << std::endl;
+}
+
+BatchProcessor::~BatchProcessor() {
+    clearMethods();
+    delete singleCalibration;
+    delete stereoCalibration;
+}
+
+// Creates a new instance of the pupil detection algorithm with the given title, returns nullptr for unknown titles
+PupilDetectionMethod* BatchProcessor::createMethod(const std::string &title) {
+
+    if(title == "ElSe")
+        return new ElSe();
+    if(title == "ExCuSe")
+        return new ExCuSe();
+    if(title == "PuRe")
+        return new PuRe();
+    if(title == "PuReST")
+        return new PuReST();
+    if(title == "Starburst")
+        return new Starburst();
+    if(title == "Swirski2D")
+        return new Swirski2D();
+
+    return nullptr;
+}
+
+// Selects the pupil detection algorithm by its title, returns false for unknown algorithms
+bool BatchProcessor::setAlgorithm(const QString &title) {
+
+    PupilDetectionMethod *method = createMethod(title.toStdString());
+    if(!method) {
+        std::cerr << "BatchProcessor: Unknown algorithm: " << title.toStdString() << std::endl;
+        return false;
+    }
+    delete method;
+
+    // Instances are created on processing, once the number of threads is known
+    clearMethods();
+    algorithm = title;
+
+    return true;
+}
+
+// Sets the given value only if the parameter set contains the key
+template<typename T> static void readParameter(const json &parameterSet, const char *key, T &value) {
+    if(parameterSet.contains(key))
+        value = parameterSet[key].get<T>();
+}
+
+// Applies the parameter set of a JSON parameter file to the given algorithm instance
+// The parameter names are the same as in the parameter files loaded in the algorithm settings of the GUI
+static void applyParameters(const json &parameterSet, PupilDetectionMethod *method) {
+
+    if(auto *purest = dynamic_cast<PuReST*>(method)) {
+        readParameter(parameterSet, "meanCanthiDistanceMM", purest->meanCanthiDistanceMM);
+        readParameter(parameterSet, "minPupilDiameterMM", purest->minPupilDiameterMM);
+        readParameter(parameterSet, "maxPupilDiameterMM", purest->maxPupilDiameterMM);
+    } else if(auto *pure = dynamic_cast<PuRe*>(method)) {
+        readParameter(parameterSet, "meanCanthiDistanceMM", pure->meanCanthiDistanceMM);
+        readParameter(parameterSet, "minPupilDiameterMM", pure->minPupilDiameterMM);
+        readParameter(parameterSet, "maxPupilDiameterMM", pure->maxPupilDiameterMM);
+    } else if(auto *p_else = dynamic_cast<ElSe*>(method)) {
+        readParameter(parameterSet, "minAreaRatio", p_else->minAreaRatio);
+        readParameter(parameterSet, "maxAreaRatio", p_else->maxAreaRatio);
+    } else if(auto *excuse = dynamic_cast<ExCuSe*>(method)) {
+        readParameter(parameterSet, "max_ellipse_radi", excuse->max_ellipse_radi);
+        readParameter(parameterSet, "good_ellipse_threshold", excuse->good_ellipse_threshold);
+    } else if(auto *starburst = dynamic_cast<Starburst*>(method)) {
+        readParameter(parameterSet, "edge_threshold", starburst->edge_threshold);
+        readParameter(parameterSet, "rays", starburst->rays);
+        readParameter(parameterSet, "min_feature_candidates", starburst->min_feature_candidates);
+        readParameter(parameterSet, "corneal_reflection_ratio_to_image_size", starburst->corneal_reflection_ratio_to_image_size);
+        readParameter(parameterSet, "crWindowSize", starburst->crWindowSize);
+    } else if(auto *swirski = dynamic_cast<Swirski2D*>(method)) {
+        readParameter(parameterSet, "Radius_Min", swirski->params.Radius_Min);
+        readParameter(parameterSet, "Radius_Max", swirski->params.Radius_Max);
+        readParameter(parameterSet, "CannyBlur", swirski->params.CannyBlur);
+        readParameter(parameterSet, "CannyThreshold1", swirski->params.CannyThreshold1);
+        readParameter(parameterSet, "CannyThreshold2", swirski->params.CannyThreshold2);
+        readParameter(parameterSet, "StarburstPoints", swirski->params.StarburstPoints);
+        readParameter(parameterSet, "PercentageInliers", swirski->params.PercentageInliers);
+        readParameter(parameterSet, "InlierIterations", swirski->params.InlierIterations);
+        readParameter(parameterSet, "EarlyTerminationPercentage", swirski->params.EarlyTerminationPercentage);
+        readParameter(parameterSet, "ImageAwareSupport", swirski->params.ImageAwareSupport);
+        readParameter(parameterSet, "EarlyRejection", swirski->params.EarlyRejection);
+    }
+}
+
+// Loads the algorithm parameters from a JSON parameter file containing a "Parameter Set" object
+// Parameters are applied to all instances of the selected algorithm, keys not contained keep the algorithm defaults
+bool BatchProcessor::loadParameters(const QString &filename) {
+
+    try {
+        std::ifstream file(filename.toStdString());
+        json j;
+        file >> j;
+
+        parameters = j.at("Parameter Set").dump();
+        clearMethods();
+    } catch(...) {
+        std::cerr << "BatchProcessor: Error while loading parameter file: " << filename.toStdString() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Loads a camera calibration file, single or stereo depending on the directory structure
+// With a calibration, the undistorted pupil diameter is calculated and for stereo additionally the physical pupil diameter
+bool BatchProcessor::loadCalibration(const QString &filename) {
+
+    if(stereoMode) {
+        delete stereoCalibration;
+        stereoCalibration = new StereoCameraCalibration();
+        stereoCalibration->loadFromFile(filename);
+
+        if(!stereoCalibration->isCalibrated()) {
+            std::cerr << "BatchProcessor: Could not load stereo calibration: " << filename.toStdString() << std::endl;
+            return false;
+        }
+    } else {
+        delete singleCalibration;
+        singleCalibration = new CameraCalibration();
+        singleCalibration->loadFromFile(filename);
+
+        if(!singleCalibration->isCalibrated()) {
+            std::cerr << "BatchProcessor: Could not load calibration: " << filename.toStdString() << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Creates algorithm instances until count instances exist per camera, new instances are configured with the loaded parameters
+void BatchProcessor::createMethods(int count) {
+
+    while(methods.size() < static_cast<size_t>(count)) {
+        methods.push_back(createMethod(algorithm.toStdString()));
+        methodsSecondary.push_back(createMethod(algorithm.toStdString()));
+
+        if(!parameters.empty()) {
+            json parameterSet = json::parse(parameters);
+            applyParameters(parameterSet, methods.back());
+            applyParameters(parameterSet, methodsSecondary.back());
+        }
+    }
+}
+
+void BatchProcessor::clearMethods() {
+
+    for(auto pm: methods)
+        delete pm;
+    for(auto pm: methodsSecondary)
+        delete pm;
+
+    methods.clear();
+    methodsSecondary.clear();
+}
+
+// Detects the pupil in the given image, same as the pupil detection of the GUI without ROI
+Pupil BatchProcessor::detect(PupilDetectionMethod *method, const cv::Mat &img) {
+
+    Pupil pupil;
+
+    try {
+        if(useOutlineConfidence) {
+            method->runWithConfidence(img, pupil);
+        } else {
+            method->run(img, pupil);
+        }
+    } catch (...) {
+        pupil.clear();
+    }
+
+    pupil.algorithmName = method->title();
+    return pupil;
+}
+
+// Reads and processes the image(s) with the given index using the algorithm instances of the given worker
+// Executed concurrently for different indices and workers
+void BatchProcessor::detectImage(size_t index, size_t worker, Pupil &pupil, Pupil &pupilSecondary) {
+
+    cv::Mat img = cv::imread(filenames[index], cv::IMREAD_GRAYSCALE);
+
+    if(!img.data) {
+        std::cerr << "BatchProcessor: Image could not be read, skipping: " << filenames[index] << std::endl;
+        pupil.clear();
+        pupil.algorithmName = methods[worker]->title();
+        // The secondary pupil is reused between images, it must not keep the result of a previous image
+        pupilSecondary.clear();
+        pupilSecondary.algorithmName = pupil.algorithmName;
+        return;
+    }
+
+    pupil = detect(methods[worker], img);
+
+    if(!stereoMode) {
+        if(singleCalibration)
+            pupil.undistortedDiameter = singleCalibration->undistortPupilDiameter(pupil);
+        return;
+    }
+
+    cv::Mat imgSecondary = cv::imread(filenamesSecondary[index], cv::IMREAD_GRAYSCALE);
+
+    if(!imgSecondary.data) {
+        std::cerr << "BatchProcessor: Image could not be read, skipping: " << filenamesSecondary[index] << std::endl;
+        pupilSecondary.clear();
+        pupilSecondary.algorithmName = pupil.algorithmName;
+        return;
+    }
+
+    pupilSecondary = detect(methodsSecondary[worker], imgSecondary);
+
+    if(stereoCalibration) {
+        std::pair<double, double> diameters = stereoCalibration->undistortPupilDiameters(pupil, pupilSecondary);
+        pupil.undistortedDiameter = diameters.first;
+        pupilSecondary.undistortedDiameter = diameters.second;
+
+        if(pupil.valid(-2.0) && pupilSecondary.valid(-2.0)) {
+            pupil.physicalDiameter = stereoCalibration->physicalPupilDiameter(pupil, pupilSecondary);
+            pupilSecondary.physicalDiameter = pupil.physicalDiameter;
+        }
+    }
+}
+
+// Images recorded by the ImageWriter are named by their timestamp, otherwise the fallback is used
+uint64_t BatchProcessor::filenameTimestamp(const std::string &filename, uint64_t fallback) {
+
+    bool ok = false;
+    uint64_t timestamp = QFileInfo(QString::fromStdString(filename)).completeBaseName().toULongLong(&ok);
+
+    return ok ? timestamp : fallback;
+}
+
+// Processes all images of the directory and writes the pupil detections to the given CSV file
+// Returns the number of processed images
+int BatchProcessor::process(const QString &outputFile) {
+
+    createMethods(1);
+
+    // Stateful algorithms depend on the previous image, thus are processed with a single instance in order
+    int workers = methods.front()->isStateless() ? threads : 1;
+    createMethods(workers);
+
+    DataWriter writer(outputFile, stereoMode ? WriteMode::STEREO : WriteMode::SINGLE);
+
+    std::vector<Pupil> pupils(static_cast<size_t>(workers));
+    std::vector<Pupil> pupilsSecondary(static_cast<size_t>(workers));
+
+    size_t total = filenames.size();
+    size_t processed = 0;
+
+    // Process the images in blocks of one image per worker, results of a block are written in order once all are finished
+    while(processed < total) {
+        size_t block = std::min(static_cast<size_t>(workers), total - processed);
+
+        if(block == 1) {
+            detectImage(processed, 0, pupils[0], pupilsSecondary[0]);
+        } else {
+            QFutureSynchronizer<void> synchronizer;
+            for(size_t w = 0; w < block; w++) {
+                synchronizer.addFuture(QtConcurrent::run([this, &pupils, &pupilsSecondary, processed, w]() {
+                    detectImage(processed + w, w, pupils[w], pupilsSecondary[w]);
+                }));
+            }
+            synchronizer.waitForFinished();
+        }
+
+        for(size_t w = 0; w < block; w++) {
+            size_t index = processed + w;
+            pupils[w].frameNumber = index;
+            pupilsSecondary[w].frameNumber = index;
+
+            uint64_t timestamp = filenameTimestamp(filenames[index], index);
+            QString filename = QString::fromStdString(filenames[index]);
+
+            if(stereoMode) {
+                writer.newStereoPupilData(timestamp, pupils[w], pupilsSecondary[w], filename);
+            } else {
+                writer.newPupilData(timestamp, pupils[w], filename);
+            }
+        }
+
+        processed += block;
+
+        if(processed % 1000 < block || processed == total)
+            emit progress(static_cast<int>(processed), static_cast<int>(total));
+    }
+
+    writer.close();
+
+    return static_cast<int>(processed);
+}
@@ -0,0 +1,103 @@
+
+#ifndef PUPILEXT_BATCHPROCESSOR_H
+#define PUPILEXT_BATCHPROCESSOR_H
+
+/**
+    @author Moritz Lode
+*/
+
+#include <QtCore/QObject>
+#include <QtCore/QDir>
+#include "pupil-detection-methods/PupilDetectionMethod.h"
+#include "cameraCalibration.h"
+#include "stereoCameraCalibration.h"
+
+
+/**
+    Headless pupil detection of recorded image directories, used by the command-line interface (no camera SDK and no widgets needed)
+
+    Supports the same directory layouts as the ImageReader: all images in a single directory, or a stereo structure with the
+    directories 0 (main camera) and 1 (secondary camera) containing images with corresponding filenames
+
+    Images are not played back at a playback speed but processed as fast as possible. For algorithms without state between frames
+    (see PupilDetectionMethod::isStateless()) multiple images are read and detected concurrently, each thread using its own algorithm
+    instances. Stateful algorithms process the images sequentially. Results are always written in image order using the DataWriter,
+    thus the CSV output has the same format as the one written by the GUI.
+
+    The timestamp of an image is taken from its filename, as written by the ImageWriter, if the filename is not a number the image index is used
+
+    setAlgorithm(): select the algorithm by its title i.e. PuRe, PuReST, ElSe, ExCuSe, Starburst, Swirski2D
+    loadParameters(): load algorithm parameters from a JSON parameter file, same format as loaded in the pupil detection settings
+    loadCalibration(): load a single or stereo camera calibration XML file, enables the undistorted and physical pupil diameters
+    process(): detects the pupil in all images of the directory and writes the results to the given CSV file
+
+signals:
+    progress(int processed, int total): emitted periodically during processing
+*/
+class BatchProcessor : public QObject {
+    Q_OBJECT
+
+public:
+
+    explicit BatchProcessor(const QString &directory, QObject *parent = 0);
+    ~BatchProcessor() override;
+
+    static PupilDetectionMethod* createMethod(const std::string &title);
+
+    bool isStereo() {
+        return stereoMode;
+    }
+
+    size_t getImageCount() {
+        return filenames.size();
+    }
+
+    bool setAlgorithm(const QString &title);
+    bool loadParameters(const QString &filename);
+    bool loadCalibration(const QString &filename);
+
+    void setThreads(int value) {
+        threads = std::max(1, value);
+    }
+
+    void enableOutlineConfidence(bool value) {
+        useOutlineConfidence = value;
+    }
+
+    int process(const QString &outputFile);
+
+private:
+
+    QDir imageDirectory;
+    std::vector<std::string> filenames, filenamesSecondary;
+
+    bool stereoMode;
+    bool useOutlineConfidence;
+    int threads;
+
+    QString algorithm;
+    // Parameter set of the loaded parameter file, applied to every created algorithm instance
+    std::string parameters;
+    // Algorithm instances per thread, the main camera instances are also used for single camera directories
+    std::vector<PupilDetectionMethod*> methods;
+    std::vector<PupilDetectionMethod*> methodsSecondary;
+
+    CameraCalibration *singleCalibration;
+    StereoCameraCalibration *stereoCalibration;
+
+    void createMethods(int count);
+    void clearMethods();
+
+    Pupil detect(PupilDetectionMethod *method, const cv::Mat &img);
+    void detectImage(size_t index, size_t worker, Pupil &pupil, Pupil &pupilSecondary);
+
+    static uint64_t filenameTimestamp(const std::string &filename, uint64_t fallback);
+
+signals:
+
+    void progress(int processed, int total);
+
+};
+
+
+#endif //PUPILEXT_BATCHPROCESSOR_H
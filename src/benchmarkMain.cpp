@@ -0,0 +1,122 @@
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QDateTime>
+#include <opencv2/core.hpp>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include "pupilDetectionBenchmark.h"
+
+// Command-line micro-benchmark of the pupil detection algorithms over a directory of eye images
+// Each algorithm is measured for every resolution, with and without outline confidence and with and without ROI pre-processing
+//
+// Usage: PupilEXT-benchmark [options] <directory>
+// i.e. PupilEXT-benchmark --algorithms PuRe,ElSe --resolutions 640x480,1280x1024 --output results.json /data/eyes
+//
+// Results are printed as table and written as JSON, to compare builds against each other
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("PupilEXT-benchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Latency, throughput and memory benchmark of the pupil detection algorithms.");
+    parser.addHelpOption();
+
+    parser.addPositionalArgument("directory", "Directory containing eye images.");
+
+    QCommandLineOption algorithmsOption("algorithms", "Comma separated list of algorithms. Default ElSe,ExCuSe,PuRe,PuReST,Starburst,Swirski2D.", "names", "ElSe,ExCuSe,PuRe,PuReST,Starburst,Swirski2D");
+    QCommandLineOption resolutionsOption("resolutions", "Comma separated list of resolutions. Default 320x240,640x480,1280x1024,2048x1536.", "sizes", "320x240,640x480,1280x1024,2048x1536");
+    QCommandLineOption maxImagesOption("max-images", "Maximum number of images loaded from the directory, 0 for all. Default 100.", "count", "100");
+    QCommandLineOption warmupOption("warmup", "Number of not measured frames before each measurement. Default 10.", "count", "10");
+    QCommandLineOption roiScaleOption("roi-scale", "Size of the centered ROI relative to the image size. Default 0.5.", "scale", "0.5");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Output JSON file. Default benchmark.json.", "file", "benchmark.json");
+
+    parser.addOption(algorithmsOption);
+    parser.addOption(resolutionsOption);
+    parser.addOption(maxImagesOption);
+    parser.addOption(warmupOption);
+    parser.addOption(roiScaleOption);
+    parser.addOption(outputOption);
+
+    parser.process(a);
+
+    const QStringList args = parser.positionalArguments();
+    if(args.size() != 1) {
+        parser.showHelp(1);
+    }
+
+    std::vector<cv::Size> resolutions;
+    for(const QString &value: parser.value(resolutionsOption).split(',', Qt::SkipEmptyParts)) {
+        QStringList size = value.split('x');
+        int width = size.size() == 2 ? size[0].toInt() : 0;
+        int height = size.size() == 2 ? size[1].toInt() : 0;
+        if(width <= 0 || height <= 0) {
+            std::cerr << "Invalid resolution: " << value.toStdString() << std::endl;
+            return 1;
+        }
+        resolutions.emplace_back(width, height);
+    }
+
+    QStringList algorithms = parser.value(algorithmsOption).split(',', Qt::SkipEmptyParts);
+
+    PupilDetectionBenchmark benchmark(args.at(0).toStdString(), parser.value(maxImagesOption).toInt());
+    benchmark.setWarmupFrames(parser.value(warmupOption).toInt());
+    benchmark.setROIScale(parser.value(roiScaleOption).toFloat());
+
+    if(benchmark.getImageCount() == 0) {
+        std::cerr << "No images found in directory: " << args.at(0).toStdString() << std::endl;
+        return 1;
+    }
+
+    nlohmann::json results = nlohmann::json::array();
+
+    std::cout << std::left << std::setw(10) << "Algorithm" << std::setw(11) << "Resolution" << std::setw(6) << "Conf" << std::setw(5) << "ROI"
+              << std::right << std::setw(9) << "p50 ms" << std::setw(9) << "p95 ms" << std::setw(9) << "p99 ms" << std::setw(9) << "FPS"
+              << std::setw(9) << "Allocs" << std::setw(9) << "Mats" << std::setw(12) << "RSS KB" << std::endl;
+
+    for(const cv::Size &resolution: resolutions) {
+        benchmark.setResolution(resolution);
+
+        for(const QString &algorithm: algorithms) {
+            for(bool roi: {false, true}) {
+                for(bool outlineConfidence: {false, true}) {
+                    BenchmarkResult result = benchmark.run(algorithm.toStdString(), outlineConfidence, roi);
+
+                    if(result.frames == 0) {
+                        std::cerr << "Unknown algorithm: " << algorithm.toStdString() << std::endl;
+                        return 1;
+                    }
+
+                    std::cout << std::left << std::setw(10) << result.algorithm
+                              << std::setw(11) << (std::to_string(resolution.width) + "x" + std::to_string(resolution.height))
+                              << std::setw(6) << (outlineConfidence ? "yes" : "no") << std::setw(5) << (roi ? "yes" : "no")
+                              << std::right << std::fixed << std::setprecision(2)
+                              << std::setw(9) << result.p50Latency << std::setw(9) << result.p95Latency << std::setw(9) << result.p99Latency
+                              << std::setw(9) << result.throughput << std::setw(9) << result.allocationsPerFrame
+                              << std::setw(9) << result.matAllocationsPerFrame << std::setw(12) << result.peakRSS << std::endl;
+
+                    results.push_back(PupilDetectionBenchmark::toJson(result));
+                }
+            }
+        }
+    }
+
+    nlohmann::json j;
+    j["date"] = QDateTime::currentDateTime().toString(Qt::ISODate).toStdString();
+    j["directory"] = args.at(0).toStdString();
+    j["images"] = benchmark.getImageCount();
+    j["opencvVersion"] = CV_VERSION;
+    j["opencvThreads"] = cv::getNumThreads();
+    j["results"] = results;
+
+    std::ofstream file(parser.value(outputOption).toStdString());
+    if(!file.is_open()) {
+        std::cerr << "Could not write output file: " << parser.value(outputOption).toStdString() << std::endl;
+        return 2;
+    }
+    file << std::setw(4) << j << std::endl;
+
+    return 0;
+}
@@ -36,6 +36,8 @@ CameraCalibration::~CameraCalibration() {
 
 // Resets the calibration state and all values calculated by a previous calibration
 void CameraCalibration::reset() {
+    QWriteLocker locker(&undistortLock);
+
     mode = NONE;
     captureCount = 0;
     intrinsicRMSE = 0;
@@ -47,6 +49,8 @@ void CameraCalibration::reset() {
     cameraMatrix.at<double>(0,0) = 1.0;
 
     distCoeffs = cv::Mat::zeros(8, 1, CV_64F);
+    locker.unlock();
+
     emit unavailableCalibration();
 }
 
@@ -62,7 +66,9 @@ void CameraCalibration::startCapturing() {
 // Starts the verification of a existing calibration
 // Images are detected for calibration pattern and based on their detection pattern a calibration error is calculated (reprojection error)
 void CameraCalibration::startVerifying() {
+    undistortLock.lockForWrite();
     mode = VERIFYING;
+    undistortLock.unlock();
     captureCount = 0;
 
     verifyHistory.clear();
@@ -73,8 +79,10 @@ void CameraCalibration::startVerifying() {
 
 // Stops the current process i.e. capturing or verification
 void CameraCalibration::stop() {
+    QWriteLocker locker(&undistortLock);
     if(mode == VERIFYING) {
         mode = CALIBRATED;
+        locker.unlock();
         if(!verifyOutputPath.isEmpty()) {
             // MAE_px is an average over the feature points of each image
             writeVectorCSV(verifyHistory, "frame,timestamp,MAE_px", verifyOutputPath.toStdString());
@@ -202,12 +210,15 @@ void CameraCalibration::onNewImage(const CameraImage &cimg) {
         emit processedImage(mimg);
 
         if(calibrationSuccess.isFinished() && calibrationSuccess.result()) {
-            // Calibration finished, change state and calculate undistort-matrix for image undistortion
-            mode = CALIBRATED;
+            // Calibration finished, calculate undistort-matrix for image undistortion and change state
+            undistortLock.lockForWrite();
 
             // Initials the maps for image mapping for undistortion using cv::remap
             newCameraMatrix = getOptimalNewCameraMatrix(cameraMatrix, distCoeffs, imageSize, 1, imageSize, 0);
             initUndistortRectifyMap(cameraMatrix, distCoeffs, cv::Mat(), newCameraMatrix, imageSize, CV_32F, undistMap1, undistMap2);
+            mode = CALIBRATED;
+
+            undistortLock.unlock();
 
             emit finishedCalibration();
         } else if(calibrationSuccess.isFinished() && !calibrationSuccess.result()) {
@@ -510,19 +521,26 @@ void CameraCalibration::loadFromFile(QString filename) {
     // If the calibration is "valid", calculate mappings for the undistortion
     if(cv::checkRange(cameraMatrix) && cv::checkRange(distCoeffs)) {
 
+        undistortLock.lockForWrite();
         newCameraMatrix = getOptimalNewCameraMatrix(cameraMatrix, distCoeffs, imageSize, 1, imageSize, 0);
         initUndistortRectifyMap(cameraMatrix, distCoeffs, cv::Mat(), newCameraMatrix, imageSize, CV_32F, undistMap1, undistMap2);
 
-        if(cv::checkRange(undistMap1) && cv::checkRange(undistMap2)) {
+        bool valid = cv::checkRange(undistMap1) && cv::checkRange(undistMap2);
+        if(valid)
             mode = CALIBRATED;
+        undistortLock.unlock();
+
+        if(valid)
             emit finishedCalibration();
-        }
     }
 }
 
 // Undistorts a given image using the calibration
 // If no calibration is load, the unchanged image is returned
-cv::Mat CameraCalibration::undistortImage(const cv::Mat &img) {
+// The maps are only read, concurrent calls share the read lock and only wait for a calibration which is replaced meanwhile
+cv::Mat CameraCalibration::undistortImage(const cv::Mat &img) const {
+    QReadLocker locker(&undistortLock);
+
     // Undistorting using remap should be faster than using the undistort function
     if(mode!=CALIBRATED)
         return img;
@@ -534,7 +552,9 @@ cv::Mat CameraCalibration::undistortImage(const cv::Mat &img) {
 
 // Undistorts only the pupil size of a given pupil detection, rather then the complete image (faster)
 // This is done by undistorting only contour points of the pupil and calculating the new pupil size using the undistorted points
-double CameraCalibration::undistortPupilDiameter(const Pupil &pupil) {
+double CameraCalibration::undistortPupilDiameter(const Pupil &pupil) const {
+    QReadLocker locker(&undistortLock);
+
     // Undistorting using remap should be faster than using the undistort function
     if(mode!=CALIBRATED || !pupil.valid(-2))
         return pupil.diameter();
@@ -10,6 +10,7 @@
 #include <opencv2/core/mat.hpp>
 #include <QtCore/QElapsedTimer>
 #include <QtCore/QMutex>
+#include <QtCore/QReadWriteLock>
 #include "devices/camera.h"
 #include "pupil-detection-methods/Pupil.h"
 #include <QtConcurrent/QtConcurrent>
@@ -155,7 +156,8 @@ public:
         return imageSize;
     }
 
-    cv::Mat undistortImage(const cv::Mat &img);
+    // Thread-safe, may be called concurrently i.e. by the parallel pupil detection workers (see undistortLock)
+    cv::Mat undistortImage(const cv::Mat &img) const;
 
     void setVerifyOutputPath(QString path) {
         verifyOutputPath = path;
@@ -165,12 +167,17 @@ public:
         return verifyOutputPath;
     }
 
-    double undistortPupilDiameter(const Pupil &pupil);
+    // Thread-safe, may be called concurrently i.e. by the parallel pupil detection workers (see undistortLock)
+    double undistortPupilDiameter(const Pupil &pupil) const;
 
 private:
 
     QMutex mutex;
 
+    // Guards the calibrated state against the undistortion of other threads, the undistort functions only read the mode, camera
+    // matrices and undistortion maps under the read lock, these are only replaced under the write lock while leaving or entering CALIBRATED
+    mutable QReadWriteLock undistortLock;
+
     std::vector<std::vector<cv::Point2f>> imagePoints;
 
     std::vector<std::vector<cv::Point3f>> referenceObjectPoints;
@@ -1,14 +1,25 @@
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <QtCore/qfileinfo.h>
 #include "dataWriter.h"
+#include "pupilLog.h"
 
-// TODO datawriter is receiving pupil signal at the full rate, slowing down the gui thread? move to other thread?
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
-DataWriter::DataWriter(const QString& fileName, int mode, QObject *parent) : QObject(parent) {
+// Rows are collected up to this size before being written to the file
+static const size_t defaultFlushSize = 256 * 1024;
+
+DataWriter::DataWriter(const QString& fileName, int mode, QObject *parent) : QObject(parent), flushTimer(new QTimer(this)), binary(PupilLog::isPupilLog(fileName)), flushSize(defaultFlushSize) {
 
     // Header definitions of the output file, this must fit the output format in the pupilToRow functions
-    header = "filename,timestamp_ms,algorithm,diameter_px,undistortedDiameter_px,physicalDiameter_mm,width_px,height_px,axisRatio,center_x,center_y,angle_deg,circumference_px,confidence,outlineConfidence";
-    stereoHeader = "filename,timestamp_ms,algorithm,diameterMain_px,diameterSec_px,undistortedDiameterMain_px,undistortedDiameterSec_px,physicalDiameter_mm,widthMain_px,heightMain_px,axisRatioMain,widthSec_px,heightSec_px,axisRatioSec,centerMain_x,centerMain_y,centerSec_x,centerSec_y,angleMain_deg,angleSec_deg,circumferenceMain_px,circumferenceSec_px,confidenceMain,outlineConfidenceMain,confidenceSec,outlineConfidenceSec";
+    header = "filename,timestamp_ms,algorithm,diameter_px,undistortedDiameter_px,physicalDiameter_mm,width_px,height_px,axisRatio,center_x,center_y,angle_deg,circumference_px,confidence,outlineConfidence,frameNumber";
+    stereoHeader = "filename,timestamp_ms,algorithm,diameterMain_px,diameterSec_px,undistortedDiameterMain_px,undistortedDiameterSec_px,physicalDiameter_mm,widthMain_px,heightMain_px,axisRatioMain,widthSec_px,heightSec_px,axisRatioSec,centerMain_x,centerMain_y,centerSec_x,centerSec_y,angleMain_deg,angleSec_deg,circumferenceMain_px,circumferenceSec_px,confidenceMain,outlineConfidenceMain,confidenceSec,outlineConfidenceSec,frameNumber";
 
     std::cout<<fileName.toStdString()<<std::endl;
 
@@ -16,125 +27,360 @@ DataWriter::DataWriter(const QString& fileName, int mode, QObject *parent) : QOb
 
     bool exists = dataFile->exists();
 
+    // Records are only appended to an existing binary log with the same schema
+    if(binary && exists) {
+        PupilLogHeader logHeader;
+        bool compatible = dataFile->open(QIODevice::ReadOnly) && PupilLog::readHeader(*dataFile, logHeader) && logHeader.mode == static_cast<uint32_t>(mode);
+        dataFile->close();
+
+        if(!compatible) {
+            std::cout << "Recording failure. Existing file is no binary pupil log of the same mode: " << fileName.toStdString() << std::endl;
+            delete dataFile;
+            dataFile = nullptr;
+            return;
+        }
+
+        // A log of a crashed recording may end with a partial record, which would misalign all records appended after it
+        qint64 size = dataFile->size();
+        qint64 recordsSize = std::max<qint64>(0, size - logHeader.headerSize);
+        qint64 validSize = logHeader.headerSize + recordsSize / logHeader.recordSize * logHeader.recordSize;
+        if(validSize != size) {
+            std::cout << "Recording: Removing partial record at the end of: " << fileName.toStdString() << std::endl;
+            if(!dataFile->resize(validSize)) {
+                std::cout << "Recording failure. Could not remove the partial record: " << fileName.toStdString() << std::endl;
+                delete dataFile;
+                dataFile = nullptr;
+                return;
+            }
+        }
+    }
+
     // Open the file in append mode
-    if (!dataFile->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+    QIODevice::OpenMode openMode = binary ? (QIODevice::WriteOnly | QIODevice::Append) : (QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+    if (!dataFile->open(openMode)) {
         std::cout << "Recording failure. Could not open: " << fileName.toStdString() << std::endl;
         delete dataFile;
         dataFile = nullptr;
+        return;
     }
 
-    textStream = new QTextStream(dataFile);
+    buffer.reserve(flushSize + 4096);
 
     // To not write again a header line to the file when it already existed (appending), check it
-    if(!exists) {
+    if(!exists && binary) {
+        buffer += PupilLog::createHeader(mode);
+        flush();
+    } else if(!exists) {
         if(mode==WriteMode::SINGLE) {
-            *textStream << header << Qt::endl;
+            buffer += header.toStdString();
+            buffer += '\n';
         } else if(mode==WriteMode::STEREO) {
-            *textStream << stereoHeader << Qt::endl;
+            buffer += stereoHeader.toStdString();
+            buffer += '\n';
         }
+        flush();
     }
+
+    // Rows arriving slowly are still written regularly, the timer moves with the object into the writer thread
+    connect(flushTimer, SIGNAL(timeout()), this, SLOT(flush()));
+    flushTimer->start(1000);
 }
 
 DataWriter::~DataWriter() {
     close();
 }
 
-// Close the file and fielstreams
+// Writes the remaining rows, syncs the file to disk and closes it
 void DataWriter::close() {
 
-    if (dataFile){
+    flushTimer->stop();
+
+    if (dataFile) {
+        flush();
+        dataFile->flush();
+
+        // Make sure the recording is on disk when the recording is stopped, not only in the OS cache
+#if defined(_WIN32)
+        _commit(dataFile->handle());
+#else
+        fsync(dataFile->handle());
+#endif
+
         dataFile->close();
-        dataFile->deleteLater();
     }
-    delete textStream;
     delete dataFile;
     dataFile = nullptr;
-    textStream = nullptr;
+}
+
+// Writes the row buffer to the file in a single block
+void DataWriter::flush() {
+
+    if (!dataFile || buffer.empty())
+        return;
+
+    if (dataFile->write(buffer.data(), static_cast<qint64>(buffer.size())) != static_cast<qint64>(buffer.size())) {
+        std::cerr << "DataWriter: Could not write to file: " << dataFile->fileName().toStdString() << std::endl;
+    }
+    buffer.clear();
+}
+
+// Called after each appended row, writes the buffer once it is full
+void DataWriter::rowWritten() {
+    if (buffer.size() >= flushSize)
+        flush();
 }
 
 // On new pupil data, write the pupil detection to file in a new row
 void DataWriter::newPupilData(quint64 timestamp, const Pupil &pupil, const QString &filename) {
 
-    if (!textStream)
+    if (!dataFile)
         return;
 
-    if (textStream->status() == QTextStream::Ok) {
-        *textStream<<pupilToRow(timestamp, pupil, filename) << Qt::endl;
+    if (binary) {
+        PupilLog::appendRecord(buffer, timestamp, pupil, filename);
+    } else {
+        pupilToRow(buffer, timestamp, pupil, filename);
     }
+    rowWritten();
 }
 
 // Upon a new stereo pupil detection, write it to file in a new row (stereo format)
 void DataWriter::newStereoPupilData(quint64 timestamp, const Pupil &pupil, const Pupil &pupilSec, const QString &filename) {
 
-    if (!textStream)
+    if (!dataFile)
         return;
 
-    if (textStream->status() == QTextStream::Ok) {
-        *textStream<<pupilToStereoRow(timestamp, pupil, pupilSec, filename) << Qt::endl;
+    if (binary) {
+        PupilLog::appendStereoRecord(buffer, timestamp, pupil, pupilSec, filename);
+    } else {
+        pupilToStereoRow(buffer, timestamp, pupil, pupilSec, filename);
     }
+    rowWritten();
 }
 
-// Converts a pupil detection to a string row that is written to file
-// CAUTION: This must exactly reproduce the format defined by the header fields
-QString DataWriter::pupilToRow(quint64 timestamp, const Pupil &pupil, const QString &filepath) {
+// Appends an unsigned integer in decimal
+void DataWriter::appendNumber(std::string &out, uint64_t value) {
 
-    QString filename = "-1";
-    if(!filepath.isEmpty())
-        filename = QFileInfo(filepath).fileName();
+    char digits[20];
+    int length = 0;
+    do {
+        digits[length++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
 
-    //"filename,timestamp[ms],algorithm,diameter[px],physicaldiameter[mm],width[px],height[px],axis_ratio,center_x,center_y,angle[deg],circumference[px],confidence,outline_confidence";
+    while (length > 0)
+        out += digits[--length];
+}
+
+// Appends a signed integer in decimal
+void DataWriter::appendNumber(std::string &out, int value) {
 
-    return filename + ',' + QString::number(timestamp) + ',' + QString::fromStdString(pupil.algorithmName) + ',' + QString::number(pupil.diameter()) + ',' + QString::number(pupil.undistortedDiameter)  + ',' + QString::number(pupil.physicalDiameter)
-        + ',' + QString::number(pupil.width()) + ',' + QString::number(pupil.height()) + ',' + QString::number((double)pupil.width() / pupil.height())
-        + ',' + QString::number(pupil.center.x) + ',' + QString::number(pupil.center.y) + ',' + QString::number(pupil.angle)
-        + ',' + QString::number(pupil.circumference()) + ',' + QString::number(pupil.confidence) + ',' + QString::number(pupil.outline_confidence);
+    if (value < 0) {
+        out += '-';
+        appendNumber(out, static_cast<uint64_t>(-static_cast<int64_t>(value)));
+    } else {
+        appendNumber(out, static_cast<uint64_t>(value));
+    }
 }
 
-// Converts a pupil detection to a string row that is written to file
+// Appends a floating point value with 6 significant digits, identical to QString::number(value) and printf("%g")
+// The digits are computed with a single scaling and integer rounding, values which can not be rounded safely this way
+// (ties, very large or small exponents) are formatted by snprintf
+// Non-finite values are written like Qt does, without sign for NaN, as printf would write "-nan" for the default NaN of x86
+void DataWriter::appendNumber(std::string &out, double value) {
+
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    if (std::isnan(value)) {
+        out += "nan";
+        return;
+    }
+
+    if (std::isinf(value)) {
+        out += value < 0 ? "-inf" : "inf";
+        return;
+    }
+
+    if (value == 0.0 && !std::signbit(value)) {
+        out += '0';
+        return;
+    }
+
+    double magnitude = std::fabs(value);
+    int exponent = std::isfinite(magnitude) && magnitude > 0.0 ? static_cast<int>(std::floor(std::log10(magnitude))) : 0;
+    int shift = 5 - exponent;
+
+    double scaled = 0.0;
+    bool exact = std::isfinite(magnitude) && magnitude > 0.0 && std::abs(shift) <= 22;
+    if (exact) {
+        scaled = shift >= 0 ? magnitude * powers[shift] : magnitude / powers[-shift];
+
+        // log10 may be off by one near powers of ten, bring the value into [100000, 1000000)
+        if (scaled < 100000.0 && shift < 22) {
+            exponent--;
+            shift++;
+            scaled = shift >= 0 ? magnitude * powers[shift] : magnitude / powers[-shift];
+        } else if (scaled >= 1000000.0 && shift > -22) {
+            exponent++;
+            shift--;
+            scaled = shift >= 0 ? magnitude * powers[shift] : magnitude / powers[-shift];
+        }
+
+        double fraction = scaled - std::floor(scaled);
+        exact = scaled >= 100000.0 && scaled < 1000000.0 && std::fabs(fraction - 0.5) > 1e-6;
+    }
+
+    if (!exact) {
+        char text[32];
+        int length = std::snprintf(text, sizeof(text), "%g", value);
+        if (length > 0)
+            out.append(text, static_cast<size_t>(std::min(length, static_cast<int>(sizeof(text)) - 1)));
+        return;
+    }
+
+    uint64_t significand = static_cast<uint64_t>(scaled + 0.5);
+    if (significand == 1000000) {
+        significand = 100000;
+        exponent++;
+    }
+
+    // Six significant digits, trailing zeros are removed as by %g
+    char digits[6];
+    for (int i = 5; i >= 0; i--) {
+        digits[i] = static_cast<char>('0' + significand % 10);
+        significand /= 10;
+    }
+    int count = 6;
+    while (count > 1 && digits[count - 1] == '0')
+        count--;
+
+    if (value < 0)
+        out += '-';
+
+    if (exponent < -4 || exponent >= 6) {
+        out += digits[0];
+        if (count > 1) {
+            out += '.';
+            out.append(digits + 1, static_cast<size_t>(count - 1));
+        }
+        out += 'e';
+        out += exponent < 0 ? '-' : '+';
+        int absExponent = std::abs(exponent);
+        if (absExponent < 10)
+            out += '0';
+        appendNumber(out, static_cast<uint64_t>(absExponent));
+    } else if (exponent >= 0) {
+        int integerDigits = exponent + 1;
+        for (int i = 0; i < integerDigits; i++)
+            out += i < count ? digits[i] : '0';
+        if (count > integerDigits) {
+            out += '.';
+            out.append(digits + integerDigits, static_cast<size_t>(count - integerDigits));
+        }
+    } else {
+        out += "0.";
+        out.append(static_cast<size_t>(-exponent - 1), '0');
+        out.append(digits, static_cast<size_t>(count));
+    }
+}
+
+// Appends the filename without directory of the given path, or -1 if no path is given
+void DataWriter::appendFilename(std::string &out, const QString &filepath) {
+
+    if (filepath.isEmpty()) {
+        out += "-1";
+        return;
+    }
+
+    out += QFileInfo(filepath).fileName().toStdString();
+}
+
+// Converts a pupil detection to a row that is appended to the given buffer
 // CAUTION: This must exactly reproduce the format defined by the header fields
-QString DataWriter::pupilToStereoRow(quint64 timestamp, const Pupil &pupil, const Pupil &pupilSec, const QString &filepath) {
+void DataWriter::pupilToRow(std::string &out, quint64 timestamp, const Pupil &pupil, const QString &filepath) {
+
+    //"filename,timestamp[ms],algorithm,diameter[px],physicaldiameter[mm],width[px],height[px],axis_ratio,center_x,center_y,angle[deg],circumference[px],confidence,outline_confidence,frame_number";
+    // The frame number is the camera image number, gaps in it show images dropped by the camera or the pupil detection frame queue
+
+    appendFilename(out, filepath);
+    out += ','; appendNumber(out, static_cast<uint64_t>(timestamp));
+    out += ','; out += pupil.algorithmName;
+    out += ','; appendNumber(out, pupil.diameter());
+    out += ','; appendNumber(out, static_cast<double>(pupil.undistortedDiameter));
+    out += ','; appendNumber(out, static_cast<double>(pupil.physicalDiameter));
+    out += ','; appendNumber(out, pupil.width());
+    out += ','; appendNumber(out, pupil.height());
+    out += ','; appendNumber(out, (double)pupil.width() / pupil.height());
+    out += ','; appendNumber(out, static_cast<double>(pupil.center.x));
+    out += ','; appendNumber(out, static_cast<double>(pupil.center.y));
+    out += ','; appendNumber(out, static_cast<double>(pupil.angle));
+    out += ','; appendNumber(out, static_cast<double>(pupil.circumference()));
+    out += ','; appendNumber(out, static_cast<double>(pupil.confidence));
+    out += ','; appendNumber(out, static_cast<double>(pupil.outline_confidence));
+    out += ','; appendNumber(out, static_cast<uint64_t>(pupil.frameNumber));
+    out += '\n';
+}
 
-    QString filename = "-1";
-    if(!filepath.isEmpty())
-        filename = QFileInfo(filepath).fileName();
+// Converts a stereo pupil detection to a row that is appended to the given buffer
+// CAUTION: This must exactly reproduce the format defined by the header fields
+void DataWriter::pupilToStereoRow(std::string &out, quint64 timestamp, const Pupil &pupil, const Pupil &pupilSec, const QString &filepath) {
 
     //"filename,timestamp[ms],algorithm,diameter[px],diameterSec[px],physicaldiameter[mm],width[px],height[px],axis_ratio,widthSec[px],heightSec[px],axis_ratioSec,center_x,center_y,center_xSec,center_ySec,angle[deg],angleSec[deg],circumference[px],circumferenceSec[px],confidence,outline_confidence,confidenceSec,outline_confidenceSec";
 
-    return filename + ',' + QString::number(timestamp) + ',' + QString::fromStdString(pupil.algorithmName) + ',' + QString::number(pupil.diameter()) + ',' + QString::number(pupilSec.diameter())
-           + ',' + QString::number(pupil.undistortedDiameter) + ',' + QString::number(pupilSec.undistortedDiameter)
-           + ',' + QString::number(pupil.physicalDiameter) + ',' + QString::number(pupil.width()) + ',' + QString::number(pupil.height()) + ',' + QString::number((double)pupil.width() / pupil.height())
-           + ',' + QString::number(pupilSec.width()) + ',' + QString::number(pupilSec.height()) + ',' + QString::number((double)pupilSec.width() / pupilSec.height())
-           + ',' + QString::number(pupil.center.x) + ',' + QString::number(pupil.center.y) + ',' + QString::number(pupilSec.center.x) + ',' + QString::number(pupilSec.center.y)
-           + ',' + QString::number(pupil.angle) + ',' + QString::number(pupilSec.angle)
-           + ',' + QString::number(pupil.circumference()) + ',' + QString::number(pupilSec.circumference()) + ',' + QString::number(pupil.confidence) + ',' + QString::number(pupil.outline_confidence)
-           + ',' + QString::number(pupilSec.confidence) + ',' + QString::number(pupilSec.outline_confidence);
+    appendFilename(out, filepath);
+    out += ','; appendNumber(out, static_cast<uint64_t>(timestamp));
+    out += ','; out += pupil.algorithmName;
+    out += ','; appendNumber(out, pupil.diameter());
+    out += ','; appendNumber(out, pupilSec.diameter());
+    out += ','; appendNumber(out, static_cast<double>(pupil.undistortedDiameter));
+    out += ','; appendNumber(out, static_cast<double>(pupilSec.undistortedDiameter));
+    out += ','; appendNumber(out, static_cast<double>(pupil.physicalDiameter));
+    out += ','; appendNumber(out, pupil.width());
+    out += ','; appendNumber(out, pupil.height());
+    out += ','; appendNumber(out, (double)pupil.width() / pupil.height());
+    out += ','; appendNumber(out, pupilSec.width());
+    out += ','; appendNumber(out, pupilSec.height());
+    out += ','; appendNumber(out, (double)pupilSec.width() / pupilSec.height());
+    out += ','; appendNumber(out, static_cast<double>(pupil.center.x));
+    out += ','; appendNumber(out, static_cast<double>(pupil.center.y));
+    out += ','; appendNumber(out, static_cast<double>(pupilSec.center.x));
+    out += ','; appendNumber(out, static_cast<double>(pupilSec.center.y));
+    out += ','; appendNumber(out, static_cast<double>(pupil.angle));
+    out += ','; appendNumber(out, static_cast<double>(pupilSec.angle));
+    out += ','; appendNumber(out, static_cast<double>(pupil.circumference()));
+    out += ','; appendNumber(out, static_cast<double>(pupilSec.circumference()));
+    out += ','; appendNumber(out, static_cast<double>(pupil.confidence));
+    out += ','; appendNumber(out, static_cast<double>(pupil.outline_confidence));
+    out += ','; appendNumber(out, static_cast<double>(pupilSec.confidence));
+    out += ','; appendNumber(out, static_cast<double>(pupilSec.outline_confidence));
+    out += ','; appendNumber(out, static_cast<uint64_t>(pupil.frameNumber));
+    out += '\n';
 }
 
 // Given a set of pupil detections, the functions writes the complete set to file
 void DataWriter::writePupilData(const std::vector<Pupil>& pupilData) {
 
-    if (textStream == nullptr)
+    if (!dataFile)
         return;
 
     int framePos = 0;
     for(const auto& pupil: pupilData) {
-        if (textStream->status() == QTextStream::Ok) {
-            *textStream << pupilToRow(static_cast<quint64>(framePos), pupil, "") << Qt::endl;
-        }
+        newPupilData(static_cast<quint64>(framePos), pupil, "");
         ++framePos;
     }
+    flush();
 }
 // Given a set of pupil detections, the functions writes the complete set to file
 void DataWriter::writeStereoPupilData(const std::vector<std::tuple<Pupil, Pupil>>& pupilData) {
 
-    if (textStream == nullptr)
+    if (!dataFile)
         return;
 
     int framePos = 0;
     for(const auto& pupil_tup: pupilData) {
-        if (textStream->status() == QTextStream::Ok) {
-            *textStream<<pupilToStereoRow(static_cast<quint64>(framePos), std::get<0>(pupil_tup), std::get<1>(pupil_tup), "") << Qt::endl;
-        }
+        newStereoPupilData(static_cast<quint64>(framePos), std::get<0>(pupil_tup), std::get<1>(pupil_tup), "");
         ++framePos;
     }
+    flush();
 }
@@ -7,7 +7,8 @@
 
 #include <QtCore/QObject>
 #include <QtCore/QFile>
-#include <QtCore/QTextStream>
+#include <QtCore/QTimer>
+#include <string>
 #include "pupil-detection-methods/Pupil.h"
 
 
@@ -17,11 +18,21 @@ enum WriteMode {SINGLE = 0, STEREO = 1};
 /**
     Class to persist the pupil detection information on disk, in a CSV, comma-separated format
 
-    File is created and opened upon construction, and closed upon destruction
+    File is created and opened upon construction, and closed upon destruction, isOpen() tells whether opening succeeded
 
-    newPupilData(): called for each new pupil data, writes the pupil data to the file stream (which is flushes its content to disk occasionally)
+    If the filename has the extension of the binary pupil log (.pxl), fixed-width binary records are written instead of CSV rows,
+    see PupilLog, which can be converted to CSV afterwards. When appending to an existing log, a partial record at its end (i.e. of a
+    crashed recording) is removed first.
+
+    Rows are formatted into a reusable buffer, which is written to the file in large blocks once it exceeds flushSize bytes or
+    each second by a timer. On close, the remaining buffer is written and the file is synced to disk. The GUI moves the data writer
+    into its own thread (see MainWindow::onRecordClick), so that neither formatting nor writing run on the GUI thread.
+
+    newPupilData(): called for each new pupil data, appends the pupil data to the row buffer
 
     writePupilData(): given a vector of pupil data, write all its entries to file
+
+    close(): writes the remaining rows, syncs and closes the file, must be called in the thread of the data writer
 */
 class DataWriter : public QObject {
     Q_OBJECT
@@ -30,11 +41,18 @@ public:
 
     explicit DataWriter(const QString& fileName, int mode=WriteMode::SINGLE, QObject *parent = 0);
     ~DataWriter() override;
-    void close();
+
+    bool isOpen() const {
+        return dataFile != nullptr;
+    }
 
     void writePupilData(const std::vector<Pupil>& pupilData);
     void writeStereoPupilData(const std::vector<std::tuple<Pupil, Pupil>> &pupilData);
 
+    static void appendNumber(std::string &out, double value);
+    static void appendNumber(std::string &out, uint64_t value);
+    static void appendNumber(std::string &out, int value);
+
 private:
 
     QString method;
@@ -42,16 +60,27 @@ private:
     QString stereoHeader;
 
     QFile *dataFile;
-    QTextStream *textStream;
+    QTimer *flushTimer;
 
-    static QString pupilToRow(quint64 timestamp, const Pupil &pupil, const QString &filepath);
-    static QString pupilToStereoRow(quint64 timestamp, const Pupil &pupil, const Pupil &pupilSec, const QString &filepath);
+    bool binary;
+
+    std::string buffer;
+    size_t flushSize;
+
+    static void appendFilename(std::string &out, const QString &filepath);
+    static void pupilToRow(std::string &out, quint64 timestamp, const Pupil &pupil, const QString &filepath);
+    static void pupilToStereoRow(std::string &out, quint64 timestamp, const Pupil &pupil, const Pupil &pupilSec, const QString &filepath);
+
+    void rowWritten();
 
 public slots:
 
     void newPupilData(quint64 timestamp, const Pupil &pupil, const QString &filename);
     void newStereoPupilData(quint64 timestamp, const Pupil &pupil, const Pupil &pupilSec, const QString &filename);
 
+    void flush();
+    void close();
+
 };
 
 
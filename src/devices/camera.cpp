@@ -0,0 +1,14 @@
+
+#include "camera.h"
+#include "../frameBus.h"
+
+// Every image emitted by the camera is also published to its frame bus, directly in the emitting thread
+Camera::Camera(QObject *parent) : QObject(parent), frameBus(std::make_shared<FrameBus>()) {
+    connect(this, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(publishFrame(CameraImage)), Qt::DirectConnection);
+}
+
+Camera::~Camera() = default;
+
+void Camera::publishFrame(const CameraImage &img) {
+    frameBus->publish(img);
+}
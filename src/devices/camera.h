@@ -9,6 +9,7 @@
 
 #include <QtCore/QObject>
 #include <opencv2/core/mat.hpp>
+#include <memory>
 
 /**
     Enum representing the different camera image types, also used for differentiating the respective camera type
@@ -33,6 +34,8 @@ struct CameraImage {
 
 Q_DECLARE_METATYPE(CameraImage)
 
+class FrameBus;
+
 /**
     Abstract class representing a camera device, can represent any device type defined in CameraImageType
 
@@ -40,6 +43,8 @@ Q_DECLARE_METATYPE(CameraImage)
     close(): closes the camera device
     getType(): describe the type of camera
 
+    getFrameBus(): frame bus to which every camera image is published, consumers subscribe to it instead of connecting to onNewGrabResult
+
 signals:
     onNewGrabResult(): transmits a newly arrived camera image
 */
@@ -48,12 +53,25 @@ class Camera : public QObject {
 
 public:
 
-    explicit inline Camera(QObject *parent = 0) : QObject(parent){}
+    explicit Camera(QObject *parent = 0);
+    ~Camera() override;
 
     virtual bool isOpen() = 0;
     virtual void close() = 0;
     virtual CameraImageType getType() = 0;
 
+    std::shared_ptr<FrameBus> getFrameBus() {
+        return frameBus;
+    }
+
+private:
+
+    std::shared_ptr<FrameBus> frameBus;
+
+private slots:
+
+    void publishFrame(const CameraImage &img);
+
 signals:
 
     void onNewGrabResult(CameraImage grabResult);
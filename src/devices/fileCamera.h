@@ -61,6 +61,26 @@ public:
         imageReader->setPlaybackLoop(loop);
     }
 
+    int getPrefetchDepth()
+    {
+        return imageReader->getPrefetchDepth();
+    }
+
+    void setPrefetchDepth(int depth)
+    {
+        imageReader->setPrefetchDepth(depth);
+    }
+
+    int getDecoderThreads()
+    {
+        return imageReader->getDecoderThreads();
+    }
+
+    void setDecoderThreads(int threads)
+    {
+        imageReader->setDecoderThreads(threads);
+    }
+
     CameraCalibration *getCameraCalibration();
     StereoCameraCalibration *getStereoCameraCalibration();
 
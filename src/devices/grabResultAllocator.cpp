@@ -0,0 +1,56 @@
+
+#include "grabResultAllocator.h"
+
+std::atomic<int> GrabResultAllocator::heldGrabResults(0);
+
+// Wraps the buffer of the grab result into a matrix, the matrix data holds a copy of the grab result pointer
+// Only Mono8 images can be wrapped, for other pixel formats or when too many grab results are held an empty matrix is returned
+cv::Mat GrabResultAllocator::wrap(const CGrabResultPtr &ptrGrabResult) {
+
+    static GrabResultAllocator allocator;
+
+    if(ptrGrabResult->GetPixelType() != PixelType_Mono8)
+        return cv::Mat();
+
+    if(heldGrabResults.fetch_add(1) >= maxHeldGrabResults) {
+        heldGrabResults.fetch_sub(1);
+        return cv::Mat();
+    }
+
+    const int rows = static_cast<int>(ptrGrabResult->GetHeight());
+    const int cols = static_cast<int>(ptrGrabResult->GetWidth());
+    const size_t step = cols + ptrGrabResult->GetPaddingX();
+    auto *buffer = static_cast<uchar*>(ptrGrabResult->GetBuffer());
+
+    cv::Mat img(rows, cols, CV_8UC1, buffer, step);
+
+    // Same scheme as the numpy allocator of the OpenCV python bindings, the matrix becomes the first reference of the data
+    cv::UMatData *u = new cv::UMatData(&allocator);
+    u->data = u->origdata = buffer;
+    u->size = step * rows;
+    u->userdata = new CGrabResultPtr(ptrGrabResult);
+    img.u = u;
+    img.addref();
+
+    return img;
+}
+
+// Matrices allocated through this allocator (i.e. create() on a wrapped matrix) use the default allocator
+cv::UMatData* GrabResultAllocator::allocate(int dims, const int* sizes, int type, void* data, size_t* step, cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const {
+    return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+}
+
+bool GrabResultAllocator::allocate(cv::UMatData* data, cv::AccessFlag accessflags, cv::UMatUsageFlags usageFlags) const {
+    return cv::Mat::getStdAllocator()->allocate(data, accessflags, usageFlags);
+}
+
+// Called when the last matrix referencing the grab buffer is released, releases the grab result and thus returns the buffer to the camera
+void GrabResultAllocator::deallocate(cv::UMatData* u) const {
+
+    if(!u || u->refcount != 0 || u->urefcount != 0)
+        return;
+
+    delete static_cast<CGrabResultPtr*>(u->userdata);
+    delete u;
+    heldGrabResults.fetch_sub(1);
+}
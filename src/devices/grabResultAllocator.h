@@ -0,0 +1,53 @@
+
+#ifndef PUPILEXT_GRABRESULTALLOCATOR_H
+#define PUPILEXT_GRABRESULTALLOCATOR_H
+
+/**
+    @author Moritz Lode
+*/
+
+#include <atomic>
+#include <opencv2/core/mat.hpp>
+#include <pylon/PylonIncludes.h>
+
+using namespace Pylon;
+
+/**
+    OpenCV matrix allocator which references the buffer of a Pylon grab result instead of owning memory, used to pass camera
+    images to the application without copy
+
+    The grab result is held by the reference counted matrix data, every copy of the cv::Mat (i.e. in queued signals or the
+    CameraImage of a consumer) keeps the grab buffer alive. The buffer is returned to the camera's buffer pool when the
+    last matrix referencing it is released. Consumers which need to modify an image must clone it first, as before.
+
+    CAUTION: As held grab results are missing in the camera's buffer pool, the number of wrapped grab results is limited
+    to half of the camera buffers (see maxHeldGrabResults), further images must be copied by the caller
+
+    wrap(): returns a matrix referencing the Mono8 grab buffer, or an empty matrix if the image must be copied instead
+    getHeldGrabResults(): number of grab results currently referenced by matrices
+*/
+class GrabResultAllocator : public cv::MatAllocator {
+
+public:
+
+    // Number of buffers the cameras allocate for grabbing, the Pylon default is 10
+    static const int cameraBufferCount = 32;
+    static const int maxHeldGrabResults = cameraBufferCount / 2;
+
+    static cv::Mat wrap(const CGrabResultPtr &ptrGrabResult);
+
+    static int getHeldGrabResults() {
+        return heldGrabResults.load();
+    }
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override;
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessflags, cv::UMatUsageFlags usageFlags) const override;
+    void deallocate(cv::UMatData* data) const override;
+
+private:
+
+    static std::atomic<int> heldGrabResults;
+
+};
+
+#endif //PUPILEXT_GRABRESULTALLOCATOR_H
@@ -47,6 +47,9 @@ SingleCamera::SingleCamera(const CDeviceInfo &di, QObject* parent)
 
         camera.Open();
 
+        // More buffers than the default, as grab results are held by the emitted images until all consumers released them
+        camera.MaxNumBuffer = GrabResultAllocator::cameraBufferCount;
+
         synchronizeTime();
         cameraImageEventHandler->setTimeSynchronization(cameraTime, systemTime);
 
@@ -115,6 +118,9 @@ void SingleCamera::enableHardwareTrigger(bool enabled) {
 
         camera.Open();
 
+        // More buffers than the default, as grab results are held by the emitted images until all consumers released them
+        camera.MaxNumBuffer = GrabResultAllocator::cameraBufferCount;
+
         synchronizeTime();
         cameraImageEventHandler->setTimeSynchronization(cameraTime, systemTime);
 
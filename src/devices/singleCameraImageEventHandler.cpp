@@ -21,7 +21,9 @@ void SingleCameraImageEventHandler::OnImagesSkipped(CInstantCamera& camera, size
 // Event handler when a new image was grabbed from the camera
 // Receives the grab result pointer which contains the grabbed image and meta information
 // After a successful image grab, the image timestamp is converted to system time using the previously acquired starting timestamps
-// The image is converted to a 8 bit grayscale cv::Mat format and bundled with meta information in a CameraImage object
+// Mono8 images reference the grab buffer without copy (see GrabResultAllocator), other pixel formats or images exceeding
+// the held grab results limit are converted to a 8 bit grayscale cv::Mat format
+// The image is bundled with meta information in a CameraImage object
 // Emits signal onNewGrabResult containing the newly grabbed CameraImage
 void SingleCameraImageEventHandler::OnImageGrabbed(CInstantCamera& camera, const CGrabResultPtr& ptrGrabResult) {
     //std::cout << "OnImageGrabbed event for device " << camera.GetDeviceInfo().GetModelName() << std::endl;
@@ -35,13 +37,17 @@ void SingleCameraImageEventHandler::OnImageGrabbed(CInstantCamera& camera, const
         // cameraTime describes the acquisition start in camera time, systemTime the acquisition start in system time
         timeStamp = ((timeStamp-cameraTime) / 1000000) + systemTime;
 
-        formatConverter.Convert(pylonImage, ptrGrabResult);
-        cv::Mat img = cv::Mat(ptrGrabResult->GetHeight(), ptrGrabResult->GetWidth(), CV_8UC1, (uint8_t *) pylonImage.GetBuffer());
+        cv::Mat img = GrabResultAllocator::wrap(ptrGrabResult);
+        if(img.empty()) {
+            formatConverter.Convert(pylonImage, ptrGrabResult);
+            img = cv::Mat(ptrGrabResult->GetHeight(), ptrGrabResult->GetWidth(), CV_8UC1, (uint8_t *) pylonImage.GetBuffer()).clone();
+        }
 
         CameraImage result;
         result.type = CameraImageType::LIVE_SINGLE_CAMERA;
-        result.img = img.clone();
+        result.img = img;
         result.timestamp = timeStamp;
+        result.frameNumber = ptrGrabResult->GetImageNumber();
 
         emit onNewGrabResult(result);
     } else {
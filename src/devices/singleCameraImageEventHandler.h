@@ -12,6 +12,7 @@
 #include <pylon/ImageEventHandler.h>
 #include <pylon/PylonIncludes.h>
 #include "camera.h"
+#include "grabResultAllocator.h"
 
 using namespace Pylon;
 
@@ -20,6 +21,9 @@ Q_DECLARE_METATYPE(cv::Mat)
 /**
     Image event handler, gets called at each new image received from a single camera (Basler camera)
 
+    Mono8 images are emitted without copy, the emitted image references the grab buffer which is returned to the camera
+    once all consumers released the image
+
     setTimeSynchronization(): set the camera and system times which are used to sync the camera timestamps, usually only a single time at camera initialisation
 
     onNewGrabResult(): signal send at each new image, distributing the images from the camera
@@ -29,6 +29,7 @@ StereoCamera::StereoCamera(QObject* parent) : Camera(parent),
 
     connect(cameraImageEventHandler, SIGNAL(onNewGrabResult(CameraImage)), this, SIGNAL(onNewGrabResult(CameraImage)));
     connect(cameraImageEventHandler, SIGNAL(onNewGrabResult(CameraImage)), frameCounter, SLOT(count(CameraImage)));
+    connect(cameraImageEventHandler, SIGNAL(pairingStatistics(double, double, quint64, quint64)), this, SIGNAL(pairingStatistics(double, double, quint64, quint64)));
     connect(cameraImageEventHandler, SIGNAL(needsTimeSynchronization()), this, SLOT(resynchronizeTime()));
 
     connect(frameCounter, SIGNAL(fps(double)), this, SIGNAL(fps(double)));
@@ -109,6 +110,10 @@ void StereoCamera::open() {
 
         cameras.Open();
 
+        // More buffers than the default, as grab results are held by the emitted stereo images until all consumers released them
+        cameras[0].MaxNumBuffer = GrabResultAllocator::cameraBufferCount;
+        cameras[1].MaxNumBuffer = GrabResultAllocator::cameraBufferCount;
+
         // Synchronize the camera time to the system time
         synchronizeTime();
         cameraImageEventHandler->setTimeSynchronization(cameraMainTime, cameraSecondaryTime, systemTime);
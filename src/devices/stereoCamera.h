@@ -38,6 +38,7 @@ using namespace Basler_UniversalCameraParams;
 signals:
     fps(double fps): frames per second of the file camera playback
     framecount(int framecount): current framecount of the file camera playback
+    pairingStatistics(): pairing latency and orphaned images of the stereo image pairing, see StereoCameraImageEventHandler
 
 */
 class StereoCamera : public Camera {
@@ -124,6 +125,7 @@ signals:
 
     void fps(double fps);
     void framecount(int framecount);
+    void pairingStatistics(double meanLatencyMs, double maxLatencyMs, quint64 pairedFrames, quint64 orphanedFrames);
 
 };
 
@@ -1,14 +1,26 @@
 
+#include <algorithm>
 #include <opencv2/core.hpp>
+#include <QtCore/QMutexLocker>
 #include "stereoCameraImageEventHandler.h"
 
 // Creates a new stereo image event handler for a StereoCamera
-StereoCameraImageEventHandler::StereoCameraImageEventHandler(QObject* parent) : QObject(parent), systemTime(0), stereoImage() {
-
-    formatConverter.OutputPixelFormat = Pylon::PixelType_Mono8;
-
-    stereoImage.timestamp = 0;
-    stereoImage.type = CameraImageType::LIVE_STEREO_CAMERA;
+StereoCameraImageEventHandler::StereoCameraImageEventHandler(QObject* parent) :
+        QObject(parent),
+        systemTime(0),
+        pairedFrames(0),
+        orphanedFrames(0),
+        reportedOrphanedFrames(0),
+        latencySum(0),
+        latencyMax(0),
+        latencyCount(0),
+        statisticsTimer(new QTimer(this)) {
+
+    formatConverter[0].OutputPixelFormat = Pylon::PixelType_Mono8;
+    formatConverter[1].OutputPixelFormat = Pylon::PixelType_Mono8;
+
+    connect(statisticsTimer, SIGNAL(timeout()), this, SLOT(reportStatistics()));
+    statisticsTimer->start(1000);
 }
 
 StereoCameraImageEventHandler::~StereoCameraImageEventHandler() {
@@ -16,8 +28,7 @@ StereoCameraImageEventHandler::~StereoCameraImageEventHandler() {
 }
 
 // Event handler that is executed if for any of the two cameras in the stereo camera images were skipped
-// If image skipping happens in one of the two cameras, one may assume that the images are not in sync
-// anymore and the onImageGrabbed event handler may not be able produce any stereo images due to unsync framecount
+// If image skipping happens in one of the two cameras, the images of the other camera for these frames are dropped as orphans
 void StereoCameraImageEventHandler::OnImagesSkipped(CInstantCamera& camera, size_t countOfSkippedImages) {
     std::cout << "OnImagesSkipped event for device " << camera.GetDeviceInfo().GetModelName() << std::endl;
     std::cout << countOfSkippedImages  << " images have been skipped." << std::endl;
@@ -26,64 +37,151 @@ void StereoCameraImageEventHandler::OnImagesSkipped(CInstantCamera& camera, size
 
 // Event handler that is executed for EACH image acquisition of EACH camera
 // This means that for each hardware trigger signal to the two cameras in a StereoCamera, this handler is called two times
-// In order to produce a single stereo camera image, combining the two camera acquisitions , OnImageGrabbed synchronized the
-// image grab results based on their framenumber. For two consecutive(!) images with the same framenumber, a single new stereo
-// camera image is produced and emitted through onNewGrabResult (containing both images).
-// In case only a single image was acquired and its consecutive image is of a different framenumber, the first image is dropped.
+// In order to produce a single stereo camera image, combining the two camera acquisitions, OnImageGrabbed pairs the
+// image grab results based on their framenumber in the pairing buffer. Once both images of a framenumber are received, a single
+// new stereo camera image is produced and emitted through onNewGrabResult (containing both images).
+// Images of the two cameras may arrive in any order, as long as the pair completes within the size and timeout of the pairing buffer
 void StereoCameraImageEventHandler::OnImageGrabbed(CInstantCamera& camera, const CGrabResultPtr& ptrGrabResult) {
     //std::cout << "OnImageGrabbed event for device " << ptrGrabResult->GetCameraContext() << std::endl;
 
     if (ptrGrabResult->GrabSucceeded()) {
-        // As we modify the stereoImage in potentially different threads (Pylon image event handler) lock the mutex for the update
-        mutex.lock();
 
         intptr_t cameraContextValue = ptrGrabResult->GetCameraContext();
-        int64_t frameNumber = ptrGrabResult->GetImageNumber();
+        if(cameraContextValue != 0 && cameraContextValue != 1)
+            return;
+
+        uint64_t frameNumber = ptrGrabResult->GetImageNumber();
 
         uint64_t timeStamp = ptrGrabResult->GetTimeStamp();
         timeStamp = ((timeStamp-cameraTime[cameraContextValue]) + systemTime) / 1000000;
 
         //std::cout<< "Grabresult from camera" << cameraContextValue << ": frameNumber:  " << frameNumber << ", timestamp: " << timeStamp <<std::endl;
 
-        formatConverter.Convert(pylonImage, ptrGrabResult);
-        cv::Mat img(ptrGrabResult->GetHeight(), ptrGrabResult->GetWidth(), CV_8UC1, (uint8_t *) pylonImage.GetBuffer());
+        // The image is converted outside of the lock, each camera has its own converter and grab thread
+        cv::Mat img = GrabResultAllocator::wrap(ptrGrabResult);
+        if(img.empty()) {
+            formatConverter[cameraContextValue].Convert(pylonImage[cameraContextValue], ptrGrabResult);
+            img = cv::Mat(ptrGrabResult->GetHeight(), ptrGrabResult->GetWidth(), CV_8UC1, (uint8_t *) pylonImage[cameraContextValue].GetBuffer()).clone();
+        }
 
-        // If the current image and its framenumber are part of the existing stereoImage, then the stereoImage is complete and gets emitted
-        // To make sure stereo image consists of two images at the same time from both cameras, their framenumber is checked
+        // To make sure stereo image consists of two images at the same time from both cameras, their framenumber is used as key
         // We assume that when both cameras are started grabbing at the same time, the framenumbers should match (at each camera acquisition start, the framenumber is reset)
         // Combining images based on timestamps showed to be error prone as the time difference between the two images started to drift for unknown reasons
 
-        //int diff = std::abs((int)(timeStamp - stereoImage.timestamp));
-        //std::cout<<"Grabresult diff: "<<diff<<std::endl;
+        const auto now = std::chrono::steady_clock::now();
+
+        CameraImage stereoImage;
+        bool complete = false;
+        {
+            // Both camera grab threads access the pairing buffer, the lock only covers the slot update
+            QMutexLocker locker(&mutex);
+
+            expireSlots(now, frameNumber);
+
+            PairingSlot &slot = pairingBuffer[frameNumber % pairingBufferSize];
+
+            if(slot.used && slot.frameNumber > frameNumber) {
+                // The image arrived after its slot was taken over by a newer frame, its counterpart was already dropped
+                orphanedFrames++;
+                return;
+            }
+
+            if(slot.used && (slot.frameNumber != frameNumber || slot.received[cameraContextValue])) {
+                // Slot holds an older unpaired frame or the same camera delivered the framenumber twice
+                releaseSlot(slot);
+            }
 
-        if(stereoImage.frameNumber == frameNumber) {
-            // If framenumber matches the already contained image in the stereo image this means the missing second images is now found
-            // Cameracontextvalue describes the index of the camera in a basler camera array (main or secondary)
-            if(cameraContextValue == 0) {
-                stereoImage.img = img.clone();
-            } else if(cameraContextValue == 1) {
-                stereoImage.imgSecondary = img.clone();
+            if(!slot.used) {
+                slot.used = true;
+                slot.frameNumber = frameNumber;
+                slot.arrival = now;
             }
+
+            slot.received[cameraContextValue] = true;
+            slot.img[cameraContextValue] = img;
+            // The timestamp of the main camera is used for the stereo image, the secondary timestamp only until the main image arrives
+            if(cameraContextValue == 0 || !slot.received[0])
+                slot.timestamp = timeStamp;
+
+            if(slot.received[0] && slot.received[1]) {
+                stereoImage.type = CameraImageType::LIVE_STEREO_CAMERA;
+                stereoImage.img = slot.img[0];
+                stereoImage.imgSecondary = slot.img[1];
+                stereoImage.timestamp = slot.timestamp;
+                stereoImage.frameNumber = slot.frameNumber;
+                complete = true;
+
+                double latency = std::chrono::duration<double, std::milli>(now - slot.arrival).count();
+                latencySum += latency;
+                latencyMax = std::max(latencyMax, latency);
+                latencyCount++;
+                pairedFrames++;
+
+                slot = PairingSlot();
+            }
+        }
+
+        if(complete) {
             //std::cout<< "Stereoimage complete: " << stereoImage.frameNumber << " " << stereoImage.timestamp <<std::endl;
-            //std::cout<< "-------------------------------" <<std::endl;
             emit onNewGrabResult(stereoImage);
-        } else {
-            // Else, we have a "new" stereo image, set the timestamp, image and wait for the second missing one, then emit
-            stereoImage.timestamp = timeStamp;
-            stereoImage.frameNumber = frameNumber;
-            if(cameraContextValue == 0) {
-                stereoImage.img = img.clone();
-            } else if(cameraContextValue == 1) {
-                stereoImage.imgSecondary = img.clone();
-            }
         }
-        mutex.unlock();
     } else {
         std::cout << "Error: " << ptrGrabResult->GetErrorCode() << " " << ptrGrabResult->GetErrorDescription() << std::endl;
     }
 
 }
 
+// Drops unpaired images which exceeded the pairing timeout or which are too old to complete given the newest framenumber
+// Must be called with the mutex locked
+void StereoCameraImageEventHandler::expireSlots(std::chrono::steady_clock::time_point now, uint64_t frameNumber) {
+
+    for(PairingSlot &slot : pairingBuffer) {
+        if(!slot.used)
+            continue;
+
+        if(now - slot.arrival > std::chrono::milliseconds(pairingTimeoutMs) || (frameNumber > slot.frameNumber && frameNumber - slot.frameNumber >= pairingBufferSize)) {
+            releaseSlot(slot);
+        }
+    }
+}
+
+// Drops the images of an unpaired slot, counting them as orphans
+void StereoCameraImageEventHandler::releaseSlot(PairingSlot &slot) {
+
+    orphanedFrames += (slot.received[0] ? 1 : 0) + (slot.received[1] ? 1 : 0);
+    slot = PairingSlot();
+}
+
+// Emits the pairing latency of the last interval and the total counts, dropped images are also reported to the console
+// Expires pending slots too, so that held grab buffers are released when a camera stops delivering images
+void StereoCameraImageEventHandler::reportStatistics() {
+
+    double meanLatency, maxLatency;
+    quint64 paired, orphaned, newOrphans;
+    {
+        QMutexLocker locker(&mutex);
+
+        expireSlots(std::chrono::steady_clock::now(), 0);
+
+        meanLatency = latencyCount > 0 ? latencySum / latencyCount : 0;
+        maxLatency = latencyMax;
+        paired = pairedFrames;
+        orphaned = orphanedFrames;
+        newOrphans = orphanedFrames - reportedOrphanedFrames;
+        reportedOrphanedFrames = orphanedFrames;
+
+        latencySum = 0;
+        latencyMax = 0;
+        latencyCount = 0;
+    }
+
+    if(newOrphans > 0) {
+        std::cout << "StereoCameraImageEventHandler: " << newOrphans << " images dropped without matching stereo image (" << orphaned << " total)." << std::endl;
+    }
+
+    emit pairingStatistics(meanLatency, maxLatency, paired, orphaned);
+}
+
 // Set the timestamps of both cameras and the system time for a given point in time, used for converting between from cameratime to systemtime
 void StereoCameraImageEventHandler::setTimeSynchronization(uint64_t m_mainCameraTime, uint64_t m_secondaryCameraTime, uint64_t m_systemTime) {
 
@@ -1,4 +1,3 @@
-
 #ifndef PUPILEXT_STEREOCAMERAIMAGEEVENTHANDLER_H
 #define PUPILEXT_STEREOCAMERAIMAGEEVENTHANDLER_H
 
@@ -8,18 +7,25 @@
 
 
 #include <QtCore/QObject>
+#include <QtCore/QTimer>
 #include <opencv2/core/mat.hpp>
 #include <pylon/PylonImage.h>
 #include <pylon/ImageEventHandler.h>
 #include <pylon/PylonIncludes.h>
 #include <QtCore/QMutex>
+#include <chrono>
 #include "camera.h"
+#include "grabResultAllocator.h"
 
 using namespace Pylon;
 
 /**
     Image event handler for stereo camera, gets called for EACH of the stereo camera images, meaning it will get called two times for a single stereo-image
 
+    The images of both cameras are paired by their framenumber in a small pairing buffer (ring indexed by framenumber), thus images may
+    arrive in any order across the two cameras. Images whose counterpart does not arrive within pairingTimeoutMs, or which are pushed out of
+    the ring by newer frames, are dropped and counted as orphans.
+
     CAUTION:
     To sync the images, the camera provided framecount is used and it is assumed that the framecount of both cameras matches due to sync acquisition start (See StereoCamera)
     Its important for stereo synchronization, that only after opening of the stereo camera (acquisition start) the hardware triggers are started
@@ -27,6 +33,7 @@ using namespace Pylon;
     setTimeSynchronization(): set the camera and system times which are used to sync the camera timestamps, usually only a single time at camera initialisation
 
     onNewGrabResult(): signal send at each new stereo image, distributing the new stereo images of both cameras
+    pairingStatistics(): signal send every second, mean and max time between the two images of a pair in the last second, total paired and orphaned images
 */
 class StereoCameraImageEventHandler : public QObject, public CImageEventHandler {
 Q_OBJECT
@@ -44,19 +51,50 @@ public:
 
 private:
 
+    // Pending stereo image in the pairing buffer, waiting for the image of the other camera
+    struct PairingSlot {
+        bool used = false;
+        bool received[2] = {false, false};
+        uint64_t frameNumber = 0;
+        uint64_t timestamp = 0;
+        cv::Mat img[2];
+        std::chrono::steady_clock::time_point arrival;
+    };
+
+    static const int pairingBufferSize = 16;
+    static const int pairingTimeoutMs = 200;
+
     QMutex mutex;
 
     uint64_t cameraTime[2] = {0, 0};
     uint64_t systemTime;
 
-    CImageFormatConverter formatConverter;
-    CPylonImage pylonImage;
+    // A converter per camera, as the grab threads of both cameras convert their images concurrently
+    CImageFormatConverter formatConverter[2];
+    CPylonImage pylonImage[2];
+
+    PairingSlot pairingBuffer[pairingBufferSize];
+
+    quint64 pairedFrames;
+    quint64 orphanedFrames;
+    quint64 reportedOrphanedFrames;
+    double latencySum;
+    double latencyMax;
+    quint64 latencyCount;
+
+    QTimer *statisticsTimer;
+
+    void expireSlots(std::chrono::steady_clock::time_point now, uint64_t frameNumber);
+    void releaseSlot(PairingSlot &slot);
+
+private slots:
 
-    CameraImage stereoImage;
+    void reportStatistics();
 
 signals:
 
     void onNewGrabResult(CameraImage grabResult);
+    void pairingStatistics(double meanLatencyMs, double maxLatencyMs, quint64 pairedFrames, quint64 orphanedFrames);
 
 };
 
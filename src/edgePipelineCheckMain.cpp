@@ -0,0 +1,505 @@
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "pupil-detection-methods/EdgePipeline.h"
+
+// Output equivalence check of the shared EdgePipeline against the edge detection which ExCuSe and ElSe implemented before
+// The reference functions below are the original implementations, only renamed and with the fixed size check arrays replaced
+// by vectors. Canny edges, gradient magnitude, corner thinning and the extracted curves (points, order and means) must be identical.
+//
+// Usage: PupilEXT-edgecheck [directory]
+// Checks synthetic eye images of several sizes, and all images of the given directory if any, returns 1 on any difference
+
+static const int referenceMaxLine = 10000;
+
+static cv::Mat referenceHysteresis(const cv::Mat &strong, const cv::Mat &weak)
+{
+
+    int pic_x = strong.cols;
+    int pic_y = strong.rows;
+
+    cv::Mat check = cv::Mat::zeros(pic_y, pic_x, CV_8U);
+
+    std::vector<int> lines(referenceMaxLine, 0);
+    int lines_idx = 0;
+
+    int idx = 0;
+
+    for (int i = 1; i < pic_y - 1; i++)
+    {
+        for (int j = 1; j < pic_x - 1; j++)
+        {
+
+            if (strong.at<uchar>(idx + j) != 0 && check.at<uchar>(idx + j) == 0)
+            {
+
+                check.at<uchar>(idx + j) = 255;
+                lines_idx = 1;
+                lines[0] = idx + j;
+
+                int akt_idx = 0;
+
+                while (akt_idx < lines_idx && lines_idx < referenceMaxLine)
+                {
+
+                    int akt_pos = lines[akt_idx];
+
+                    if (akt_pos - pic_x - 1 >= 0 && akt_pos + pic_x + 1 < pic_x * pic_y)
+                    {
+                        for (int k1 = -1; k1 < 2; k1++)
+                        {
+                            for (int k2 = -1; k2 < 2; k2++)
+                            {
+
+                                if (check.at<uchar>((akt_pos + (k1 * pic_x)) + k2) == 0 && weak.at<uchar>((akt_pos + (k1 * pic_x)) + k2) != 0)
+                                {
+                                    check.at<uchar>((akt_pos + (k1 * pic_x)) + k2) = 255;
+                                    if (lines_idx < referenceMaxLine)
+                                    {
+                                        lines[lines_idx] = (akt_pos + (k1 * pic_x)) + k2;
+                                        lines_idx++;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                    akt_idx++;
+                }
+            }
+        }
+        idx += pic_x;
+    }
+
+    return check;
+}
+
+// Original canny_impl of ExCuSe (truncated non-edge count) and ElSe (rounded non-edge count, magnitude output)
+static cv::Mat referenceCanny(cv::Mat *pic, cv::Mat *magni, bool roundNonEdgeCount)
+{
+    int k_sz = 16;
+
+    float gau[16] = {0.000000220358050f, 0.000007297256405f, 0.000146569312970f, 0.001785579770079f,
+                     0.013193749090229f, 0.059130281094460f, 0.160732768610747f, 0.265003534507060f, 0.265003534507060f,
+                     0.160732768610747f, 0.059130281094460f, 0.013193749090229f, 0.001785579770079f, 0.000146569312970f,
+                     0.000007297256405f, 0.000000220358050f};
+    float deriv_gau[16] = {-0.000026704586264f, -0.000276122963398f, -0.003355163265098f, -0.024616683775044f, -0.108194751875585f,
+                           -0.278368310241814f, -0.388430056419619f, -0.196732206873178f, 0.196732206873178f, 0.388430056419619f,
+                           0.278368310241814f, 0.108194751875585f, 0.024616683775044f, 0.003355163265098f, 0.000276122963398f, 0.000026704586264f};
+
+    cv::Point anchor = cv::Point(-1, -1);
+    float delta = 0;
+    int ddepth = -1;
+
+    pic->convertTo(*pic, CV_32FC1);
+
+    cv::Mat gau_x = cv::Mat(1, k_sz, CV_32FC1, &gau);
+    cv::Mat deriv_gau_x = cv::Mat(1, k_sz, CV_32FC1, &deriv_gau);
+
+    cv::Mat res_x;
+    cv::Mat res_y;
+
+    cv::transpose(*pic, *pic);
+    cv::filter2D(*pic, res_x, ddepth, gau_x, anchor, delta, cv::BORDER_REPLICATE);
+    cv::transpose(*pic, *pic);
+    cv::transpose(res_x, res_x);
+
+    cv::filter2D(res_x, res_x, ddepth, deriv_gau_x, anchor, delta, cv::BORDER_REPLICATE);
+
+    cv::filter2D(*pic, res_y, ddepth, gau_x, anchor, delta, cv::BORDER_REPLICATE);
+
+    cv::transpose(res_y, res_y);
+    cv::filter2D(res_y, res_y, ddepth, deriv_gau_x, anchor, delta, cv::BORDER_REPLICATE);
+    cv::transpose(res_y, res_y);
+
+    *magni = cv::Mat::zeros(pic->rows, pic->cols, CV_32FC1);
+
+    float *p_res, *p_x, *p_y;
+    for (int i = 0; i < magni->rows; i++)
+    {
+        p_res = magni->ptr<float>(i);
+        p_x = res_x.ptr<float>(i);
+        p_y = res_y.ptr<float>(i);
+
+        // Both used the float overloads of hypot and abs (ElSe unqualified, through the C++ math headers included by OpenCV)
+        for (int j = 0; j < magni->cols; j++)
+        {
+            p_res[j] = std::hypot(p_x[j], p_y[j]);
+        }
+    }
+
+    //th selection
+    int PercentOfPixelsNotEdges = roundNonEdgeCount ? (int)std::round(0.7 * magni->cols * magni->rows) : (int)(0.7 * magni->cols * magni->rows);
+    float ThresholdRatio = 0.4f;
+
+    float high_th = 0;
+    float low_th = 0;
+
+    int h_sz = 64;
+    int hist[64];
+    for (int i = 0; i < h_sz; i++)
+        hist[i] = 0;
+
+    cv::normalize(*magni, *magni, 0, 1, cv::NORM_MINMAX, CV_32FC1);
+    cv::Mat res_idx = cv::Mat::zeros(pic->rows, pic->cols, CV_8U);
+    cv::normalize(*magni, res_idx, 0, 63, cv::NORM_MINMAX, CV_32S);
+
+    int *p_res_idx = 0;
+    for (int i = 0; i < magni->rows; i++)
+    {
+        p_res_idx = res_idx.ptr<int>(i);
+        for (int j = 0; j < magni->cols; j++)
+        {
+            hist[p_res_idx[j]]++;
+        }
+    }
+
+    int sum = 0;
+    for (int i = 0; i < h_sz; i++)
+    {
+        sum += hist[i];
+        if (sum > PercentOfPixelsNotEdges)
+        {
+            high_th = float(i + 1) / float(h_sz);
+            break;
+        }
+    }
+
+    low_th = ThresholdRatio * high_th;
+    (void)low_th;
+
+    //non maximum supression + interpolation
+    cv::Mat non_ms = cv::Mat::zeros(pic->rows, pic->cols, CV_8U);
+    cv::Mat non_ms_hth = cv::Mat::zeros(pic->rows, pic->cols, CV_8U);
+
+    float ix, iy, grad1, grad2, d;
+    char *p_non_ms, *p_non_ms_hth;
+    float *p_res_t, *p_res_b;
+
+    for (int i = 1; i < magni->rows - 1; i++)
+    {
+        p_non_ms = non_ms.ptr<char>(i);
+        p_non_ms_hth = non_ms_hth.ptr<char>(i);
+
+        p_res = magni->ptr<float>(i);
+        p_res_t = magni->ptr<float>(i - 1);
+        p_res_b = magni->ptr<float>(i + 1);
+
+        p_x = res_x.ptr<float>(i);
+        p_y = res_y.ptr<float>(i);
+
+        for (int j = 1; j < magni->cols - 1; j++)
+        {
+
+            iy = p_y[j];
+            ix = p_x[j];
+
+            if ((iy <= 0 && ix > -iy) || (iy >= 0 && ix < -iy))
+            {
+
+                d = std::abs(iy / ix);
+                grad1 = (p_res[j + 1] * (1 - d)) + (p_res_t[j + 1] * d);
+                grad2 = (p_res[j - 1] * (1 - d)) + (p_res_b[j - 1] * d);
+
+                if (p_res[j] >= grad1 && p_res[j] >= grad2)
+                {
+                    p_non_ms[j] = (char)255;
+
+                    if (p_res[j] > high_th)
+                        p_non_ms_hth[j] = (char)255;
+                }
+            }
+
+            if ((ix > 0 && -iy >= ix) || (ix < 0 && -iy <= ix))
+            {
+                d = std::abs(ix / iy);
+                grad1 = (p_res_t[j] * (1 - d)) + (p_res_t[j + 1] * d);
+                grad2 = (p_res_b[j] * (1 - d)) + (p_res_b[j - 1] * d);
+
+                if (p_res[j] >= grad1 && p_res[j] >= grad2)
+                {
+                    p_non_ms[j] = (char)255;
+                    if (p_res[j] > high_th)
+                        p_non_ms_hth[j] = (char)255;
+                }
+            }
+
+            if ((ix <= 0 && ix > iy) || (ix >= 0 && ix < iy))
+            {
+                d = std::abs(ix / iy);
+                grad1 = (p_res_t[j] * (1 - d)) + (p_res_t[j - 1] * d);
+                grad2 = (p_res_b[j] * (1 - d)) + (p_res_b[j + 1] * d);
+
+                if (p_res[j] >= grad1 && p_res[j] >= grad2)
+                {
+                    p_non_ms[j] = (char)255;
+                    if (p_res[j] > high_th)
+                        p_non_ms_hth[j] = (char)255;
+                }
+            }
+
+            if ((iy < 0 && ix <= iy) || (iy > 0 && ix >= iy))
+            {
+                d = std::abs(iy / ix);
+                grad1 = (p_res[j - 1] * (1 - d)) + (p_res_t[j - 1] * d);
+                grad2 = (p_res[j + 1] * (1 - d)) + (p_res_b[j + 1] * d);
+
+                if (p_res[j] >= grad1 && p_res[j] >= grad2)
+                {
+                    p_non_ms[j] = (char)255;
+                    if (p_res[j] > high_th)
+                        p_non_ms_hth[j] = (char)255;
+                }
+            }
+        }
+    }
+
+    return referenceHysteresis(non_ms_hth, non_ms);
+}
+
+// Original first pass of remove_points_with_low_angle (ExCuSe) and filter_edges (ElSe)
+static void referenceThinCorners(cv::Mat *edge, int start_x, int end_x, int start_y, int end_y)
+{
+    for (int j = start_y; j < end_y; j++)
+        for (int i = start_x; i < end_x; i++)
+        {
+            int box[9];
+
+            box[4] = (int)edge->data[(edge->cols * (j)) + (i)];
+
+            if (box[4])
+            {
+                box[1] = (int)edge->data[(edge->cols * (j - 1)) + (i)];
+                box[3] = (int)edge->data[(edge->cols * (j)) + (i - 1)];
+                box[5] = (int)edge->data[(edge->cols * (j)) + (i + 1)];
+                box[7] = (int)edge->data[(edge->cols * (j + 1)) + (i)];
+
+                if ((box[5] && box[7]))
+                    edge->data[(edge->cols * (j)) + (i)] = 0;
+                if ((box[5] && box[1]))
+                    edge->data[(edge->cols * (j)) + (i)] = 0;
+                if ((box[3] && box[7]))
+                    edge->data[(edge->cols * (j)) + (i)] = 0;
+                if ((box[3] && box[1]))
+                    edge->data[(edge->cols * (j)) + (i)] = 0;
+            }
+        }
+}
+
+// Original curve collection of get_curves (ExCuSe and ElSe), before the curves are filtered and scored
+static std::vector<EdgeCurve> referenceCurves(cv::Mat *edge, int start_x, int end_x, int start_y, int end_y)
+{
+    std::vector<EdgeCurve> all_lines;
+    std::vector<cv::Point> curve;
+
+    if (start_x < 2)
+        start_x = 2;
+    if (start_y < 2)
+        start_y = 2;
+    if (end_x > edge->cols - 2)
+        end_x = edge->cols - 2;
+    if (end_y > edge->rows - 2)
+        end_y = edge->rows - 2;
+
+    int curve_idx = 0;
+    cv::Point mean_p;
+
+    // check[x][y] of the original
+    std::vector<std::vector<bool>> check(edge->cols, std::vector<bool>(edge->rows, false));
+
+    for (int i = start_x; i < end_x; i++)
+        for (int j = start_y; j < end_y; j++)
+        {
+
+            if (edge->data[(edge->cols * (j)) + (i)] == 255 && !check[i][j])
+            {
+                check[i][j] = true;
+
+                curve.clear();
+                curve_idx = 0;
+
+                curve.push_back(cv::Point(i, j));
+                mean_p.x = i;
+                mean_p.y = j;
+                curve_idx++;
+
+                int akt_idx = 0;
+
+                while (akt_idx < curve_idx)
+                {
+
+                    cv::Point akt_pos = curve[akt_idx];
+                    for (int k1 = -1; k1 < 2; k1++)
+                        for (int k2 = -1; k2 < 2; k2++)
+                        {
+
+                            if (akt_pos.x + k1 >= start_x && akt_pos.x + k1 < end_x && akt_pos.y + k2 >= start_y && akt_pos.y + k2 < end_y)
+                                if (!check[akt_pos.x + k1][akt_pos.y + k2])
+                                    if (edge->data[(edge->cols * (akt_pos.y + k2)) + (akt_pos.x + k1)] == 255)
+                                    {
+                                        check[akt_pos.x + k1][akt_pos.y + k2] = true;
+
+                                        mean_p.x += akt_pos.x + k1;
+                                        mean_p.y += akt_pos.y + k2;
+                                        curve.push_back(cv::Point(akt_pos.x + k1, akt_pos.y + k2));
+                                        curve_idx++;
+                                    }
+                        }
+                    akt_idx++;
+                }
+
+                mean_p.x = (int)std::floor((double(mean_p.x) / double(curve_idx)) + 0.5);
+                mean_p.y = (int)std::floor((double(mean_p.y) / double(curve_idx)) + 0.5);
+
+                EdgeCurve line;
+                line.points = curve;
+                line.mean = mean_p;
+                all_lines.push_back(line);
+            }
+        }
+
+    return all_lines;
+}
+
+// Synthetic eye image, dark elliptic pupil with a glint on a shaded and noisy background, reproducible through the seed
+static cv::Mat syntheticEye(const cv::Size &size, uint64_t seed)
+{
+    cv::RNG rng(seed);
+
+    cv::Mat img(size, CV_8UC1);
+    for (int y = 0; y < img.rows; y++)
+        for (int x = 0; x < img.cols; x++)
+            img.at<uchar>(y, x) = cv::saturate_cast<uchar>(120 + 60.0 * x / img.cols - 30.0 * y / img.rows);
+
+    cv::Point center(rng.uniform(img.cols / 4, 3 * img.cols / 4), rng.uniform(img.rows / 4, 3 * img.rows / 4));
+    int radius = std::max(4, std::min(img.cols, img.rows) / rng.uniform(5, 10));
+    cv::Size axes(radius, static_cast<int>(radius * rng.uniform(0.6, 1.0)));
+
+    cv::ellipse(img, center, cv::Size(axes.width * 2, axes.height * 2), rng.uniform(0.0, 180.0), 0, 360, cv::Scalar(90), -1);
+    cv::ellipse(img, center, axes, rng.uniform(0.0, 180.0), 0, 360, cv::Scalar(25), -1);
+    cv::circle(img, center + cv::Point(radius / 3, -radius / 3), std::max(1, radius / 6), cv::Scalar(250), -1);
+
+    for (int i = 0; i < 5; i++)
+        cv::line(img, cv::Point(rng.uniform(0, img.cols), rng.uniform(0, img.rows)), cv::Point(rng.uniform(0, img.cols), rng.uniform(0, img.rows)),
+                 cv::Scalar(rng.uniform(0, 256)), rng.uniform(1, 4));
+
+    cv::Mat noise(size, CV_16SC1);
+    rng.fill(noise, cv::RNG::NORMAL, 0, 8);
+    cv::Mat noisy;
+    img.convertTo(noisy, CV_16SC1);
+    noisy += noise;
+    noisy.convertTo(img, CV_8UC1);
+
+    return img;
+}
+
+static bool sameCurves(const std::vector<EdgeCurve> &a, const std::vector<EdgeCurve> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].mean != b[i].mean || a[i].points != b[i].points)
+            return false;
+    }
+    return true;
+}
+
+// Compares the pipeline with the reference on the given image area, in the way ExCuSe and ElSe call it
+static bool checkImage(EdgePipeline &pipeline, const cv::Mat &img, const cv::Rect &area, const std::string &name)
+{
+    bool equal = true;
+
+    for (int rounding = 0; rounding < 2; rounding++) {
+        const std::string label = name + (rounding ? " [ElSe]" : " [ExCuSe]");
+
+        cv::Mat picpic = img(area).clone();
+        cv::Mat referenceMagnitude;
+        cv::Mat referenceEdges = referenceCanny(&picpic, &referenceMagnitude, rounding == 1);
+
+        const cv::Mat &edges = pipeline.canny(img(area), rounding == 1);
+
+        int edgeDifferences = cv::countNonZero(edges != referenceEdges);
+        double magnitudeDifference = cv::norm(pipeline.getMagnitude(), referenceMagnitude, cv::NORM_INF);
+        if (edgeDifferences != 0 || magnitudeDifference != 0) {
+            std::cerr << label << ": canny differs, " << edgeDifferences << " edge pixels, max. magnitude difference " << magnitudeDifference << std::endl;
+            equal = false;
+            continue;
+        }
+
+        cv::Mat detected = cv::Mat::zeros(img.rows, img.cols, CV_8U);
+        edges.copyTo(detected(area));
+
+        // Area of the edge filters, see remove_points_with_low_angle and filter_edges
+        int start_x = std::max(5, area.x + 5);
+        int end_x = std::min(img.cols - 5, area.x + area.width - 5);
+        int start_y = std::max(5, area.y + 5);
+        int end_y = std::min(img.rows - 5, area.y + area.height - 5);
+
+        cv::Mat referenceDetected = detected.clone();
+        referenceThinCorners(&referenceDetected, start_x, end_x, start_y, end_y);
+        EdgePipeline::thinCorners(detected, start_x, end_x, start_y, end_y);
+
+        int thinDifferences = cv::countNonZero(detected != referenceDetected);
+        if (thinDifferences != 0) {
+            std::cerr << label << ": corner thinning differs in " << thinDifferences << " pixels" << std::endl;
+            equal = false;
+            continue;
+        }
+
+        std::vector<EdgeCurve> reference = referenceCurves(&referenceDetected, area.x, area.x + area.width, area.y, area.y + area.height);
+        if (!sameCurves(pipeline.findCurves(detected, area.x, area.x + area.width, area.y, area.y + area.height), reference)) {
+            std::cerr << label << ": curves differ" << std::endl;
+            equal = false;
+        }
+    }
+
+    return equal;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::pair<std::string, cv::Mat>> images;
+
+    const std::vector<cv::Size> sizes = {cv::Size(97, 61), cv::Size(320, 240), cv::Size(401, 299), cv::Size(640, 480)};
+    for (const cv::Size &size: sizes) {
+        for (uint64_t seed = 1; seed <= 4; seed++)
+            images.emplace_back("synthetic " + std::to_string(size.width) + "x" + std::to_string(size.height) + " #" + std::to_string(seed), syntheticEye(size, seed));
+    }
+
+    if (argc > 1) {
+        std::vector<cv::String> filenames;
+        cv::glob(argv[1], filenames, false);
+        for (const cv::String &filename: filenames) {
+            cv::Mat img = cv::imread(filename, cv::IMREAD_GRAYSCALE);
+            if (img.data)
+                images.emplace_back(filename, img);
+        }
+    }
+
+    // The same pipeline is used for all images, so that reused buffers of different sizes are checked as well
+    EdgePipeline pipeline;
+    int failed = 0;
+
+    for (const auto &image: images) {
+        const cv::Mat &img = image.second;
+
+        bool equal = checkImage(pipeline, img, cv::Rect(0, 0, img.cols, img.rows), image.first);
+
+        // Not continuous region, like the ROI of ExCuSe
+        cv::Rect area(img.cols / 8, img.rows / 6, img.cols * 5 / 8, img.rows * 2 / 3);
+        if (area.width > 20 && area.height > 20)
+            equal = checkImage(pipeline, img, area, image.first + " (region)") && equal;
+
+        if (!equal)
+            failed++;
+    }
+
+    std::cout << images.size() - failed << " of " << images.size() << " images equal" << std::endl;
+
+    return failed == 0 ? 0 : 1;
+}
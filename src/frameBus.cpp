@@ -0,0 +1,123 @@
+
+#include <algorithm>
+#include <QtCore/QMutexLocker>
+#include "frameBus.h"
+
+// Creates a new frame bus, the ring holds at most capacity frames not yet read by all lossless subscribers
+FrameBus::FrameBus(int capacity) : ring(std::max(2, capacity)), published(0), released(0) {
+
+}
+
+// Subscriptions hold a reference to the bus, thus the bus is only destroyed when no subscription exists anymore
+FrameBus::~FrameBus() = default;
+
+// Stores the image as new frame and notifies the subscribers
+// The frame is written before the published count is increased, subscribers only read frames below the published count
+void FrameBus::publish(const CameraImage &img) {
+    QMutexLocker locker(&mutex);
+
+    const uint64_t sequence = published.load(std::memory_order_relaxed);
+    const uint64_t capacity = ring.size();
+
+    std::atomic_store(&ring[sequence % capacity], std::shared_ptr<const Frame>(new Frame{sequence, img}));
+    published.store(sequence + 1, std::memory_order_release);
+
+    // Release the frames read by all lossless subscribers, the newest frame is always kept for the latest subscribers
+    // Frames older than the ring capacity were already replaced by the current and previous frames
+    uint64_t releaseUntil = sequence;
+    for(FrameSubscription *subscription : subscriptions) {
+        if(subscription->mode == FrameSubscriptionMode::LOSSLESS)
+            releaseUntil = std::min(releaseUntil, subscription->cursor.load());
+    }
+    released = std::max(released, sequence + 1 > capacity ? sequence + 1 - capacity : 0);
+    for(; released < releaseUntil; released++) {
+        std::atomic_store(&ring[released % capacity], std::shared_ptr<const Frame>());
+    }
+
+    for(FrameSubscription *subscription : subscriptions) {
+        subscription->notify();
+    }
+}
+
+std::shared_ptr<const FrameBus::Frame> FrameBus::getFrame(uint64_t sequence) {
+    return std::atomic_load(&ring[sequence % ring.size()]);
+}
+
+// New subscriptions start with the next published frame
+void FrameBus::subscribe(FrameSubscription *subscription) {
+    QMutexLocker locker(&mutex);
+
+    subscription->cursor = published.load();
+    subscriptions.push_back(subscription);
+}
+
+// After unsubscribing, the subscription is not notified anymore and may be destroyed
+void FrameBus::unsubscribe(FrameSubscription *subscription) {
+    QMutexLocker locker(&mutex);
+
+    subscriptions.erase(std::remove(subscriptions.begin(), subscriptions.end(), subscription), subscriptions.end());
+}
+
+
+// Creates a new subscription to the given bus, receiving frames published from now on
+FrameSubscription::FrameSubscription(std::shared_ptr<FrameBus> bus, FrameSubscriptionMode mode, QObject *parent) :
+        QObject(parent),
+        bus(std::move(bus)),
+        mode(mode),
+        cursor(0),
+        deliveryPending(false),
+        droppedFrames(0) {
+
+    this->bus->subscribe(this);
+}
+
+FrameSubscription::~FrameSubscription() {
+    bus->unsubscribe(this);
+}
+
+// Called by the publishing thread, schedules a delivery in the thread of this subscription if none is pending
+void FrameSubscription::notify() {
+    if(!deliveryPending.exchange(true))
+        QMetaObject::invokeMethod(this, "deliver", Qt::QueuedConnection);
+}
+
+// Delivers the frames published since the last delivery, executed in the thread of this subscription
+// The pending flag is reset first, frames published during the delivery schedule the next one
+void FrameSubscription::deliver() {
+
+    deliveryPending = false;
+
+    const uint64_t available = bus->published.load(std::memory_order_acquire);
+    const uint64_t capacity = bus->ring.size();
+    uint64_t next = cursor.load();
+
+    if(mode == FrameSubscriptionMode::LATEST) {
+        if(available <= next)
+            return;
+
+        cursor = available;
+        std::shared_ptr<const FrameBus::Frame> frame = bus->getFrame(available - 1);
+        // A newer frame may have replaced it in the meantime, which is then delivered by the next scheduled delivery
+        if(frame && frame->sequence == available - 1)
+            emit onNewGrabResult(frame->image);
+        return;
+    }
+
+    while(next < available) {
+        std::shared_ptr<const FrameBus::Frame> frame = bus->getFrame(next);
+
+        if(!frame || frame->sequence != next) {
+            // The publisher overwrote the frame before it was read, continue with the oldest frame still in the ring
+            const uint64_t published = bus->published.load(std::memory_order_acquire);
+            const uint64_t oldest = std::max(next + 1, published > capacity ? published - capacity : 0);
+            droppedFrames += oldest - next;
+            next = oldest;
+            cursor = next;
+            continue;
+        }
+
+        next++;
+        cursor = next;
+        emit onNewGrabResult(frame->image);
+    }
+}
@@ -0,0 +1,138 @@
+
+#ifndef PUPILEXT_FRAMEBUS_H
+#define PUPILEXT_FRAMEBUS_H
+
+/**
+    @author Moritz Lode
+*/
+
+#include <QtCore/QObject>
+#include <QtCore/QMutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "devices/camera.h"
+
+
+enum FrameSubscriptionMode { LATEST=0, LOSSLESS=1 };
+
+class FrameSubscription;
+
+/**
+    Distributes the images of a camera to any number of subscribers, replaces a queued signal connection per consumer
+
+    Published images are stored once as shared immutable frames in a ring, each subscriber reads them through its own cursor.
+    A subscriber has at most one pending delivery in its event queue, independent of the camera rate, thus additional
+    subscribers (i.e. a second camera view) neither queue up images nor hold additional copies of them.
+
+    Publishing and (un)subscribing are serialised by the bus mutex, which is only contended if multiple threads publish at the
+    same time (i.e. the grab threads of a stereo camera). Subscribers do not take the bus mutex, but the slots of the ring are
+    shared pointers accessed through std::atomic_load/std::atomic_store, which are not lock-free (libstdc++ guards them with an
+    internal pool of mutexes, held only while copying the pointer). Frames are released from the ring once all lossless
+    subscribers have read them.
+
+    CAUTION: A lossless subscriber falling behind by more than the ring capacity loses the overwritten frames, they are counted
+    per subscription, see FrameSubscription::getDroppedFrameCount()
+
+    CAUTION: Frames are shared between all subscribers, a subscriber must clone an image before modifying it
+
+    publish(): stores a new camera image and notifies all subscribers, called in the thread of the camera
+*/
+class FrameBus {
+
+public:
+
+    explicit FrameBus(int capacity = 64);
+    ~FrameBus();
+
+    void publish(const CameraImage &img);
+
+    int getCapacity() {
+        return static_cast<int>(ring.size());
+    }
+
+    uint64_t getPublishedCount() {
+        return published.load();
+    }
+
+private:
+
+    friend class FrameSubscription;
+
+    struct Frame {
+        uint64_t sequence;
+        CameraImage image;
+    };
+
+    QMutex mutex;
+
+    std::vector<std::shared_ptr<const Frame>> ring;
+    std::atomic<uint64_t> published;
+    uint64_t released;
+
+    std::vector<FrameSubscription*> subscriptions;
+
+    std::shared_ptr<const Frame> getFrame(uint64_t sequence);
+
+    void subscribe(FrameSubscription *subscription);
+    void unsubscribe(FrameSubscription *subscription);
+
+};
+
+
+/**
+    Subscription to the images of a FrameBus, emits onNewGrabResult in its own thread like a camera
+
+    The subscription must live in the thread of the receiving object, for receivers in a worker thread it is moved to that
+    thread, so that the collapsing of deliveries happens in the event queue of the worker.
+
+    Modes define which images are delivered:
+    LATEST: only the newest image at the time of delivery, skipped images are not counted (views, calibration)
+    LOSSLESS: every image in order, images overwritten in the ring before they were read are counted as dropped (recording)
+
+    getDroppedFrameCount(): number of images a lossless subscriber missed as it fell behind the ring capacity
+
+signals:
+    onNewGrabResult(CameraImage grabResult): delivers an image of the bus, executed in the thread of the subscription
+*/
+class FrameSubscription : public QObject {
+    Q_OBJECT
+
+public:
+
+    explicit FrameSubscription(std::shared_ptr<FrameBus> bus, FrameSubscriptionMode mode = FrameSubscriptionMode::LATEST, QObject *parent = 0);
+    ~FrameSubscription() override;
+
+    FrameSubscriptionMode getMode() {
+        return mode;
+    }
+
+    uint64_t getDroppedFrameCount() {
+        return droppedFrames.load();
+    }
+
+private:
+
+    friend class FrameBus;
+
+    std::shared_ptr<FrameBus> bus;
+    FrameSubscriptionMode mode;
+
+    std::atomic<uint64_t> cursor;
+    std::atomic<bool> deliveryPending;
+    std::atomic<uint64_t> droppedFrames;
+
+    void notify();
+
+private slots:
+
+    void deliver();
+
+signals:
+
+    void onNewGrabResult(const CameraImage &grabResult);
+
+};
+
+
+#endif //PUPILEXT_FRAMEBUS_H
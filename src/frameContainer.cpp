@@ -0,0 +1,293 @@
+
+#include <QtCore/QFileInfo>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include "frameContainer.h"
+
+static const char headerMagic[8] = {'P', 'X', 'F', 'R', 'A', 'M', 'E', 'S'};
+static const char recordMagic[4] = {'F', 'R', 'M', '0'};
+static const uint32_t containerVersion = 1;
+
+// Records and frame data are aligned to cache lines, allows aligned vector loads on the memory mapped images
+static const uint64_t containerAlignment = 64;
+static const uint64_t pageSize = 4096;
+
+static uint64_t alignedSize(uint64_t size) {
+    return (size + containerAlignment - 1) & ~(containerAlignment - 1);
+}
+
+// Creates a new container file, an existing file is overwritten
+// Camera count is 1 for single camera recordings and 2 for stereo recordings
+FrameContainerWriter::FrameContainerWriter(const std::string &filename, int cameraCount) :
+        file(nullptr),
+        fileBuffer(4 << 20),
+        offset(0) {
+
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, headerMagic, sizeof(header.magic));
+    header.version = containerVersion;
+    header.cameraCount = static_cast<uint32_t>(std::min(2, std::max(1, cameraCount)));
+
+    file = std::fopen(filename.c_str(), "wb");
+    if(!file) {
+        std::cerr << "FrameContainerWriter: Could not open file: " << filename << std::endl;
+        return;
+    }
+
+    // Large stdio buffer, so that the images are written in few large blocks
+    std::setvbuf(file, fileBuffer.data(), _IOFBF, fileBuffer.size());
+
+    if(std::fwrite(&header, sizeof(header), 1, file) != 1) {
+        std::cerr << "FrameContainerWriter: Could not write header: " << filename << std::endl;
+        std::fclose(file);
+        file = nullptr;
+        return;
+    }
+    offset = sizeof(header);
+}
+
+FrameContainerWriter::~FrameContainerWriter() {
+    close();
+}
+
+// Appends the image as record to the container, returns false if the image could not be written
+// On a write error the container is closed without index, the records written so far remain readable
+bool FrameContainerWriter::write(const cv::Mat &img, uint64_t timestamp, uint64_t frameNumber, int cameraIndex) {
+
+    if(!file || img.empty() || img.dims != 2 || cameraIndex < 0 || cameraIndex >= static_cast<int>(header.cameraCount))
+        return false;
+
+    FrameContainerRecord record;
+    std::memset(&record, 0, sizeof(record));
+    std::memcpy(record.magic, recordMagic, sizeof(record.magic));
+    record.cameraIndex = static_cast<uint32_t>(cameraIndex);
+    record.timestamp = timestamp;
+    record.frameNumber = frameNumber;
+    record.width = static_cast<uint32_t>(img.cols);
+    record.height = static_cast<uint32_t>(img.rows);
+    record.type = static_cast<uint32_t>(img.type());
+    record.step = static_cast<uint32_t>(img.cols * img.elemSize());
+    record.dataSize = static_cast<uint64_t>(record.step) * record.height;
+
+    const uint64_t padding = alignedSize(record.dataSize) - record.dataSize;
+    static const char zeros[containerAlignment] = {};
+
+    bool ok = std::fwrite(&record, sizeof(record), 1, file) == 1;
+    if(img.isContinuous()) {
+        ok = ok && std::fwrite(img.data, 1, record.dataSize, file) == record.dataSize;
+    } else {
+        for(int r = 0; ok && r < img.rows; r++)
+            ok = std::fwrite(img.ptr(r), 1, record.step, file) == record.step;
+    }
+    ok = ok && std::fwrite(zeros, 1, padding, file) == padding;
+
+    if(!ok) {
+        std::cerr << "FrameContainerWriter: Could not write image, closing container without index." << std::endl;
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    FrameContainerIndexEntry entry;
+    entry.offset = offset;
+    entry.timestamp = timestamp;
+    entry.frameNumber = frameNumber;
+    entry.cameraIndex = record.cameraIndex;
+    entry.reserved = 0;
+    index.push_back(entry);
+
+    offset += sizeof(record) + record.dataSize + padding;
+    return true;
+}
+
+// Writes the index of all records behind the last record and updates the header with its offset
+void FrameContainerWriter::close() {
+
+    if(!file)
+        return;
+
+    header.indexOffset = offset;
+    header.frameCount = index.size();
+
+    bool ok = index.empty() || std::fwrite(index.data(), sizeof(FrameContainerIndexEntry), index.size(), file) == index.size();
+    ok = ok && std::fseek(file, 0, SEEK_SET) == 0;
+    ok = ok && std::fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = std::fclose(file) == 0 && ok;
+    file = nullptr;
+
+    if(!ok) {
+        std::cerr << "FrameContainerWriter: Could not write index, container is read by scanning its records." << std::endl;
+    }
+}
+
+
+// Opens and memory maps the given container file, throws std::invalid_argument if it is not a valid container
+FrameContainerReader::FrameContainerReader(const QString &filename) :
+        file(std::make_shared<QFile>(filename)),
+        data(nullptr),
+        size(0) {
+
+    if(!file->open(QIODevice::ReadOnly)) {
+        throw std::invalid_argument( "Frame container could not be opened." );
+    }
+
+    size = static_cast<uint64_t>(file->size());
+    if(size < sizeof(header)) {
+        throw std::invalid_argument( "Frame container is too small." );
+    }
+
+    // Private mapping, a receiver writing into an image only modifies its own copy of the page and never the file
+    data = file->map(0, file->size(), QFileDevice::MapPrivateOption);
+    if(!data) {
+        throw std::invalid_argument( "Frame container could not be memory mapped." );
+    }
+
+    std::memcpy(&header, data, sizeof(header));
+    if(std::memcmp(header.magic, headerMagic, sizeof(header.magic)) != 0 || header.version != containerVersion || header.cameraCount < 1 || header.cameraCount > 2) {
+        throw std::invalid_argument( "File is not a supported frame container." );
+    }
+
+    const uint64_t indexSize = header.frameCount * sizeof(FrameContainerIndexEntry);
+    if(header.indexOffset >= sizeof(header) && header.indexOffset <= size && indexSize <= size - header.indexOffset) {
+        const auto *entries = reinterpret_cast<const FrameContainerIndexEntry*>(data + header.indexOffset);
+        for(uint64_t i = 0; i < header.frameCount; i++) {
+            if(validRecord(entries[i].offset))
+                addRecord(entries[i].offset);
+        }
+    } else {
+        std::cout << "FrameContainerReader: No index found, container was not closed properly, scanning records..." << std::endl;
+        scanRecords();
+    }
+
+    // Stereo frames require both images
+    if(header.cameraCount == 2) {
+        size_t count = frames.size();
+        frames.erase(std::remove_if(frames.begin(), frames.end(), [](const Frame &frame) { return frame.offset[1] == 0; }), frames.end());
+        if(frames.size() != count) {
+            std::cerr << "FrameContainerReader: Skipping " << (count - frames.size()) << " stereo frames without secondary image." << std::endl;
+        }
+    }
+
+    std::cout << "FrameContainerReader: found " << frames.size() << " frames in " << filename.toStdString() << std::endl;
+}
+
+// The mapping is not unmapped here, images which are still referenced elsewhere hold the file, it is unmapped with the last of them
+FrameContainerReader::~FrameContainerReader() = default;
+
+// Containers are recognized by their file extension
+bool FrameContainerReader::isContainer(const QString &filename) {
+    return QFileInfo(filename).suffix().compare(FRAMECONTAINER_EXTENSION, Qt::CaseInsensitive) == 0;
+}
+
+// Checks that a complete record with consistent image size starts at the given offset
+bool FrameContainerReader::validRecord(uint64_t offset) {
+
+    if(offset < sizeof(header) || offset > size || size - offset < sizeof(FrameContainerRecord))
+        return false;
+
+    const auto *record = reinterpret_cast<const FrameContainerRecord*>(data + offset);
+
+    const uint64_t elemSize = CV_ELEM_SIZE(static_cast<int>(record->type));
+    return std::memcmp(record->magic, recordMagic, sizeof(record->magic)) == 0
+           && record->cameraIndex < header.cameraCount
+           && record->width > 0 && record->height > 0
+           && record->step == record->width * elemSize
+           && record->dataSize == static_cast<uint64_t>(record->step) * record->height
+           && record->dataSize <= size - offset - sizeof(FrameContainerRecord);
+}
+
+// Adds the record at the given offset, images of the secondary camera are assigned to the preceding main camera image
+void FrameContainerReader::addRecord(uint64_t offset) {
+
+    const auto *record = reinterpret_cast<const FrameContainerRecord*>(data + offset);
+
+    if(record->cameraIndex == 0) {
+        frames.push_back({record->timestamp, record->frameNumber, {offset, 0}});
+        return;
+    }
+
+    if(!frames.empty() && frames.back().offset[1] == 0 && frames.back().timestamp == record->timestamp && frames.back().frameNumber == record->frameNumber) {
+        frames.back().offset[1] = offset;
+    }
+}
+
+// Reads the records in order from the start of the file until the first incomplete record
+void FrameContainerReader::scanRecords() {
+
+    uint64_t offset = sizeof(header);
+
+    while(validRecord(offset)) {
+        addRecord(offset);
+        offset += sizeof(FrameContainerRecord) + alignedSize(reinterpret_cast<const FrameContainerRecord*>(data + offset)->dataSize);
+    }
+}
+
+// Returns the image of the given frame and camera, the image references the mapped file and is not copied, but keeps it mapped
+cv::Mat FrameContainerReader::getImage(size_t frame, int cameraIndex) {
+
+    if(frame >= frames.size() || cameraIndex < 0 || cameraIndex >= static_cast<int>(header.cameraCount))
+        return cv::Mat();
+
+    const uint64_t offset = frames[frame].offset[cameraIndex];
+    const auto *record = reinterpret_cast<const FrameContainerRecord*>(data + offset);
+
+    return FrameContainerAllocator::wrap(file, static_cast<int>(record->height), static_cast<int>(record->width), static_cast<int>(record->type),
+                                         data + offset + sizeof(FrameContainerRecord), record->step);
+}
+
+// Reads one byte per memory page of the images of the given frame, the pages are then read from disk by the calling thread
+void FrameContainerReader::prefetch(size_t frame) {
+
+    if(frame >= frames.size())
+        return;
+
+    volatile uchar sink = 0;
+    for(uint32_t c = 0; c < header.cameraCount; c++) {
+        const uint64_t offset = frames[frame].offset[c];
+        const auto *record = reinterpret_cast<const FrameContainerRecord*>(data + offset);
+        const uint64_t end = offset + sizeof(FrameContainerRecord) + record->dataSize;
+
+        for(uint64_t p = offset; p < end; p += pageSize)
+            sink ^= data[p];
+    }
+}
+
+
+// Wraps the image data of the mapped file into a matrix, the matrix data holds a reference to the file and thus its mapping
+cv::Mat FrameContainerAllocator::wrap(const std::shared_ptr<QFile> &file, int rows, int cols, int type, uchar *data, size_t step) {
+
+    static FrameContainerAllocator allocator;
+
+    cv::Mat img(rows, cols, type, data, step);
+
+    // Same scheme as the numpy allocator of the OpenCV python bindings, the matrix becomes the first reference of the data
+    cv::UMatData *u = new cv::UMatData(&allocator);
+    u->data = u->origdata = data;
+    u->size = step * rows;
+    u->userdata = new std::shared_ptr<QFile>(file);
+    img.u = u;
+    img.addref();
+
+    return img;
+}
+
+// Matrices allocated through this allocator (i.e. create() on a wrapped matrix) use the default allocator
+cv::UMatData* FrameContainerAllocator::allocate(int dims, const int* sizes, int type, void* data, size_t* step, cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const {
+    return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+}
+
+bool FrameContainerAllocator::allocate(cv::UMatData* data, cv::AccessFlag accessflags, cv::UMatUsageFlags usageFlags) const {
+    return cv::Mat::getStdAllocator()->allocate(data, accessflags, usageFlags);
+}
+
+// Called when the last matrix referencing the image is released, releases the file reference, the last one unmaps the file
+void FrameContainerAllocator::deallocate(cv::UMatData* u) const {
+
+    if(!u || u->refcount != 0 || u->urefcount != 0)
+        return;
+
+    delete static_cast<std::shared_ptr<QFile>*>(u->userdata);
+    delete u;
+}
@@ -0,0 +1,200 @@
+
+#ifndef PUPILEXT_FRAMECONTAINER_H
+#define PUPILEXT_FRAMECONTAINER_H
+
+/**
+    @author Moritz Lode
+*/
+
+#include <QtCore/QFile>
+#include <opencv2/core/mat.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// File extension of the raw frame container recordings
+#define FRAMECONTAINER_EXTENSION "pxr"
+
+/*
+    File layout of the raw frame container, all values are little-endian as written by the recording machine
+
+    [FrameContainerHeader]
+    [FrameContainerRecord][frame data, padded to 64 bytes]   (repeated for every camera image, append-only)
+    ...
+    [FrameContainerIndexEntry]                              (one per record, written on close)
+    ...
+
+    Record headers and frame data start at 64 byte aligned offsets. The index offset and frame count in the header are
+    written on close, a container which was not closed properly (i.e. crash during recording) has an index offset of zero,
+    its records are then found by scanning the file from the start.
+*/
+struct FrameContainerHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t cameraCount;
+    uint64_t frameCount;
+    uint64_t indexOffset;
+    uint8_t reserved[32];
+};
+
+struct FrameContainerRecord {
+    char magic[4];
+    uint32_t cameraIndex;
+    uint64_t timestamp;
+    uint64_t frameNumber;
+    uint32_t width;
+    uint32_t height;
+    uint32_t type;
+    uint32_t step;
+    uint64_t dataSize;
+    uint8_t reserved[16];
+};
+
+struct FrameContainerIndexEntry {
+    uint64_t offset;
+    uint64_t timestamp;
+    uint64_t frameNumber;
+    uint32_t cameraIndex;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(FrameContainerHeader) == 64, "FrameContainerHeader must be 64 bytes");
+static_assert(sizeof(FrameContainerRecord) == 64, "FrameContainerRecord must be 64 bytes");
+static_assert(sizeof(FrameContainerIndexEntry) == 32, "FrameContainerIndexEntry must be 32 bytes");
+
+
+/**
+    Append-only writer of raw camera images into a single container file, replaces one image file per frame
+
+    Images are written uncompressed, each with its timestamp, frame number and camera index (0 main camera, 1 secondary
+    camera), the same layout as the stereo directories 0 and 1 of image file recordings. Writing is not thread-safe, a
+    single thread must write the images in order.
+
+    write(): appends an image to the container
+    close(): writes the trailing index and finalizes the header, called by the destructor
+*/
+class FrameContainerWriter {
+
+public:
+
+    explicit FrameContainerWriter(const std::string &filename, int cameraCount = 1);
+    ~FrameContainerWriter();
+
+    bool isOpen() {
+        return file != nullptr;
+    }
+
+    uint64_t getFrameCount() {
+        return index.size();
+    }
+
+    bool write(const cv::Mat &img, uint64_t timestamp, uint64_t frameNumber, int cameraIndex = 0);
+    void close();
+
+private:
+
+    std::FILE *file;
+    std::vector<char> fileBuffer;
+
+    FrameContainerHeader header;
+    std::vector<FrameContainerIndexEntry> index;
+    uint64_t offset;
+
+};
+
+
+/**
+    Reader of raw frame containers, the file is memory mapped and images are returned without copy
+
+    For stereo containers, the images of camera 0 and 1 with the same timestamp and frame number form a single frame,
+    images without their corresponding image are skipped
+
+    Returned images reference the memory mapped file through FrameContainerAllocator, every copy of the cv::Mat (i.e. in the
+    frame bus, queued signals or the image writer) keeps the mapping alive, the file is unmapped when the reader and the
+    last image referencing it are released
+
+    getImage(): returns the image of the given frame and camera index, referencing the mapped file
+    prefetch(): touches the memory of the given frame, so that the pages are read from disk before accessing the image
+*/
+class FrameContainerReader {
+
+public:
+
+    explicit FrameContainerReader(const QString &filename);
+    ~FrameContainerReader();
+
+    static bool isContainer(const QString &filename);
+
+    QString getFilename() {
+        return file->fileName();
+    }
+
+    int getCameraCount() {
+        return static_cast<int>(header.cameraCount);
+    }
+
+    size_t getFrameCount() {
+        return frames.size();
+    }
+
+    uint64_t getTimestamp(size_t frame) {
+        return frames[frame].timestamp;
+    }
+
+    uint64_t getFrameNumber(size_t frame) {
+        return frames[frame].frameNumber;
+    }
+
+    cv::Mat getImage(size_t frame, int cameraIndex = 0);
+    void prefetch(size_t frame);
+
+private:
+
+    // Frame of the container, the record offsets of each camera image
+    struct Frame {
+        uint64_t timestamp;
+        uint64_t frameNumber;
+        uint64_t offset[2];
+    };
+
+    // Shared with the returned images, destroying the QFile unmaps the file
+    std::shared_ptr<QFile> file;
+    uchar *data;
+    uint64_t size;
+
+    FrameContainerHeader header;
+    std::vector<Frame> frames;
+
+    bool validRecord(uint64_t offset);
+    void addRecord(uint64_t offset);
+    void scanRecords();
+
+};
+
+
+/**
+    OpenCV matrix allocator which references the memory mapped file of a FrameContainerReader instead of owning memory,
+    used to pass container images to the application without copy
+
+    Same scheme as GrabResultAllocator, the matrix data holds a reference to the mapped file, which is unmapped when the
+    last matrix referencing it is released. Consumers which need to modify an image must clone it first, as before.
+
+    wrap(): returns a matrix referencing the given image data of the mapped file
+*/
+class FrameContainerAllocator : public cv::MatAllocator {
+
+public:
+
+    static cv::Mat wrap(const std::shared_ptr<QFile> &file, int rows, int cols, int type, uchar *data, size_t step);
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override;
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessflags, cv::UMatUsageFlags usageFlags) const override;
+    void deallocate(cv::UMatData* data) const override;
+
+};
+
+
+#endif //PUPILEXT_FRAMECONTAINER_H
@@ -0,0 +1,160 @@
+
+#include "frameQueue.h"
+
+// Creates a new frame queue holding at most capacity images
+FrameQueue::FrameQueue(int capacity, FrameQueuePolicy policy, QObject *parent) : QObject(parent),
+                                                                                 buffer(std::max(1, capacity)),
+                                                                                 head(0),
+                                                                                 count(0),
+                                                                                 policy(policy),
+                                                                                 closed(false),
+                                                                                 totalDropCount(0),
+                                                                                 secDropCount(0) {
+    dropTimer.start();
+}
+
+FrameQueue::~FrameQueue() {
+    close();
+}
+
+// Enqueues a new image, if the queue is full the configured policy decides which image is discarded or if the caller waits
+// Returns false if the given image was not enqueued (dropped or queue closed)
+bool FrameQueue::push(const CameraImage &img) {
+
+    bool enqueued = true;
+    double dropRate = -1.0;
+
+    mutex.lock();
+
+    if(policy == FrameQueuePolicy::BLOCK) {
+        while(count == buffer.size() && !closed)
+            notFull.wait(&mutex);
+    }
+
+    if(closed) {
+        mutex.unlock();
+        return false;
+    }
+
+    if(count == buffer.size()) {
+        totalDropCount++;
+        secDropCount++;
+
+        if(policy == FrameQueuePolicy::DROP_NEWEST) {
+            enqueued = false;
+        } else {
+            // Overwrite the oldest image, the head moves one forward
+            head = (head + 1) % buffer.size();
+            count--;
+        }
+    }
+
+    if(enqueued) {
+        buffer[(head + count) % buffer.size()] = img;
+        count++;
+    }
+
+    // Once a second, calculate the drop rate of the last interval
+    if(dropTimer.elapsed() > 999) {
+        dropRate = secDropCount / (dropTimer.elapsed() / 1000.0);
+        secDropCount = 0;
+        dropTimer.restart();
+    }
+
+    mutex.unlock();
+
+    if(dropRate >= 0)
+        emit droppedFPS(dropRate);
+
+    return enqueued;
+}
+
+// Dequeues the oldest image, returns false if the queue is empty
+bool FrameQueue::pop(CameraImage &img) {
+    QMutexLocker locker(&mutex);
+
+    if(count == 0)
+        return false;
+
+    img = buffer[head];
+    // Release the image data held by the slot, otherwise the ring keeps the images alive
+    buffer[head] = CameraImage();
+    head = (head + 1) % buffer.size();
+    count--;
+
+    notFull.wakeOne();
+    return true;
+}
+
+// Discards all queued images
+void FrameQueue::clear() {
+    QMutexLocker locker(&mutex);
+
+    for(auto &slot: buffer)
+        slot = CameraImage();
+    head = 0;
+    count = 0;
+
+    notFull.wakeAll();
+}
+
+// Accept images again after the queue was closed
+void FrameQueue::open() {
+    QMutexLocker locker(&mutex);
+    closed = false;
+    secDropCount = 0;
+    dropTimer.restart();
+}
+
+// Rejects further images and wakes up producers blocked in push
+void FrameQueue::close() {
+    QMutexLocker locker(&mutex);
+    closed = true;
+    notFull.wakeAll();
+}
+
+bool FrameQueue::isEmpty() {
+    QMutexLocker locker(&mutex);
+    return count == 0;
+}
+
+int FrameQueue::size() {
+    QMutexLocker locker(&mutex);
+    return static_cast<int>(count);
+}
+
+int FrameQueue::getCapacity() {
+    QMutexLocker locker(&mutex);
+    return static_cast<int>(buffer.size());
+}
+
+// Changing the capacity discards the currently queued images
+void FrameQueue::setCapacity(int value) {
+    QMutexLocker locker(&mutex);
+
+    if(value < 1 || static_cast<size_t>(value) == buffer.size())
+        return;
+
+    buffer = std::vector<CameraImage>(value);
+    head = 0;
+    count = 0;
+
+    notFull.wakeAll();
+}
+
+FrameQueuePolicy FrameQueue::getPolicy() {
+    QMutexLocker locker(&mutex);
+    return policy;
+}
+
+void FrameQueue::setPolicy(FrameQueuePolicy value) {
+    QMutexLocker locker(&mutex);
+    policy = value;
+    // Producers waiting due to a previous BLOCK policy must re-evaluate
+    notFull.wakeAll();
+}
+
+uint64_t FrameQueue::droppedFrameCount() {
+    QMutexLocker locker(&mutex);
+    return totalDropCount;
+}
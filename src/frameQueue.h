@@ -0,0 +1,88 @@
+
+#ifndef PUPILEXT_FRAMEQUEUE_H
+#define PUPILEXT_FRAMEQUEUE_H
+
+/**
+    @author Moritz Lode
+*/
+
+#include <QtCore/QObject>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+#include <QtCore/QElapsedTimer>
+#include "devices/camera.h"
+
+
+enum FrameQueuePolicy { DROP_OLDEST=0, DROP_NEWEST=1, BLOCK=2 };
+
+
+/**
+    Bounded, thread-safe ring buffer of camera images placed between a camera and a slower consumer i.e. the pupil detection
+
+    Replaces the unbounded queueing of images in the Qt event loop, which lets the memory grow until the application is killed
+    when the consumer can not keep up with the camera rate
+
+    Policies define what happens when a new image arrives while the queue is full:
+    DROP_OLDEST: the oldest queued image is discarded (live cameras, detection stays close to real-time)
+    DROP_NEWEST: the arriving image is discarded (keeps the already queued sequence intact)
+    BLOCK: the producer is blocked until space is available (file playback, no images are lost)
+
+    CAUTION: BLOCK stalls the producing thread, for live cameras this only shifts the dropping to the camera driver
+
+    push(): called by the producer thread, enqueues a new image according to the policy
+    pop(): called by the consumer thread, returns false if no image is queued
+    close(): wakes up and rejects blocked producers, used when the consumer stops
+
+signals:
+    droppedFPS(double fps): number of dropped images per second, emitted roughly each second while images arrive
+*/
+class FrameQueue : public QObject {
+    Q_OBJECT
+
+public:
+
+    explicit FrameQueue(int capacity = 32, FrameQueuePolicy policy = FrameQueuePolicy::DROP_OLDEST, QObject *parent = 0);
+    ~FrameQueue() override;
+
+    bool push(const CameraImage &img);
+    bool pop(CameraImage &img);
+
+    void clear();
+    void open();
+    void close();
+
+    bool isEmpty();
+    int size();
+
+    int getCapacity();
+    void setCapacity(int value);
+
+    FrameQueuePolicy getPolicy();
+    void setPolicy(FrameQueuePolicy value);
+
+    uint64_t droppedFrameCount();
+
+private:
+
+    QMutex mutex;
+    QWaitCondition notFull;
+
+    std::vector<CameraImage> buffer;
+    size_t head;
+    size_t count;
+
+    FrameQueuePolicy policy;
+    bool closed;
+
+    uint64_t totalDropCount;
+    int secDropCount;
+    QElapsedTimer dropTimer;
+
+signals:
+
+    void droppedFPS(double fps);
+
+};
+
+
+#endif //PUPILEXT_FRAMEQUEUE_H
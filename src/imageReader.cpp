@@ -2,6 +2,7 @@
 #include <opencv2/core/utility.hpp>
 #include <opencv2/opencv.hpp>
 #include <QtConcurrent/QtConcurrent>
+#include <fstream>
 #include "imageReader.h"
 
 // Creates a new image reader which opens the given directory and plays back the contained image files
@@ -9,14 +10,37 @@
 // Actual playback process is performed using Qts concurrent thread execution, to no block the GUI thread
 // First it is checked wherever a stereo directory structure exists or not, which
 ImageReader::ImageReader(QString directory, int playbackSpeed, bool playbackLoop, QObject *parent) :
-    QObject(parent), imageDirectory(directory), startTimestamp(0), playbackSpeed(playbackSpeed), noDelay(false), stereoMode(false), playbackLoop(playbackLoop), state(PlaybackState::STOPPED), currentImageIndex(0) {
+    QObject(parent), imageDirectory(directory), startTimestamp(0), playbackSpeed(playbackSpeed), noDelay(false), stereoMode(false), playbackLoop(playbackLoop), state(PlaybackState::STOPPED), currentImageIndex(0), containerMode(false), prefetchDepth(8) {
+
+    // Half of the cores decode ahead, the remaining ones are left for the pupil detection of the played images
+    decoderPool.setMaxThreadCount(std::max(2, QThread::idealThreadCount() / 2));
 
     if(!imageDirectory.exists()) {
         throw std::invalid_argument( "Image Directory does not exists." );
     }
 
-    // Check if in directory, a stereo structure with directories 0 and 1 for main and secondary camera are present
-    if(imageDirectory.exists("0") && imageDirectory.exists("1")) {
+    const QStringList containerFiles = imageDirectory.entryList(QStringList() << QString("*.") + FRAMECONTAINER_EXTENSION, QDir::Files, QDir::Name);
+
+    // Check if in directory, raw frame containers or a stereo structure with directories 0 and 1 for main and secondary camera are present
+    if(!containerFiles.isEmpty()) {
+        containerMode = true;
+
+        std::cout<<"ImageReader: Found raw frame containers in directory, reading containers..." << std::endl;
+
+        for(const QString &containerFile: containerFiles) {
+            containers.emplace_back(new FrameContainerReader(imageDirectory.filePath(containerFile)));
+            FrameContainerReader *container = containers.back().get();
+
+            if(container->getCameraCount() != containers.front()->getCameraCount()) {
+                throw std::invalid_argument( "Frame containers of the directory mix single and stereo recordings." );
+            }
+
+            for(size_t frame = 0; frame < container->getFrameCount(); frame++) {
+                containerImages.emplace_back(container, frame);
+            }
+        }
+        stereoMode = containers.front()->getCameraCount() == 2;
+    } else if(imageDirectory.exists("0") && imageDirectory.exists("1")) {
         stereoMode = true;
 
         std::cout<<"ImageReader: Found stereo structure in directory, reading as stereo..." << std::endl;
@@ -37,7 +61,7 @@ ImageReader::ImageReader(QString directory, int playbackSpeed, bool playbackLoop
         cv::glob(imageDirectory.path().toStdString(), filenames, false);
     }
 
-    std::cout<<"ImageReader: found " << filenames.size() << " images. Ready." << std::endl;
+    std::cout<<"ImageReader: found " << getImageCount() << " images. Ready." << std::endl;
 
     setPlaybackSpeed(playbackSpeed);
 }
@@ -63,70 +87,100 @@ void ImageReader::setPlaybackSpeed(int fps) {
     }
 }
 
-// Executes the play back of the images through reading them in order, creating a CameraImage object and sending the onNewImage signal
-// The play back can be stopped by changing the PlaybackState variable state
-// When the playback is finished, a finished signal is send (also send when stopping the play back early)
-void ImageReader::run() {
+// Sets the number of images which are read ahead of the playback, takes effect on the next start of the playback
+void ImageReader::setPrefetchDepth(int depth) {
+    prefetchDepth = std::max(1, depth);
+}
 
-    for(; currentImageIndex < filenames.size(); currentImageIndex++) {
-        std::chrono::steady_clock::time_point beginProcess = std::chrono::steady_clock::now();
+// Sets the number of threads which read and decode the images ahead of the playback
+void ImageReader::setDecoderThreads(int threads) {
+    decoderPool.setMaxThreadCount(std::max(1, threads));
+}
 
-        if(state != PlaybackState::PLAYING) {
-            std::cout<<"Image Reader: Run Loop found Stop/Pause signal"<<std::endl;
-            break;
-        }
+// Returns the number of images, files or frames of the containers
+int ImageReader::getImageCount() {
+    return containerMode ? static_cast<int>(containerImages.size()) : static_cast<int>(filenames.size());
+}
 
-        //std::chrono::steady_clock::time_point beginRead = std::chrono::steady_clock::now();
-        cv::Mat img = cv::imread(filenames[currentImageIndex], cv::IMREAD_GRAYSCALE);
-        //std::cout<<std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - beginRead).count()<<std::endl;
+// Returns the filename of the image with the given index, for container images the container filename followed by the frame in the container
+std::string ImageReader::getImageName(int index) {
+    if(containerMode) {
+        return containerImages[index].first->getFilename().toStdString() + "#" + std::to_string(containerImages[index].second);
+    }
+    return filenames[index];
+}
 
-        startTimestamp += playbackDelay;
+// Returns the image index following the given one, or -1 if the end of the images is reached and no looping is active
+int ImageReader::nextImageIndex(int index) {
+    if(index + 1 < getImageCount())
+        return index + 1;
+    return playbackLoop && getImageCount() > 0 ? 0 : -1;
+}
 
-        // Due to the continue in the next if, we check for end of the loop here
-        if(playbackLoop && currentImageIndex == filenames.size()-1) {
-            std::cout << "ImageReader: end reached, resetting playback, endless looping " << std::endl;
-            currentImageIndex = 0;
-        }
+// Reads the image file into the given buffer and decodes it as grayscale into the given image matrix
+// The memory of the matrix is reused if no one else references it anymore, otherwise new memory is allocated, as a previously
+// emitted image may still be in use by the receivers of the onNewImage signal
+bool ImageReader::readImage(const std::string &filename, std::vector<uchar> &buffer, cv::Mat &img) {
 
-        if(!img.data) {
-            std::cerr << "Image Reader: Image could not be read, skipping: " << filenames[currentImageIndex] << std::endl;
-            continue;
-        }
+    if(img.u && CV_XADD(&img.u->refcount, 0) > 1)
+        img = cv::Mat();
 
-        //std::cout<<"Reading image: "<< filename << std::endl;
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if(!file.is_open())
+        return false;
 
-        CameraImage cimg;
-        cimg.type = CameraImageType::SINGLE_IMAGE_FILE;
-        cimg.img = img.clone();
-        cimg.timestamp = startTimestamp;
-        cimg.filename = filenames[currentImageIndex];
-        img.release();
+    std::streamsize size = file.tellg();
+    if(size <= 0)
+        return false;
 
-        if(!noDelay) {
-            int durProcess = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - beginProcess).count();
-            if(playbackDelay-durProcess > 0) {
-                QThread::msleep(playbackDelay-durProcess);
-            }
+    buffer.resize(static_cast<size_t>(size));
+    file.seekg(0, std::ios::beg);
+    if(!file.read(reinterpret_cast<char*>(buffer.data()), size))
+        return false;
+
+    cv::imdecode(buffer, cv::IMREAD_GRAYSCALE, &img);
+    return img.data != nullptr;
+}
+
+// Decodes the image(s) of the file index of the given prefetch slot, executed by the threads of the decoder pool
+// Container images are not decoded, only their memory pages are read ahead
+void ImageReader::decode(PrefetchSlot *slot) {
+    if(containerMode) {
+        FrameContainerReader *container = containerImages[slot->index].first;
+        size_t frame = containerImages[slot->index].second;
+
+        container->prefetch(frame);
+        slot->img = container->getImage(frame, 0);
+        if(stereoMode) {
+            slot->imgSecondary = container->getImage(frame, 1);
         }
-        emit onNewImage(cimg);
+        slot->valid = !slot->img.empty() && (!stereoMode || !slot->imgSecondary.empty());
+        return;
     }
 
-    // Playback loop finished, either due to end of files, or pause/stop action
-    if(state != PlaybackState::PAUSED) {
-        state = PlaybackState::STOPPED;
-        currentImageIndex = 0;
+    slot->valid = readImage(filenames[slot->index], slot->buffer, slot->img);
+    if(stereoMode) {
+        slot->valid = readImage(filenamesSecondary[slot->index], slot->bufferSecondary, slot->imgSecondary) && slot->valid;
     }
-    emit finished();
 }
 
-// Executes the play back of the stereo images through reading them in order, creating a CameraImage object and sending the onNewImage signal
+// Executes the play back of the images through reading them in order, creating a CameraImage object and sending the onNewImage signal
+// Images are read and decoded ahead by the decoder pool into the prefetch ring, this thread only waits for the next image, paces and emits it
+// For stereo recordings both images of a file index are decoded in the same slot
 // The play back can be stopped by changing the PlaybackState variable state
 // When the playback is finished, a finished signal is send (also send when stopping the play back early)
-// Stereo images are read using QTs concurrent run to (potentially) reduce file read time
-void ImageReader::runStereo() {
+void ImageReader::run() {
+
+    const int depth = prefetchDepth;
+    prefetchSlots.resize(static_cast<size_t>(depth));
 
-    // We assume both lists filenames and filenamesSecondary are same length
-    for(; currentImageIndex < filenames.size(); currentImageIndex++) {
+    // File index of the next image to decode, -1 if all remaining images are already scheduled
+    int scheduleIndex = currentImageIndex < getImageCount() ? currentImageIndex : -1;
+    // Number of images scheduled for decoding and emitted in this run, the slot of an image is its count modulo the depth
+    uint64 scheduled = 0;
+    uint64 consumed = 0;
+
+    while(true) {
         std::chrono::steady_clock::time_point beginProcess = std::chrono::steady_clock::now();
 
         if(state != PlaybackState::PLAYING) {
@@ -134,38 +188,51 @@ void ImageReader::runStereo() {
             break;
         }
 
-        QFutureSynchronizer<cv::Mat> synchronizer;
-        // Read images from disk asynchronous to save time
-        synchronizer.addFuture(QtConcurrent::run(cv::imread, filenames[currentImageIndex], cv::IMREAD_GRAYSCALE));
-        synchronizer.addFuture(QtConcurrent::run(cv::imread, filenamesSecondary[currentImageIndex], cv::IMREAD_GRAYSCALE));
-        synchronizer.waitForFinished();
-        cv::Mat img = synchronizer.futures().at(0).result();
-        cv::Mat imgSecondary = synchronizer.futures().at(1).result();
+        // Refill the ring with upcoming images, a slot is free again once its previous image was emitted
+        while(scheduleIndex >= 0 && scheduled - consumed < static_cast<uint64>(depth)) {
+            PrefetchSlot *slot = &prefetchSlots[scheduled % depth];
+            slot->index = scheduleIndex;
+            slot->future = QtConcurrent::run(&decoderPool, this, &ImageReader::decode, slot);
+            scheduleIndex = nextImageIndex(scheduleIndex);
+            scheduled++;
+        }
+
+        // All images are emitted
+        if(consumed == scheduled)
+            break;
+
+        PrefetchSlot &slot = prefetchSlots[consumed % depth];
+        slot.future.waitForFinished();
+        consumed++;
 
         startTimestamp += playbackDelay;
 
-        // Due to the continue in the next if, we check for end of the loop here
-        if(playbackLoop && currentImageIndex == filenames.size()-1) {
+        int nextIndex = nextImageIndex(slot.index);
+        currentImageIndex = nextIndex < 0 ? getImageCount() : nextIndex;
+
+        if(playbackLoop && nextIndex == 0) {
             std::cout << "ImageReader: end reached, resetting playback, endless looping " << std::endl;
-            currentImageIndex = 0;
         }
 
-        if(!img.data || !imgSecondary.data) {
-            std::cerr << "Image Reader: StereoImage could not be read, skipping: " << filenames[currentImageIndex] << " and " << filenamesSecondary[currentImageIndex] << std::endl;
+        if(!slot.valid) {
+            if(stereoMode && !containerMode) {
+                std::cerr << "Image Reader: StereoImage could not be read, skipping: " << filenames[slot.index] << " and " << filenamesSecondary[slot.index] << std::endl;
+            } else {
+                std::cerr << "Image Reader: Image could not be read, skipping: " << getImageName(slot.index) << std::endl;
+            }
             continue;
         }
 
-        //std::cout<<"Reading image "<< filename << std::endl;
-
+        // The slot images are passed without copy, the decoder allocates new memory for the slot if they are still referenced
         CameraImage cimg;
-        cimg.type = CameraImageType::STEREO_IMAGE_FILE;
-        cimg.img = img.clone();
-        cimg.imgSecondary = imgSecondary.clone();
+        cimg.type = stereoMode ? CameraImageType::STEREO_IMAGE_FILE : CameraImageType::SINGLE_IMAGE_FILE;
+        cimg.img = slot.img;
+        if(stereoMode) {
+            cimg.imgSecondary = slot.imgSecondary;
+        }
         cimg.timestamp = startTimestamp;
-        cimg.frameNumber = currentImageIndex;
-        cimg.filename = filenames[currentImageIndex];
-        img.release();
-        imgSecondary.release();
+        cimg.frameNumber = slot.index;
+        cimg.filename = getImageName(slot.index);
 
         if(!noDelay) {
             int durProcess = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - beginProcess).count();
@@ -176,6 +243,11 @@ void ImageReader::runStereo() {
         emit onNewImage(cimg);
     }
 
+    // Images decoded ahead but not emitted are discarded, paused playback decodes them again on start
+    for(PrefetchSlot &slot: prefetchSlots) {
+        slot.future.waitForFinished();
+    }
+
     // Playback loop finished, either due to end of files, or pause/stop action
     if(state != PlaybackState::PAUSED) {
         state = PlaybackState::STOPPED;
@@ -195,11 +267,7 @@ void ImageReader::start() {
     state = PlaybackState::PLAYING;
     startTimestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 
-    if(stereoMode) {
-        playbackProcess = QtConcurrent::run(this, &ImageReader::runStereo);
-    } else {
-        playbackProcess = QtConcurrent::run(this, &ImageReader::run);
-    }
+    playbackProcess = QtConcurrent::run(this, &ImageReader::run);
 }
 
 // Pause the image play back at the current image, calling start again will proceed at the paused image
@@ -7,8 +7,14 @@
 */
 
 #include <QtCore/QObject>
-#include <QtGui/QtGui>
+#include <QtCore/QDir>
+#include <QtCore/QMutex>
+#include <QtCore/QFuture>
+#include <QtCore/QThreadPool>
+#include <atomic>
+#include <memory>
 #include "devices/camera.h"
+#include "frameContainer.h"
 
 
 enum PlaybackState { STOPPED=0, PAUSED=1, PLAYING=2 };
@@ -21,16 +27,23 @@ enum PlaybackState { STOPPED=0, PAUSED=1, PLAYING=2 };
 
     For single camera images, all images are in a single directory, without any other files
     For stereo camera images, two directories exist, 0 for main camera images, 1 for secondary camera images, each image have corresponding filenames
+    For raw frame container recordings (see FrameContainerWriter), the directory contains one or more .pxr container files, which are played
+    in alphabetically order, images are memory mapped and emitted without decoding and copy, each image keeps its container mapped
 
     CAUTION:
     OpenCV's cv::glob is used to list the content of the directory, which returns the files in alphabetically order, a preceeding, zeros are necessary for the correct order
     i.e. 10.jpg and 9.jpg are ordered wrong due to that (1<9), 09.jpg and 10.jpg do not have the problem (0<1)
 
+    Images are read ahead of the playback by a pool of decoder threads into a ring of prefetchDepth slots, the playback
+    thread only waits for the next slot, paces the playback and emits the image. The image matrices of the slots are reused
+    for following images once no receiver references them anymore, otherwise a new matrix is allocated for the slot, thus
+    the emitted images are never overwritten and no copy is necessary
+
     CAUTION:
     Depending on the disk read speed, high replay framerates may not be possible due to disk read speed and filesize
 
-    TODO Improvement: Speed could be improved by pre-loading images of the directory into memory, disk read speed is limiting the playback speed
-
+    setPrefetchDepth(): number of images read ahead of the playback, takes effect on the next start
+    setDecoderThreads(): number of threads reading and decoding images ahead of the playback
 */
 class ImageReader : public QObject {
 Q_OBJECT
@@ -72,8 +85,31 @@ public:
         playbackLoop = loop;
     }
 
+    int getPrefetchDepth() {
+        return prefetchDepth;
+    }
+
+    void setPrefetchDepth(int depth);
+
+    int getDecoderThreads() {
+        return decoderPool.maxThreadCount();
+    }
+
+    void setDecoderThreads(int threads);
+
 private:
 
+    // Slot of the prefetch ring, holding the decoded image(s) of a single file index
+    struct PrefetchSlot {
+        int index = -1;
+        bool valid = false;
+        cv::Mat img;
+        cv::Mat imgSecondary;
+        std::vector<uchar> buffer;
+        std::vector<uchar> bufferSecondary;
+        QFuture<void> future;
+    };
+
     QFuture<void> playbackProcess;
     QMutex mutex;
 
@@ -81,6 +117,11 @@ private:
 
     std::vector<std::string> filenames, filenamesSecondary;
 
+    // Raw frame containers of the directory, with the container and frame of each image index
+    bool containerMode;
+    std::vector<std::unique_ptr<FrameContainerReader>> containers;
+    std::vector<std::pair<FrameContainerReader*, size_t>> containerImages;
+
     uint64 startTimestamp;
     int playbackSpeed;
     int playbackDelay;
@@ -93,8 +134,17 @@ private:
     bool noDelay;
     bool playbackLoop;
 
+    std::atomic<int> prefetchDepth;
+    std::vector<PrefetchSlot> prefetchSlots;
+    QThreadPool decoderPool;
+
+    int getImageCount();
+    std::string getImageName(int index);
+    int nextImageIndex(int index);
+    void decode(PrefetchSlot *slot);
+    static bool readImage(const std::string &filename, std::vector<uchar> &buffer, cv::Mat &img);
+
     void run();
-    void runStereo();
 
 public slots:
 
@@ -1,13 +1,25 @@
-
 #include <QtCore/qstandardpaths.h>
 #include <QtConcurrent>
 #include <opencv2/imgcodecs.hpp>
+#include <chrono>
+#include <iostream>
 #include <QtCore/qthreadpool.h>
 #include "imageWriter.h"
 
 // Creates a new image writer that outputs images in the given directory
 // If stereo is true, a stereo directory structure is created in the given directory
-ImageWriter::ImageWriter(QString directory, QString format, bool stereo, QObject *parent) : QObject(parent), format(format), stereoMode(stereo) {
+// For the raw frame container format, a single container file named by the current timestamp is created in the given directory
+ImageWriter::ImageWriter(QString directory, QString format, bool stereo, QObject *parent) :
+        QObject(parent),
+        format(format),
+        stereoMode(stereo),
+        containerWriter(nullptr),
+        queueCapacity(64),
+        pendingWrites(0),
+        bytesWritten(0),
+        droppedFrames(0),
+        failedWrites(0),
+        lastBytesWritten(0) {
 
     outputDirectory = QDir(directory);
 
@@ -15,7 +27,17 @@ ImageWriter::ImageWriter(QString directory, QString format, bool stereo, QObject
         outputDirectory.mkdir(".");
     }
 
-    if(stereoMode) {
+    // Image encoding is CPU heavy, a quarter of the cores is used so that the pupil detection keeps the remaining ones
+    writerPool.setMaxThreadCount(std::max(1, QThread::idealThreadCount() / 4));
+
+    if(format == FRAMECONTAINER_EXTENSION) {
+        uint64 timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        QString filepath = outputDirectory.filePath(QString::number(timestamp) + "." + format);
+
+        containerWriter = new FrameContainerWriter(filepath.toStdString(), stereoMode ? 2 : 1);
+        // A single thread appends the images, thus they are written in the order received
+        writerPool.setMaxThreadCount(1);
+    } else if(stereoMode) {
         outputDirectorySecondary = outputDirectory;
         if(!outputDirectory.exists("0")) {
             outputDirectory.mkdir("0");
@@ -27,25 +49,107 @@ ImageWriter::ImageWriter(QString directory, QString format, bool stereo, QObject
         }
         outputDirectorySecondary.cd("1");
     }
+
+    connect(&statisticsTimer, SIGNAL(timeout()), this, SLOT(updateStatistics()));
+    statisticsTimer.start(1000);
+    statisticsInterval.start();
 }
 
-ImageWriter::~ImageWriter() = default;
+// Waits until all received images are written and closes the container
+ImageWriter::~ImageWriter() {
+    statisticsTimer.stop();
+    writerPool.waitForDone();
+    delete containerWriter;
+
+    if(droppedFrames > 0 || failedWrites > 0) {
+        std::cerr << "ImageWriter: " << droppedFrames << " images dropped and " << failedWrites << " writes failed during recording." << std::endl;
+    }
+}
 
 // Slot callback which receives new camera images
 // Write the received image to disk using the specified image format
-// File writing is executed using Qts concurrent to not block the GUI thread for writing
+// Writing is executed by the writer pool to not block the GUI thread, if the queue is full the image is dropped
 void ImageWriter::onNewImage(const CameraImage &img) {
 
-    QString filepath = outputDirectory.filePath(QString::number(img.timestamp) + "." + format);
+    // Only this thread increases the pending count, thus it can not exceed the capacity between check and increment
+    if(pendingWrites.load() >= queueCapacity) {
+        droppedFrames++;
+        return;
+    }
+
+    std::string filepath, filepathSecondary;
+    if(!containerWriter) {
+        filepath = outputDirectory.filePath(QString::number(img.timestamp) + "." + format).toStdString();
+        if(stereoMode && (img.type == CameraImageType::STEREO_IMAGE_FILE || img.type == CameraImageType::LIVE_STEREO_CAMERA)) {
+            filepathSecondary = outputDirectorySecondary.filePath(QString::number(img.timestamp) + "." + format).toStdString();
+        }
+    }
+
+    pendingWrites++;
+    QtConcurrent::run(&writerPool, [this, img, filepath, filepathSecondary]() {
+        writeImage(img, filepath, filepathSecondary);
+        pendingWrites--;
+    });
+}
+
+// Writes the image(s) of the camera image, either as image files or into the container, executed by the writer pool
+void ImageWriter::writeImage(const CameraImage &img, const std::string &filepath, const std::string &filepathSecondary) {
+
+    // Recording must not delay the pupil detection, writer threads yield to it
+    QThread::currentThread()->setPriority(QThread::LowPriority);
 
-    // std::cout<<"Saving image: " << filepath.toStdString() << std::endl;
+    if(containerWriter) {
+        bool stereoImage = stereoMode && (img.type == CameraImageType::STEREO_IMAGE_FILE || img.type == CameraImageType::LIVE_STEREO_CAMERA);
 
-    // Write every image over a thread pool managed by QT, this way nothing blocks and we can write images very fast (cpu heavy)
-    QtConcurrent::run(cv::imwrite, filepath.toStdString(), img.img,std::vector<int>());
+        if(containerWriter->write(img.img, img.timestamp, img.frameNumber, 0)) {
+            bytesWritten += img.img.total() * img.img.elemSize();
+        } else {
+            failedWrites++;
+        }
+
+        if(stereoImage) {
+            if(containerWriter->write(img.imgSecondary, img.timestamp, img.frameNumber, 1)) {
+                bytesWritten += img.imgSecondary.total() * img.imgSecondary.elemSize();
+            } else {
+                failedWrites++;
+            }
+        }
+        return;
+    }
 
-    if(stereoMode && (img.type == CameraImageType::STEREO_IMAGE_FILE || img.type == CameraImageType::LIVE_STEREO_CAMERA)) {
-        QString filepathSecondary = outputDirectorySecondary.filePath(QString::number(img.timestamp) + "." + format);
-        QtConcurrent::run(cv::imwrite, filepathSecondary.toStdString(), img.imgSecondary,std::vector<int>());
+    writeFile(filepath, img.img);
+
+    if(!filepathSecondary.empty()) {
+        writeFile(filepathSecondary, img.imgSecondary);
     }
 }
 
+// Writes a single image file, failures are counted
+bool ImageWriter::writeFile(const std::string &filepath, const cv::Mat &img) {
+
+    bool written = false;
+    try {
+        written = cv::imwrite(filepath, img);
+    } catch(cv::Exception &e) {
+        std::cerr << "ImageWriter: " << e.what() << std::endl;
+    }
+
+    if(!written) {
+        failedWrites++;
+        return false;
+    }
+
+    bytesWritten += img.total() * img.elemSize();
+    return true;
+}
+
+// Emits the statistics of the last interval, called each second by the statistics timer
+void ImageWriter::updateStatistics() {
+
+    uint64_t bytes = bytesWritten.load();
+    double seconds = statisticsInterval.restart() / 1000.0;
+    double bytesPerSecond = seconds > 0 ? (bytes - lastBytesWritten) / seconds : 0.0;
+    lastBytesWritten = bytes;
+
+    emit statistics(pendingWrites.load(), bytesPerSecond, droppedFrames.load(), failedWrites.load());
+}
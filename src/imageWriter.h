@@ -7,16 +7,35 @@
 */
 
 #include <QtCore/qdir.h>
+#include <QtCore/QThreadPool>
+#include <QtCore/QTimer>
+#include <QtCore/QElapsedTimer>
+#include <algorithm>
+#include <atomic>
 #include "devices/camera.h"
+#include "frameContainer.h"
 
 /**
     Class to write camera images to disk
 
     Supports recording of single and stereo images
 
+    Besides image files, images can be recorded into a single raw frame container (format "pxr", see FrameContainerWriter), which
+    avoids the creation of a file per image. The container is appended in order by a single writer thread and finalized when the
+    image writer is destroyed
+
+    Images are written by a dedicated writer thread pool with low thread priority, separate from the global thread pool used by
+    the pupil detection. At most queueCapacity images are pending, images arriving at a full queue are dropped and counted, thus a
+    slow disk never lets the memory grow or takes the cores of the pupil detection.
+
     onNewImage(): received new image and writes it to disk, file writing is performed concurrently for maximal performance
+    setQueueCapacity(): maximal number of images waiting to be written
 
     CAUTION: Chosen image format has a large performance impact due to size and disk write speeds
+
+signals:
+    statistics(int queueDepth, double bytesPerSecond, quint64 droppedFrames, quint64 failedWrites): emitted each second, pending images,
+        written image data (uncompressed) per second and the total number of dropped images and failed writes
 */
 class ImageWriter : public QObject {
 Q_OBJECT
@@ -27,16 +46,56 @@ public:
     ImageWriter(QString directory, QString format="bmp", bool stereo=false, QObject *parent = 0);
     ~ImageWriter() override;
 
+    int getQueueCapacity() {
+        return queueCapacity;
+    }
+
+    void setQueueCapacity(int capacity) {
+        queueCapacity = std::max(1, capacity);
+    }
+
+    uint64_t droppedFrameCount() {
+        return droppedFrames;
+    }
+
+    uint64_t failedWriteCount() {
+        return failedWrites;
+    }
+
 private:
 
     QDir outputDirectory, outputDirectorySecondary;
     QString format;
     bool stereoMode;
 
+    FrameContainerWriter *containerWriter;
+    QThreadPool writerPool;
+
+    int queueCapacity;
+    std::atomic<int> pendingWrites;
+    std::atomic<uint64_t> bytesWritten;
+    std::atomic<uint64_t> droppedFrames;
+    std::atomic<uint64_t> failedWrites;
+
+    QTimer statisticsTimer;
+    QElapsedTimer statisticsInterval;
+    uint64_t lastBytesWritten;
+
+    void writeImage(const CameraImage &img, const std::string &filepath, const std::string &filepathSecondary);
+    bool writeFile(const std::string &filepath, const cv::Mat &img);
+
+private slots:
+
+    void updateStatistics();
+
 public slots:
 
     void onNewImage(const CameraImage &img);
 
+signals:
+
+    void statistics(int queueDepth, double bytesPerSecond, quint64 droppedFrames, quint64 failedWrites);
+
 };
 
 
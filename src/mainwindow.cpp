@@ -15,6 +15,7 @@
 #include "subwindows/RestorableQMdiSubWindow.h"
 #include "subwindows/singleCameraSharpnessView.h"
 #include "subwindows/gettingsStartedWizard.h"
+#include "frameBus.h"
 
 
 // Upon construction, worker objects for processing are created pupil detection and its respective thread
@@ -26,6 +27,10 @@ MainWindow::MainWindow(): mdiArea(new QMdiArea(this)),
                           singleCameraSettingsDialog(nullptr),
                           stereoCameraSettingsDialog(nullptr),
                           pupilDetectionThread(new QThread()),
+                          dataWriter(nullptr),
+                          dataWriterThread(nullptr),
+                          imageWriter(nullptr),
+                          imageWriterSubscription(nullptr),
                           selectedCamera(nullptr),
                           cameraViewWindow(nullptr),
                           calibrationWindow(nullptr),
@@ -88,6 +93,7 @@ MainWindow::MainWindow(): mdiArea(new QMdiArea(this)),
     qRegisterMetaType<Pupil>("Pupil");
     qRegisterMetaType<cv::Mat>("cv::Mat");
     qRegisterMetaType<CameraImage>("CameraImage");
+    qRegisterMetaType<PupilOverlay>("PupilOverlay");
 
 
     // Get settings key if gettings started dialog was already opened
@@ -372,6 +378,14 @@ void MainWindow::createStatusBar() {
 
     currentDirectoryLabel = new QLabel("");
     statusBar()->addWidget(currentDirectoryLabel);
+
+    imageWriterStatusLabel = new QLabel("");
+    imageWriterStatusLabel->setVisible(false);
+    statusBar()->addWidget(imageWriterStatusLabel);
+
+    stereoPairingStatusLabel = new QLabel("");
+    stereoPairingStatusLabel->setVisible(false);
+    statusBar()->addWidget(stereoPairingStatusLabel);
 }
 
 void MainWindow::closeEvent(QCloseEvent *event) {
@@ -448,7 +462,7 @@ void MainWindow::openSourceDialog() {
 
 void MainWindow::setLogFile() {
 
-    logFileName = QFileDialog::getSaveFileName(this, tr("Save Log File"), recentPath, tr("CSV files (*.csv)"), nullptr, QFileDialog::DontConfirmOverwrite);
+    logFileName = QFileDialog::getSaveFileName(this, tr("Save Log File"), recentPath, tr("CSV files (*.csv);;Binary pupil log (*.pxl)"), nullptr, QFileDialog::DontConfirmOverwrite);
 
     if(!logFileName.isEmpty()) {
         QFileInfo fileInfo(logFileName);
@@ -635,7 +649,13 @@ void MainWindow::onRecordClick() {
 
     if(recordOn) {
         // Deactivate recording
-        dataWriter->close(); // TODO check if may terminate writing to early? because of the lag of the event queue in pupildetection
+        // Rows still queued in the event loop of the writer thread are written before the blocking close call is processed
+        disconnect(pupilDetectionWorker, nullptr, dataWriter, nullptr);
+        QMetaObject::invokeMethod(dataWriter, "close", Qt::BlockingQueuedConnection);
+        // Finishing the thread deletes the data writer and the thread
+        dataWriterThread->quit();
+        dataWriter = nullptr;
+        dataWriterThread = nullptr;
 
         const QIcon recordOffIcon = QIcon(":/icons/Breeze/actions/22/media-record.svg"); //QIcon::fromTheme("camera-video");
         recordAct->setIcon(recordOffIcon);
@@ -643,7 +663,14 @@ void MainWindow::onRecordClick() {
     } else {
         // Activate recording
         bool stereo = selectedCamera->getType() == CameraImageType::LIVE_STEREO_CAMERA || selectedCamera->getType() == CameraImageType::STEREO_IMAGE_FILE;
-        dataWriter = new DataWriter(logFileName, stereo ? WriteMode::STEREO : WriteMode::SINGLE, this);
+        dataWriter = new DataWriter(logFileName, stereo ? WriteMode::STEREO : WriteMode::SINGLE);
+
+        // Formatting and writing of the rows is done in its own thread, the pupil detection signals are queued to it
+        dataWriterThread = new QThread();
+        dataWriter->moveToThread(dataWriterThread);
+        connect(dataWriterThread, SIGNAL (finished()), dataWriter, SLOT (deleteLater()));
+        connect(dataWriterThread, SIGNAL (finished()), dataWriterThread, SLOT (deleteLater()));
+        dataWriterThread->start();
 
         if(stereo) {
             connect(pupilDetectionWorker, SIGNAL (processedStereoPupilData(quint64, Pupil, Pupil, QString)), dataWriter, SLOT (newStereoPupilData(quint64, Pupil, Pupil, QString)));
@@ -662,8 +689,11 @@ void MainWindow::onRecordImageClick() {
     if(recordImagesOn) {
         // Deactivate recording
 
-        // disconnect(selectedCamera, SIGNAL (onNewGrabResult(CameraImage)), imageWriter, SLOT (onNewImage(CameraImage)));
-        disconnect(signalPubSubHandler, SIGNAL(onNewGrabResult(CameraImage)), imageWriter, SLOT (onNewImage(CameraImage)));
+        // Deleting the writer also deletes its frame subscription, the writer waits for the pending images and finalizes a frame container recording
+        delete imageWriter;
+        imageWriter = nullptr;
+        imageWriterSubscription = nullptr;
+        imageWriterStatusLabel->setVisible(false);
 
         const QIcon recordOffIcon = QIcon(":/icons/Breeze/actions/22/media-record-blue.svg"); //QIcon::fromTheme("camera-video");
         recordImagesAct->setIcon(recordOffIcon);
@@ -675,8 +705,10 @@ void MainWindow::onRecordImageClick() {
         bool stereo = selectedCamera->getType() == CameraImageType::LIVE_STEREO_CAMERA || selectedCamera->getType() == CameraImageType::STEREO_IMAGE_FILE;
         imageWriter = new ImageWriter(outputDirectory, imageFormat, stereo, this);
 
-        // connect(selectedCamera, SIGNAL (onNewGrabResult(CameraImage)), signalPubSubHandler, SLOT (onNewImage(CameraImage)));
-        connect(signalPubSubHandler, SIGNAL(onNewGrabResult(CameraImage)), imageWriter, SLOT (onNewImage(CameraImage)));
+        // Lossless subscription, the writer receives every camera image and decides itself which images it drops
+        imageWriterSubscription = new FrameSubscription(selectedCamera->getFrameBus(), FrameSubscriptionMode::LOSSLESS, imageWriter);
+        connect(imageWriterSubscription, SIGNAL(onNewGrabResult(CameraImage)), imageWriter, SLOT (onNewImage(CameraImage)));
+        connect(imageWriter, SIGNAL(statistics(int, double, quint64, quint64)), this, SLOT(onImageWriterStatistics(int, double, quint64, quint64)));
 
         const QIcon recordOnIcon = QIcon(":/icons/Breeze/actions/22/kt-stop-all.svg"); //QIcon::fromTheme("camera-video");
         recordImagesAct->setIcon(recordOnIcon);
@@ -684,6 +716,38 @@ void MainWindow::onRecordImageClick() {
     }
 }
 
+// Shows the state of the image writer queue in the status bar, dropped images and failed writes are highlighted
+// Dropped images include those the writer could not take from the frame bus, as they were overwritten before
+void MainWindow::onImageWriterStatistics(int queueDepth, double bytesPerSecond, quint64 droppedFrames, quint64 failedWrites) {
+
+    if(imageWriterSubscription)
+        droppedFrames += imageWriterSubscription->getDroppedFrameCount();
+
+    imageWriterStatusLabel->setText(QString("Image Writer: %1 queued, %2 MB/s, %3 dropped, %4 failed")
+            .arg(queueDepth).arg(bytesPerSecond / (1024.0 * 1024.0), 0, 'f', 1).arg(droppedFrames).arg(failedWrites));
+
+    if(droppedFrames > 0 || failedWrites > 0) {
+        imageWriterStatusLabel->setStyleSheet("color: red;");
+    } else {
+        imageWriterStatusLabel->setStyleSheet("color: black;");
+    }
+    imageWriterStatusLabel->setVisible(true);
+}
+
+// Shows the stereo image pairing in the status bar, images dropped without their stereo counterpart are highlighted
+void MainWindow::onStereoPairingStatistics(double meanLatencyMs, double maxLatencyMs, quint64 pairedFrames, quint64 orphanedFrames) {
+
+    stereoPairingStatusLabel->setText(QString("Stereo Pairing: %1 paired, %2 orphaned, latency %3 ms (max %4 ms)")
+            .arg(pairedFrames).arg(orphanedFrames).arg(meanLatencyMs, 0, 'f', 2).arg(maxLatencyMs, 0, 'f', 2));
+
+    if(orphanedFrames > 0) {
+        stereoPairingStatusLabel->setStyleSheet("color: red;");
+    } else {
+        stereoPairingStatusLabel->setStyleSheet("color: black;");
+    }
+    stereoPairingStatusLabel->setVisible(true);
+}
+
 void MainWindow::onCameraClick() {
     // fix to open submenu in the camera menu
     cameraAct->menu()->exec(QCursor::pos());
@@ -725,7 +789,6 @@ void MainWindow::onCameraDisconnectClick() {
         selectedCamera->close();
     }
 
-    disconnect(selectedCamera, SIGNAL (onNewGrabResult(CameraImage)), signalPubSubHandler, SIGNAL (onNewGrabResult(CameraImage)));
     disconnect(selectedCamera, SIGNAL(fps(double)), signalPubSubHandler, SIGNAL(cameraFPS(double)));
     disconnect(selectedCamera, SIGNAL(framecount(int)), signalPubSubHandler, SIGNAL(cameraFramecount(int)));
 
@@ -752,6 +815,7 @@ void MainWindow::onCameraDisconnectClick() {
     subjectConfigurationLabel->setText("");
     currentDirectoryLabel->setText("");
     currentDirectoryLabel->setToolTip("");
+    stereoPairingStatusLabel->setVisible(false);
 
     cameraAct->setDisabled(false);
     cameraSettingsAct->setDisabled(true);
@@ -785,7 +849,6 @@ void MainWindow::singleCameraSelected(QAction *action) {
     if(dynamic_cast<SingleCamera*>(selectedCamera)->getCameraCalibration()->isCalibrated())
         onCameraCalibrationEnabled();
 
-    connect(selectedCamera, SIGNAL (onNewGrabResult(CameraImage)), signalPubSubHandler, SIGNAL (onNewGrabResult(CameraImage)));
     connect(selectedCamera, SIGNAL(fps(double)), signalPubSubHandler, SIGNAL(cameraFPS(double)));
     connect(selectedCamera, SIGNAL(framecount(int)), signalPubSubHandler, SIGNAL(cameraFramecount(int)));
 
@@ -830,9 +893,9 @@ void MainWindow::stereoCameraSelected() {
     //auto *child = new RestorableQMdiSubWindow(childWidget, "StereoCameraSettingsDialog", this);
     stereoCameraSettingsDialog->show();
 
-    connect(selectedCamera, SIGNAL(onNewGrabResult(CameraImage)), signalPubSubHandler, SIGNAL(onNewGrabResult(CameraImage)));
     connect(selectedCamera, SIGNAL(fps(double)), signalPubSubHandler, SIGNAL(cameraFPS(double)));
     connect(selectedCamera, SIGNAL(framecount(int)), signalPubSubHandler, SIGNAL(cameraFramecount(int)));
+    connect(selectedCamera, SIGNAL(pairingStatistics(double, double, quint64, quint64)), this, SLOT(onStereoPairingStatistics(double, double, quint64, quint64)));
 
     connect(stereoCameraSettingsDialog, &StereoCameraSettingsDialog::onSerialConfig, serialSettingsDialog, &SerialSettingsDialog::show);
     connect(subjectSelectionDialog, SIGNAL (onSettingsChange()), stereoCameraSettingsDialog, SLOT (onSettingsChange()));
@@ -945,6 +1008,9 @@ Pylon::DeviceInfoList_t MainWindow::enumerateCameraDevices() {
 }
 
 MainWindow::~MainWindow() {
+    if(recordOn) {
+        onRecordClick();
+    }
     pupilDetectionThread->quit();
     pupilDetectionThread->wait();
 }
@@ -1100,9 +1166,11 @@ void MainWindow::onOpenImageDirectory() {
         selectedCamera = new FileCamera(imageDirectory, playbackSpeed, playbackLoop, this);
         std::cout<<"FileCamera created using playbackspeed [fps]: "<<playbackSpeed <<std::endl;
 
+        dynamic_cast<FileCamera*>(selectedCamera)->setPrefetchDepth(applicationSettings->value("playbackPrefetchDepth", generalSettingsDialog->getPrefetchDepth()).toInt());
+        dynamic_cast<FileCamera*>(selectedCamera)->setDecoderThreads(applicationSettings->value("playbackDecoderThreads", generalSettingsDialog->getDecoderThreads()).toInt());
+
         connect(selectedCamera, SIGNAL(finished()), this, SLOT(onPlayImageDirectoryFinished()));
 
-        connect(selectedCamera, SIGNAL (onNewGrabResult(CameraImage)), signalPubSubHandler, SIGNAL (onNewGrabResult(CameraImage)));
         connect(selectedCamera, SIGNAL(fps(double)), signalPubSubHandler, SIGNAL(cameraFPS(double)));
         connect(selectedCamera, SIGNAL(framecount(int)), signalPubSubHandler, SIGNAL(cameraFramecount(int)));
 
@@ -1221,6 +1289,10 @@ void MainWindow::onGeneralSettingsChange() {
             if(dynamic_cast<FileCamera*>(selectedCamera)->getPlaybackLoop() != static_cast<int>(playbackLoop)) {
                 dynamic_cast<FileCamera*>(selectedCamera)->setPlaybackLoop(playbackLoop);
             }
+
+            // The prefetch depth is applied on the next start of the playback
+            dynamic_cast<FileCamera*>(selectedCamera)->setPrefetchDepth(applicationSettings->value("playbackPrefetchDepth", generalSettingsDialog->getPrefetchDepth()).toInt());
+            dynamic_cast<FileCamera*>(selectedCamera)->setDecoderThreads(applicationSettings->value("playbackDecoderThreads", generalSettingsDialog->getDecoderThreads()).toInt());
         }
     }
 
@@ -23,6 +23,8 @@
 #include <QSettings>
 #include <pylon/TlFactory.h>
 
+class FrameSubscription;
+
 
 /**
     Main interface of the software
@@ -104,6 +106,8 @@ private:
     QLabel *calibrationStatusIcon;
     QLabel *subjectConfigurationLabel;
     QLabel *currentDirectoryLabel;
+    QLabel *imageWriterStatusLabel;
+    QLabel *stereoPairingStatusLabel;
 
     bool trackingOn = false;
     bool recordOn = false;
@@ -126,7 +130,10 @@ private:
     QThread *pupilDetectionThread;
 
     DataWriter *dataWriter;
+    QThread *dataWriterThread;
     ImageWriter *imageWriter;
+    // Frame bus subscription of the image writer, owned and deleted by the image writer
+    FrameSubscription *imageWriterSubscription;
 
 private slots:
 
@@ -160,6 +167,8 @@ private slots:
     void cameraViewClick();
 
     void onRecordImageClick();
+    void onImageWriterStatistics(int queueDepth, double bytesPerSecond, quint64 droppedFrames, quint64 failedWrites);
+    void onStereoPairingStatistics(double meanLatencyMs, double maxLatencyMs, quint64 pairedFrames, quint64 orphanedFrames);
 
     void singleCameraSelected(QAction *action);
     void stereoCameraSelected();
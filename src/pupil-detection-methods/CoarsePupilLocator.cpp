@@ -0,0 +1,150 @@
+
+#include <opencv2/imgproc.hpp>
+#include <tbb/tbb.h>
+#include <algorithm>
+#include "CoarsePupilLocator.h"
+
+// Strict order of candidates, higher response first, ties are ordered by position and radius so that the result does not
+// depend on the order in which the parallel tasks found them
+static bool betterCandidate(const CoarsePupilCandidate &a, const CoarsePupilCandidate &b) {
+    if(a.response != b.response)
+        return a.response > b.response;
+    if(a.center.y != b.center.y)
+        return a.center.y < b.center.y;
+    if(a.center.x != b.center.x)
+        return a.center.x < b.center.x;
+    return a.radius < b.radius;
+}
+
+// Bounded heap of the best candidates, the worst kept candidate is at the front and replaced by better ones
+class CoarseCandidateHeap {
+
+public:
+
+    explicit CoarseCandidateHeap(size_t capacity) : capacity(capacity) {
+        candidates.reserve(capacity);
+    }
+
+    void push(const CoarsePupilCandidate &candidate) {
+        if(candidates.size() < capacity) {
+            candidates.push_back(candidate);
+            std::push_heap(candidates.begin(), candidates.end(), betterCandidate);
+        } else if(capacity > 0 && betterCandidate(candidate, candidates.front())) {
+            std::pop_heap(candidates.begin(), candidates.end(), betterCandidate);
+            candidates.back() = candidate;
+            std::push_heap(candidates.begin(), candidates.end(), betterCandidate);
+        }
+    }
+
+    void merge(const CoarseCandidateHeap &other) {
+        for(const auto &candidate: other.candidates)
+            push(candidate);
+    }
+
+    // Candidates sorted by decreasing response, the heap is consumed
+    std::vector<CoarsePupilCandidate> sorted() {
+        std::sort_heap(candidates.begin(), candidates.end(), betterCandidate);
+        return std::move(candidates);
+    }
+
+private:
+
+    size_t capacity;
+    std::vector<CoarsePupilCandidate> candidates;
+
+};
+
+// Radii are given in pixels of the searched image, the pixel steps apply to the columns and rows of the feature centers
+CoarsePupilLocator::CoarsePupilLocator(int minRadius, int maxRadius, int radiusStep, const cv::Size &pixelStep, int surroundFactor, bool padBorders, CoarseHaarNormalization normalization) :
+        minRadius(std::max(1, minRadius)),
+        maxRadius(std::max(std::max(1, minRadius), maxRadius)),
+        radiusStep(std::max(1, radiusStep)),
+        pixelStep(std::max(1, pixelStep.width), std::max(1, pixelStep.height)),
+        surroundFactor(std::max(2, surroundFactor)),
+        padBorders(padBorders),
+        normalization(normalization) {
+
+}
+
+// Evaluates the Haar feature for all radii at every pixelStep pixel of the image, returns the best maxCandidates candidates
+// Radii and rows are distributed over the TBB worker threads, the integral image is computed once and shared
+std::vector<CoarsePupilCandidate> CoarsePupilLocator::locate(const cv::Mat &image, const int &maxCandidates) const {
+
+    if(image.empty() || image.type() != CV_8UC1 || maxCandidates <= 0)
+        return std::vector<CoarsePupilCandidate>();
+
+    // Centers have at least the inner radius to the image border, the surround may reach the replicated border
+    const int padding = padBorders ? (surroundFactor - 1) * maxRadius : 0;
+
+    cv::Mat itg;
+    if(padding > 0) {
+        cv::Mat padded;
+        cv::copyMakeBorder(image, padded, padding, padding, padding, padding, cv::BORDER_REPLICATE);
+        cv::integral(padded, itg, CV_32S);
+    } else {
+        cv::integral(image, itg, CV_32S);
+    }
+
+    std::vector<int> radii;
+    for(int r = minRadius; r <= maxRadius; r += radiusStep)
+        radii.push_back(r);
+
+    // Distance of the feature centers to the image border for the given radius
+    auto margin = [&](int r) { return padBorders ? r : surroundFactor * r; };
+
+    // The grid of each radius starts at its margin, the smallest radius has the most rows, larger radii end earlier
+    const int rowCount = (image.rows - 2 * margin(minRadius) + pixelStep.height - 1) / pixelStep.height;
+    if(rowCount <= 0)
+        return std::vector<CoarsePupilCandidate>();
+
+    CoarseCandidateHeap result = tbb::parallel_reduce(
+            tbb::blocked_range2d<int>(0, static_cast<int>(radii.size()), 1, 0, rowCount, std::max(1, rowCount / 8)),
+            CoarseCandidateHeap(static_cast<size_t>(maxCandidates)),
+            [&](const tbb::blocked_range2d<int> &range, CoarseCandidateHeap heap) -> CoarseCandidateHeap {
+
+                for(int ri = range.rows().begin(); ri < range.rows().end(); ri++) {
+                    const int r = radii[ri];
+                    const int s = surroundFactor * r;
+                    const int m = margin(r);
+
+                    // Weights of the inner and the surround sum, the response is higher for darker inner regions
+                    float innerWeight, outerWeight;
+                    if(normalization == CoarseHaarNormalization::SQUARE_RADIUS) {
+                        innerWeight = 1.0f / (r * r);
+                        outerWeight = 1.0f / ((surroundFactor * surroundFactor - 1) * r * r);
+                    } else {
+                        const int innerCount = (2 * r + 1) * (2 * r + 1);
+                        const int outerCount = (2 * s + 1) * (2 * s + 1) - innerCount;
+                        innerWeight = 1.0f / (255.0f * innerCount);
+                        outerWeight = 1.0f / (255.0f * outerCount);
+                    }
+
+                    for(int yi = range.cols().begin(); yi < range.cols().end(); yi++) {
+                        const int y = m + yi * pixelStep.height;
+                        if(y >= image.rows - m)
+                            break;
+
+                        const int *innerTop = itg.ptr<int>(y + padding - r);
+                        const int *innerBottom = itg.ptr<int>(y + padding + r + 1);
+                        const int *outerTop = itg.ptr<int>(y + padding - s);
+                        const int *outerBottom = itg.ptr<int>(y + padding + s + 1);
+
+                        for(int x = m; x < image.cols - m; x += pixelStep.width) {
+                            const int xi = x + padding;
+                            const int inner = innerBottom[xi + r + 1] + innerTop[xi - r] - innerTop[xi + r + 1] - innerBottom[xi - r];
+                            const int outer = outerBottom[xi + s + 1] + outerTop[xi - s] - outerTop[xi + s + 1] - outerBottom[xi - s] - inner;
+
+                            const float response = outerWeight * outer - innerWeight * inner;
+                            heap.push({cv::Point(x, y), r, response});
+                        }
+                    }
+                }
+                return heap;
+            },
+            [](CoarseCandidateHeap a, const CoarseCandidateHeap &b) -> CoarseCandidateHeap {
+                a.merge(b);
+                return a;
+            });
+
+    return result.sorted();
+}
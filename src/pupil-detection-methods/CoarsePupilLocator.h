@@ -0,0 +1,86 @@
+
+#ifndef PUPILEXT_COARSEPUPILLOCATOR_H
+#define PUPILEXT_COARSEPUPILLOCATOR_H
+
+/**
+    @author Moritz Lode
+*/
+
+#include <opencv2/core/mat.hpp>
+#include <vector>
+
+
+/**
+    Weighting of the inner and surround sums of the Haar feature
+
+    MEAN_DIFFERENCE: mean intensity of the surround minus the mean intensity of the inner region, normalized to [-1, 1]
+    SQUARE_RADIUS: sums divided by the square radius of the region, as in the Haar feature of Swirski's implementation
+*/
+enum class CoarseHaarNormalization { MEAN_DIFFERENCE, SQUARE_RADIUS };
+
+
+/**
+    Candidate pupil location of the coarse pupil locator, in coordinates of the searched image
+
+    response: higher for a darker inner region than its surround, see CoarseHaarNormalization
+*/
+struct CoarsePupilCandidate {
+    cv::Point center;
+    int radius;
+    float response;
+
+    // Region between the inner and the surround region of the Haar feature, pupils are often larger than the inner region
+    cv::Rect region(const int &surroundFactor=3) const {
+        int r = (1 + surroundFactor) * radius / 2;
+        return cv::Rect(center.x - r, center.y - r, 2 * r + 1, 2 * r + 1);
+    }
+};
+
+
+/**
+    Coarse pupil localization through a Haar-like surround feature on the integral image, shared by the coarse pupil detection
+    of PupilDetectionMethod and the Haar search of Swirski2D, can be used as pre-stage for any pupil detection algorithm
+
+    Haar-like feature suggested by Swirski. For details, see
+    Świrski, Lech, Andreas Bulling, and Neil Dodgson.
+    "Robust real-time pupil tracking in highly off-axis images."
+    Proceedings of the Symposium on Eye Tracking Research and Applications. ACM, 2012.
+
+    A dark inner square of radius r is searched inside a bright surround square of radius surroundFactor*r, over all radii from
+    minRadius to maxRadius. Both squares include their center row and column, thus have a side length of 2r+1. Radii and image
+    rows are searched in parallel, each task keeps only its best candidates in a bounded heap, thus the result is independent of
+    the task scheduling.
+
+    Without border padding, only features completely inside the image are evaluated. With padding, the image border is replicated
+    and the centers of the inner regions are searched over the whole image (except a border of the inner radius). The grid of
+    feature centers of each radius starts at the first valid center of that radius.
+
+    locate(): returns the best candidates of a single channel 8 bit image, sorted by decreasing response
+*/
+class CoarsePupilLocator {
+
+public:
+
+    explicit CoarsePupilLocator(int minRadius, int maxRadius, int radiusStep=1, const cv::Size &pixelStep=cv::Size(1, 1), int surroundFactor=3,
+                                bool padBorders=false, CoarseHaarNormalization normalization=CoarseHaarNormalization::MEAN_DIFFERENCE);
+
+    std::vector<CoarsePupilCandidate> locate(const cv::Mat &image, const int &maxCandidates=16) const;
+
+    int getSurroundFactor() const {
+        return surroundFactor;
+    }
+
+private:
+
+    int minRadius;
+    int maxRadius;
+    int radiusStep;
+    cv::Size pixelStep;
+    int surroundFactor;
+    bool padBorders;
+    CoarseHaarNormalization normalization;
+
+};
+
+
+#endif //PUPILEXT_COARSEPUPILLOCATOR_H
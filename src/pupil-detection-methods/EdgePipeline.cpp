@@ -0,0 +1,300 @@
+
+#include <opencv2/imgproc.hpp>
+#include <cmath>
+#include "EdgePipeline.h"
+
+// Maximum number of pixels the hysteresis traces from a single strong edge pixel
+static const int maxLinePixels = 10000;
+
+static const int kernelSize = 16;
+
+static const float gaussian[kernelSize] = {0.000000220358050f, 0.000007297256405f, 0.000146569312970f, 0.001785579770079f,
+                                           0.013193749090229f, 0.059130281094460f, 0.160732768610747f, 0.265003534507060f, 0.265003534507060f,
+                                           0.160732768610747f, 0.059130281094460f, 0.013193749090229f, 0.001785579770079f, 0.000146569312970f,
+                                           0.000007297256405f, 0.000000220358050f};
+
+static const float gaussianDerivative[kernelSize] = {-0.000026704586264f, -0.000276122963398f, -0.003355163265098f, -0.024616683775044f, -0.108194751875585f,
+                                                     -0.278368310241814f, -0.388430056419619f, -0.196732206873178f, 0.196732206873178f, 0.388430056419619f,
+                                                     0.278368310241814f, 0.108194751875585f, 0.024616683775044f, 0.003355163265098f, 0.000276122963398f, 0.000026704586264f};
+
+// Number of bins of the magnitude histogram used to select the hysteresis threshold
+static const int histogramSize = 64;
+
+EdgePipeline::EdgePipeline() : lines(maxLinePixels) {
+
+}
+
+// Canny edge detection of ExCuSe and ElSe, the high threshold is chosen so that 70% of the pixels are no edges
+// ExCuSe truncates the number of non-edge pixels, ElSe rounds it (roundNonEdgeCount)
+const cv::Mat &EdgePipeline::canny(const cv::Mat &image, bool roundNonEdgeCount) {
+
+    image.convertTo(image32, CV_32FC1);
+
+    // Filtering with the column kernels equals filtering the transposed image with the row kernels, without the transposes
+    const cv::Mat gaussianRow(1, kernelSize, CV_32FC1, const_cast<float*>(gaussian));
+    const cv::Mat gaussianColumn(kernelSize, 1, CV_32FC1, const_cast<float*>(gaussian));
+    const cv::Mat derivativeRow(1, kernelSize, CV_32FC1, const_cast<float*>(gaussianDerivative));
+    const cv::Mat derivativeColumn(kernelSize, 1, CV_32FC1, const_cast<float*>(gaussianDerivative));
+    const cv::Point anchor(-1, -1);
+
+    cv::filter2D(image32, smoothed, -1, gaussianColumn, anchor, 0, cv::BORDER_REPLICATE);
+    cv::filter2D(smoothed, gradX, -1, derivativeRow, anchor, 0, cv::BORDER_REPLICATE);
+
+    cv::filter2D(image32, smoothed, -1, gaussianRow, anchor, 0, cv::BORDER_REPLICATE);
+    cv::filter2D(smoothed, gradY, -1, derivativeColumn, anchor, 0, cv::BORDER_REPLICATE);
+
+    // Products of floats are exact in double, thus this equals hypot of the floats and vectorizes
+    magnitude.create(image.rows, image.cols, CV_32FC1);
+    for(int i = 0; i < magnitude.rows; i++) {
+        float *p_res = magnitude.ptr<float>(i);
+        const float *p_x = gradX.ptr<float>(i);
+        const float *p_y = gradY.ptr<float>(i);
+
+        for(int j = 0; j < magnitude.cols; j++) {
+            const double x = p_x[j];
+            const double y = p_y[j];
+            p_res[j] = static_cast<float>(std::sqrt(x * x + y * y));
+        }
+    }
+
+    //th selection
+    const double nonEdgeFraction = 0.7 * magnitude.cols * magnitude.rows;
+    const int nonEdgeCount = roundNonEdgeCount ? static_cast<int>(std::round(nonEdgeFraction)) : static_cast<int>(nonEdgeFraction);
+
+    cv::normalize(magnitude, magnitude, 0, 1, cv::NORM_MINMAX, CV_32FC1);
+    cv::normalize(magnitude, magnitudeBins, 0, histogramSize - 1, cv::NORM_MINMAX, CV_32S);
+
+    int hist[histogramSize] = {0};
+    for(int i = 0; i < magnitudeBins.rows; i++) {
+        const int *p_bin = magnitudeBins.ptr<int>(i);
+        for(int j = 0; j < magnitudeBins.cols; j++)
+            hist[p_bin[j]]++;
+    }
+
+    float high_th = 0;
+    int sum = 0;
+    for(int i = 0; i < histogramSize; i++) {
+        sum += hist[i];
+        if(sum > nonEdgeCount) {
+            high_th = float(i + 1) / float(histogramSize);
+            break;
+        }
+    }
+
+    //non maximum supression + interpolation
+    nonMax.create(image.rows, image.cols, CV_8U);
+    nonMax.setTo(0);
+    nonMaxHigh.create(image.rows, image.cols, CV_8U);
+    nonMaxHigh.setTo(0);
+
+    for(int i = 1; i < magnitude.rows - 1; i++) {
+        uchar *p_non_ms = nonMax.ptr<uchar>(i);
+        uchar *p_non_ms_hth = nonMaxHigh.ptr<uchar>(i);
+
+        const float *p_res = magnitude.ptr<float>(i);
+        const float *p_res_t = magnitude.ptr<float>(i - 1);
+        const float *p_res_b = magnitude.ptr<float>(i + 1);
+
+        const float *p_x = gradX.ptr<float>(i);
+        const float *p_y = gradY.ptr<float>(i);
+
+        for(int j = 1; j < magnitude.cols - 1; j++) {
+            const float iy = p_y[j];
+            const float ix = p_x[j];
+            float d, grad1, grad2;
+
+            if((iy <= 0 && ix > -iy) || (iy >= 0 && ix < -iy)) {
+                d = std::abs(iy / ix);
+                grad1 = (p_res[j + 1] * (1 - d)) + (p_res_t[j + 1] * d);
+                grad2 = (p_res[j - 1] * (1 - d)) + (p_res_b[j - 1] * d);
+
+                if(p_res[j] >= grad1 && p_res[j] >= grad2) {
+                    p_non_ms[j] = 255;
+                    if(p_res[j] > high_th)
+                        p_non_ms_hth[j] = 255;
+                }
+            }
+
+            if((ix > 0 && -iy >= ix) || (ix < 0 && -iy <= ix)) {
+                d = std::abs(ix / iy);
+                grad1 = (p_res_t[j] * (1 - d)) + (p_res_t[j + 1] * d);
+                grad2 = (p_res_b[j] * (1 - d)) + (p_res_b[j - 1] * d);
+
+                if(p_res[j] >= grad1 && p_res[j] >= grad2) {
+                    p_non_ms[j] = 255;
+                    if(p_res[j] > high_th)
+                        p_non_ms_hth[j] = 255;
+                }
+            }
+
+            if((ix <= 0 && ix > iy) || (ix >= 0 && ix < iy)) {
+                d = std::abs(ix / iy);
+                grad1 = (p_res_t[j] * (1 - d)) + (p_res_t[j - 1] * d);
+                grad2 = (p_res_b[j] * (1 - d)) + (p_res_b[j + 1] * d);
+
+                if(p_res[j] >= grad1 && p_res[j] >= grad2) {
+                    p_non_ms[j] = 255;
+                    if(p_res[j] > high_th)
+                        p_non_ms_hth[j] = 255;
+                }
+            }
+
+            if((iy < 0 && ix <= iy) || (iy > 0 && ix >= iy)) {
+                d = std::abs(iy / ix);
+                grad1 = (p_res[j - 1] * (1 - d)) + (p_res_t[j - 1] * d);
+                grad2 = (p_res[j + 1] * (1 - d)) + (p_res_b[j + 1] * d);
+
+                if(p_res[j] >= grad1 && p_res[j] >= grad2) {
+                    p_non_ms[j] = 255;
+                    if(p_res[j] > high_th)
+                        p_non_ms_hth[j] = 255;
+                }
+            }
+        }
+    }
+
+    hysteresis();
+
+    return edges;
+}
+
+// Keeps all weak edge pixels (non-maximum) connected to a strong edge pixel (above the high threshold)
+// Traces at most maxLinePixels pixels from a strong pixel, the scan starts one row above the strong pixel like the original
+void EdgePipeline::hysteresis() {
+
+    const int pic_x = nonMaxHigh.cols;
+    const int pic_y = nonMaxHigh.rows;
+
+    edges.create(pic_y, pic_x, CV_8U);
+    edges.setTo(0);
+
+    const uchar *strong = nonMaxHigh.data;
+    const uchar *weak = nonMax.data;
+    uchar *check = edges.data;
+    int *line = lines.data();
+
+    int lines_idx = 0;
+    int idx = 0;
+
+    for(int i = 1; i < pic_y - 1; i++) {
+        for(int j = 1; j < pic_x - 1; j++) {
+
+            if(strong[idx + j] != 0 && check[idx + j] == 0) {
+
+                check[idx + j] = 255;
+                lines_idx = 1;
+                line[0] = idx + j;
+
+                int akt_idx = 0;
+
+                while(akt_idx < lines_idx && lines_idx < maxLinePixels) {
+
+                    int akt_pos = line[akt_idx];
+
+                    if(akt_pos - pic_x - 1 >= 0 && akt_pos + pic_x + 1 < pic_x * pic_y) {
+                        for(int k1 = -1; k1 < 2; k1++) {
+                            for(int k2 = -1; k2 < 2; k2++) {
+                                const int pos = akt_pos + (k1 * pic_x) + k2;
+
+                                if(check[pos] == 0 && weak[pos] != 0) {
+                                    check[pos] = 255;
+                                    if(lines_idx < maxLinePixels) {
+                                        line[lines_idx] = pos;
+                                        lines_idx++;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                    akt_idx++;
+                }
+            }
+        }
+        idx += pic_x;
+    }
+}
+
+// Removes edge pixels which have a horizontal and a vertical neighbour, in place and row by row, thus already removed pixels
+// are no neighbours of the following pixels
+void EdgePipeline::thinCorners(cv::Mat &edge, int startX, int endX, int startY, int endY) {
+
+    for(int j = startY; j < endY; j++) {
+        const uchar *top = edge.ptr<uchar>(j - 1);
+        uchar *row = edge.ptr<uchar>(j);
+        const uchar *bottom = edge.ptr<uchar>(j + 1);
+
+        for(int i = startX; i < endX; i++) {
+            if(row[i] && (top[i] || bottom[i]) && (row[i - 1] || row[i + 1]))
+                row[i] = 0;
+        }
+    }
+}
+
+// Collects the 8-connected curves of non-zero edge pixels inside the area, the area is limited to 2 pixels from the border
+// Curves are found column by column and traced in the neighbour order of the original implementations, as the order decides
+// between equally good curves. The columns are scanned as rows of the transposed area.
+const std::vector<EdgeCurve> &EdgePipeline::findCurves(const cv::Mat &edge, int startX, int endX, int startY, int endY) {
+
+    curves.clear();
+
+    if(startX < 2)
+        startX = 2;
+    if(startY < 2)
+        startY = 2;
+    if(endX > edge.cols - 2)
+        endX = edge.cols - 2;
+    if(endY > edge.rows - 2)
+        endY = edge.rows - 2;
+
+    if(endX <= startX || endY <= startY)
+        return curves;
+
+    visited.create(edge.rows, edge.cols, CV_8U);
+    visited.setTo(0);
+
+    cv::transpose(edge(cv::Rect(startX, startY, endX - startX, endY - startY)), edgeColumns);
+
+    for(int i = startX; i < endX; i++) {
+        const uchar *column = edgeColumns.ptr<uchar>(i - startX);
+
+        for(int j = startY; j < endY; j++) {
+
+            if(column[j - startY] == 0 || visited.at<uchar>(j, i))
+                continue;
+
+            visited.at<uchar>(j, i) = 1;
+
+            curves.emplace_back();
+            std::vector<cv::Point> &curve = curves.back().points;
+            curve.push_back(cv::Point(i, j));
+            cv::Point sum(i, j);
+
+            for(size_t akt_idx = 0; akt_idx < curve.size(); akt_idx++) {
+                const cv::Point akt_pos = curve[akt_idx];
+
+                for(int k1 = -1; k1 < 2; k1++) {
+                    const int x = akt_pos.x + k1;
+                    if(x < startX || x >= endX)
+                        continue;
+
+                    for(int k2 = -1; k2 < 2; k2++) {
+                        const int y = akt_pos.y + k2;
+                        if(y < startY || y >= endY)
+                            continue;
+
+                        if(!visited.at<uchar>(y, x) && edge.at<uchar>(y, x) != 0) {
+                            visited.at<uchar>(y, x) = 1;
+                            sum += cv::Point(x, y);
+                            curve.push_back(cv::Point(x, y));
+                        }
+                    }
+                }
+            }
+
+            curves.back().mean.x = static_cast<int>(std::floor((double(sum.x) / double(curve.size())) + 0.5));
+            curves.back().mean.y = static_cast<int>(std::floor((double(sum.y) / double(curve.size())) + 0.5));
+        }
+    }
+
+    return curves;
+}
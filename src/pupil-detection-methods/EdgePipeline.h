@@ -0,0 +1,78 @@
+
+#ifndef PUPILEXT_EDGEPIPELINE_H
+#define PUPILEXT_EDGEPIPELINE_H
+
+/**
+    @author Moritz Lode
+*/
+
+#include <opencv2/core/mat.hpp>
+#include <vector>
+
+
+/**
+    Connected edge curve of an edge image, in coordinates of the edge image
+
+    mean: rounded mean position of the curve points
+*/
+struct EdgeCurve {
+    std::vector<cv::Point> points;
+    cv::Point mean;
+};
+
+
+/**
+    Edge detection and curve extraction shared by ExCuSe and ElSe, which carried their own copies of the same pipeline
+
+    Fuhl, Wolfgang, et al. "ExCuSe: Robust Pupil Detection in Real-World Scenarios." CAIP 2015.
+    Fuhl, Wolfgang, et al. "ElSe: Ellipse Selection for Robust Pupil Detection in Real-World Environments." ETRA 2016.
+
+    The results are the same as those of the original implementations. All passes work row-major on continuous buffers, the
+    vertical filters use column kernels instead of transposing the image, and all buffers are kept per instance and reused for
+    the next frame of the same size. An instance must not be used by multiple threads at the same time.
+
+    canny(): Canny edges of a single channel 8 bit image (derivative of Gaussian, non-maximum suppression, hysteresis), returns
+             an edge image with 255 for edge pixels, valid until the next call
+    getMagnitude(): gradient magnitude of the last canny() call, normalized to [0, 1]
+    thinCorners(): removes edge pixels with both a horizontal and a vertical neighbour inside the given area
+    findCurves(): 8-connected curves of an edge image inside the given area, valid until the next call
+*/
+class EdgePipeline {
+
+public:
+
+    EdgePipeline();
+
+    const cv::Mat &canny(const cv::Mat &image, bool roundNonEdgeCount=false);
+
+    const cv::Mat &getMagnitude() const {
+        return magnitude;
+    }
+
+    static void thinCorners(cv::Mat &edge, int startX, int endX, int startY, int endY);
+
+    const std::vector<EdgeCurve> &findCurves(const cv::Mat &edge, int startX, int endX, int startY, int endY);
+
+private:
+
+    cv::Mat image32;
+    cv::Mat smoothed;
+    cv::Mat gradX;
+    cv::Mat gradY;
+    cv::Mat magnitude;
+    cv::Mat magnitudeBins;
+    cv::Mat nonMax;
+    cv::Mat nonMaxHigh;
+    cv::Mat edges;
+    std::vector<int> lines;
+
+    cv::Mat edgeColumns;
+    cv::Mat visited;
+    std::vector<EdgeCurve> curves;
+
+    void hysteresis();
+
+};
+
+
+#endif //PUPILEXT_EDGEPIPELINE_H
@@ -17,11 +17,7 @@
 
 using namespace cv;
 
-float ElSe::minArea = 0;
-float ElSe::maxArea = 0;
-
 #define IMG_SIZE 640 //400
-#define MAX_LINE 10000
 
 static bool is_good_ellipse_eval(RotatedRect *ellipse, Mat *pic, int *erg)
 {
@@ -135,103 +131,30 @@ static int calc_inner_gray(Mat *pic, std::vector<Point> curve, RotatedRect ellip
     return gray_val;
 }
 
-static std::vector<std::vector<Point>> get_curves(Mat *pic, Mat *edge, Mat *magni, int start_x, int end_x, int start_y, int end_y, double mean_dist, int inner_color_range)
+static std::vector<std::vector<Point>> get_curves(EdgePipeline &edgePipeline, Mat *pic, Mat *edge, int start_x, int end_x, int start_y, int end_y, double mean_dist, int inner_color_range, float minArea, float maxArea)
 {
 
-    (void)magni;
-    std::vector<std::vector<Point>> all_lines;
-
     std::vector<std::vector<Point>> all_curves;
     std::vector<Point> curve;
 
-    std::vector<Point> all_means;
-
-    if (start_x < 2)
-        start_x = 2;
-    if (start_y < 2)
-        start_y = 2;
-    if (end_x > pic->cols - 2)
-        end_x = pic->cols - 2;
-    if (end_y > pic->rows - 2)
-        end_y = pic->rows - 2;
-
-    int curve_idx = 0;
     Point mean_p;
     bool add_curve;
     int mean_inner_gray;
     int mean_inner_gray_last = 1000000;
 
-    all_curves.clear();
-    all_means.clear();
-    all_lines.clear();
-
-    bool check[IMG_SIZE][IMG_SIZE];
-
-    for (int i = 0; i < IMG_SIZE; i++)
-        for (int j = 0; j < IMG_SIZE; j++)
-            check[i][j] = 0;
-
     //get all lines
-    for (int i = start_x; i < end_x; i++)
-        for (int j = start_y; j < end_y; j++)
-        {
-
-            if (edge->data[(edge->cols * (j)) + (i)] > 0 && !check[i][j])
-            {
-                check[i][j] = 1;
-
-                curve.clear();
-                curve_idx = 0;
-
-                curve.push_back(Point(i, j));
-                mean_p.x = i;
-                mean_p.y = j;
-                curve_idx++;
-
-                int akt_idx = 0;
-
-                while (akt_idx < curve_idx)
-                {
-
-                    Point akt_pos = curve[akt_idx];
-                    for (int k1 = -1; k1 < 2; k1++)
-                        for (int k2 = -1; k2 < 2; k2++)
-                        {
-
-                            if (akt_pos.x + k1 >= start_x && akt_pos.x + k1 < end_x && akt_pos.y + k2 >= start_y && akt_pos.y + k2 < end_y)
-                                if (!check[akt_pos.x + k1][akt_pos.y + k2])
-                                    if (edge->data[(edge->cols * (akt_pos.y + k2)) + (akt_pos.x + k1)] > 0)
-                                    {
-                                        check[akt_pos.x + k1][akt_pos.y + k2] = 1;
-
-                                        mean_p.x += akt_pos.x + k1;
-                                        mean_p.y += akt_pos.y + k2;
-                                        curve.push_back(Point(akt_pos.x + k1, akt_pos.y + k2));
-                                        curve_idx++;
-                                    }
-                        }
-                    akt_idx++;
-                }
-
-                if (curve_idx > 10 && curve.size() > 10)
-                {
-
-                    mean_p.x = (int)floor((double(mean_p.x) / double(curve_idx)) + 0.5);
-                    mean_p.y = (int)floor((double(mean_p.y) / double(curve_idx)) + 0.5);
-
-                    all_means.push_back(mean_p);
-                    all_lines.push_back(curve);
-                }
-            }
-        }
+    const std::vector<EdgeCurve> &all_lines = edgePipeline.findCurves(*edge, start_x, end_x, start_y, end_y);
 
     RotatedRect selected_ellipse;
 
     for (unsigned int iii = 0; iii < all_lines.size(); iii++)
     {
 
-        curve = all_lines.at(iii);
-        mean_p = all_means.at(iii);
+        if (all_lines[iii].points.size() <= 10)
+            continue;
+
+        curve = all_lines[iii].points;
+        mean_p = all_lines[iii].mean;
 
         int results = 0;
         add_curve = true;
@@ -264,8 +187,8 @@ static std::vector<std::vector<Point>> get_curves(Mat *pic, Mat *edge, Mat *magn
 
             if (add_curve)
             { // pupil area
-                if (ellipse.size.width * ellipse.size.height < ElSe::minArea ||
-                    ellipse.size.width * ellipse.size.height > ElSe::maxArea)
+                if (ellipse.size.width * ellipse.size.height < minArea ||
+                    ellipse.size.width * ellipse.size.height > maxArea)
                     add_curve = false;
             }
 
@@ -309,7 +232,7 @@ static std::vector<std::vector<Point>> get_curves(Mat *pic, Mat *edge, Mat *magn
     return all_curves;
 }
 
-static RotatedRect find_best_edge(Mat *pic, Mat *edge, Mat *magni, int start_x, int end_x, int start_y, int end_y, double mean_dist, int inner_color_range)
+static RotatedRect find_best_edge(EdgePipeline &edgePipeline, Mat *pic, Mat *edge, int start_x, int end_x, int start_y, int end_y, double mean_dist, int inner_color_range, float minArea, float maxArea)
 {
 
     RotatedRect ellipse;
@@ -319,7 +242,7 @@ static RotatedRect find_best_edge(Mat *pic, Mat *edge, Mat *magni, int start_x,
     ellipse.size.height = 0.0;
     ellipse.size.width = 0.0;
 
-    std::vector<std::vector<Point>> all_curves = get_curves(pic, edge, magni, start_x, end_x, start_y, end_y, mean_dist, inner_color_range);
+    std::vector<std::vector<Point>> all_curves = get_curves(edgePipeline, pic, edge, start_x, end_x, start_y, end_y, mean_dist, inner_color_range, minArea, maxArea);
 
     if (all_curves.size() == 1)
     {
@@ -363,30 +286,7 @@ static void filter_edges(Mat *edge, int start_xx, int end_xx, int start_yy, int
     if (end_y > edge->rows - 5)
         end_y = edge->rows - 5;
 
-    for (int j = start_y; j < end_y; j++)
-        for (int i = start_x; i < end_x; i++)
-        {
-            int box[9];
-
-            box[4] = (int)edge->data[(edge->cols * (j)) + (i)];
-
-            if (box[4])
-            {
-                box[1] = (int)edge->data[(edge->cols * (j - 1)) + (i)];
-                box[3] = (int)edge->data[(edge->cols * (j)) + (i - 1)];
-                box[5] = (int)edge->data[(edge->cols * (j)) + (i + 1)];
-                box[7] = (int)edge->data[(edge->cols * (j + 1)) + (i)];
-
-                if ((box[5] && box[7]))
-                    edge->data[(edge->cols * (j)) + (i)] = 0;
-                if ((box[5] && box[1]))
-                    edge->data[(edge->cols * (j)) + (i)] = 0;
-                if ((box[3] && box[7]))
-                    edge->data[(edge->cols * (j)) + (i)] = 0;
-                if ((box[3] && box[1]))
-                    edge->data[(edge->cols * (j)) + (i)] = 0;
-            }
-        }
+    EdgePipeline::thinCorners(*edge, start_x, end_x, start_y, end_y);
 
     //too many neigbours
     for (int j = start_y; j < end_y; j++)
@@ -590,315 +490,6 @@ static void filter_edges(Mat *edge, int start_xx, int end_xx, int start_yy, int
         }
 }
 
-static void bwselect(Mat *strong, Mat *weak, Mat *check)
-{
-
-    int pic_x = strong->cols;
-    int pic_y = strong->rows;
-
-    int lines[MAX_LINE];
-    int lines_idx = 0;
-
-    int idx = 0;
-
-    for (int i = 1; i < pic_y - 1; i++)
-    {
-        for (int j = 1; j < pic_x - 1; j++)
-        {
-
-            if (strong->data[idx + j] != 0 && check->data[idx + j] == 0)
-            {
-
-                check->data[idx + j] = 255;
-                lines_idx = 1;
-                lines[0] = idx + j;
-
-                int akt_idx = 0;
-
-                while (akt_idx < lines_idx && lines_idx < MAX_LINE - 1)
-                {
-
-                    int akt_pos = lines[akt_idx];
-
-                    if (akt_pos - pic_x - 1 >= 0 && akt_pos + pic_x + 1 < pic_x * pic_y)
-                    {
-                        for (int k1 = -1; k1 < 2; k1++)
-                        {
-                            for (int k2 = -1; k2 < 2; k2++)
-                            {
-                                if (check->data[(akt_pos + (k1 * pic_x)) + k2] == 0 && weak->data[(akt_pos + (k1 * pic_x)) + k2] != 0)
-                                {
-                                    check->data[(akt_pos + (k1 * pic_x)) + k2] = 255;
-                                    lines_idx++;
-                                    lines[lines_idx - 1] = (akt_pos + (k1 * pic_x)) + k2;
-                                }
-                            }
-                        }
-                    }
-                    akt_idx++;
-                }
-            }
-        }
-        idx += pic_x;
-    }
-}
-
-static Mat cbwselect(const Mat &strong, const Mat &weak)
-{
-
-    int pic_x = strong.cols;
-    int pic_y = strong.rows;
-
-    Mat check = Mat::zeros(pic_y, pic_x, CV_8U);
-
-    int lines[MAX_LINE] = {0};
-    int lines_idx = 0;
-
-    int idx = 0;
-
-    for (int i = 1; i < pic_y - 1; i++)
-    {
-        for (int j = 1; j < pic_x - 1; j++)
-        {
-
-            if (strong.at<uchar>(idx + j) != 0 && check.at<uchar>(idx + j) == 0)
-            {
-
-                check.at<uchar>(idx + j) = 255;
-                lines_idx = 1;
-                lines[0] = idx + j;
-
-                int akt_idx = 0;
-
-                while (akt_idx < lines_idx && lines_idx < MAX_LINE)
-                {
-
-                    int akt_pos = lines[akt_idx];
-
-                    if (akt_pos - pic_x - 1 >= 0 && akt_pos + pic_x + 1 < pic_x * pic_y)
-                    {
-                        for (int k1 = -1; k1 < 2; k1++)
-                        {
-                            for (int k2 = -1; k2 < 2; k2++)
-                            {
-
-                                if (check.at<uchar>((akt_pos + (k1 * pic_x)) + k2) == 0 && weak.at<uchar>((akt_pos + (k1 * pic_x)) + k2) != 0)
-                                {
-                                    check.at<uchar>((akt_pos + (k1 * pic_x)) + k2) = 255;
-                                    // ML 18.11.20: fixed array boundary access for lines array
-                                    if (lines_idx < MAX_LINE)
-                                    {
-                                        lines[lines_idx] = (akt_pos + (k1 * pic_x)) + k2;
-                                        lines_idx++;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    akt_idx++;
-                }
-            }
-        }
-        idx += pic_x;
-    }
-
-    return check;
-}
-
-static Mat canny_impl(Mat *pic, Mat *magni)
-{
-    int k_sz = 16;
-
-    float gau[16] = {0.000000220358050f, 0.000007297256405f, 0.000146569312970f, 0.001785579770079f,
-                     0.013193749090229f, 0.059130281094460f, 0.160732768610747f, 0.265003534507060f, 0.265003534507060f,
-                     0.160732768610747f, 0.059130281094460f, 0.013193749090229f, 0.001785579770079f, 0.000146569312970f,
-                     0.000007297256405f, 0.000000220358050f};
-    float deriv_gau[16] = {-0.000026704586264f, -0.000276122963398f, -0.003355163265098f, -0.024616683775044f, -0.108194751875585f,
-                           -0.278368310241814f, -0.388430056419619f, -0.196732206873178f, 0.196732206873178f, 0.388430056419619f,
-                           0.278368310241814f, 0.108194751875585f, 0.024616683775044f, 0.003355163265098f, 0.000276122963398f, 0.000026704586264f};
-
-    Point anchor = Point(-1, -1);
-    float delta = 0;
-    int ddepth = -1;
-
-    pic->convertTo(*pic, CV_32FC1);
-
-    Mat gau_x = Mat(1, k_sz, CV_32FC1, &gau);
-    Mat deriv_gau_x = Mat(1, k_sz, CV_32FC1, &deriv_gau);
-
-    Mat res_x;
-    Mat res_y;
-
-    transpose(*pic, *pic);
-    filter2D(*pic, res_x, ddepth, gau_x, anchor, delta, BORDER_REPLICATE);
-    transpose(*pic, *pic);
-    transpose(res_x, res_x);
-
-    filter2D(res_x, res_x, ddepth, deriv_gau_x, anchor, delta, BORDER_REPLICATE);
-    filter2D(*pic, res_y, ddepth, gau_x, anchor, delta, BORDER_REPLICATE);
-
-    transpose(res_y, res_y);
-    filter2D(res_y, res_y, ddepth, deriv_gau_x, anchor, delta, BORDER_REPLICATE);
-    transpose(res_y, res_y);
-
-    *magni = Mat::zeros(pic->rows, pic->cols, CV_32FC1);
-
-    float *p_res, *p_x, *p_y;
-    for (int i = 0; i < magni->rows; i++)
-    {
-        p_res = magni->ptr<float>(i);
-        p_x = res_x.ptr<float>(i);
-        p_y = res_y.ptr<float>(i);
-
-        for (int j = 0; j < magni->cols; j++)
-        {
-            //res.at<float>(j, i)= sqrt( (res_x.at<float>(j, i)*res_x.at<float>(j, i)) + (res_y.at<float>(j, i)*res_y.at<float>(j, i)) );
-            //res.at<float>(j, i)=robust_pytagoras_after_MOLAR_MORRIS(res_x.at<float>(j, i), res_y.at<float>(j, i));
-            //res.at<float>(j, i)=hypot(res_x.at<float>(j, i), res_y.at<float>(j, i));
-
-            //p_res[j]=__ieee754_hypot(p_x[j], p_y[j]);
-
-            p_res[j] = hypot(p_x[j], p_y[j]);
-        }
-    }
-
-    //th selection
-    int PercentOfPixelsNotEdges = (int)round(0.7 * magni->cols * magni->rows);
-    float ThresholdRatio = 0.4f;
-
-    float high_th = 0;
-    float low_th = 0;
-
-    int h_sz = 64;
-    int hist[64];
-    for (int i = 0; i < h_sz; i++)
-        hist[i] = 0;
-
-    normalize(*magni, *magni, 0, 1, NORM_MINMAX, CV_32FC1);
-
-    Mat res_idx = Mat::zeros(pic->rows, pic->cols, CV_8U);
-    normalize(*magni, res_idx, 0, 63, NORM_MINMAX, CV_32S);
-
-    int *p_res_idx = 0;
-    for (int i = 0; i < magni->rows; i++)
-    {
-        p_res_idx = res_idx.ptr<int>(i);
-        for (int j = 0; j < magni->cols; j++)
-        {
-            hist[p_res_idx[j]]++;
-        }
-    }
-
-    int sum = 0;
-    for (int i = 0; i < h_sz; i++)
-    {
-        sum += hist[i];
-        if (sum > PercentOfPixelsNotEdges)
-        {
-            high_th = float(i + 1) / float(h_sz);
-            break;
-        }
-    }
-
-    low_th = ThresholdRatio * high_th;
-
-    //non maximum supression + interpolation
-    Mat non_ms = Mat::zeros(pic->rows, pic->cols, CV_8U);
-    Mat non_ms_hth = Mat::zeros(pic->rows, pic->cols, CV_8U);
-
-    float ix, iy, grad1, grad2, d;
-
-    char *p_non_ms, *p_non_ms_hth;
-    float *p_res_t, *p_res_b;
-    for (int i = 1; i < magni->rows - 1; i++)
-    {
-        p_non_ms = non_ms.ptr<char>(i);
-        p_non_ms_hth = non_ms_hth.ptr<char>(i);
-
-        p_res = magni->ptr<float>(i);
-        p_res_t = magni->ptr<float>(i - 1);
-        p_res_b = magni->ptr<float>(i + 1);
-
-        p_x = res_x.ptr<float>(i);
-        p_y = res_y.ptr<float>(i);
-
-        for (int j = 1; j < magni->cols - 1; j++)
-        {
-
-            iy = p_y[j];
-            ix = p_x[j];
-
-            if ((iy <= 0 && ix > -iy) || (iy >= 0 && ix < -iy))
-            {
-
-                d = abs(iy / ix);
-                grad1 = (p_res[j + 1] * (1 - d)) + (p_res_t[j + 1] * d);
-                grad2 = (p_res[j - 1] * (1 - d)) + (p_res_b[j - 1] * d);
-
-                if (p_res[j] >= grad1 && p_res[j] >= grad2)
-                {
-                    p_non_ms[j] = (char)255;
-
-                    if (p_res[j] > high_th)
-                        p_non_ms_hth[j] = (char)255;
-                }
-            }
-
-            if ((ix > 0 && -iy >= ix) || (ix < 0 && -iy <= ix))
-            {
-                d = abs(ix / iy);
-                grad1 = (p_res_t[j] * (1 - d)) + (p_res_t[j + 1] * d);
-                grad2 = (p_res_b[j] * (1 - d)) + (p_res_b[j - 1] * d);
-
-                if (p_res[j] >= grad1 && p_res[j] >= grad2)
-                {
-                    p_non_ms[j] = (char)255;
-                    if (p_res[j] > high_th)
-                        p_non_ms_hth[j] = (char)255;
-                }
-            }
-
-            if ((ix <= 0 && ix > iy) || (ix >= 0 && ix < iy))
-            {
-                d = abs(ix / iy);
-                grad1 = (p_res_t[j] * (1 - d)) + (p_res_t[j - 1] * d);
-                grad2 = (p_res_b[j] * (1 - d)) + (p_res_b[j + 1] * d);
-
-                if (p_res[j] >= grad1 && p_res[j] >= grad2)
-                {
-                    p_non_ms[j] = (char)255;
-                    if (p_res[j] > high_th)
-                        p_non_ms_hth[j] = (char)255;
-                }
-            }
-
-            if ((iy < 0 && ix <= iy) || (iy > 0 && ix >= iy))
-            {
-                d = abs(iy / ix);
-                grad1 = (p_res[j - 1] * (1 - d)) + (p_res_t[j - 1] * d);
-                grad2 = (p_res[j + 1] * (1 - d)) + (p_res_b[j + 1] * d);
-
-                if (p_res[j] >= grad1 && p_res[j] >= grad2)
-                {
-                    p_non_ms[j] = (char)255;
-                    if (p_res[j] > high_th)
-                        p_non_ms_hth[j] = (char)255;
-                }
-            }
-        }
-    }
-    ////bw select
-
-    //Mat res_lin = Mat::zeros(pic->rows, pic->cols, CV_8U);
-    //bwselect(&non_ms_hth, &non_ms, &res_lin);
-
-    Mat res_lin = cbwselect(non_ms_hth, non_ms);
-
-    //res_lin.convertTo(res_lin, CV_8U);
-
-    return res_lin;
-}
-
 static void mum(Mat *pic, Mat *result, int fak)
 {
 
@@ -1260,6 +851,13 @@ static RotatedRect blob_finder(Mat *pic)
 }
 
 Pupil ElSe::run(const Mat &frame)
+{
+    return detect(frame, -1, -1);
+}
+
+// Detection with the pupil area limits derived from the given diameters, or from minAreaRatio and maxAreaRatio of the image size if not given
+// The limits are local to the call, thus instances can run concurrently
+Pupil ElSe::detect(const Mat &frame, float minPupilDiameterPx, float maxPupilDiameterPx)
 {
 
     RotatedRect ellipse;
@@ -1280,8 +878,15 @@ Pupil ElSe::run(const Mat &frame)
     Mat pic;
     normalize(downscaled, pic, 0, 255, NORM_MINMAX, CV_8U);
 
-    minArea = downscaled.cols * downscaled.rows * minAreaRatio;
-    maxArea = downscaled.cols * downscaled.rows * maxAreaRatio;
+    float minArea = downscaled.cols * downscaled.rows * minAreaRatio;
+    float maxArea = downscaled.cols * downscaled.rows * maxAreaRatio;
+
+    // User given diameters are in pixels of the frame, the areas are compared in the downscaled image
+    if (minPupilDiameterPx > 0 && maxPupilDiameterPx > 0)
+    {
+        minArea = pow(minPupilDiameterPx * scalingRatio, 2);
+        maxArea = pow(maxPupilDiameterPx * scalingRatio, 2);
+    }
 
     double border = 0.0; // ER takes care of setting an ROI
     double mean_dist = 3;
@@ -1293,25 +898,11 @@ Pupil ElSe::run(const Mat &frame)
     int end_x = pic.cols - start_x;
     int end_y = pic.rows - start_y;
 
-    Mat picpic = Mat::zeros(end_y - start_y, end_x - start_x, CV_8U);
-    Mat magni;
-
-    for (int i = 0; i < picpic.cols; i++)
-    {
-        for (int j = 0; j < picpic.rows; j++)
-        {
-            picpic.data[(picpic.cols * j) + i] = pic.data[(pic.cols * (start_y + j)) + (start_x + i)];
-        }
-    }
-
-    Mat detected_edges2 = canny_impl(&picpic, &magni);
+    cv::Rect area(start_x, start_y, end_x - start_x, end_y - start_y);
+    const cv::Mat &detected_edges2 = edgePipeline.canny(pic(area), true);
 
     Mat detected_edges = Mat::zeros(pic.rows, pic.cols, CV_8U);
-    for (int i = 0; i < detected_edges2.cols; i++)
-        for (int j = 0; j < detected_edges2.rows; j++)
-        {
-            detected_edges.data[(detected_edges.cols * (start_y + j)) + (start_x + i)] = detected_edges2.data[(detected_edges2.cols * j) + i];
-        }
+    detected_edges2.copyTo(detected_edges(area));
 
     //cv::imwrite( "edge_image.jpg", detected_edges);
 
@@ -1319,7 +910,7 @@ Pupil ElSe::run(const Mat &frame)
 
     //cv::imwrite( "filtered_edge_image.jpg", detected_edges );
 
-    ellipse = find_best_edge(&pic, &detected_edges, &magni, start_x, end_x, start_y, end_y, mean_dist, inner_color_range);
+    ellipse = find_best_edge(edgePipeline, &pic, &detected_edges, start_x, end_x, start_y, end_y, mean_dist, inner_color_range, minArea, maxArea);
 
     if ((ellipse.center.x <= 0 && ellipse.center.y <= 0) || ellipse.center.x >= pic.cols || ellipse.center.y >= pic.rows)
     {
@@ -1344,18 +935,7 @@ void ElSe::run(const cv::Mat &frame, const cv::Rect &roi, Pupil &pupil, const fl
         return;
     }
 
-    if (minPupilDiameterPx > 0 && maxPupilDiameterPx > 0)
-    {
-        minArea = pow(minPupilDiameterPx, 2);
-        maxArea = pow(maxPupilDiameterPx, 2);
-    }
-    else
-    {
-        minArea = frame.cols * frame.rows * 0.005;
-        maxArea = frame.cols * frame.rows * 0.2;
-    }
-
-    pupil = run(frame(roi));
+    pupil = detect(frame(roi), minPupilDiameterPx, maxPupilDiameterPx);
     if (pupil.center.x > 0 && pupil.center.y > 0)
         pupil.shift(roi.tl());
 }
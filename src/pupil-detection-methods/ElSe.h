@@ -12,14 +12,12 @@
 */
 
 #include "PupilDetectionMethod.h"
+#include "EdgePipeline.h"
 
 class ElSe : public PupilDetectionMethod {
 
 public:
 
-    static float minArea;
-    static float maxArea;
-
     ElSe() {
         mDesc = "ElSe (Fuhl et al. 2016)";
         mTitle = "ElSe";
@@ -40,9 +38,27 @@ public:
         return false;
     }
 
+    bool isStateless() override {
+        return true;
+    }
+
+    void copyParameters(PupilDetectionMethod *other) override {
+        if(auto *p_else = dynamic_cast<ElSe*>(other)) {
+            minAreaRatio = p_else->minAreaRatio;
+            maxAreaRatio = p_else->maxAreaRatio;
+        }
+    }
+
     float minAreaRatio = 0.005;
     float maxAreaRatio = 0.2;
 
+private:
+
+    // Edge detection buffers, reused for the next frame
+    EdgePipeline edgePipeline;
+
+    Pupil detect(const cv::Mat &frame, float minPupilDiameterPx, float maxPupilDiameterPx);
+
 };
 
 
@@ -17,317 +17,10 @@
 using namespace std;
 using namespace cv;
 
-#define MAX_LINE 10000
 #define IMG_SIZE 680 //400
 #define DEF_SIZE 800 //800
 //#define MAX_RADI 50
 
-static void bwselect(cv::Mat *strong, cv::Mat *weak, cv::Mat *check)
-{
-
-    int pic_x = strong->cols;
-    int pic_y = strong->rows;
-    int lines[MAX_LINE];
-    int lines_idx = 0;
-    int idx = 0;
-
-    for (int i = 1; i < pic_y - 1; i++)
-    {
-        for (int j = 1; j < pic_x - 1; j++)
-        {
-
-            if (strong->data[idx + j] != 0 && check->data[idx + j] == 0)
-            {
-
-                //check->data[idx+j]=255;
-                lines_idx = 1;
-                lines[0] = idx + j;
-
-                int akt_idx = 0;
-
-                while (akt_idx < lines_idx && lines_idx < MAX_LINE - 1)
-                {
-                    int akt_pos = lines[akt_idx];
-
-                    if (akt_pos - pic_x - 1 >= 0 && akt_pos + pic_x + 1 < pic_x * pic_y)
-                    {
-                        for (int k1 = -1; k1 < 2; k1++)
-                            for (int k2 = -1; k2 < 2; k2++)
-                            {
-                                if (check->data[(akt_pos + (k1 * pic_x)) + k2] == 0 && weak->data[(akt_pos + (k1 * pic_x)) + k2] != 0)
-                                {
-                                    check->data[(akt_pos + (k1 * pic_x)) + k2] = 255;
-                                    lines_idx++;
-                                    lines[lines_idx - 1] = (akt_pos + (k1 * pic_x)) + k2;
-                                }
-                            }
-                    }
-                    akt_idx++;
-                }
-            }
-        }
-        idx += pic_x;
-    }
-}
-
-static Mat cbwselect(const Mat &strong, const Mat &weak)
-{
-
-    int pic_x = strong.cols;
-    int pic_y = strong.rows;
-
-    Mat check = Mat::zeros(pic_y, pic_x, CV_8U);
-
-    int lines[MAX_LINE] = {0};
-    int lines_idx = 0;
-
-    int idx = 0;
-
-    for (int i = 1; i < pic_y - 1; i++)
-    {
-        for (int j = 1; j < pic_x - 1; j++)
-        {
-
-            if (strong.at<uchar>(idx + j) != 0 && check.at<uchar>(idx + j) == 0)
-            {
-
-                check.at<uchar>(idx + j) = 255;
-                lines_idx = 1;
-                lines[0] = idx + j;
-
-                int akt_idx = 0;
-
-                while (akt_idx < lines_idx && lines_idx < MAX_LINE)
-                {
-
-                    int akt_pos = lines[akt_idx];
-
-                    if (akt_pos - pic_x - 1 >= 0 && akt_pos + pic_x + 1 < pic_x * pic_y)
-                    {
-                        for (int k1 = -1; k1 < 2; k1++)
-                        {
-                            for (int k2 = -1; k2 < 2; k2++)
-                            {
-
-                                if (check.at<uchar>((akt_pos + (k1 * pic_x)) + k2) == 0 && weak.at<uchar>((akt_pos + (k1 * pic_x)) + k2) != 0)
-                                {
-                                    check.at<uchar>((akt_pos + (k1 * pic_x)) + k2) = 255;
-                                    // ML 18.11.20: fixed array boundary access for lines array
-                                    if (lines_idx < MAX_LINE)
-                                    {
-                                        lines[lines_idx] = (akt_pos + (k1 * pic_x)) + k2;
-                                        lines_idx++;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    akt_idx++;
-                }
-            }
-        }
-        idx += pic_x;
-    }
-
-    return check;
-}
-
-static cv::Mat canny_impl(cv::Mat *pic)
-{
-    int k_sz = 16;
-
-    float gau[16] = {0.000000220358050f, 0.000007297256405f, 0.000146569312970f, 0.001785579770079f,
-                     0.013193749090229f, 0.059130281094460f, 0.160732768610747f, 0.265003534507060f, 0.265003534507060f,
-                     0.160732768610747f, 0.059130281094460f, 0.013193749090229f, 0.001785579770079f, 0.000146569312970f,
-                     0.000007297256405f, 0.000000220358050f};
-    float deriv_gau[16] = {-0.000026704586264f, -0.000276122963398f, -0.003355163265098f, -0.024616683775044f, -0.108194751875585f,
-                           -0.278368310241814f, -0.388430056419619f, -0.196732206873178f, 0.196732206873178f, 0.388430056419619f,
-                           0.278368310241814f, 0.108194751875585f, 0.024616683775044f, 0.003355163265098f, 0.000276122963398f, 0.000026704586264f};
-
-    cv::Point anchor = cv::Point(-1, -1);
-    float delta = 0;
-    int ddepth = -1;
-
-    pic->convertTo(*pic, CV_32FC1);
-
-    cv::Mat gau_x = cv::Mat(1, k_sz, CV_32FC1, &gau);
-    cv::Mat deriv_gau_x = cv::Mat(1, k_sz, CV_32FC1, &deriv_gau);
-
-    cv::Mat res_x;
-    cv::Mat res_y;
-
-    cv::transpose(*pic, *pic);
-    filter2D(*pic, res_x, ddepth, gau_x, anchor, delta, cv::BORDER_REPLICATE);
-    cv::transpose(*pic, *pic);
-    cv::transpose(res_x, res_x);
-
-    filter2D(res_x, res_x, ddepth, deriv_gau_x, anchor, delta, cv::BORDER_REPLICATE);
-
-    filter2D(*pic, res_y, ddepth, gau_x, anchor, delta, cv::BORDER_REPLICATE);
-
-    cv::transpose(res_y, res_y);
-    filter2D(res_y, res_y, ddepth, deriv_gau_x, anchor, delta, cv::BORDER_REPLICATE);
-    cv::transpose(res_y, res_y);
-
-    cv::Mat res = cv::Mat::zeros(pic->rows, pic->cols, CV_32FC1);
-
-    float *p_res, *p_x, *p_y;
-
-    for (int i = 0; i < res.rows; i++)
-    {
-        p_res = res.ptr<float>(i);
-        p_x = res_x.ptr<float>(i);
-        p_y = res_y.ptr<float>(i);
-
-        for (int j = 0; j < res.cols; j++)
-        {
-            //res.at<float>(j, i)= sqrt( (res_x.at<float>(j, i)*res_x.at<float>(j, i)) + (res_y.at<float>(j, i)*res_y.at<float>(j, i)) );
-            //res.at<float>(j, i)=robust_pytagoras_after_MOLAR_MORRIS(res_x.at<float>(j, i), res_y.at<float>(j, i));
-            //res.at<float>(j, i)=hypot(res_x.at<float>(j, i), res_y.at<float>(j, i));
-
-            //p_res[j]=__ieee754_hypot(p_x[j], p_y[j]);
-
-            p_res[j] = hypot(p_x[j], p_y[j]);
-        }
-    }
-
-    //th selection
-    int PercentOfPixelsNotEdges = 0.7 * res.cols * res.rows;
-    float ThresholdRatio = 0.4f;
-
-    float high_th = 0;
-    float low_th = 0;
-
-    int h_sz = 64;
-    int hist[64];
-    for (int i = 0; i < h_sz; i++)
-        hist[i] = 0;
-
-    cv::normalize(res, res, 0, 1, cv::NORM_MINMAX, CV_32FC1);
-    cv::Mat res_idx = cv::Mat::zeros(pic->rows, pic->cols, CV_8U);
-    cv::normalize(res, res_idx, 0, 63, cv::NORM_MINMAX, CV_32S);
-
-    int *p_res_idx = 0;
-
-    for (int i = 0; i < res.rows; i++)
-    {
-        p_res_idx = res_idx.ptr<int>(i);
-        for (int j = 0; j < res.cols; j++)
-        {
-            hist[p_res_idx[j]]++;
-        }
-    }
-
-    int sum = 0;
-
-    for (int i = 0; i < h_sz; i++)
-    {
-        sum += hist[i];
-        if (sum > PercentOfPixelsNotEdges)
-        {
-            high_th = float(i + 1) / float(h_sz);
-            break;
-        }
-    }
-
-    low_th = ThresholdRatio * high_th;
-
-    //non maximum supression + interpolation
-    cv::Mat non_ms = cv::Mat::zeros(pic->rows, pic->cols, CV_8U);
-    cv::Mat non_ms_hth = cv::Mat::zeros(pic->rows, pic->cols, CV_8U);
-
-    float ix, iy, grad1, grad2, d;
-    char *p_non_ms, *p_non_ms_hth;
-    float *p_res_t, *p_res_b;
-
-    for (int i = 1; i < res.rows - 1; i++)
-    {
-        p_non_ms = non_ms.ptr<char>(i);
-        p_non_ms_hth = non_ms_hth.ptr<char>(i);
-
-        p_res = res.ptr<float>(i);
-        p_res_t = res.ptr<float>(i - 1);
-        p_res_b = res.ptr<float>(i + 1);
-
-        p_x = res_x.ptr<float>(i);
-        p_y = res_y.ptr<float>(i);
-
-        for (int j = 1; j < res.cols - 1; j++)
-        {
-
-            iy = p_y[j];
-            ix = p_x[j];
-
-            if ((iy <= 0 && ix > -iy) || (iy >= 0 && ix < -iy))
-            {
-
-                d = abs(iy / ix);
-                grad1 = (p_res[j + 1] * (1 - d)) + (p_res_t[j + 1] * d);
-                grad2 = (p_res[j - 1] * (1 - d)) + (p_res_b[j - 1] * d);
-
-                if (p_res[j] >= grad1 && p_res[j] >= grad2)
-                {
-                    p_non_ms[j] = (char)255;
-
-                    if (p_res[j] > high_th)
-                        p_non_ms_hth[j] = (char)255;
-                }
-            }
-
-            if ((ix > 0 && -iy >= ix) || (ix < 0 && -iy <= ix))
-            {
-                d = abs(ix / iy);
-                grad1 = (p_res_t[j] * (1 - d)) + (p_res_t[j + 1] * d);
-                grad2 = (p_res_b[j] * (1 - d)) + (p_res_b[j - 1] * d);
-
-                if (p_res[j] >= grad1 && p_res[j] >= grad2)
-                {
-                    p_non_ms[j] = (char)255;
-                    if (p_res[j] > high_th)
-                        p_non_ms_hth[j] = (char)255;
-                }
-            }
-
-            if ((ix <= 0 && ix > iy) || (ix >= 0 && ix < iy))
-            {
-                d = abs(ix / iy);
-                grad1 = (p_res_t[j] * (1 - d)) + (p_res_t[j - 1] * d);
-                grad2 = (p_res_b[j] * (1 - d)) + (p_res_b[j + 1] * d);
-
-                if (p_res[j] >= grad1 && p_res[j] >= grad2)
-                {
-                    p_non_ms[j] = (char)255;
-                    if (p_res[j] > high_th)
-                        p_non_ms_hth[j] = (char)255;
-                }
-            }
-
-            if ((iy < 0 && ix <= iy) || (iy > 0 && ix >= iy))
-            {
-                d = abs(iy / ix);
-                grad1 = (p_res[j - 1] * (1 - d)) + (p_res_t[j - 1] * d);
-                grad2 = (p_res[j + 1] * (1 - d)) + (p_res_b[j + 1] * d);
-
-                if (p_res[j] >= grad1 && p_res[j] >= grad2)
-                {
-                    p_non_ms[j] = (char)255;
-                    if (p_res[j] > high_th)
-                        p_non_ms_hth[j] = (char)255;
-                }
-            }
-        }
-    }
-
-    ////bw select
-    //cv::Mat res_lin=cv::Mat::zeros(pic->rows, pic->cols, CV_8U);
-    //bwselect(&non_ms_hth, &non_ms,&res_lin);
-    //pic->convertTo(*pic, CV_8U);
-
-    Mat res_lin = cbwselect(non_ms_hth, non_ms);
-
-    return res_lin;
-}
-
 static bool peek(cv::Mat *pic, double *stddev, int start_x, int end_x, int start_y, int end_y, int peek_detector_factor, int bright_region_th)
 {
 
@@ -448,33 +141,7 @@ static void remove_points_with_low_angle(cv::Mat *edge, int start_xx, int end_xx
             }
         }
 
-    for (int j = start_y; j < end_y; j++)
-        for (int i = start_x; i < end_x; i++)
-        {
-            int box[9];
-
-            box[4] = (int)edge->data[(edge->cols * (j)) + (i)];
-
-            if (box[4])
-            {
-                box[1] = (int)edge->data[(edge->cols * (j - 1)) + (i)];
-                box[3] = (int)edge->data[(edge->cols * (j)) + (i - 1)];
-                box[5] = (int)edge->data[(edge->cols * (j)) + (i + 1)];
-                box[7] = (int)edge->data[(edge->cols * (j + 1)) + (i)];
-
-                if ((box[5] && box[7]))
-                    edge->data[(edge->cols * (j)) + (i)] = 0;
-                if ((box[5] && box[1]))
-                    edge->data[(edge->cols * (j)) + (i)] = 0;
-                if ((box[3] && box[7]))
-                    edge->data[(edge->cols * (j)) + (i)] = 0;
-                if ((box[3] && box[1]))
-                    edge->data[(edge->cols * (j)) + (i)] = 0;
-
-                //if( (box[1] && box[5]) || (box[1] && box[3]) || (box[3] && box[7]) || (box[5] && box[7]) )
-                //		edge->data[(edge->cols*(j))+(i)]=0;
-            }
-        }
+    EdgePipeline::thinCorners(*edge, start_x, end_x, start_y, end_y);
 
     for (int j = start_y; j < end_y; j++)
         for (int i = start_x; i < end_x; i++)
@@ -625,179 +292,114 @@ static void remove_points_with_low_angle(cv::Mat *edge, int start_xx, int end_xx
         }
 }
 
-static std::vector<std::vector<cv::Point>> get_curves(cv::Mat *pic, cv::Mat *edge, int start_x, int end_x, int start_y, int end_y, double mean_dist, int inner_color_range)
+static std::vector<std::vector<cv::Point>> get_curves(EdgePipeline &edgePipeline, cv::Mat *pic, cv::Mat *edge, int start_x, int end_x, int start_y, int end_y, double mean_dist, int inner_color_range)
 {
 
     std::vector<std::vector<cv::Point>> all_curves;
-    std::vector<cv::Point> curve;
-
-    if (start_x < 2)
-        start_x = 2;
-    if (start_y < 2)
-        start_y = 2;
-    if (end_x > pic->cols - 2)
-        end_x = pic->cols - 2;
-    if (end_y > pic->rows - 2)
-        end_y = pic->rows - 2;
-
-    int curve_idx = 0;
-    cv::Point mean_p;
+
     bool add_curve;
     int mean_inner_gray;
     int mean_inner_gray_last = 1000000;
 
-    //curve.reserve(1000);
-    //all_curves.reserve(1000);
-
-    all_curves.clear();
+    for (const EdgeCurve &edgeCurve : edgePipeline.findCurves(*edge, start_x, end_x, start_y, end_y))
+    {
+        const std::vector<cv::Point> &curve = edgeCurve.points;
+        const cv::Point &mean_p = edgeCurve.mean;
 
-    bool check[IMG_SIZE][IMG_SIZE];
+        add_curve = true;
 
-    for (int i = 0; i < IMG_SIZE; i++)
-        for (int j = 0; j < IMG_SIZE; j++)
-            check[i][j] = 0;
+        for (int i = 0; i < curve.size(); i++)
+            if (abs(mean_p.x - curve[i].x) <= mean_dist && abs(mean_p.y - curve[i].y) <= mean_dist)
+                add_curve = false;
 
-    for (int i = start_x; i < end_x; i++)
-        for (int j = start_y; j < end_y; j++)
+        //is ellipse fit possible
+        if (add_curve)
         {
+            cv::RotatedRect ellipse = cv::fitEllipse(cv::Mat(curve));
 
-            if (edge->data[(edge->cols * (j)) + (i)] == 255 && !check[i][j])
+            if (ellipse.center.x < 0 || ellipse.center.y < 0 ||
+                ellipse.center.x > pic->cols || ellipse.center.y > pic->rows)
             {
-                check[i][j] = 1;
 
-                curve.clear();
-                curve_idx = 0;
+                add_curve = false;
+            }
 
-                curve.push_back(cv::Point(i, j));
-                mean_p.x = i;
-                mean_p.y = j;
-                curve_idx++;
+            if (ellipse.size.height > 2.0 * ellipse.size.width ||
+                ellipse.size.width > 2.0 * ellipse.size.height)
+            {
 
-                int akt_idx = 0;
+                add_curve = false;
+            }
+        }
 
-                while (akt_idx < curve_idx)
+        if (add_curve)
+        {
+            if (inner_color_range > 0)
+            {
+                mean_inner_gray = 0;
+
+                //calc inner mean
+                for (int i = 0; i < curve.size(); i++)
                 {
 
-                    cv::Point akt_pos = curve[akt_idx];
-                    for (int k1 = -1; k1 < 2; k1++)
-                        for (int k2 = -1; k2 < 2; k2++)
-                        {
-
-                            if (akt_pos.x + k1 >= start_x && akt_pos.x + k1 < end_x && akt_pos.y + k2 >= start_y && akt_pos.y + k2 < end_y)
-                                if (!check[akt_pos.x + k1][akt_pos.y + k2])
-                                    if (edge->data[(edge->cols * (akt_pos.y + k2)) + (akt_pos.x + k1)] == 255)
-                                    {
-                                        check[akt_pos.x + k1][akt_pos.y + k2] = 1;
-
-                                        mean_p.x += akt_pos.x + k1;
-                                        mean_p.y += akt_pos.y + k2;
-                                        curve.push_back(cv::Point(akt_pos.x + k1, akt_pos.y + k2));
-                                        curve_idx++;
-                                    }
-                        }
-                    akt_idx++;
-                }
+                    if (pic->data[(pic->cols * (curve[i].y + 1)) + (curve[i].x)] != 0 || pic->data[(pic->cols * (curve[i].y - 1)) + (curve[i].x)] != 0)
+                        if (sqrt(pow(double(curve[i].y - mean_p.y), 2) + pow(double(curve[i].x - mean_p.x) + 2, 2)) <
+                            sqrt(pow(double(curve[i].y - mean_p.y), 2) + pow(double(curve[i].x - mean_p.x) - 2, 2)))
 
-                if (curve_idx > 0 && curve.size() > 0)
-                {
-                    add_curve = true;
-                    mean_p.x = floor((double(mean_p.x) / double(curve_idx)) + 0.5);
-                    mean_p.y = floor((double(mean_p.y) / double(curve_idx)) + 0.5);
+                            mean_inner_gray += (unsigned char)pic->data[(pic->cols * (curve[i].y)) + (curve[i].x + 2)];
+                        else
+                            mean_inner_gray += (unsigned char)pic->data[(pic->cols * (curve[i].y)) + (curve[i].x - 2)];
 
-                    for (int i = 0; i < curve.size(); i++)
-                        if (abs(mean_p.x - curve[i].x) <= mean_dist && abs(mean_p.y - curve[i].y) <= mean_dist)
-                            add_curve = false;
+                    else if (pic->data[(pic->cols * (curve[i].y)) + (curve[i].x + 1)] != 0 || pic->data[(pic->cols * (curve[i].y)) + (curve[i].x - 1)] != 0)
+                        if (sqrt(pow(double(curve[i].y - mean_p.y + 2), 2) + pow(double(curve[i].x - mean_p.x), 2)) <
+                            sqrt(pow(double(curve[i].y - mean_p.y - 2), 2) + pow(double(curve[i].x - mean_p.x), 2)))
 
-                    //is ellipse fit possible
-                    if (add_curve)
-                    {
-                        cv::RotatedRect ellipse = cv::fitEllipse(cv::Mat(curve));
+                            mean_inner_gray += (unsigned char)pic->data[(pic->cols * (curve[i].y + 2)) + (curve[i].x)];
+                        else
+                            mean_inner_gray += (unsigned char)pic->data[(pic->cols * (curve[i].y - 2)) + (curve[i].x)];
 
-                        if (ellipse.center.x < 0 || ellipse.center.y < 0 ||
-                            ellipse.center.x > pic->cols || ellipse.center.y > pic->rows)
-                        {
+                    else if (pic->data[(pic->cols * (curve[i].y + 1)) + (curve[i].x + 1)] != 0 || pic->data[(pic->cols * (curve[i].y - 1)) + (curve[i].x - 1)] != 0)
+                        if (sqrt(pow(double(curve[i].y - mean_p.y - 2), 2) + pow(double(curve[i].x - mean_p.x + 2), 2)) <
+                            sqrt(pow(double(curve[i].y - mean_p.y + 2), 2) + pow(double(curve[i].x - mean_p.x - 2), 2)))
 
-                            add_curve = false;
-                        }
+                            mean_inner_gray += (unsigned char)pic->data[(pic->cols * (curve[i].y - 2)) + (curve[i].x + 2)];
+                        else
+                            mean_inner_gray += (unsigned char)pic->data[(pic->cols * (curve[i].y + 2)) + (curve[i].x - 2)];
 
-                        if (ellipse.size.height > 2.0 * ellipse.size.width ||
-                            ellipse.size.width > 2.0 * ellipse.size.height)
-                        {
+                    else if (pic->data[(pic->cols * (curve[i].y - 1)) + (curve[i].x + 1)] != 0 || pic->data[(pic->cols * (curve[i].y + 1)) + (curve[i].x - 1)] != 0)
+                        if (sqrt(pow(double(curve[i].y - mean_p.y + 2), 2) + pow(double(curve[i].x - mean_p.x + 2), 2)) <
+                            sqrt(pow(double(curve[i].y - mean_p.y - 2), 2) + pow(double(curve[i].x - mean_p.x - 2), 2)))
 
-                            add_curve = false;
-                        }
-                    }
+                            mean_inner_gray += (unsigned char)pic->data[(pic->cols * (curve[i].y + 2)) + (curve[i].x + 2)];
+                        else
+                            mean_inner_gray += (unsigned char)pic->data[(pic->cols * (curve[i].y - 2)) + (curve[i].x - 2)];
+
+                    //mean_inner_gray+=pic->data[( pic->cols*( curve[i].y+((mean_p.y-curve[i].y)/2) ) ) + ( curve[i].x+((mean_p.x-curve[i].x)/2) )];
+                }
+
+                mean_inner_gray = floor((double(mean_inner_gray) / double(curve.size())) + 0.5);
+
+                if (mean_inner_gray_last > (mean_inner_gray + inner_color_range))
+                {
+                    mean_inner_gray_last = mean_inner_gray;
+                    all_curves.clear();
+                    all_curves.push_back(curve);
+                }
+                else if (mean_inner_gray_last <= (mean_inner_gray + inner_color_range) && mean_inner_gray_last >= (mean_inner_gray - inner_color_range))
+                {
 
-                    if (add_curve)
+                    if (curve.size() > all_curves[0].size())
                     {
-                        if (inner_color_range > 0)
-                        {
-                            mean_inner_gray = 0;
-
-                            //calc inner mean
-                            for (int i = 0; i < curve.size(); i++)
-                            {
-
-                                if (pic->data[(pic->cols * (curve[i].y + 1)) + (curve[i].x)] != 0 || pic->data[(pic->cols * (curve[i].y - 1)) + (curve[i].x)] != 0)
-                                    if (sqrt(pow(double(curve[i].y - mean_p.y), 2) + pow(double(curve[i].x - mean_p.x) + 2, 2)) <
-                                        sqrt(pow(double(curve[i].y - mean_p.y), 2) + pow(double(curve[i].x - mean_p.x) - 2, 2)))
-
-                                        mean_inner_gray += (unsigned char)pic->data[(pic->cols * (curve[i].y)) + (curve[i].x + 2)];
-                                    else
-                                        mean_inner_gray += (unsigned char)pic->data[(pic->cols * (curve[i].y)) + (curve[i].x - 2)];
-
-                                else if (pic->data[(pic->cols * (curve[i].y)) + (curve[i].x + 1)] != 0 || pic->data[(pic->cols * (curve[i].y)) + (curve[i].x - 1)] != 0)
-                                    if (sqrt(pow(double(curve[i].y - mean_p.y + 2), 2) + pow(double(curve[i].x - mean_p.x), 2)) <
-                                        sqrt(pow(double(curve[i].y - mean_p.y - 2), 2) + pow(double(curve[i].x - mean_p.x), 2)))
-
-                                        mean_inner_gray += (unsigned char)pic->data[(pic->cols * (curve[i].y + 2)) + (curve[i].x)];
-                                    else
-                                        mean_inner_gray += (unsigned char)pic->data[(pic->cols * (curve[i].y - 2)) + (curve[i].x)];
-
-                                else if (pic->data[(pic->cols * (curve[i].y + 1)) + (curve[i].x + 1)] != 0 || pic->data[(pic->cols * (curve[i].y - 1)) + (curve[i].x - 1)] != 0)
-                                    if (sqrt(pow(double(curve[i].y - mean_p.y - 2), 2) + pow(double(curve[i].x - mean_p.x + 2), 2)) <
-                                        sqrt(pow(double(curve[i].y - mean_p.y + 2), 2) + pow(double(curve[i].x - mean_p.x - 2), 2)))
-
-                                        mean_inner_gray += (unsigned char)pic->data[(pic->cols * (curve[i].y - 2)) + (curve[i].x + 2)];
-                                    else
-                                        mean_inner_gray += (unsigned char)pic->data[(pic->cols * (curve[i].y + 2)) + (curve[i].x - 2)];
-
-                                else if (pic->data[(pic->cols * (curve[i].y - 1)) + (curve[i].x + 1)] != 0 || pic->data[(pic->cols * (curve[i].y + 1)) + (curve[i].x - 1)] != 0)
-                                    if (sqrt(pow(double(curve[i].y - mean_p.y + 2), 2) + pow(double(curve[i].x - mean_p.x + 2), 2)) <
-                                        sqrt(pow(double(curve[i].y - mean_p.y - 2), 2) + pow(double(curve[i].x - mean_p.x - 2), 2)))
-
-                                        mean_inner_gray += (unsigned char)pic->data[(pic->cols * (curve[i].y + 2)) + (curve[i].x + 2)];
-                                    else
-                                        mean_inner_gray += (unsigned char)pic->data[(pic->cols * (curve[i].y - 2)) + (curve[i].x - 2)];
-
-                                //mean_inner_gray+=pic->data[( pic->cols*( curve[i].y+((mean_p.y-curve[i].y)/2) ) ) + ( curve[i].x+((mean_p.x-curve[i].x)/2) )];
-                            }
-
-                            mean_inner_gray = floor((double(mean_inner_gray) / double(curve.size())) + 0.5);
-
-                            if (mean_inner_gray_last > (mean_inner_gray + inner_color_range))
-                            {
-                                mean_inner_gray_last = mean_inner_gray;
-                                all_curves.clear();
-                                all_curves.push_back(curve);
-                            }
-                            else if (mean_inner_gray_last <= (mean_inner_gray + inner_color_range) && mean_inner_gray_last >= (mean_inner_gray - inner_color_range))
-                            {
-
-                                if (curve.size() > all_curves[0].size())
-                                {
-                                    mean_inner_gray_last = mean_inner_gray;
-                                    all_curves.clear();
-                                    all_curves.push_back(curve);
-                                }
-                            }
-                        }
-                        else
-                            all_curves.push_back(curve);
+                        mean_inner_gray_last = mean_inner_gray;
+                        all_curves.clear();
+                        all_curves.push_back(curve);
                     }
                 }
             }
+            else
+                all_curves.push_back(curve);
         }
+    }
 
     /*
     std::cout<<all_curves.size()<<std::endl;
@@ -819,7 +421,7 @@ static std::vector<std::vector<cv::Point>> get_curves(cv::Mat *pic, cv::Mat *edg
     return all_curves;
 }
 
-static cv::RotatedRect find_best_edge(cv::Mat *pic, cv::Mat *edge, int start_x, int end_x, int start_y, int end_y, double mean_dist, int inner_color_range)
+static cv::RotatedRect find_best_edge(EdgePipeline &edgePipeline, cv::Mat *pic, cv::Mat *edge, int start_x, int end_x, int start_y, int end_y, double mean_dist, int inner_color_range)
 {
 
     cv::RotatedRect ellipse;
@@ -829,7 +431,7 @@ static cv::RotatedRect find_best_edge(cv::Mat *pic, cv::Mat *edge, int start_x,
     ellipse.size.height = 0.0;
     ellipse.size.width = 0.0;
 
-    std::vector<std::vector<cv::Point>> all_curves = get_curves(pic, edge, start_x, end_x, start_y, end_y, mean_dist, inner_color_range);
+    std::vector<std::vector<cv::Point>> all_curves = get_curves(edgePipeline, pic, edge, start_x, end_x, start_y, end_y, mean_dist, inner_color_range);
 
     if (all_curves.size() == 1)
     {
@@ -1302,7 +904,7 @@ static void rays(cv::Mat *th_edges, int end_x, int end_y, cv::Point *pos, int *r
         }
 }
 
-static void zero_around_region_th_border(cv::Mat *pic, cv::Mat *edges, cv::Mat *th_edges, int th, int edge_to_th, double mean_dist, double area, cv::RotatedRect *pos)
+static void zero_around_region_th_border(EdgePipeline &edgePipeline, cv::Mat *pic, cv::Mat *edges, cv::Mat *th_edges, int th, int edge_to_th, double mean_dist, double area, cv::RotatedRect *pos)
 {
 
     int ret[8];
@@ -1345,7 +947,7 @@ static void zero_around_region_th_border(cv::Mat *pic, cv::Mat *edges, cv::Mat *
         }
 
     //remove_points_with_low_angle(th_edges, start_x, end_x, start_y, end_y);
-    std::vector<std::vector<cv::Point>> all_curves = get_curves(pic, th_edges, start_x, end_x, start_y, end_y, mean_dist, 0);
+    std::vector<std::vector<cv::Point>> all_curves = get_curves(edgePipeline, pic, th_edges, start_x, end_x, start_y, end_y, mean_dist, 0);
 
     //std::cout<<"all curves:"<<all_curves.size()<<std::endl;
 
@@ -1359,11 +961,7 @@ static void zero_around_region_th_border(cv::Mat *pic, cv::Mat *edges, cv::Mat *
         }
         */
 
-        for (int i = 0; i < th_edges->cols; i++)
-            for (int j = 0; j < th_edges->rows; j++)
-            {
-                th_edges->data[(th_edges->cols * (j)) + (i)] = 0;
-            }
+        th_edges->setTo(0);
 
         //draw remaining edges
         for (int i = 0; i < all_curves.size(); i++)
@@ -1486,7 +1084,7 @@ static void optimize_pos(cv::Mat *pic, double area, cv::Point *pos)
     }
 }
 
-static cv::RotatedRect runexcuse(cv::Mat *pic, cv::Mat *pic_th, cv::Mat *th_edges, int good_ellipse_threshold, int max_ellipse_radi)
+static cv::RotatedRect runexcuse(EdgePipeline &edgePipeline, cv::Mat *pic, cv::Mat *pic_th, cv::Mat *th_edges, int good_ellipse_threshold, int max_ellipse_radi)
 {
     //mean under mean
     //mean_under_mean(pic, 5);
@@ -1527,25 +1125,15 @@ static cv::RotatedRect runexcuse(cv::Mat *pic, cv::Mat *pic_th, cv::Mat *th_edge
     threshold_up = ceil(stddev / 2);
     threshold_up--;
 
-    cv::Mat picpic = cv::Mat::zeros(end_y - start_y, end_x - start_x, CV_8U);
-
-    for (int i = 0; i < picpic.cols; i++)
-        for (int j = 0; j < picpic.rows; j++)
-        {
-            picpic.data[(picpic.cols * j) + i] = pic->data[(pic->cols * (start_y + j)) + (start_x + i)];
-        }
+    cv::Rect area(start_x, start_y, end_x - start_x, end_y - start_y);
 
     //cv::Mat detected_edges2;
     //cv::GaussianBlur(picpic,detected_edges2, cv::Size(15,15),sqrt(2.0));
     //Canny( detected_edges2, detected_edges2, stddev*0.4, stddev, 3 );
-    cv::Mat detected_edges2 = canny_impl(&picpic);
+    const cv::Mat &detected_edges2 = edgePipeline.canny((*pic)(area));
 
     cv::Mat detected_edges = cv::Mat::zeros(pic->rows, pic->cols, CV_8U);
-    for (int i = 0; i < detected_edges2.cols; i++)
-        for (int j = 0; j < detected_edges2.rows; j++)
-        {
-            detected_edges.data[(detected_edges.cols * (start_y + j)) + (start_x + i)] = detected_edges2.data[(detected_edges2.cols * j) + i];
-        }
+    detected_edges2.copyTo(detected_edges(area));
 
     remove_points_with_low_angle(&detected_edges, start_x, end_x, start_y, end_y);
 
@@ -1553,7 +1141,7 @@ static cv::RotatedRect runexcuse(cv::Mat *pic, cv::Mat *pic_th, cv::Mat *th_edge
     if (peek_found)
     {
         edges_only_tried = true;
-        ellipse = find_best_edge(pic, &detected_edges, start_x, end_x, start_y, end_y, mean_dist, inner_color_range);
+        ellipse = find_best_edge(edgePipeline, pic, &detected_edges, start_x, end_x, start_y, end_y, mean_dist, inner_color_range);
 
         if (ellipse.center.x <= 0 || ellipse.center.x >= pic->cols || ellipse.center.y <= 0 || ellipse.center.y >= pic->rows)
         {
@@ -1579,7 +1167,7 @@ static cv::RotatedRect runexcuse(cv::Mat *pic, cv::Mat *pic_th, cv::Mat *th_edge
 
     if (pos.x == 0 && pos.y == 0 && !edges_only_tried)
     {
-        ellipse = find_best_edge(pic, &detected_edges, start_x, end_x, start_y, end_y, mean_dist, inner_color_range);
+        ellipse = find_best_edge(edgePipeline, pic, &detected_edges, start_x, end_x, start_y, end_y, mean_dist, inner_color_range);
         peek_found = true;
     }
 
@@ -1592,7 +1180,7 @@ static cv::RotatedRect runexcuse(cv::Mat *pic, cv::Mat *pic_th, cv::Mat *th_edge
         ellipse.angle = 0.0;
         ellipse.size.height = 0.0;
         ellipse.size.width = 0.0;
-        zero_around_region_th_border(pic, &detected_edges, th_edges, threshold_up, edge_to_th, mean_dist, area_edges, &ellipse);
+        zero_around_region_th_border(edgePipeline, pic, &detected_edges, th_edges, threshold_up, edge_to_th, mean_dist, area_edges, &ellipse);
     }
 
     //if(ellipse.size.height>0 && ellipse.size.width>0.0){
@@ -1648,7 +1236,7 @@ Pupil ExCuSe::run(const Mat &frame)
     Mat pic_th = Mat::zeros(target.rows, target.cols, CV_8U);
     Mat th_edges = Mat::zeros(target.rows, target.cols, CV_8U);
 
-    cv::RotatedRect ellipse = runexcuse(&target, &pic_th, &th_edges, good_ellipse_threshold, max_ellipse_radi);
+    cv::RotatedRect ellipse = runexcuse(edgePipeline, &target, &pic_th, &th_edges, good_ellipse_threshold, max_ellipse_radi);
     cv::RotatedRect scaledEllipse(cv::Point2f(ellipse.center.x / scalingRatio, ellipse.center.y / scalingRatio), cv::Size2f(ellipse.size.width / scalingRatio, ellipse.size.height / scalingRatio), ellipse.angle);
 
     return Pupil(scaledEllipse);
@@ -12,6 +12,7 @@
 */
 
 #include "PupilDetectionMethod.h"
+#include "EdgePipeline.h"
 
 class ExCuSe : public PupilDetectionMethod {
 
@@ -43,6 +44,22 @@ public:
         return false;
     }
 
+    bool isStateless() override {
+        return true;
+    }
+
+    void copyParameters(PupilDetectionMethod *other) override {
+        if(auto *excuse = dynamic_cast<ExCuSe*>(other)) {
+            max_ellipse_radi = excuse->max_ellipse_radi;
+            good_ellipse_threshold = excuse->good_ellipse_threshold;
+        }
+    }
+
+private:
+
+    // Edge detection buffers, reused for the next frame
+    EdgePipeline edgePipeline;
+
 };
 
 #endif // EXCUSE_H
@@ -41,6 +41,7 @@
 #include <iostream>
 #include <numeric>
 #include <opencv2/highgui.hpp>
+#include <opencv2/core/hal/intrin.hpp>
 
 //#define SAVE_ILLUSTRATION
 
@@ -105,18 +106,109 @@ void PuRe::init(const Mat &frame) {
 }
 
 
+static const float tg22_5 = 0.4142135623730950488016887242097f;
+static const float tg67_5 = 2.4142135623730950488016887242097f;
+
+// Non maximum suppression of pixel j of a row, returns the edge type 0 (no edge), 128 (weak) or 255 (strong)
+static inline uchar nonMaximumSuppression(const float *p_res, const float *p_res_t, const float *p_res_b, const float *p_x, const float *p_y, int j, float low_th, float high_th) {
+
+	float m = p_res[j];
+	if (m < low_th)
+		return 0;
+
+	float iy = p_y[j];
+	float ix = p_x[j];
+	float y  = abs( (double) iy );
+	float x  = abs( (double) ix );
+
+	uchar val = p_res[j] > high_th ? 255 : 128;
+
+	float tg22_5x = tg22_5 * x;
+	if (y < tg22_5x) {
+		if (m > p_res[j-1] && m >= p_res[j+1])
+			return val;
+	} else {
+		float tg67_5x = tg67_5 * x;
+		if (y > tg67_5x) {
+			if (m > p_res_b[j] && m >= p_res_t[j])
+				return val;
+		} else {
+			if ( (iy<=0) == (ix<=0) ) {
+				if ( m > p_res_t[j-1] && m >= p_res_b[j+1])
+					return val;
+			} else {
+				if ( m > p_res_b[j-1] && m >= p_res_t[j+1])
+					return val;
+			}
+		}
+	}
+	return 0;
+}
+
+#if CV_SIMD
+// Non maximum suppression of a single vector of pixels starting at j, same comparisons as the scalar version
+// All directions are evaluated and the result is selected per lane, thus the output is bit-exact
+static inline v_uint32 nonMaximumSuppressionVector(const float *p_res, const float *p_res_t, const float *p_res_b, const float *p_x, const float *p_y, int j, const v_float32 &low, const v_float32 &high) {
+
+	v_float32 m = vx_load(p_res + j);
+	v_float32 ix = vx_load(p_x + j);
+	v_float32 iy = vx_load(p_y + j);
+	v_float32 x = v_abs(ix);
+	v_float32 y = v_abs(iy);
+	v_float32 zero = vx_setzero_f32();
+
+	v_float32 horizontal = y < vx_setall_f32(tg22_5) * x;
+	v_float32 vertical = y > vx_setall_f32(tg67_5) * x;
+	v_float32 differentSign = (iy <= zero) ^ (ix <= zero);
+
+	v_float32 horizontalMax = (m > vx_load(p_res + j - 1)) & (m >= vx_load(p_res + j + 1));
+	v_float32 verticalMax = (m > vx_load(p_res_b + j)) & (m >= vx_load(p_res_t + j));
+	v_float32 diagonalMax = (m > vx_load(p_res_t + j - 1)) & (m >= vx_load(p_res_b + j + 1));
+	v_float32 antiDiagonalMax = (m > vx_load(p_res_b + j - 1)) & (m >= vx_load(p_res_t + j + 1));
+
+	v_float32 isMax = v_select(horizontal, horizontalMax, v_select(vertical, verticalMax, v_select(differentSign, antiDiagonalMax, diagonalMax)));
+	// Pixels below the low threshold are never edges, m < low_th keeps the behaviour for NaN magnitudes
+	isMax = isMax & ~(m < low);
+
+	v_uint32 val = v_select(v_reinterpret_as_u32(m > high), vx_setall_u32(255), vx_setall_u32(128));
+	return v_reinterpret_as_u32(isMax) & val;
+}
+
+// Vectorized non maximum suppression of a row from pixel 1 on, using OpenCV's universal intrinsics (SSE, AVX2, NEON)
+// Returns the first pixel which was not processed, the remaining pixels up to end are left for the scalar version
+static inline int nonMaximumSuppressionSIMD(const float *p_res, const float *p_res_t, const float *p_res_b, const float *p_x, const float *p_y, uchar *_edgeType, int end, float low_th, float high_th) {
+
+	const int lanes = CV_SIMD_WIDTH / sizeof(float);
+	v_float32 low = vx_setall_f32(low_th);
+	v_float32 high = vx_setall_f32(high_th);
+
+	// The loads of the neighbours reach up to j+4*lanes, which must not exceed the last pixel of the row (end)
+	int j = 1;
+	for(; j + 4*lanes <= end; j += 4*lanes) {
+		v_uint32 a = nonMaximumSuppressionVector(p_res, p_res_t, p_res_b, p_x, p_y, j, low, high);
+		v_uint32 b = nonMaximumSuppressionVector(p_res, p_res_t, p_res_b, p_x, p_y, j + lanes, low, high);
+		v_uint32 c = nonMaximumSuppressionVector(p_res, p_res_t, p_res_b, p_x, p_y, j + 2*lanes, low, high);
+		v_uint32 d = nonMaximumSuppressionVector(p_res, p_res_t, p_res_b, p_x, p_y, j + 3*lanes, low, high);
+		v_store(_edgeType + j, v_pack(v_pack(a, b), v_pack(c, d)));
+	}
+	return j;
+}
+#endif
+
 Mat PuRe::canny(const Mat &in, bool blurImage, bool useL2, int bins, float nonEdgePixelsRatio, float lowHighThresholdRatio) {
 	(void) useL2;
 	/*
 	 * Smoothing and directional derivatives
 	 * TODO: adapt sizes to image size
 	 */
-	Mat blurred;
+	allocateWorkspace(in.size());
+
+	Mat blurred = in;
 	if (blurImage) {
 		Size blurSize(5,5);
+		blurred = workspaceView(blurredBuffer, in.size(), in.type());
 		GaussianBlur(in, blurred, blurSize, 1.5, 1.5, BORDER_REPLICATE);
-	} else
-		blurred = in;
+	}
 
 	Sobel(blurred, dx, dx.type(), 1, 0, 7, 1, BORDER_REPLICATE);
 	Sobel(blurred, dy, dy.type(), 0, 1, 7, 1, BORDER_REPLICATE);
@@ -139,16 +231,15 @@ Mat PuRe::canny(const Mat &in, bool blurImage, bool useL2, int bins, float nonEd
 	float high_th = 0;
 
 	// Normalization
-	magnitude = magnitude / maxMag;
+	magnitude.convertTo(magnitude, CV_32F, 1.0 / maxMag);
 
 	// Histogram
-	int *histogram = new int[bins]();
-	Mat res_idx = (bins-1) * magnitude;
-	res_idx.convertTo(res_idx, CV_16U);
+	histogram.assign(bins, 0);
+	magnitude.convertTo(histogramIndex, CV_16U, bins-1);
 	short *p_res_idx=0;
-	for(int i=0; i<res_idx.rows; i++){
-		p_res_idx = res_idx.ptr<short>(i);
-		for(int j=0; j<res_idx.cols; j++)
+	for(int i=0; i<histogramIndex.rows; i++){
+		p_res_idx = histogramIndex.ptr<short>(i);
+		for(int j=0; j<histogramIndex.cols; j++)
 			histogram[ p_res_idx[j] ]++;
 	}
 
@@ -164,16 +255,17 @@ Mat PuRe::canny(const Mat &in, bool blurImage, bool useL2, int bins, float nonEd
 	}
 	low_th = lowHighThresholdRatio*high_th;
 
-	delete[] histogram;
-
 	/*
 	 *  Non maximum supression
 	 */
-	const float tg22_5 = 0.4142135623730950488016887242097f;
-	const float tg67_5 = 2.4142135623730950488016887242097f;
 	uchar *_edgeType;
 	float *p_res_b, *p_res_t;
-	edgeType.setTo(0);
+	// The workspace keeps the edge types of the previous frame, instead of clearing the whole image beforehand every
+	// inner pixel is written below and only the border, which is never written, is cleared
+	edgeType.row(0).setTo(0);
+	edgeType.row(edgeType.rows-1).setTo(0);
+	edgeType.col(0).setTo(0);
+	edgeType.col(edgeType.cols-1).setTo(0);
 	for(int i=1; i<magnitude.rows-1; i++) {
 		_edgeType = edgeType.ptr<uchar>(i);
 
@@ -184,39 +276,12 @@ Mat PuRe::canny(const Mat &in, bool blurImage, bool useL2, int bins, float nonEd
 		p_x=dx.ptr<float>(i);
 		p_y=dy.ptr<float>(i);
 
-		for(int j=1; j<magnitude.cols-1; j++){
-
-			float m = p_res[j];
-			if (m < low_th)
-				continue;
-
-			float iy = p_y[j];
-			float ix = p_x[j];
-			float y  = abs( (double) iy );
-			float x  = abs( (double) ix );
-
-			uchar val = p_res[j] > high_th ? 255 : 128;
-
-			float tg22_5x = tg22_5 * x;
-			if (y < tg22_5x) {
-				if (m > p_res[j-1] && m >= p_res[j+1])
-					_edgeType[j] = val;
-			} else {
-				float tg67_5x = tg67_5 * x;
-				if (y > tg67_5x) {
-					if (m > p_res_b[j] && m >= p_res_t[j])
-						_edgeType[j] = val;
-				} else {
-					if ( (iy<=0) == (ix<=0) ) {
-						if ( m > p_res_t[j-1] && m >= p_res_b[j+1])
-							_edgeType[j] = val;
-					} else {
-						if ( m > p_res_b[j-1] && m >= p_res_t[j+1])
-							_edgeType[j] = val;
-					}
-				}
-			}
-		}
+		int j=1;
+#if CV_SIMD
+		j = nonMaximumSuppressionSIMD(p_res, p_res_t, p_res_b, p_x, p_y, _edgeType, magnitude.cols-1, low_th, high_th);
+#endif
+		for(; j<magnitude.cols-1; j++)
+			_edgeType[j] = nonMaximumSuppression(p_res, p_res_t, p_res_b, p_x, p_y, j, low_th, high_th);
 	}
 
 	/*
@@ -225,37 +290,49 @@ Mat PuRe::canny(const Mat &in, bool blurImage, bool useL2, int bins, float nonEd
 	int pic_x=edgeType.cols;
 	int pic_y=edgeType.rows;
 	int area = pic_x*pic_y;
-	int lines_idx=0;
 	int idx=0;
 
-	vector<int> lines;
+	const uchar *p_type = edgeType.data;
+	uchar *p_edge = edge.data;
+
+	// Flat stack of the pixels to visit, each pixel is pushed at most once as it is marked before
+	// The visiting order does not change the result, all weak pixels connected to a strong pixel are marked
+	if (hysteresisStack.size() < static_cast<size_t>(area))
+		hysteresisStack.resize(area);
+	int *stack = hysteresisStack.data();
+
 	edge.setTo(0);
 	for(int i=1;i<pic_y-1;i++){
 		for(int j=1;j<pic_x-1;j++){
 
-			if( edgeType.data[idx+j] != 255 || edge.data[idx+j] != 0 )
+#if CV_SIMD
+			// Skip whole blocks without strong edge pixels
+			while(j+CV_SIMD_WIDTH <= pic_x-1 && !v_check_any(vx_load(p_type+idx+j) == vx_setall_u8(255)))
+				j += CV_SIMD_WIDTH;
+			if(j >= pic_x-1)
+				break;
+#endif
+
+			if( p_type[idx+j] != 255 || p_edge[idx+j] != 0 )
 				continue;
 
-			edge.data[idx+j] = 255;
-			lines_idx = 1;
-			lines.clear();
-			lines.push_back(idx+j);
-			int akt_idx = 0;
+			p_edge[idx+j] = 255;
+			int top = 0;
+			stack[top++] = idx+j;
 
-			while(akt_idx<lines_idx){
-				int akt_pos=lines[akt_idx];
-				akt_idx++;
+			while(top > 0){
+				int akt_pos=stack[--top];
 
 				if( akt_pos-pic_x-1 < 0 || akt_pos+pic_x+1 >= area )
 					continue;
 
 				for(int k1=-1;k1<2;k1++)
 					for(int k2=-1;k2<2;k2++){
-						if(edge.data[(akt_pos+(k1*pic_x))+k2]!=0 || edgeType.data[(akt_pos+(k1*pic_x))+k2]==0)
+						int pos = (akt_pos+(k1*pic_x))+k2;
+						if(p_edge[pos]!=0 || p_type[pos]==0)
 							continue;
-						edge.data[(akt_pos+(k1*pic_x))+k2] = 255;
-						lines.push_back((akt_pos+(k1*pic_x))+k2);
-						lines_idx++;
+						p_edge[pos] = 255;
+						stack[top++] = pos;
 					}
 			}
 		}
@@ -265,6 +342,26 @@ Mat PuRe::canny(const Mat &in, bool blurImage, bool useL2, int bins, float nonEd
 	return edge;
 }
 
+// Sets the canny matrices to the given size using the workspace buffers of this instance
+// The buffers are only reallocated if they are too small, thus changing sizes (i.e. ROIs) do not allocate each frame
+void PuRe::allocateWorkspace(const cv::Size &size) {
+	dx = workspaceView(dxBuffer, size, CV_32F);
+	dy = workspaceView(dyBuffer, size, CV_32F);
+	magnitude = workspaceView(magnitudeBuffer, size, CV_32F);
+	edgeType = workspaceView(edgeTypeBuffer, size, CV_8U);
+	edge = workspaceView(edgeBuffer, size, CV_8U);
+	histogramIndex = workspaceView(histogramIndexBuffer, size, CV_16U);
+}
+
+// Continuous matrix header of the given size and type on the memory of the buffer, the buffer grows if needed
+// CAUTION: the returned matrix does not own its memory, it is only valid until the buffer is reallocated
+Mat PuRe::workspaceView(Mat &buffer, const Size &size, int type) {
+	size_t bytes = static_cast<size_t>(size.area()) * CV_ELEM_SIZE(type);
+	if (buffer.empty() || buffer.total() < bytes)
+		buffer.create(1, static_cast<int>(bytes), CV_8U);
+	return Mat(size, type, buffer.data);
+}
+
 void PuRe::filterEdges(cv::Mat &edges) {
 	// TODO: there is room for improvement here; however, it is prone to small
 	// mistakes; will be done when we have time
@@ -489,6 +586,47 @@ void PuRe::filterEdges(cv::Mat &edges) {
 		}
 }
 
+// Removes curves starting at a pixel of another curve, curves are visited from the last to the first
+// The order of the remaining curves is kept
+void PuRe::removeDuplicates(std::vector<std::vector<cv::Point> > &curves, const cv::Size &size) {
+
+	size_t area = static_cast<size_t>(size.area());
+	if (visitedMask.size() < area) {
+		visitedMask.assign(area, 0);
+		visitedGeneration = 0;
+	}
+
+	// Pixels marked in previous calls hold older generations, only on overflow the mask needs to be cleared
+	visitedGeneration++;
+	if (visitedGeneration == 0) {
+		std::fill(visitedMask.begin(), visitedMask.end(), 0);
+		visitedGeneration = 1;
+	}
+
+	uint16_t *visited = visitedMask.data();
+	keepCurve.assign(curves.size(), 0);
+
+	for (size_t i=curves.size(); i-->0;) {
+		if (visited[pointHash(curves[i][0], size.width)] == visitedGeneration)
+			continue;
+
+		keepCurve[i] = 1;
+		for (const cv::Point &p: curves[i])
+			visited[pointHash(p, size.width)] = visitedGeneration;
+	}
+
+	// Stable compaction of the kept curves
+	size_t kept = 0;
+	for (size_t i=0; i<curves.size(); i++) {
+		if (!keepCurve[i])
+			continue;
+		if (kept != i)
+			curves[kept] = std::move(curves[i]);
+		kept++;
+	}
+	curves.resize(kept);
+}
+
 void PuRe::findPupilEdgeCandidates(const Mat &intensityImage, Mat &edge, vector<PupilCandidate> &candidates) {
 	/* Find all lines
 	 * Small note here: using anchor points tends to result in better ellipse fitting later!
@@ -498,7 +636,7 @@ void PuRe::findPupilEdgeCandidates(const Mat &intensityImage, Mat &edge, vector<
 	vector<vector<Point> > curves;
 	findContours( edge, curves, hierarchy, RETR_LIST, CHAIN_APPROX_TC89_KCOS );
 
-	removeDuplicates(curves, edge.cols);
+	removeDuplicates(curves, edge.size());
 
 	// Create valid candidates
 	for (size_t i=curves.size(); i-->0;) {
@@ -508,41 +646,124 @@ void PuRe::findPupilEdgeCandidates(const Mat &intensityImage, Mat &edge, vector<
 	}
 }
 
+// Cell size in pixels of the working image for the spatial index of the candidate combination
+static const int combinationGridCellSize = 16;
+
+// Builds a uniform grid over the image, each cell lists the candidates whose combination region overlaps the cell
+// Cells are stored flat: the candidates of cell c are gridCandidates[gridStart[c]] to gridCandidates[gridStart[c+1]-1]
+void PuRe::buildCombinationGrid(const cv::Size &size, const std::vector<PupilCandidate> &candidates) {
+
+	gridCols = max<int>(1, (size.width + combinationGridCellSize - 1) / combinationGridCellSize);
+	gridRows = max<int>(1, (size.height + combinationGridCellSize - 1) / combinationGridCellSize);
+
+	gridStart.assign(gridCols*gridRows + 1, 0);
+
+	// Count, prefix sum and fill, regions outside of the image are clamped to the border cells
+	for (int pass=0; pass<2; pass++) {
+		if (pass == 1) {
+			for (size_t c=1; c<gridStart.size(); c++)
+				gridStart[c] += gridStart[c-1];
+			gridCandidates.resize(gridStart.back());
+			gridFill.assign(gridStart.begin(), gridStart.end()-1);
+		}
+
+		for (size_t i=0; i<candidates.size(); i++) {
+			Rect cells = combinationCells(candidates[i].combinationRegion);
+			for (int y=cells.y; y<cells.y+cells.height; y++)
+				for (int x=cells.x; x<cells.x+cells.width; x++) {
+					if (pass == 0)
+						gridStart[y*gridCols + x + 1]++;
+					else
+						gridCandidates[gridFill[y*gridCols + x]++] = static_cast<int>(i);
+				}
+		}
+	}
+}
+
+// Range of grid cells covered by the given region, clamped to the grid
+cv::Rect PuRe::combinationCells(const cv::Rect &region) {
+	int x0 = min(max(region.x / combinationGridCellSize, 0), gridCols-1);
+	int y0 = min(max(region.y / combinationGridCellSize, 0), gridRows-1);
+	int x1 = min(max((region.x + region.width - 1) / combinationGridCellSize, 0), gridCols-1);
+	int y1 = min(max((region.y + region.height - 1) / combinationGridCellSize, 0), gridRows-1);
+	return Rect(x0, y0, x1-x0+1, y1-y0+1);
+}
+
 void PuRe::combineEdgeCandidates(const cv::Mat &intensityImage, cv::Mat &edge, std::vector<PupilCandidate> &candidates) {
 	(void) edge;
 	if (candidates.size() <= 1)
 		return;
+
+	// Only candidates sharing a grid cell can have intersecting combination regions, instead of testing all pairs
+	// the grid cells of each candidate are searched for partners with a higher index, which are then visited in the
+	// original pair order, thus the merged candidates are identical to the exhaustive search
+	buildCombinationGrid(intensityImage.size(), candidates);
+	candidateStamp.assign(candidates.size(), -1);
+
 	vector<PupilCandidate> mergedCandidates;
-	for (auto pc=candidates.begin(); pc!=candidates.end(); pc++) {
-		for (auto pc2=pc+1; pc2!=candidates.end(); pc2++) {
+	vector<int> partners;
+	vector<Point> mergedPoints;
+	for (size_t i=0; i<candidates.size(); i++) {
+		const PupilCandidate &pc = candidates[i];
+
+		partners.clear();
+		Rect cells = combinationCells(pc.combinationRegion);
+		for (int y=cells.y; y<cells.y+cells.height; y++)
+			for (int x=cells.x; x<cells.x+cells.width; x++) {
+				int cell = y*gridCols + x;
+				for (int k=gridStart[cell]; k<gridStart[cell+1]; k++) {
+					int j = gridCandidates[k];
+					if (j <= static_cast<int>(i) || candidateStamp[j] == static_cast<int>(i))
+						continue;
+					candidateStamp[j] = static_cast<int>(i);
+					partners.push_back(j);
+				}
+			}
+		sort(partners.begin(), partners.end());
+
+		for (int j: partners) {
+			const PupilCandidate &pc2 = candidates[j];
 
-			Rect intersection = pc->combinationRegion & pc2->combinationRegion;
+			Rect intersection = pc.combinationRegion & pc2.combinationRegion;
 			if (intersection.area() < 1)
 				continue; // no intersection
 //#define DBG_EDGE_COMBINATION
 #ifdef DBG_EDGE_COMBINATION
 			Mat tmp;
 			cvtColor(intensityImage, tmp, CV_GRAY2BGR);
-			rectangle(tmp, pc->combinationRegion, pc->color);
-			for (unsigned int i=0; i<pc->points.size(); i++)
-				cv::circle(tmp, pc->points[i], 1, pc->color, -1);
-			rectangle(tmp, pc2->combinationRegion, pc2->color);
-			for (unsigned int i=0; i<pc2->points.size(); i++)
-				cv::circle(tmp, pc2->points[i], 1, pc2->color, -1);
+			rectangle(tmp, pc.combinationRegion, pc.color);
+			for (unsigned int i=0; i<pc.points.size(); i++)
+				cv::circle(tmp, pc.points[i], 1, pc.color, -1);
+			rectangle(tmp, pc2.combinationRegion, pc2.color);
+			for (unsigned int i=0; i<pc2.points.size(); i++)
+				cv::circle(tmp, pc2.points[i], 1, pc2.color, -1);
 			imshow("Combined edges", tmp);
 			imwrite("combined.png", tmp);
 			//waitKey(0);
 #endif
 
-			if (intersection.area() >= min<int>(pc->combinationRegion.area(),pc2->combinationRegion.area()))
+			if (intersection.area() >= min<int>(pc.combinationRegion.area(),pc2.combinationRegion.area()))
+				continue;
+
+			// Early rejection on the bounding box of the merged points, before any points are copied
+			// The largest gap between the points is at least the box extent and at most the box diagonal,
+			// these bounds reject exactly the merges isValid would reject by their gap
+			Rect mergedBox = pc.pointsBoundingBox | pc2.pointsBoundingBox;
+			int extentX = mergedBox.width - 1;
+			int extentY = mergedBox.height - 1;
+			if (max(extentX, extentY) >= maxPupilDiameterPx)
+				continue;
+			if (sqrt(static_cast<double>(extentX*extentX + extentY*extentY)) + 1e-3 < minPupilDiameterPx)
 				continue;
 
-			vector<Point> mergedPoints = pc->points;
-			mergedPoints.insert(mergedPoints.end(), pc2->points.begin(), pc2->points.end());
+			mergedPoints.clear();
+			mergedPoints.reserve(pc.points.size() + pc2.points.size());
+			mergedPoints.insert(mergedPoints.end(), pc.points.begin(), pc.points.end());
+			mergedPoints.insert(mergedPoints.end(), pc2.points.begin(), pc2.points.end());
 			PupilCandidate candidate( mergedPoints );
 			if (!candidate.isValid(intensityImage, minPupilDiameterPx, maxPupilDiameterPx, outlineBias))
 				continue;
-			if (candidate.outlineContrast < pc->outlineContrast || candidate.outlineContrast < pc2->outlineContrast)
+			if (candidate.outlineContrast < pc.outlineContrast || candidate.outlineContrast < pc2.outlineContrast)
 				continue;
 			mergedCandidates.push_back( candidate );
 		}
@@ -668,7 +889,6 @@ void PuRe::run(const Mat &frame, Pupil &pupil) {
 	init(frame);
 
 	// Downscaling
-	Mat downscaled = frame;
 	resize(frame, downscaled, Size(), scalingRatio, scalingRatio, INTER_LINEAR);
 	normalize(downscaled, input, 0, 255, NORM_MINMAX, CV_8U);
 
@@ -678,13 +898,6 @@ void PuRe::run(const Mat &frame, Pupil &pupil) {
 	// Estimate parameters based on the working size
 	estimateParameters(workingSize.height, workingSize.width);
 
-	// Preallocate stuff for edge detection
-	dx = Mat::zeros(workingSize, CV_32F);
-	dy = Mat::zeros(workingSize, CV_32F);
-	magnitude = Mat::zeros(workingSize, CV_32F);
-	edgeType = Mat::zeros(workingSize, CV_8U);
-	edge = Mat::zeros(workingSize, CV_8U);
-
 	//cvtColor(input, dbg, CV_GRAY2BGR);
 	//circle(dbg, Point(0.5*dbg.cols,0.5*dbg.rows), 0.5*minPupilDiameterPx, Scalar(0,0,0), 2);
 	//circle(dbg, Point(0.5*dbg.cols,0.5*dbg.rows), 0.5*maxPupilDiameterPx, Scalar(0,0,0), 3);
@@ -706,7 +919,6 @@ void PuRe::run(const cv::Mat &frame, Pupil &pupil, std::vector<cv::Point2f> &inl
     init(frame);
 
     // Downscaling
-    Mat downscaled = frame;
     resize(frame, downscaled, Size(), scalingRatio, scalingRatio, INTER_LINEAR);
     normalize(downscaled, input, 0, 255, NORM_MINMAX, CV_8U);
 
@@ -716,13 +928,6 @@ void PuRe::run(const cv::Mat &frame, Pupil &pupil, std::vector<cv::Point2f> &inl
     // Estimate parameters based on the working size
     estimateParameters(workingSize.height, workingSize.width);
 
-    // Preallocate stuff for edge detection
-    dx = Mat::zeros(workingSize, CV_32F);
-    dy = Mat::zeros(workingSize, CV_32F);
-    magnitude = Mat::zeros(workingSize, CV_32F);
-    edgeType = Mat::zeros(workingSize, CV_8U);
-    edge = Mat::zeros(workingSize, CV_8U);
-
     //cvtColor(input, dbg, CV_GRAY2BGR);
     //circle(dbg, Point(0.5*dbg.cols,0.5*dbg.rows), 0.5*minPupilDiameterPx, Scalar(0,0,0), 2);
     //circle(dbg, Point(0.5*dbg.cols,0.5*dbg.rows), 0.5*maxPupilDiameterPx, Scalar(0,0,0), 3);
@@ -753,7 +958,6 @@ void PuRe::run(const cv::Mat &frame, const cv::Rect &roi, Pupil &pupil, const fl
 		maxPupilDiameterPx = scalingRatio*userMaxPupilDiameterPx;
 
 	// Downscaling
-	Mat downscaled;
 	resize(frame(roi), downscaled, Size(), scalingRatio, scalingRatio, INTER_LINEAR);
 	normalize(downscaled, input, 0, 255, NORM_MINMAX, CV_8U);
 
@@ -762,13 +966,6 @@ void PuRe::run(const cv::Mat &frame, const cv::Rect &roi, Pupil &pupil, const fl
 	workingSize.width = input.cols;
 	workingSize.height = input.rows;
 
-	// Preallocate stuff for edge detection
-	dx = Mat::zeros(workingSize, CV_32F);
-	dy = Mat::zeros(workingSize, CV_32F);
-	magnitude = Mat::zeros(workingSize, CV_32F);
-	edgeType = Mat::zeros(workingSize, CV_8U);
-	edge = Mat::zeros(workingSize, CV_8U);
-
 	//cvtColor(input, dbg, CV_GRAY2BGR);
 	//circle(dbg, Point(0.5*dbg.cols,0.5*dbg.rows), 0.5*minPupilDiameterPx, Scalar(0,0,0), 2);
 	//circle(dbg, Point(0.5*dbg.cols,0.5*dbg.rows), 0.5*maxPupilDiameterPx, Scalar(0,0,0), 3);
@@ -950,7 +1147,8 @@ inline bool PupilCandidate::fastValidityCheck(const int &maxPupilDiameterPx) {
 	if (majorAxis > maxPupilDiameterPx)
 		return false;
 
-	combinationRegion = boundingRect(points);
+	pointsBoundingBox = boundingRect(points);
+	combinationRegion = pointsBoundingBox;
 	combinationRegion.width = max<int>(combinationRegion.width, combinationRegion.height);
 	combinationRegion.height = combinationRegion.width;
 
@@ -959,132 +1157,12 @@ inline bool PupilCandidate::fastValidityCheck(const int &maxPupilDiameterPx) {
 
 inline bool PupilCandidate::validateOutlineContrast(const Mat &intensityImage, const int &bias) {
 	int delta = 0.15*minorAxis;
-	cv::Point c = outline.center;
-//#define DBG_OUTLINE_CONTRAST
-#ifdef DBG_OUTLINE_CONTRAST
-	cv::Mat tmp;
-	cv::cvtColor(intensityImage, tmp, CV_GRAY2BGR);
-	cv::ellipse(tmp, outline, cv::Scalar(0,255,255));
-	cv::Scalar lineColor;
-#endif
-	int evaluated = 0;
-	int validCount = 0;
 
-	vector<Point> outlinePoints = ellipse2Points(outline, 10);
-	for (auto p=outlinePoints.begin(); p!=outlinePoints.end(); p++) {
-		int dx = p->x - c.x;
-		int dy = p->y - c.y;
-
-		float a = 0;
-		if (dx != 0)
-			a = dy / (float) dx;
-		float b = c.y - a*c.x;
-
-		if (a == 0)
-			continue;
-
-		if ( abs(dx) > abs(dy) ) {
-			int sx = p->x - delta;
-			int ex = p->x + delta;
-			int sy = std::roundf(a*sx + b);
-			int ey = std::roundf(a*ex + b);
-			cv::Point start = { sx, sy };
-			cv::Point end = { ex, ey };
-			evaluated++;
-
-			if (!boundaries.contains(start) || !boundaries.contains(end) )
-				continue;
-
-			float m1, m2, count;
-
-			m1 = count = 0;
-			for (int x=sx; x<p->x; x++)
-				m1 += intensityImage.ptr<uchar>( (int) std::roundf(a*x+b) )[x];
-			m1 = std::roundf( m1 / delta );
-
-			m2 = count = 0;
-			for (int x=p->x+1; x<=ex; x++) {
-				m2 += intensityImage.ptr<uchar>( (int) std::roundf(a*x+b) )[x];
-			}
-			m2 = std::roundf( m2 / delta );
-
-#ifdef DBG_OUTLINE_CONTRAST
-			lineColor = cv::Scalar(0,0,255);
-#endif
-			if (p->x < c.x) {// leftwise point
-				if (m1 > m2+bias) {
-					validCount ++;
-#ifdef DBG_OUTLINE_CONTRAST
-					lineColor = cv::Scalar(0,255,0);
-#endif
-				}
-			} else {// rightwise point
-				if (m2 > m1+bias) {
-					validCount++;
-#ifdef DBG_OUTLINE_CONTRAST
-					lineColor = cv::Scalar(0,255,0);
-#endif
-				}
-			}
-
-#ifdef DBG_OUTLINE_CONTRAST
-			cv::line(tmp, start, end, lineColor);
-#endif
-		} else {
-			int sy = p->y - delta;
-			int ey = p->y + delta;
-			int sx = std::roundf((sy - b)/a);
-			int ex = std::roundf((ey - b)/a);
-			cv::Point start = { sx, sy };
-			cv::Point end = { ex, ey };
-
-			evaluated++;
-			if (!boundaries.contains(start) || !boundaries.contains(end) )
-				continue;
-
-			float m1, m2, count;
-
-			m1 = count = 0;
-			for (int y=sy; y<p->y; y++)
-				m1 += intensityImage.ptr<uchar>(y)[ (int) std::roundf((y-b)/a) ];
-			m1 = std::roundf( m1 / delta );
-
-			m2 = count = 0;
-			for (int y=p->y+1; y<=ey; y++)
-				m2 += intensityImage.ptr<uchar>(y)[ (int) std::roundf((y-b)/a) ];
-			m2 = std::roundf( m2 / delta );
-
-#ifdef DBG_OUTLINE_CONTRAST
-			lineColor = cv::Scalar(0,0,255);
-#endif
-			if (p->y < c.y) {// upperwise point
-				if (m1 > m2+bias) {
-					validCount++;
-#ifdef DBG_OUTLINE_CONTRAST
-					lineColor = cv::Scalar(0,255,0);
-#endif
-				}
-			} else {// bottomwise point
-				if (m2 > m1+bias) {
-					validCount++;
-#ifdef DBG_OUTLINE_CONTRAST
-					lineColor = cv::Scalar(0,255,0);
-#endif
-				}
-			}
-
-#ifdef DBG_OUTLINE_CONTRAST
-			cv::line(tmp, start, end, lineColor);
-#endif
-		}
-	}
-	if (evaluated == 0)
+	// Same measure as the generic outline confidence, see PupilDetectionMethod::outlineContrast
+	float contrast = PupilDetectionMethod::outlineContrast(intensityImage, outline, delta, bias);
+	if (contrast < 0)
 		return false;
-	outlineContrast = validCount / (float) evaluated;
-#ifdef DBG_OUTLINE_CONTRAST
-	cv::imshow("Outline Contrast", tmp);
-	cv::waitKey(0);
-#endif
+	outlineContrast = contrast;
 
 	return true;
 }
@@ -44,6 +44,7 @@
 #include <opencv2/imgproc.hpp>
 #include <map>
 #include <bitset>
+#include <cstdint>
 #include "PupilDetectionMethod.h"
 
 class PupilCandidate {
@@ -206,14 +207,35 @@ public:
         return true;
     }
 
+    bool isStateless() override {
+        return true;
+    }
+
+    void copyParameters(PupilDetectionMethod *other) override {
+        if(auto *pure = dynamic_cast<PuRe*>(other)) {
+            meanCanthiDistanceMM = pure->meanCanthiDistanceMM;
+            maxPupilDiameterMM = pure->maxPupilDiameterMM;
+            minPupilDiameterMM = pure->minPupilDiameterMM;
+            baseSize = pure->baseSize;
+        }
+    }
+
 protected:
 
     cv::Size expectedFrameSize;
     int outlineBias;
 
-    // Canny
+    // Canny, views of the workspace buffers in the current working size
 	cv::Mat dx, dy, magnitude;
     cv::Mat edgeType, edge;
+    cv::Mat histogramIndex;
+
+    // Workspace reused between frames to avoid the allocation of the canny buffers for each frame
+    cv::Mat dxBuffer, dyBuffer, magnitudeBuffer;
+    cv::Mat edgeTypeBuffer, edgeBuffer, histogramIndexBuffer;
+    cv::Mat downscaled, blurredBuffer;
+    std::vector<int> histogram;
+    std::vector<int> hysteresisStack;
 
     cv::Mat input;
     cv::Mat dbg;
@@ -236,6 +258,9 @@ protected:
 
 	cv::Mat canny(const cv::Mat &in, bool blur=true, bool useL2=true, int bins=64, float nonEdgePixelsRatio=0.7f, float lowHighThresholdRatio=0.4f);
 
+	void allocateWorkspace(const cv::Size &size);
+	static cv::Mat workspaceView(cv::Mat &buffer, const cv::Size &size, int type);
+
     // Edge filtering
 	void filterEdges(cv::Mat &edges);
 
@@ -244,19 +269,22 @@ protected:
 	    return p.y*cols+p.x;
 	}
 
-	void removeDuplicates(std::vector<std::vector<cv::Point> > &curves, const int& cols) {
-		std::map<int,uchar> contourMap;
-		for (size_t i=curves.size(); i-->0;) {
-			if (contourMap.count(pointHash(curves[i][0],cols)) > 0)
-				curves.erase(curves.begin()+i);
-			else {
-				for (int j=0; j<curves[i].size(); j++)
-					contourMap[pointHash(curves[i][j],cols)] = 1;
-			}
-		}
-	}
+	// Visited pixels of removeDuplicates, a pixel is visited if it holds the current generation, thus no clearing per frame
+	std::vector<uint16_t> visitedMask;
+	uint16_t visitedGeneration = 0;
+	std::vector<uchar> keepCurve;
+
+	void removeDuplicates(std::vector<std::vector<cv::Point> > &curves, const cv::Size &size);
 
     void findPupilEdgeCandidates(const cv::Mat &intensityImage, cv::Mat &edge, std::vector<PupilCandidate> &candidates);
+
+    // Spatial index of the candidate combination regions
+    int gridCols = 1, gridRows = 1;
+    std::vector<int> gridStart, gridFill, gridCandidates;
+    std::vector<int> candidateStamp;
+
+    void buildCombinationGrid(const cv::Size &size, const std::vector<PupilCandidate> &candidates);
+    cv::Rect combinationCells(const cv::Rect &region);
     void combineEdgeCandidates(const cv::Mat &intensityImage, cv::Mat &edge, std::vector<PupilCandidate> &candidates);
 	void searchInnerCandidates(std::vector<PupilCandidate> &candidates, PupilCandidate &candidate);
 
@@ -141,13 +141,8 @@ void PuReST::runTracking(const cv::Mat &frame, Pupil &pupil, const float &userMi
      */
     cv::resize(frame(trackingRect), input, cv::Size(), localScalingRatio, localScalingRatio, cv::INTER_LINEAR);
 
-    // Setup for Canny
+    // Setup for Canny, the canny buffers are taken from the workspace
     workingSize = {input.cols, input.rows};
-    dx = cv::Mat::zeros(workingSize.height, workingSize.width, CV_32F);
-    dy = cv::Mat::zeros(workingSize.height, workingSize.width, CV_32F);
-    magnitude = cv::Mat::zeros(workingSize.height, workingSize.width, CV_32F);
-    edgeType = cv::Mat::zeros(workingSize.height, workingSize.width, CV_8U);
-    edge = cv::Mat::zeros(workingSize.height, workingSize.width, CV_8U);
 
     // Pupil in our coordinate system
     Pupil basePupil = previousPupil;
@@ -401,7 +396,7 @@ bool PuReST::greedySearch(const cv::Mat &greedyDetectorEdges, const Pupil &baseP
         }
     }
 
-    removeDuplicates(curves, greedyDetectorEdges.cols);
+    removeDuplicates(curves, greedyDetectorEdges.size());
 
     std::vector<GreedyCandidate> candidates;
     for (int i = 0; i < curves.size(); i++)
@@ -108,6 +108,15 @@ public:
         return false;
     }
 
+    // Tracks the pupil of the previous frame
+    bool isStateless() override {
+        return false;
+    }
+
+    bool hasOwnTracking() override {
+        return true;
+    }
+
 private:
 
     cv::Mat dilateKernel;
@@ -39,19 +39,19 @@ class Pupil : public cv::RotatedRect {
 public:
 
     Pupil(const RotatedRect &outline, const float &confidence) :
-            RotatedRect(outline), confidence(confidence), outline_confidence(NO_CONFIDENCE), eyelid(0), physicalDiameter(-1.0), undistortedDiameter(-1.0), algorithmName("") {
+            RotatedRect(outline), confidence(confidence), outline_confidence(NO_CONFIDENCE), eyelid(0), physicalDiameter(-1.0), undistortedDiameter(-1.0), algorithmName(""), frameNumber(0) {
     }
 
     Pupil(const RotatedRect &outline, const float &confidence, const float &outline_confidence, const float &eyelid, const float &physicalDiameter, const float &undistortedDiameter) :
-            RotatedRect(outline), confidence(confidence), outline_confidence(outline_confidence), eyelid(eyelid), physicalDiameter(physicalDiameter), undistortedDiameter(undistortedDiameter), algorithmName("") {
+            RotatedRect(outline), confidence(confidence), outline_confidence(outline_confidence), eyelid(eyelid), physicalDiameter(physicalDiameter), undistortedDiameter(undistortedDiameter), algorithmName(""), frameNumber(0) {
     }
 
     Pupil(const Pupil &other) :
-            RotatedRect(other), confidence(other.confidence), outline_confidence(other.outline_confidence), eyelid(other.eyelid), physicalDiameter(other.physicalDiameter), undistortedDiameter(other.undistortedDiameter), algorithmName(other.algorithmName) {
+            RotatedRect(other), confidence(other.confidence), outline_confidence(other.outline_confidence), eyelid(other.eyelid), physicalDiameter(other.physicalDiameter), undistortedDiameter(other.undistortedDiameter), algorithmName(other.algorithmName), frameNumber(other.frameNumber) {
     }
 
     Pupil(const RotatedRect &outline) :
-            RotatedRect(outline), confidence(NO_CONFIDENCE), outline_confidence(NO_CONFIDENCE), eyelid(0), physicalDiameter(-1.0), undistortedDiameter(-1.0), algorithmName("") {
+            RotatedRect(outline), confidence(NO_CONFIDENCE), outline_confidence(NO_CONFIDENCE), eyelid(0), physicalDiameter(-1.0), undistortedDiameter(-1.0), algorithmName(""), frameNumber(0) {
     }
 
     Pupil() {
@@ -71,6 +71,8 @@ public:
 
     std::string algorithmName;
 
+    uint64_t frameNumber;
+
     void clear() {
         angle = -1.0;
         center = { -1.0, -1.0 };
@@ -81,6 +83,7 @@ public:
         physicalDiameter=-1.0;
         undistortedDiameter=-1.0;
         algorithmName="";
+        frameNumber=0;
     }
 
     void resize(const float &xf, const float &yf) {
@@ -24,9 +24,14 @@ OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 */
 
 #include <opencv2/imgproc.hpp>
+#include <algorithm>
 #include <deque>
 #include <bitset>
 #include "PupilDetectionMethod.h"
+#include "CoarsePupilLocator.h"
+
+// Number of best Haar responses located first for the coarse pupil region, more are only located if these are not sufficient
+static const int coarseCandidateCount = 32;
 
 cv::Rect PupilDetectionMethod::coarsePupilDetection(const cv::Mat &frame, const float &minCoverage, const int &workingWidth, const int &workingHeight)
 {
@@ -49,110 +54,56 @@ cv::Rect PupilDetectionMethod::coarsePupilDetection(const cv::Mat &frame, const
     int max_r = (int)(0.5 * 0.29 * d);
     int r_step = (int)cv::max<float>(0.2f * (max_r + min_r), 1.0f);
 
-    // TODO: padding so we consider the borders as well!
-
-    /* Haar-like feature suggested by Swirski. For details, see
-     * Świrski, Lech, Andreas Bulling, and Neil Dodgson.
-     * "Robust real-time pupil tracking in highly off-axis images."
-     * Proceedings of the Symposium on Eye Tracking Research and Applications. ACM, 2012.
-     *
-     * However, we collect a per-pixel maxima instead of the global one
-    */
-    cv::Mat itg;
-    integral(downscaled, itg, CV_32S);
-    cv::Mat res = cv::Mat::zeros(downscaled.rows, downscaled.cols, CV_32F);
-    float best_response = std::numeric_limits<float>::min();
-
-    std::deque<std::pair<cv::Rect, float>> candidates;
-
-    for (int r = min_r; r <= max_r; r += r_step)
-    {
-        int step = 3 * r;
-
-        cv::Point ia, ib, ic, id;
-        cv::Point oa, ob, oc, od;
-
-        int inner_count = (2 * r) * (2 * r);
-        int outer_count = (2 * step) * (2 * step) - inner_count;
-
-        float inner_norm = 1.0f / (255 * inner_count);
-        float outer_norm = 1.0f / (255 * outer_count);
-
-        for (int y = step; y < downscaled.rows - step; y += ystep)
-        {
-            oa.y = y - step;
-            ob.y = y - step;
-            oc.y = y + step;
-            od.y = y + step;
-            ia.y = y - r;
-            ib.y = y - r;
-            ic.y = y + r;
-            id.y = y + r;
-            for (int x = step; x < downscaled.cols - step; x += xstep)
-            {
-                oa.x = x - step;
-                ob.x = x + step;
-                oc.x = x + step;
-                od.x = x - step;
-                ia.x = x - r;
-                ib.x = x + r;
-                ic.x = x + r;
-                id.x = x - r;
-                int inner = itg.ptr<int>(ic.y)[ic.x] + itg.ptr<int>(ia.y)[ia.x] -
-                            itg.ptr<int>(ib.y)[ib.x] - itg.ptr<int>(id.y)[id.x];
-                int outer = itg.ptr<int>(oc.y)[oc.x] + itg.ptr<int>(oa.y)[oa.x] -
-                            itg.ptr<int>(ob.y)[ob.x] - itg.ptr<int>(od.y)[od.x] - inner;
-
-                float inner_mean = inner_norm * inner;
-                float outer_mean = outer_norm * outer;
-                float response = (outer_mean - inner_mean);
-
-                if (response < 0.5 * best_response)
-                    continue;
-
-                if (response < 0.5 * best_response)
-                    continue;
-
-                if (response > best_response)
-                    best_response = response;
-
-                if (response > res.ptr<float>(y)[x])
-                {
-                    res.ptr<float>(y)[x] = response;
-                    // The pupil is too small, the padding too large; we combine them.
-                    candidates.push_back(std::make_pair(cv::Rect(0.5 * (ia + oa), 0.5 * (ic + oc)), response));
-                }
-            }
-        }
-    }
-
-    auto compare = [](const std::pair<cv::Rect, float> &a, const std::pair<cv::Rect, float> &b)
-    {
-        return (a.second > b.second);
-    };
-    sort(candidates.begin(), candidates.end(), compare);
+    // Haar-like feature suggested by Swirski, but we collect the best responses instead of the global one
+    CoarsePupilLocator locator(min_r, max_r, r_step, cv::Size(xstep, ystep));
 
 #ifdef DBG_COARSE_PUPIL_DETECTION
     Mat dbg;
     cvtColor(downscaled, dbg, CV_GRAY2BGR);
 #endif
 
-    // Now add until we reach the minimum coverage or run out of candidates
+    // Now add until we reach the minimum coverage or run out of candidates, ignoring candidates with less than half the best response
+    // Unlike the original, which compared each response to the best one found so far in its scan order, the threshold is half of
+    // the overall best response, and all radii of a center are candidates, not only those improving the response of the center
+    // Only the best coarseCandidateCount candidates are located first. If all of them are combined without reaching the coverage or
+    // the threshold, the search is repeated with more candidates. As the candidates are strictly ordered (see CoarsePupilLocator),
+    // the first candidates are the same for every bound, thus the result is the same as with all candidates
     cv::Rect coarse;
     int minWidth = static_cast<int>(minCoverage * downscaled.cols);
     int minHeight = static_cast<int>(minCoverage * downscaled.rows);
-    for (int i = 0; i < candidates.size(); i++)
+    int maxCandidates = coarseCandidateCount;
+    bool exhausted = true;
+    while (exhausted)
     {
-        auto &c = candidates[i];
-        if (coarse.area() == 0)
-            coarse = c.first;
-        else
-            coarse |= c.first;
+        std::vector<CoarsePupilCandidate> candidates = locator.locate(downscaled, maxCandidates);
+        exhausted = static_cast<int>(candidates.size()) == maxCandidates;
+        coarse = cv::Rect();
+
+        for (const auto &c : candidates)
+        {
+            if (c.response < 0.5f * candidates.front().response)
+            {
+                exhausted = false;
+                break;
+            }
+
+            // The pupil is too small, the padding too large; we combine them.
+            cv::Rect region = c.region(locator.getSurroundFactor());
+            if (coarse.area() == 0)
+                coarse = region;
+            else
+                coarse |= region;
 #ifdef DBG_COARSE_PUPIL_DETECTION
-        rectangle(dbg, candidates[i].first, Scalar(0, 255, 255));
+            rectangle(dbg, region, Scalar(0, 255, 255));
 #endif
-        if (coarse.width > minWidth && coarse.height > minHeight)
-            break;
+            if (coarse.width > minWidth && coarse.height > minHeight)
+            {
+                exhausted = false;
+                break;
+            }
+        }
+
+        maxCandidates *= 4;
     }
 
 #ifdef DBG_COARSE_PUPIL_DETECTION
@@ -288,35 +239,88 @@ std::vector<cv::Point> PupilDetectionMethod::ellipse2Points(const cv::RotatedRec
     return points;
 }
 
-/* Measures the confidence for a pupil based on the inner-outer contrast
- * from the pupil following PuRe. For details, see
- * Thiago Santini, Wolfgang Fuhl, Enkelejda Kasneci
- * "PuRe: Robust pupil detection for real-time pervasive eye tracking"
- */
-float PupilDetectionMethod::outlineContrastConfidence(const cv::Mat &frame, const Pupil &pupil, const int &bias)
+// Number of line samples whose image offsets are computed at once, longer lines are gathered in multiple batches
+static const int outlineSampleBatch = 256;
+
+// Rounds non-negative values like std::roundf, sample positions are inside the image and thus never negative
+static inline int roundPositive(float value)
 {
+    return static_cast<int>(value + 0.5f);
+}
 
-    if (!pupil.hasOutline())
-        return NO_CONFIDENCE;
+// Sums the intensities of count samples on a line through the pupil center, starting at the coordinate first
+// For horizontal lines, the samples are at x = first... on y = a*x + b, otherwise at y = first... on x = (y - b) / a
+// The image offsets of a batch of samples are computed first, then the samples are gathered from the image in a separate
+// loop without rounding and row lookups
+static int sumLineSamples(const cv::Mat &frame, const bool &horizontal, const float &a, const float &b, int first, int count)
+{
+    int offsets[outlineSampleBatch];
+    const uchar *data = frame.data;
+    const int step = static_cast<int>(frame.step[0]);
+
+    int sum = 0;
+    while (count > 0)
+    {
+        const int n = std::min(count, outlineSampleBatch);
+
+        if (horizontal)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                const int x = first + i;
+                offsets[i] = roundPositive(a * x + b) * step + x;
+            }
+        }
+        else
+        {
+            for (int i = 0; i < n; i++)
+            {
+                const int y = first + i;
+                offsets[i] = y * step + roundPositive((y - b) / a);
+            }
+        }
+
+        for (int i = 0; i < n; i++)
+            sum += data[offsets[i]];
+
+        first += n;
+        count -= n;
+    }
+    return sum;
+}
+
+/* Ratio of outline points of the ellipse at which the image is darker inside than outside, following PuRe.
+ * For each outline point (every 10 degrees), the mean intensities of delta pixels inside and outside along the line
+ * through the center are compared. Points without a line completely inside the image count as evaluated but not valid.
+ * Shared by outlineContrastConfidence and the candidate validation of PuRe, requires a single channel 8 bit image.
+ * Returns a negative value if no outline point could be evaluated.
+ */
+float PupilDetectionMethod::outlineContrast(const cv::Mat &frame, const cv::RotatedRect &outline, const int &delta, const int &bias)
+{
 
     cv::Rect boundaries = {0, 0, frame.cols, frame.rows};
-    int minorAxis = pupil.minorAxis(); //cv::min<int>(pupil.size.width, pupil.size.height);
-    int delta = 0.15 * minorAxis;
-    cv::Point c = pupil.center;
+    cv::Point c = outline.center;
+
+    int angle = static_cast<int>(outline.angle);
+    while (angle < 0)
+        angle += 360;
+    while (angle > 360)
+        angle -= 360;
+
+    float alpha, beta;
+    sincos(angle, alpha, beta);
 
-#ifdef DBG_OUTLINE_CONTRAST
-    cv::Mat tmp;
-    cv::cvtColor(frame, tmp, CV_GRAY2BGR);
-    cv::ellipse(tmp, pupil, cv::Scalar(0, 255, 255));
-    cv::Scalar lineColor;
-#endif
     int evaluated = 0;
     int validCount = 0;
 
-    std::vector<cv::Point> outlinePoints = ellipse2Points(pupil, 10);
-
-    for (auto &outlinePoint : outlinePoints)
+    // Outline points as by ellipse2Points(outline, 10), computed in place instead of into a vector
+    for (int i = 0; i < 360; i += 10)
     {
+        double x = 0.5 * outline.size.width * sinTable[450 - i];
+        double y = 0.5 * outline.size.height * sinTable[i];
+        cv::Point outlinePoint(static_cast<int>(roundf(outline.center.x + x * alpha - y * beta)),
+                               static_cast<int>(roundf(outline.center.y + x * beta + y * alpha)));
+
         int dx = outlinePoint.x - c.x;
         int dy = outlinePoint.y - c.y;
 
@@ -328,123 +332,59 @@ float PupilDetectionMethod::outlineContrastConfidence(const cv::Mat &frame, cons
         if (a == 0)
             continue;
 
-        if (abs(dx) > abs(dy))
+        bool horizontal = abs(dx) > abs(dy);
+        cv::Point start, end;
+        if (horizontal)
         {
             int sx = outlinePoint.x - delta;
             int ex = outlinePoint.x + delta;
-            int sy = std::roundf(a * sx + b);
-            int ey = std::roundf(a * ex + b);
-            cv::Point start = {sx, sy};
-            cv::Point end = {ex, ey};
-            evaluated++;
-
-            if (!boundaries.contains(start) || !boundaries.contains(end))
-                continue;
-
-            float m1, m2, count;
-
-            m1 = count = 0;
-            for (int x = sx; x < outlinePoint.x; x++)
-                m1 += frame.ptr<uchar>((int)std::roundf(a * x + b))[x];
-            m1 = std::roundf(m1 / delta);
-
-            m2 = count = 0;
-            for (int x = outlinePoint.x + 1; x <= ex; x++)
-            {
-                m2 += frame.ptr<uchar>((int)std::roundf(a * x + b))[x];
-            }
-            m2 = std::roundf(m2 / delta);
-
-#ifdef DBG_OUTLINE_CONTRAST
-            lineColor = cv::Scalar(0, 0, 255);
-#endif
-            if (outlinePoint.x < c.x)
-            { // leftwise point
-                if (m1 > m2 + bias)
-                {
-                    validCount++;
-#ifdef DBG_OUTLINE_CONTRAST
-                    lineColor = cv::Scalar(0, 255, 0);
-#endif
-                }
-            }
-            else
-            { // rightwise point
-                if (m2 > m1 + bias)
-                {
-                    validCount++;
-#ifdef DBG_OUTLINE_CONTRAST
-                    lineColor = cv::Scalar(0, 255, 0);
-#endif
-                }
-            }
-
-#ifdef DBG_OUTLINE_CONTRAST
-            cv::line(tmp, start, end, lineColor);
-#endif
+            start = {sx, static_cast<int>(std::roundf(a * sx + b))};
+            end = {ex, static_cast<int>(std::roundf(a * ex + b))};
         }
         else
         {
             int sy = outlinePoint.y - delta;
             int ey = outlinePoint.y + delta;
-            int sx = std::roundf((sy - b) / a);
-            int ex = std::roundf((ey - b) / a);
-            cv::Point start = {sx, sy};
-            cv::Point end = {ex, ey};
+            start = {static_cast<int>(std::roundf((sy - b) / a)), sy};
+            end = {static_cast<int>(std::roundf((ey - b) / a)), ey};
+        }
 
-            evaluated++;
-            if (!boundaries.contains(start) || !boundaries.contains(end))
-                continue;
+        evaluated++;
+        if (!boundaries.contains(start) || !boundaries.contains(end))
+            continue;
 
-            float m1, m2, count;
+        // Mean intensities before and after the outline point along the line
+        int first = horizontal ? outlinePoint.x : outlinePoint.y;
+        float m1 = std::roundf(sumLineSamples(frame, horizontal, a, b, first - delta, delta) / (float)delta);
+        float m2 = std::roundf(sumLineSamples(frame, horizontal, a, b, first + 1, delta) / (float)delta);
 
-            m1 = count = 0;
-            for (int y = sy; y < outlinePoint.y; y++)
-                m1 += frame.ptr<uchar>(y)[(int)std::roundf((y - b) / a)];
-            m1 = std::roundf(m1 / delta);
+        // Leftwise or upperwise points have the inside after the outline point, rightwise and bottomwise ones before
+        bool before = horizontal ? outlinePoint.x < c.x : outlinePoint.y < c.y;
+        if (before ? m1 > m2 + bias : m2 > m1 + bias)
+            validCount++;
+    }
 
-            m2 = count = 0;
-            for (int y = outlinePoint.y + 1; y <= ey; y++)
-                m2 += frame.ptr<uchar>(y)[(int)std::roundf((y - b) / a)];
-            m2 = std::roundf(m2 / delta);
+    if (evaluated == 0)
+        return -1;
 
-#ifdef DBG_OUTLINE_CONTRAST
-            lineColor = cv::Scalar(0, 0, 255);
-#endif
-            if (outlinePoint.y < c.y)
-            { // upperwise point
-                if (m1 > m2 + bias)
-                {
-                    validCount++;
-#ifdef DBG_OUTLINE_CONTRAST
-                    lineColor = cv::Scalar(0, 255, 0);
-#endif
-                }
-            }
-            else
-            { // bottomwise point
-                if (m2 > m1 + bias)
-                {
-                    validCount++;
-#ifdef DBG_OUTLINE_CONTRAST
-                    lineColor = cv::Scalar(0, 255, 0);
-#endif
-                }
-            }
+    return validCount / (float)evaluated;
+}
 
-#ifdef DBG_OUTLINE_CONTRAST
-            cv::line(tmp, start, end, lineColor);
-#endif
-        }
-    }
-    if (evaluated == 0)
-        return 0;
+/* Measures the confidence for a pupil based on the inner-outer contrast
+ * from the pupil following PuRe. For details, see
+ * Thiago Santini, Wolfgang Fuhl, Enkelejda Kasneci
+ * "PuRe: Robust pupil detection for real-time pervasive eye tracking"
+ */
+float PupilDetectionMethod::outlineContrastConfidence(const cv::Mat &frame, const Pupil &pupil, const int &bias)
+{
 
-#ifdef DBG_OUTLINE_CONTRAST
-    cv::imshow("Outline Contrast Debug", tmp);
-#endif
+    if (!pupil.hasOutline())
+        return NO_CONFIDENCE;
 
-    return validCount / (float)evaluated;
+    int minorAxis = pupil.minorAxis(); //cv::min<int>(pupil.size.width, pupil.size.height);
+    int delta = 0.15 * minorAxis;
+
+    return std::max(0.0f, outlineContrast(frame, pupil, delta, bias));
 }
 
 float PupilDetectionMethod::angularSpreadConfidence(const std::vector<cv::Point> &points, const cv::Point2f &center)
@@ -44,6 +44,24 @@ public:
     virtual bool hasCoarseLocation() = 0;
     virtual bool hasInliers() = 0;
 
+    // Methods that carry no state from one frame to the next and share no data between instances can process
+    // consecutive frames concurrently, using one instance per thread
+    // Data shared by the concurrent detections outside of the instances must be thread-safe, i.e. the undistortion of the camera calibration
+    virtual bool isStateless() {
+        return false;
+    }
+
+    // Copies the configurable parameters of another instance of the same method, used to configure the additional instances
+    // of stateless methods like the primary instance
+    virtual void copyParameters(PupilDetectionMethod *other) {
+
+    }
+
+    // Methods that track the pupil between frames themselves, the tracking ROI of the pupil detection is not applied to them
+    virtual bool hasOwnTracking() {
+        return false;
+    }
+
     std::string title() {
         return mTitle;
     }
@@ -63,11 +81,19 @@ public:
         inlierPts = std::vector<cv::Point2f>();
     }
 
+    // Detection within the roi of the frame, the pupil is returned in coordinates of the whole frame
+    // Methods without own implementation ignore the diameter range and process the cropped frame
     virtual void run(const cv::Mat &frame, const cv::Rect &roi, Pupil &pupil, const float &minPupilDiameterPx, const float &maxPupilDiameterPx) {
-        (void) roi;
         (void) minPupilDiameterPx;
         (void) maxPupilDiameterPx;
-        run(frame, pupil);
+        cv::Rect frameRoi = roi & cv::Rect(0, 0, frame.cols, frame.rows);
+        if(frameRoi.area() < 10) {
+            run(frame, pupil);
+            return;
+        }
+        run(frame(frameRoi), pupil);
+        if(pupil.center.x > 0 && pupil.center.y > 0)
+            pupil.shift(frameRoi.tl());
     }
 
     Pupil runWithConfidence(const cv::Mat &frame) {
@@ -98,6 +124,7 @@ public:
 
     // Generic confidence metrics
     static float outlineContrastConfidence(const cv::Mat &frame, const Pupil &pupil, const int &bias=5);
+    static float outlineContrast(const cv::Mat &frame, const cv::RotatedRect &outline, const int &delta, const int &bias);
     static float edgeRatioConfidence(const cv::Mat &edgeImage, const Pupil &pupil, std::vector<cv::Point> &edgePoints, const int &band=5);
     static float angularSpreadConfidence(const std::vector<cv::Point> &points, const cv::Point2f &center);
     static float aspectRatioConfidence(const Pupil &pupil);
@@ -50,64 +50,65 @@
 #ifndef PUPILALGOSIMPLE_STARBURST_H
 #define PUPILALGOSIMPLE_STARBURST_H
 
+#include <cstdint>
+#include <vector>
 #include "PupilDetectionMethod.h"
 
 #define UINT8 unsigned char
-//svd function
-#define SIGN(u, v) ((v) >= 0.0 ? fabs(u) : -fabs(u))
 #ifndef MAX
 #define MAX(x, y) ((x) >= (y) ? (x) : (y))
 #endif
 #define FIX_UINT8(x) ((x) < 0 ? 0 : ((x) > 255 ? 255 : (x)))
 
+/*
+ * ML: RANSAC ellipse fit of the starburst edge points
+ *
+ * All buffers are kept per instance and reused over frames, thus a detection does not allocate once the buffers grew to the
+ * number of edge points. Each RANSAC hypothesis draws its sample from its own random sequence derived from the seed and the
+ * hypothesis index, thus hypotheses are evaluated in parallel batches and the result is the same as for a sequential
+ * evaluation, independent of the number of threads.
+ */
 class RansacEllipse
 {
 
 public:
-    RansacEllipse()
+    explicit RansacEllipse(uint64_t seed = 0) : seed(seed)
     {
     }
 
-    int starburst_pupil_contour_detection(UINT8 *pupil_image, const cv::Point2d &startPoint, int width, int height, int edge_thresh, int N, int minimum_cadidate_features);
-    int *pupil_fitting_inliers(UINT8 *pupil_image, int, int, int &return_max_inliers);
+    int starburst_pupil_contour_detection(const UINT8 *pupil_image, const cv::Point2d &startPoint, int width, int height, int edge_thresh, int N, int minimum_cadidate_features);
+    int pupil_fitting_inliers(int width, int height);
+
+    const std::vector<int> &get_inliers_index() const
+    {
+        return max_inliers_index;
+    }
 
-    std::vector<cv::Point2d *> edge_point;
+    std::vector<cv::Point2d> edge_point;
     double pupil_param[5];
 
+    uint64_t seed;
+
 private:
-    static double radius(double u, double v)
+    // Conic parameters and inlier count of a single RANSAC hypothesis
+    struct Hypothesis
     {
-        double w;
-        u = fabs(u);
-        v = fabs(v);
-
-        if (u > v)
-        {
-            w = v / u;
-            return (u * sqrt(1. + w * w));
-        }
-        else
-        {
-            if (v)
-            {
-                w = u / v;
-                return (v * sqrt(1. + w * w));
-            }
-            else
-                return 0.0;
-        }
-    }
+        double conic_param[6];
+        int ninliers;
+    };
 
-    void svd(int m, int n, double **a, double **p, double *d, double **q);
-    void destroy_edge_point();
     void locate_edge_points(const UINT8 *image, int width, int height, double cx, double cy, int dis, double angle_step, double angle_normal, double angle_spread, int edge_thresh);
     cv::Point2d get_edge_mean();
-    cv::Point2d *normalize_edge_point(double &dis_scale, cv::Point2d &nor_center, int ep_num);
-    bool solve_ellipse(double *conic_param, double *ellipse_param);
+    void normalize_edge_point(double &dis_scale, cv::Point2d &nor_center);
+    void fit_hypothesis(int index, double dis_threshold, Hypothesis &hypothesis) const;
+    bool solve_ellipse(const double *conic_param, double *ellipse_param);
     void denormalize_ellipse_param(double *par, double *normailized_par, double dis_scale, cv::Point2d nor_center);
-    void get_random_num(int n, int max_num, int *rand_num);
+    void get_random_num(int n, int num, uint64_t state, int *rand_num) const;
 
     std::vector<int> edge_intensity_diff;
+    std::vector<cv::Point2d> edge_point_nor;
+    std::vector<int> max_inliers_index;
+    std::vector<Hypothesis> hypotheses;
 };
 
 class Starburst : public PupilDetectionMethod
@@ -159,6 +160,7 @@ public:
 
 private:
     RansacEllipse ransacEllipse;
+    cv::Mat eyeImg;              //working copy of the frame, corneal reflection removal writes into it
     cv::Point2d startPoint;
     double *avgIntensityHori;    //horizontal average intensity
     double *intensityFactorHori; //horizontal intensity factor for noise reduction
@@ -24,6 +24,7 @@ Modified by Moritz Lode 2020
 */
 
 #include "Swirski2D.h"
+#include "CoarsePupilLocator.h"
 #include <opencv2/core/mat.hpp>
 #include <opencv2/imgproc.hpp>
 
@@ -35,9 +36,12 @@ Modified by Moritz Lode 2020
 #include <set>
 #include <random>
 #include <algorithm>
+#include <atomic>
 
 const double SQRT_2 = std::sqrt(2.0);
-const cv::Point2f UNKNOWN_POSITION = cv::Point2f(-1, -1);
+
+// ML: number of RANSAC hypotheses evaluated in parallel before they are accepted in order
+static const size_t ransacBatchSize = 256;
 
 template <typename T>
 inline cv::Rect_<T> roiAround(T x, T y, T radius)
@@ -51,23 +55,8 @@ inline cv::Rect_<T> roiAround(const cv::Point_<T> &centre, T radius)
     return roiAround(centre.x, centre.y, radius);
 }
 
-static std::mt19937 static_gen;
-
-int random(int min, int max)
-{
-    std::uniform_int_distribution<> distribution(min, max);
-    return distribution(static_gen);
-}
-
-int random(int min, int max, unsigned int seed)
-{
-    std::mt19937 gen(seed);
-    std::uniform_int_distribution<> distribution(min, max);
-    return distribution(gen);
-}
-
-template <typename T>
-std::vector<T> randomSubset(const std::vector<T> &src, typename std::vector<T>::size_type size)
+template <typename T, typename Generator>
+std::vector<T> randomSubset(const std::vector<T> &src, typename std::vector<T>::size_type size, Generator &gen)
 {
     if (size > src.size())
         throw std::range_error("Subset size out of range");
@@ -77,30 +66,8 @@ std::vector<T> randomSubset(const std::vector<T> &src, typename std::vector<T>::
 
     for (size_t j = src.size() - size; j < src.size(); ++j)
     {
-        size_t idx = random(0, j); // generate a random integer in range [0, j]
-
-        if (vals.find(idx) != vals.end())
-            idx = j;
-
-        ret.push_back(src[idx]);
-        vals.insert(idx);
-    }
-
-    return ret;
-}
-
-template <typename T>
-std::vector<T> randomSubset(const std::vector<T> &src, typename std::vector<T>::size_type size, unsigned int seed)
-{
-    if (size > src.size())
-        throw std::range_error("Subset size out of range");
-
-    std::vector<T> ret;
-    std::set<size_t> vals;
-
-    for (size_t j = src.size() - size; j < src.size(); ++j)
-    {
-        size_t idx = random(0, j, seed + j); // generate a random integer in range [0, j]
+        std::uniform_int_distribution<size_t> distribution(0, j);
+        size_t idx = distribution(gen); // generate a random integer in range [0, j]
 
         if (vals.find(idx) != vals.end())
             idx = j;
@@ -307,112 +274,18 @@ cv::Rect Swirski2D::findMaxHaarResponse(const cv::Mat &frame)
     // |_________________________|
     //
 
-    cv::Mat_<int32_t> mEyeIntegral;
-    int padding = 2 * params.Radius_Max;
-
-    cv::Mat mEyePad;
-    // Need to pad by an additional 1 to get bottom & right edges.
-    cv::copyMakeBorder(mEye, mEyePad, padding, padding, padding, padding, cv::BORDER_REPLICATE);
-    cv::integral(mEyePad, mEyeIntegral);
+    // Best Haar response over all radii with the square radius weights of the original feature, rows are searched in parallel, the
+    // image border is replicated
+    CoarsePupilLocator locator(params.Radius_Min, params.Radius_Max - 1, 2, cv::Size(4, 4), 3, true, CoarseHaarNormalization::SQUARE_RADIUS);
+    std::vector<CoarsePupilCandidate> haarCandidates = locator.locate(mEye, 1);
 
     cv::Point2f pHaarPupil;
     int haarRadius = 0;
 
-    const int rstep = 2;
-    const int ystep = 4;
-    const int xstep = 4;
-
-    double minResponse = std::numeric_limits<double>::infinity();
-
-    for (int r = params.Radius_Min; r < params.Radius_Max; r += rstep)
+    if (!haarCandidates.empty())
     {
-        // Get Haar feature
-        int r_inner = r;
-        int r_outer = 3 * r;
-        HaarSurroundFeature f(r_inner, r_outer);
-
-        // Use TBB for rows
-        std::pair<double, cv::Point2f> minRadiusResponse = tbb::parallel_reduce(
-            tbb::blocked_range<int>(0, (mEye.rows - r - r - 1) / ystep + 1,
-                                    ((mEye.rows - r - r - 1) / ystep + 1) / 8),
-            std::make_pair(std::numeric_limits<double>::infinity(), UNKNOWN_POSITION),
-            [&](tbb::blocked_range<int> range,
-                const std::pair<double, cv::Point2f> &minValIn) -> std::pair<double, cv::Point2f>
-            {
-                std::pair<double, cv::Point2f> minValOut = minValIn;
-                for (int i = range.begin(), y = r + range.begin() * ystep; i < range.end(); i++, y += ystep)
-                {
-                    //            �         �
-                    // row1_outer.|         |  p00._____________________.p01
-                    //            |         |     |         Haar kernel |
-                    //            |         |     |                     |
-                    // row1_inner.|         |     |   p00._______.p01   |
-                    //            |-padding-|     |      |       |      |
-                    //            |         |     |      | (x,y) |      |
-                    // row2_inner.|         |     |      |_______|      |
-                    //            |         |     |   p10'       'p11   |
-                    //            |         |     |                     |
-                    // row2_outer.|         |     |_____________________|
-                    //            |         |  p10'                     'p11
-                    //            �         �
-
-                    int *row1_inner = mEyeIntegral[y + padding - r_inner];
-                    int *row2_inner = mEyeIntegral[y + padding + r_inner + 1];
-                    int *row1_outer = mEyeIntegral[y + padding - r_outer];
-                    int *row2_outer = mEyeIntegral[y + padding + r_outer + 1];
-
-                    int *p00_inner = row1_inner + r + padding - r_inner;
-                    int *p01_inner = row1_inner + r + padding + r_inner + 1;
-                    int *p10_inner = row2_inner + r + padding - r_inner;
-                    int *p11_inner = row2_inner + r + padding + r_inner + 1;
-
-                    int *p00_outer = row1_outer + r + padding - r_outer;
-                    int *p01_outer = row1_outer + r + padding + r_outer + 1;
-                    int *p10_outer = row2_outer + r + padding - r_outer;
-                    int *p11_outer = row2_outer + r + padding + r_outer + 1;
-
-                    for (int x = r; x < mEye.cols - r; x += xstep)
-                    {
-                        int sumInner = *p00_inner + *p11_inner - *p01_inner - *p10_inner;
-                        int sumOuter = *p00_outer + *p11_outer - *p01_outer - *p10_outer - sumInner;
-
-                        double response = f.val_inner * sumInner + f.val_outer * sumOuter;
-
-                        if (response < minValOut.first)
-                        {
-                            minValOut.first = response;
-                            minValOut.second = cv::Point(x, y);
-                        }
-
-                        p00_inner += xstep;
-                        p01_inner += xstep;
-                        p10_inner += xstep;
-                        p11_inner += xstep;
-
-                        p00_outer += xstep;
-                        p01_outer += xstep;
-                        p10_outer += xstep;
-                        p11_outer += xstep;
-                    }
-                }
-                return minValOut;
-            },
-            [](const std::pair<double, cv::Point2f> &x,
-               const std::pair<double, cv::Point2f> &y) -> std::pair<double, cv::Point2f>
-            {
-                if (x.first < y.first)
-                    return x;
-                else
-                    return y;
-            });
-
-        if (minRadiusResponse.first < minResponse)
-        {
-            minResponse = minRadiusResponse.first;
-            // Set return values
-            pHaarPupil = minRadiusResponse.second;
-            haarRadius = r;
-        }
+        pHaarPupil = haarCandidates.front().center;
+        haarRadius = haarCandidates.front().radius;
     }
 
     // Paradoxically, a good Haar fit won't catch the entire pupil, so expand it a bit
@@ -473,109 +346,18 @@ void Swirski2D::run(const cv::Mat &frame, Pupil &pupil, std::vector<cv::Point2f>
     // |_________________________|
     //
 
-    cv::Mat_<int32_t> mEyeIntegral;
-    int padding = 2 * params.Radius_Max;
-
-    cv::Mat mEyePad;
-    // Need to pad by an additional 1 to get bottom & right edges.
-    cv::copyMakeBorder(mEye, mEyePad, padding, padding, padding, padding, cv::BORDER_REPLICATE);
-    cv::integral(mEyePad, mEyeIntegral);
+    // Best Haar response over all radii with the square radius weights of the original feature, rows are searched in parallel, the
+    // image border is replicated
+    CoarsePupilLocator locator(params.Radius_Min, params.Radius_Max - 1, 2, cv::Size(4, 4), 3, true, CoarseHaarNormalization::SQUARE_RADIUS);
+    std::vector<CoarsePupilCandidate> haarCandidates = locator.locate(mEye, 1);
 
     cv::Point2f pHaarPupil;
     int haarRadius = 0;
 
-    const int rstep = 2;
-    const int ystep = 4;
-    const int xstep = 4;
-
-    double minResponse = std::numeric_limits<double>::infinity();
-
-    for (int r = params.Radius_Min; r < params.Radius_Max; r += rstep)
+    if (!haarCandidates.empty())
     {
-        // Get Haar feature
-        int r_inner = r;
-        int r_outer = 3 * r;
-        HaarSurroundFeature f(r_inner, r_outer);
-
-        // Use TBB for rows
-        std::pair<double, cv::Point2f> minRadiusResponse = tbb::parallel_reduce(
-            tbb::blocked_range<int>(0, (mEye.rows - r - r - 1) / ystep + 1, ((mEye.rows - r - r - 1) / ystep + 1) / 8),
-            std::make_pair(std::numeric_limits<double>::infinity(), UNKNOWN_POSITION),
-            [&](tbb::blocked_range<int> range, const std::pair<double, cv::Point2f> &minValIn) -> std::pair<double, cv::Point2f>
-            {
-                std::pair<double, cv::Point2f> minValOut = minValIn;
-                for (int i = range.begin(), y = r + range.begin() * ystep; i < range.end(); i++, y += ystep)
-                {
-                    //            �         �
-                    // row1_outer.|         |  p00._____________________.p01
-                    //            |         |     |         Haar kernel |
-                    //            |         |     |                     |
-                    // row1_inner.|         |     |   p00._______.p01   |
-                    //            |-padding-|     |      |       |      |
-                    //            |         |     |      | (x,y) |      |
-                    // row2_inner.|         |     |      |_______|      |
-                    //            |         |     |   p10'       'p11   |
-                    //            |         |     |                     |
-                    // row2_outer.|         |     |_____________________|
-                    //            |         |  p10'                     'p11
-                    //            �         �
-
-                    int *row1_inner = mEyeIntegral[y + padding - r_inner];
-                    int *row2_inner = mEyeIntegral[y + padding + r_inner + 1];
-                    int *row1_outer = mEyeIntegral[y + padding - r_outer];
-                    int *row2_outer = mEyeIntegral[y + padding + r_outer + 1];
-
-                    int *p00_inner = row1_inner + r + padding - r_inner;
-                    int *p01_inner = row1_inner + r + padding + r_inner + 1;
-                    int *p10_inner = row2_inner + r + padding - r_inner;
-                    int *p11_inner = row2_inner + r + padding + r_inner + 1;
-
-                    int *p00_outer = row1_outer + r + padding - r_outer;
-                    int *p01_outer = row1_outer + r + padding + r_outer + 1;
-                    int *p10_outer = row2_outer + r + padding - r_outer;
-                    int *p11_outer = row2_outer + r + padding + r_outer + 1;
-
-                    for (int x = r; x < mEye.cols - r; x += xstep)
-                    {
-                        int sumInner = *p00_inner + *p11_inner - *p01_inner - *p10_inner;
-                        int sumOuter = *p00_outer + *p11_outer - *p01_outer - *p10_outer - sumInner;
-
-                        double response = f.val_inner * sumInner + f.val_outer * sumOuter;
-
-                        if (response < minValOut.first)
-                        {
-                            minValOut.first = response;
-                            minValOut.second = cv::Point(x, y);
-                        }
-
-                        p00_inner += xstep;
-                        p01_inner += xstep;
-                        p10_inner += xstep;
-                        p11_inner += xstep;
-
-                        p00_outer += xstep;
-                        p01_outer += xstep;
-                        p10_outer += xstep;
-                        p11_outer += xstep;
-                    }
-                }
-                return minValOut;
-            },
-            [](const std::pair<double, cv::Point2f> &x, const std::pair<double, cv::Point2f> &y) -> std::pair<double, cv::Point2f>
-            {
-                if (x.first < y.first)
-                    return x;
-                else
-                    return y;
-            });
-
-        if (minRadiusResponse.first < minResponse)
-        {
-            minResponse = minRadiusResponse.first;
-            // Set return values
-            pHaarPupil = minRadiusResponse.second;
-            haarRadius = r;
-        }
+        pHaarPupil = haarCandidates.front().center;
+        haarRadius = haarCandidates.front().radius;
     }
 
     // Paradoxically, a good Haar fit won't catch the entire pupil, so expand it a bit
@@ -888,7 +670,13 @@ void Swirski2D::run(const cv::Mat &frame, Pupil &pupil, std::vector<cv::Point2f>
 
         //size_t threshold_inlierCount = std::max<size_t>(n, static_cast<size_t>(out.edgePoints.size() * 0.7));
 
-        // Use TBB for RANSAC
+        // ML: Each hypothesis draws its sample from its own random stream, derived from params.Seed (or a seed of this instance
+        // for each frame if no seed is set) and the index of the hypothesis. Hypotheses are evaluated in parallel batches and
+        // accepted in the order of their index, thus best ellipse and early termination are the same as for a sequential
+        // RANSAC, independent of the number of threads
+        const uint32_t ransacSeed = params.Seed >= 0 ? static_cast<uint32_t>(params.Seed) : static_cast<uint32_t>(seedGenerator());
+        const size_t iterations = k > 0 ? static_cast<size_t>(k) : 0;
+
         struct EllipseRansac_out
         {
             std::vector<cv::Point2f> bestInliers;
@@ -900,216 +688,214 @@ void Swirski2D::run(const cv::Mat &frame, Pupil &pupil, std::vector<cv::Point2f>
             EllipseRansac_out() : bestEllipseGoodness(-std::numeric_limits<double>::infinity()), earlyTermination(false), earlyRejections(0) {}
         };
 
-        struct EllipseRansac
+        struct EllipseRansac_hypothesis
         {
-            const TrackerParams &params;
-            const std::vector<cv::Point2f> &edgePoints;
-            int n;
-            const cv::Rect &bb;
-            const cv::Mat_<float> &mDX;
-            const cv::Mat_<float> &mDY;
-            int earlyRejections;
-            bool earlyTermination;
-
-            EllipseRansac_out out;
+            bool evaluated;
+            bool valid;
+            bool earlyRejection;
+            bool terminates;
+            double goodness;
+            cv::RotatedRect ellipse;
+            std::vector<cv::Point2f> inliers;
+        };
 
-            EllipseRansac(
-                const TrackerParams &params,
-                const std::vector<cv::Point2f> &edgePoints,
-                int n,
-                const cv::Rect &bb,
-                const cv::Mat_<float> &mDX,
-                const cv::Mat_<float> &mDY)
-                : params(params), edgePoints(edgePoints), n(n), bb(bb), mDX(mDX), mDY(mDY), earlyTermination(false), earlyRejections(0)
+        // Ransac Iteration
+        // ----------------
+        auto evaluateHypothesis = [&](size_t index, EllipseRansac_hypothesis &hypothesis)
+        {
+            hypothesis.evaluated = true;
+            hypothesis.valid = false;
+            hypothesis.earlyRejection = false;
+            hypothesis.terminates = false;
+            hypothesis.inliers.clear();
+
+            std::seed_seq seq{ransacSeed, static_cast<uint32_t>(index)};
+            std::mt19937 gen(seq);
+            std::vector<cv::Point2f> sample = randomSubset(edgePoints, n, gen);
+
+            cv::RotatedRect ellipseSampleFit = fitEllipse(sample);
+            // Normalise ellipse to have width as the major axis.
+            if (ellipseSampleFit.size.height > ellipseSampleFit.size.width)
             {
+                ellipseSampleFit.angle = std::fmod(ellipseSampleFit.angle + 90, 180);
+                std::swap(ellipseSampleFit.size.height, ellipseSampleFit.size.width);
             }
 
-            EllipseRansac(EllipseRansac &other, tbb::split)
-                : params(other.params), edgePoints(other.edgePoints), n(other.n), bb(other.bb), mDX(other.mDX), mDY(other.mDY), earlyTermination(other.earlyTermination), earlyRejections(other.earlyRejections)
+            cv::Size s = ellipseSampleFit.size;
+            // Discard useless ellipses early
+            if (!ellipseSampleFit.center.inside(bbPupil) || s.height > params.Radius_Max * 2 || s.width > params.Radius_Max * 2 || s.height < params.Radius_Min * 2 && s.width < params.Radius_Min * 2 || s.height > 4 * s.width || s.width > 4 * s.height)
             {
-                //std::cout << "Ransac split" << std::endl;
+                // Bad ellipse! Go to your room!
+                return;
             }
 
-            void operator()(const tbb::blocked_range<size_t> &r)
+            // Use conic section's algebraic distance as an error measure
+            ConicSection conicSampleFit(ellipseSampleFit);
+
+            // Check if sample's gradients are correctly oriented
+            if (params.EarlyRejection)
             {
-                if (out.earlyTermination)
-                    return;
-                //std::cout << "Ransac start (" << (r.end()-r.begin()) << " elements)" << std::endl;
-                for (size_t i = r.begin(); i != r.end(); ++i)
+                bool gradientCorrect = true;
+                BOOST_FOREACH (const cv::Point2f &p, sample)
                 {
-                    // Ransac Iteration
-                    // ----------------
-                    std::vector<cv::Point2f> sample;
-                    if (params.Seed >= 0)
-                        sample = randomSubset(edgePoints, n, static_cast<unsigned int>(i + params.Seed));
-                    else
-                        sample = randomSubset(edgePoints, n);
-
-                    cv::RotatedRect ellipseSampleFit = fitEllipse(sample);
-                    // Normalise ellipse to have width as the major axis.
-                    if (ellipseSampleFit.size.height > ellipseSampleFit.size.width)
-                    {
-                        ellipseSampleFit.angle = std::fmod(ellipseSampleFit.angle + 90, 180);
-                        std::swap(ellipseSampleFit.size.height, ellipseSampleFit.size.width);
-                    }
+                    cv::Point2f grad = conicSampleFit.algebraicGradientDir(p);
+                    float dx = mPupilSobelX(cv::Point(p.x, p.y));
+                    float dy = mPupilSobelY(cv::Point(p.x, p.y));
 
-                    cv::Size s = ellipseSampleFit.size;
-                    // Discard useless ellipses early
-                    if (!ellipseSampleFit.center.inside(bb) || s.height > params.Radius_Max * 2 || s.width > params.Radius_Max * 2 || s.height < params.Radius_Min * 2 && s.width < params.Radius_Min * 2 || s.height > 4 * s.width || s.width > 4 * s.height)
-                    {
-                        // Bad ellipse! Go to your room!
-                        continue;
-                    }
+                    float dotProd = dx * grad.x + dy * grad.y;
 
-                    // Use conic section's algebraic distance as an error measure
-                    ConicSection conicSampleFit(ellipseSampleFit);
+                    gradientCorrect &= dotProd > 0;
+                }
+                if (!gradientCorrect)
+                {
+                    hypothesis.earlyRejection = true;
+                    return;
+                }
+            }
 
-                    // Check if sample's gradients are correctly oriented
-                    if (params.EarlyRejection)
-                    {
-                        bool gradientCorrect = true;
-                        BOOST_FOREACH (const cv::Point2f &p, sample)
-                        {
-                            cv::Point2f grad = conicSampleFit.algebraicGradientDir(p);
-                            float dx = mDX(cv::Point(p.x, p.y));
-                            float dy = mDY(cv::Point(p.x, p.y));
+            // Assume that the sample is the only inliers
 
-                            float dotProd = dx * grad.x + dy * grad.y;
+            cv::RotatedRect ellipseInlierFit = ellipseSampleFit;
+            ConicSection conicInlierFit = conicSampleFit;
+            std::vector<cv::Point2f> inliers, prevInliers;
 
-                            gradientCorrect &= dotProd > 0;
-                        }
-                        if (!gradientCorrect)
-                        {
-                            out.earlyRejections++;
-                            continue;
-                        }
-                    }
+            // Iteratively find inliers, and re-fit the ellipse
+            for (int i = 0; i < params.InlierIterations; ++i)
+            {
+                // Get error scale for 1px out on the minor axis
+                cv::Point2f minorAxis(-std::sin(CV_PI / 180.0 * ellipseInlierFit.angle), std::cos(CV_PI / 180.0 * ellipseInlierFit.angle));
+                cv::Point2f minorAxisPlus1px = ellipseInlierFit.center + (ellipseInlierFit.size.height / 2 + 1) * minorAxis;
+                float errOf1px = conicInlierFit.distance(minorAxisPlus1px);
+                float errorScale = 1.0f / errOf1px;
+
+                // Find inliers
+                inliers.reserve(edgePoints.size());
+                const float MAX_ERR = 2;
+                BOOST_FOREACH (const cv::Point2f &p, edgePoints)
+                {
+                    float err = errorScale * conicInlierFit.distance(p);
 
-                    // Assume that the sample is the only inliers
+                    if (err * err < MAX_ERR * MAX_ERR)
+                        inliers.push_back(p);
+                }
 
-                    cv::RotatedRect ellipseInlierFit = ellipseSampleFit;
-                    ConicSection conicInlierFit = conicSampleFit;
-                    std::vector<cv::Point2f> inliers, prevInliers;
+                if (inliers.size() < n)
+                {
+                    inliers.clear();
+                    continue;
+                }
 
-                    // Iteratively find inliers, and re-fit the ellipse
-                    for (int i = 0; i < params.InlierIterations; ++i)
-                    {
-                        // Get error scale for 1px out on the minor axis
-                        cv::Point2f minorAxis(-std::sin(CV_PI / 180.0 * ellipseInlierFit.angle), std::cos(CV_PI / 180.0 * ellipseInlierFit.angle));
-                        cv::Point2f minorAxisPlus1px = ellipseInlierFit.center + (ellipseInlierFit.size.height / 2 + 1) * minorAxis;
-                        float errOf1px = conicInlierFit.distance(minorAxisPlus1px);
-                        float errorScale = 1.0f / errOf1px;
-
-                        // Find inliers
-                        inliers.reserve(edgePoints.size());
-                        const float MAX_ERR = 2;
-                        BOOST_FOREACH (const cv::Point2f &p, edgePoints)
-                        {
-                            float err = errorScale * conicInlierFit.distance(p);
+                // Refit ellipse to inliers
+                ellipseInlierFit = fitEllipse(inliers);
+                conicInlierFit = ConicSection(ellipseInlierFit);
 
-                            if (err * err < MAX_ERR * MAX_ERR)
-                                inliers.push_back(p);
-                        }
+                // Normalise ellipse to have width as the major axis.
+                if (ellipseInlierFit.size.height > ellipseInlierFit.size.width)
+                {
+                    ellipseInlierFit.angle = std::fmod(ellipseInlierFit.angle + 90, 180);
+                    std::swap(ellipseInlierFit.size.height, ellipseInlierFit.size.width);
+                }
+            }
+            if (inliers.empty())
+                return;
 
-                        if (inliers.size() < n)
-                        {
-                            inliers.clear();
-                            continue;
-                        }
+            // Discard useless ellipses again
+            s = ellipseInlierFit.size;
+            if (!ellipseInlierFit.center.inside(bbPupil) || s.height > params.Radius_Max * 2 || s.width > params.Radius_Max * 2 || (s.height < params.Radius_Min * 2 && s.width < params.Radius_Min * 2) || s.height > 4 * s.width || s.width > 4 * s.height)
+            {
+                // Bad ellipse! Go to your room!
+                return;
+            }
 
-                        // Refit ellipse to inliers
-                        ellipseInlierFit = fitEllipse(inliers);
-                        conicInlierFit = ConicSection(ellipseInlierFit);
+            // Calculate ellipse goodness
+            double ellipseGoodness = 0;
+            if (params.ImageAwareSupport)
+            {
+                BOOST_FOREACH (cv::Point2f &p, inliers)
+                {
+                    cv::Point2f grad = conicInlierFit.algebraicGradientDir(p);
+                    float dx = mPupilSobelX(p);
+                    float dy = mPupilSobelY(p);
 
-                        // Normalise ellipse to have width as the major axis.
-                        if (ellipseInlierFit.size.height > ellipseInlierFit.size.width)
-                        {
-                            ellipseInlierFit.angle = std::fmod(ellipseInlierFit.angle + 90, 180);
-                            std::swap(ellipseInlierFit.size.height, ellipseInlierFit.size.width);
-                        }
-                    }
-                    if (inliers.empty())
-                        continue;
+                    double edgeStrength = dx * grad.x + dy * grad.y;
 
-                    // Discard useless ellipses again
-                    s = ellipseInlierFit.size;
-                    if (!ellipseInlierFit.center.inside(bb) || s.height > params.Radius_Max * 2 || s.width > params.Radius_Max * 2 || (s.height < params.Radius_Min * 2 && s.width < params.Radius_Min * 2) || s.height > 4 * s.width || s.width > 4 * s.height)
-                    {
-                        // Bad ellipse! Go to your room!
-                        continue;
-                    }
+                    ellipseGoodness += edgeStrength;
+                }
+            }
+            else
+            {
+                ellipseGoodness = inliers.size();
+            }
 
-                    // Calculate ellipse goodness
-                    double ellipseGoodness = 0;
-                    if (params.ImageAwareSupport)
-                    {
-                        BOOST_FOREACH (cv::Point2f &p, inliers)
-                        {
-                            cv::Point2f grad = conicInlierFit.algebraicGradientDir(p);
-                            float dx = mDX(p);
-                            float dy = mDY(p);
+            hypothesis.valid = true;
+            hypothesis.goodness = ellipseGoodness;
+            hypothesis.ellipse = ellipseInlierFit;
+            // Early termination, if 90% of points match
+            hypothesis.terminates = params.EarlyTerminationPercentage > 0 && inliers.size() > params.EarlyTerminationPercentage * edgePoints.size() / 100;
+            std::swap(hypothesis.inliers, inliers);
+        };
 
-                            double edgeStrength = dx * grad.x + dy * grad.y;
+        EllipseRansac_out out;
+        std::vector<EllipseRansac_hypothesis> batch(std::min(ransacBatchSize, iterations));
+        size_t next = 0;
 
-                            ellipseGoodness += edgeStrength;
-                        }
-                    }
-                    else
+        try
+        {
+            while (!out.earlyTermination && next < iterations)
+            {
+                const size_t count = std::min(ransacBatchSize, iterations - next);
+
+                // Hypotheses after one that reaches the early termination are skipped, they are only needed if it does not
+                // become the best ellipse, in which case they are evaluated in the next batch
+                std::atomic<size_t> stopAt(count);
+
+                tbb::parallel_for(tbb::blocked_range<size_t>(0, count), [&](const tbb::blocked_range<size_t> &r)
+                {
+                    for (size_t j = r.begin(); j != r.end(); ++j)
                     {
-                        ellipseGoodness = inliers.size();
+                        batch[j].evaluated = false;
+                        if (j > stopAt.load())
+                            continue;
+
+                        evaluateHypothesis(next + j, batch[j]);
+
+                        size_t current = stopAt.load();
+                        while (batch[j].terminates && j < current && !stopAt.compare_exchange_weak(current, j));
                     }
+                });
+
+                size_t j = 0;
+                while (j < count && batch[j].evaluated)
+                {
+                    EllipseRansac_hypothesis &hypothesis = batch[j++];
 
-                    if (ellipseGoodness > out.bestEllipseGoodness)
+                    if (hypothesis.earlyRejection)
+                        out.earlyRejections++;
+
+                    if (hypothesis.valid && hypothesis.goodness > out.bestEllipseGoodness)
                     {
-                        std::swap(out.bestEllipseGoodness, ellipseGoodness);
-                        std::swap(out.bestInliers, inliers);
-                        std::swap(out.bestEllipse, ellipseInlierFit);
+                        std::swap(out.bestEllipseGoodness, hypothesis.goodness);
+                        std::swap(out.bestInliers, hypothesis.inliers);
+                        std::swap(out.bestEllipse, hypothesis.ellipse);
 
-                        // Early termination, if 90% of points match
-                        if (params.EarlyTerminationPercentage > 0 && out.bestInliers.size() > params.EarlyTerminationPercentage * edgePoints.size() / 100)
+                        if (hypothesis.terminates)
                         {
-                            earlyTermination = true;
+                            out.earlyTermination = true;
                             break;
                         }
                     }
                 }
-                //std::cout << "Ransac end" << std::endl;
-            }
-
-            void join(EllipseRansac &other)
-            {
-                //std::cout << "Ransac join" << std::endl;
-                if (other.out.bestEllipseGoodness > out.bestEllipseGoodness)
-                {
-                    std::swap(out.bestEllipseGoodness, other.out.bestEllipseGoodness);
-                    std::swap(out.bestInliers, other.out.bestInliers);
-                    std::swap(out.bestEllipse, other.out.bestEllipse);
-                }
-                out.earlyRejections += other.out.earlyRejections;
-                earlyTermination |= other.earlyTermination;
-
-                out.earlyTermination = earlyTermination;
+                next += j;
             }
-        };
-
-        EllipseRansac ransac(params, edgePoints, n, bbPupil, mPupilSobelX, mPupilSobelY);
-
-        try
-        {
-            tbb::parallel_reduce(tbb::blocked_range<size_t>(0, k, k / 8), ransac);
         }
         catch (std::exception &e)
         {
-            const char *c = e.what();
             std::cerr << e.what() << std::endl;
         }
 
-        inliers = ransac.out.bestInliers;
-
-        //out.earlyRejections = ransac.out.earlyRejections;
-        //out.earlyTermination = ransac.out.earlyTermination;
+        inliers = out.bestInliers;
 
-        elPupil = ransac.out.bestEllipse;
+        elPupil = out.bestEllipse;
         elPupil.center.x += roiPupil.x;
         elPupil.center.y += roiPupil.y;
 
@@ -1165,4 +951,6 @@ void Swirski2D::run(const cv::Mat &frame, const cv::Rect &roi, Pupil &pupil, con
     (void)maxPupilDiameterPx;
 
     pupil = run(frame(roi));
+    if (pupil.center.x > 0 && pupil.center.y > 0)
+        pupil.shift(roi.tl());
 }
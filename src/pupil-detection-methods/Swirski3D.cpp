@@ -95,6 +95,8 @@ void Swirski3D::run(const cv::Mat &frame, const cv::Rect &roi, Pupil &pupil, con
     (void)maxPupilDiameterPx;
 
     pupil = run(frame(roi));
+    if (pupil.center.x > 0 && pupil.center.y > 0)
+        pupil.shift(roi.tl());
 }
 
 bool Swirski3D::add_observation(const cv::Mat &image, sef::Ellipse2D<double> &pupil, std::vector<cv::Point2f> &pupil_inliers, bool force)
@@ -119,6 +119,11 @@ public:
         return false;
     }
 
+    // Fits the eye model over consecutive frames, pupils must be detected in the coordinates of the whole frame
+    bool hasOwnTracking() override {
+        return true;
+    }
+
     bool is_model_built() {
         return is_model_built_;
     }
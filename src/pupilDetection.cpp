@@ -1,5 +1,6 @@
 
 #include <QtConcurrent/QtConcurrent>
+#include <QtCore/QThread>
 #include "pupilDetection.h"
 #include "pupil-detection-methods/ElSe.h"
 #include "pupil-detection-methods/ExCuSe.h"
@@ -13,19 +14,32 @@
 
 #include <fstream>
 
+// Tracking window size and pupil diameter range, relative to the diameter of the previous pupil
+static const float trackingWindowScale = 3.0f;
+static const float trackingMinDiameterScale = 0.5f;
+static const float trackingMaxDiameterScale = 1.5f;
+// Minimal confidence of a pupil to be tracked, for algorithms providing a confidence
+static const float trackingMinConfidence = 0.5f;
+// Smaller windows are too small for the algorithms and fall back to the whole image
+static const int trackingMinWindowSize = 10;
 
-// QTs event signal eventloop queues images for us, we run this pupildetection worker in a extra thread and every call to newImage is queued automatically
-// This may however queue a large number of images if the processing speed is slow, increasing the memory potentially until it is full and the application is killed
-// We dont have access to the eventloop to handle this, so its up to the user for now to not use a rate too high
+
+// Camera images are received directly in the camera (producer) thread and put into a bounded frame queue, the queue is drained in the
+// thread of this pupildetection worker. Previously the Qt eventloop queued every image, which could increase the memory until it was full
+// and the application was killed if the processing speed was slower than the camera. Now the queue policy decides which images are dropped.
 
 // Creates a new pupil detection worker which include all pupil detection algorithms
 // Should be run on a seperate thread
 PupilDetection::PupilDetection(QObject *parent) : QObject(parent),
                                                   camera(nullptr),
                                                   frameCounter(new FrameRateCounter(parent)),
+                                                  frameQueue(new FrameQueue(32, FrameQueuePolicy::DROP_OLDEST, this)),
+                                                  drainPending(false),
                                                   stereoMode(false),
                                                   useOutlineConfidence(true),
                                                   useROIPreProcessing(false),
+                                                  useTrackingROI(false),
+                                                  useAutoROI(false),
                                                   useImageUndistort(false),
                                                   usePupilUndistort(false),
                                                   trackingOn(false),
@@ -39,24 +53,15 @@ PupilDetection::PupilDetection(QObject *parent) : QObject(parent),
     drawDelay = 33; // ~30fps
 
     // we initialize the algorithms here one time and save them in a list, the created objects are then changed through index change of the list
-    pupilDetectionMethods.push_back(new ElSe());
-    pupilDetectionMethods.push_back(new ExCuSe());
-    pupilDetectionMethods.push_back(new PuRe());
-    pupilDetectionMethods.push_back(new PuReST());
-    pupilDetectionMethods.push_back(new Starburst());
-    pupilDetectionMethods.push_back(new Swirski2D());
-    // TODO finish integrating Swirski3D
-    //double focal_length = 0.5;
-    //pupilDetectionMethods.push_back(new Swirski3D(new PuReST(), focal_length, 5, 0.5));
+    pupilDetectionMethods = createMethods();
 
     // We need a second instance of every detection method for stereo detection due to the threaded execution and potential non-thread safe algorithm code
-    pupilDetectionMethodsSecondary.push_back(new ElSe());
-    pupilDetectionMethodsSecondary.push_back(new ExCuSe());
-    pupilDetectionMethodsSecondary.push_back(new PuRe());
-    pupilDetectionMethodsSecondary.push_back(new PuReST());
-    pupilDetectionMethodsSecondary.push_back(new Starburst());
-    pupilDetectionMethodsSecondary.push_back(new Swirski2D());
-    //pupilDetectionMethodsSecondary.push_back(new Swirski3D(new PuReST(), focal_length, 5, 0.5));
+    pupilDetectionMethodsSecondary = createMethods();
+
+    // For the same reason, each parallel detection worker has its own instance, these are created on demand (see createWorkerMethods)
+    // Leave one core for the camera and the interface
+    detectionThreads = std::max(1, getMaxDetectionThreads() - 1);
+    workerMethodsIndex = -1;
 
     // Default algorithm PuRe
     pupilDetectionIndex = 2;
@@ -66,6 +71,8 @@ PupilDetection::PupilDetection(QObject *parent) : QObject(parent),
     connect(this, SIGNAL(processedPupilData(quint64, Pupil, QString)), frameCounter, SLOT(count()));
     connect(this, SIGNAL(processedStereoPupilData(quint64, Pupil, Pupil, QString)), frameCounter, SLOT(count()));
 
+    connect(frameQueue, SIGNAL(droppedFPS(double)), this, SIGNAL(droppedFPS(double)));
+
     drawTimer.start();
     processingTimer.start();
 }
@@ -74,6 +81,60 @@ PupilDetection::~PupilDetection() {
 
 }
 
+// Creates one instance of every available pupil detection algorithm, the order defines the algorithm index
+std::vector<PupilDetectionMethod*> PupilDetection::createMethods() {
+
+    std::vector<PupilDetectionMethod*> methods;
+    methods.push_back(new ElSe());
+    methods.push_back(new ExCuSe());
+    methods.push_back(new PuRe());
+    methods.push_back(new PuReST());
+    methods.push_back(new Starburst());
+    methods.push_back(new Swirski2D());
+    // TODO finish integrating Swirski3D
+    //double focal_length = 0.5;
+    //methods.push_back(new Swirski3D(new PuReST(), focal_length, 5, 0.5));
+
+    return methods;
+}
+
+// Creates a single instance of the algorithm with the given title, returns nullptr for unknown titles
+PupilDetectionMethod* PupilDetection::createMethod(const std::string &title) {
+
+    if(title == "ElSe")
+        return new ElSe();
+    if(title == "ExCuSe")
+        return new ExCuSe();
+    if(title == "PuRe")
+        return new PuRe();
+    if(title == "PuReST")
+        return new PuReST();
+    if(title == "Starburst")
+        return new Starburst();
+    if(title == "Swirski2D")
+        return new Swirski2D();
+
+    return nullptr;
+}
+
+// Creates the instances of the selected algorithm for the additional parallel detection workers, until count instances exist
+// Instances of a previously selected algorithm are released, before each drain the instances take over the parameters of the primary instance
+void PupilDetection::createWorkerMethods(int count) {
+
+    PupilDetectionMethod *primary = pupilDetectionMethods[pupilDetectionIndex];
+
+    if(workerMethodsIndex != pupilDetectionIndex) {
+        pupilDetectionMethodsWorker.clear();
+        workerMethodsIndex = pupilDetectionIndex;
+    }
+
+    while(pupilDetectionMethodsWorker.size() < static_cast<size_t>(count))
+        pupilDetectionMethodsWorker.emplace_back(createMethod(primary->title()));
+
+    for(auto &method: pupilDetectionMethodsWorker)
+        method->copyParameters(primary);
+}
+
 // Attaches a camera to the pupil detection process
 // Checks if the camera is calibrated and stereo or single, sets the detection mode accordingly
 void PupilDetection::setCamera(Camera *m_camera) {
@@ -102,13 +163,14 @@ void PupilDetection::setCamera(Camera *m_camera) {
 void PupilDetection::startDetection() {
 
     trackingOn = true;
+    trackedPupil.clear();
+    trackedPupilSecondary.clear();
     if(camera) {
-        if(stereoMode) {
-            connect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(onNewStereoImage(CameraImage)));
-        } else {
-            //runtimeHistory.clear();
-            connect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(onNewImage(CameraImage)));
-        }
+        //runtimeHistory.clear();
+        frameQueue->clear();
+        frameQueue->open();
+        // Direct connection, the image is enqueued in the camera thread, processing happens in processQueue in the thread of this object
+        connect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(enqueueImage(CameraImage)), Qt::DirectConnection);
         emit processingStarted();
     }
 }
@@ -123,13 +185,15 @@ void PupilDetection::stopDetection() {
             // For debugging, measuring times
             //auto timestamp = std::chrono::steady_clock::now().time_since_epoch().count();
             //writeVectorCSV(runtimeHistory, "timestamp,runtime[ms]", pupilDetectionMethods[pupilDetectionIndex]->title() + "_" + std::to_string(timestamp) + "_triangulateHistory.csv");
-            disconnect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(onNewStereoImage(CameraImage)));
         } else {
             // Runtime history
             //auto timestamp = std::chrono::steady_clock::now().time_since_epoch().count();
             //writeVectorCSV(runtimeHistory, "timestamp,runtime[ms]", pupilDetectionMethods[pupilDetectionIndex]->title() + "_" + std::to_string(timestamp) + "_runtimeHistory.csv");
-            disconnect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(onNewImage(CameraImage)));
         }
+        disconnect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(enqueueImage(CameraImage)));
+        // Wake up a producer which may be blocked by a full queue and discard the remaining images
+        frameQueue->close();
+        frameQueue->clear();
         emit processingFinished();
     }
 }
@@ -140,14 +204,12 @@ void PupilDetection::stopDetection() {
 void PupilDetection::setAlgorithm(QString method) {
 
     if(camera && trackingOn) {
-        if(stereoMode) {
-            disconnect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(onNewStereoImage(CameraImage)));
-        } else {
-            disconnect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(onNewImage(CameraImage)));
-        }
+        disconnect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(enqueueImage(CameraImage)));
     }
 
     frameCounter->reset();
+    trackedPupil.clear();
+    trackedPupilSecondary.clear();
 
     int i = 0;
     for(auto pm: pupilDetectionMethods) {
@@ -159,11 +221,97 @@ void PupilDetection::setAlgorithm(QString method) {
     emit algorithmChanged();
 
     if(camera && trackingOn) {
-        if(stereoMode) {
-            connect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(onNewStereoImage(CameraImage)));
-        } else {
-            connect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(onNewImage(CameraImage)));
+        connect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(enqueueImage(CameraImage)), Qt::DirectConnection);
+    }
+}
+
+// Slot callback executed in the thread of the camera (producer) for each new camera image
+// Puts the image into the bounded frame queue and schedules a drain of the queue in the thread of this object, if not already pending
+void PupilDetection::enqueueImage(const CameraImage &cimg) {
+
+    if(!trackingOn)
+        return;
+
+    frameQueue->push(cimg);
+
+    if(!drainPending.exchange(true))
+        QMetaObject::invokeMethod(this, "processQueue", Qt::QueuedConnection);
+}
+
+// Processes the images in the frame queue at the time of the call, executed in the thread of this object
+// Only a single drain invocation is pending at a time, so the Qt event queue does not grow with the camera rate. Images arriving
+// meanwhile are processed by a new invocation, thus other queued slots of this object (i.e. ROI changes) are not starved.
+void PupilDetection::processQueue() {
+
+    drainPending = false;
+
+    const int count = frameQueue->size();
+    // The number of threads may be changed from the interface meanwhile, it is applied with the next drain
+    const int threads = detectionThreads;
+    if(useParallelDetection(threads)) {
+        processQueueParallel(threads, count);
+    } else {
+        CameraImage cimg;
+        for(int i=0; i<count && trackingOn && frameQueue->pop(cimg); i++) {
+            if(stereoMode) {
+                onNewStereoImage(cimg);
+            } else {
+                onNewImage(cimg);
+            }
+        }
+    }
+
+    // Images may have arrived after the flag was reset, schedule another drain if no one else did
+    if(trackingOn && !frameQueue->isEmpty() && !drainPending.exchange(true))
+        QMetaObject::invokeMethod(this, "processQueue", Qt::QueuedConnection);
+}
+
+// Parallel detection is only used for single camera images and algorithms without state between frames
+// Stereo images are already processed concurrently for the main and secondary image
+// In tracking ROI mode, each image depends on the pupil of the previous image, thus images are processed sequentially
+bool PupilDetection::useParallelDetection(int threads) {
+    return !stereoMode && !useTrackingROI && threads > 1 && pupilDetectionMethods[pupilDetectionIndex]->isStateless();
+}
+
+// Frame-parallel detection of the next count queued single camera images
+// Up to threads images are detected concurrently, each by its own algorithm instance. The results are reordered by
+// always waiting for the oldest pending image first, thus pupil data is published in the order the images were received
+// An algorithm instance is only handed to a new image once its previous image is finished, the instances are taken from a free list
+void PupilDetection::processQueueParallel(int threads, int count) {
+
+    createWorkerMethods(threads - 1);
+
+    std::vector<size_t> freeWorkers;
+    for(int i=threads-1; i>=0; i--)
+        freeWorkers.push_back(static_cast<size_t>(i));
+
+    CameraImage cimg;
+    while(true) {
+        // Fill the pipeline with one image per free worker
+        while(trackingOn && count > 0 && !freeWorkers.empty() && frameQueue->pop(cimg)) {
+            count--;
+            size_t worker = freeWorkers.back();
+            freeWorkers.pop_back();
+            PupilDetectionMethod *method = worker == 0 ? pupilDetectionMethods[pupilDetectionIndex] : pupilDetectionMethodsWorker[worker-1].get();
+
+            PendingDetection pending;
+            pending.cimg = cimg;
+            pending.worker = worker;
+            pending.future = QtConcurrent::run(this, &PupilDetection::detectPupil, method, cimg);
+            pendingDetections.push_back(pending);
         }
+
+        if(pendingDetections.empty())
+            break;
+
+        // Wait for the oldest image, pending images are always finished even if the detection was stopped meanwhile
+        PendingDetection pending = pendingDetections.front();
+        pendingDetections.pop_front();
+
+        DetectionResult result = pending.future.result();
+        freeWorkers.push_back(pending.worker);
+        if(trackingOn)
+            publishPupil(pending.cimg, result);
     }
 }
 
@@ -181,6 +329,18 @@ void PupilDetection::onNewImage(const CameraImage &cimg) {
         return;
     }
 
+    DetectionResult result = detectPupil(pupilDetectionMethods[pupilDetectionIndex], cimg);
+    trackedPupil = result.pupil;
+    publishPupil(cimg, result);
+}
+
+// Pupil detection on a single camera image using the given algorithm instance, including pre- and post-processing
+// May be executed concurrently in a worker thread, only the given algorithm instance is modified, the undistortion functions of the
+// shared calibration are thread-safe
+PupilDetection::DetectionResult PupilDetection::detectPupil(PupilDetectionMethod *method, const CameraImage &cimg) {
+
+    DetectionResult result;
+
     cv::Mat bwFrame = cimg.img;
 
     // Undistorting the whole image is rather slow (~4ms on our test system), use contour point undistort instead (>~1ms)
@@ -190,10 +350,10 @@ void PupilDetection::onNewImage(const CameraImage &cimg) {
         //std::cout<< std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0 <<std::endl;
     }
 
-    cv::Rect roi = cv::Rect(0, 0, bwFrame.cols, bwFrame.rows);
+    cv::Rect area = cv::Rect(0, 0, bwFrame.cols, bwFrame.rows);
 
-    if(useROIPreProcessing && !ROI.empty() && roi != ROI && ROI.width<=bwFrame.cols && ROI.height<=bwFrame.rows) {
-        roi = ROI;
+    if(useROIPreProcessing && !ROI.empty() && area != ROI && ROI.width<=bwFrame.cols && ROI.height<=bwFrame.rows) {
+        area = ROI;
         bwFrame = bwFrame(ROI);
     }
 
@@ -201,27 +361,17 @@ void PupilDetection::onNewImage(const CameraImage &cimg) {
         cv::cvtColor(bwFrame, bwFrame, cv::COLOR_BGR2GRAY);
     }
 
-    Pupil pupil = Pupil();
-
     // Pupil detection
     try {
-        if(useOutlineConfidence) {
-            //std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
-            pupilDetectionMethods[pupilDetectionIndex]->runWithConfidence(bwFrame, pupil);
-            //runtimeHistory.push_back(std::make_pair(cimg.timestamp, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()));
-        } else {
-            //std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
-            pupilDetectionMethods[pupilDetectionIndex]->run(bwFrame, pupil);
-            //runtimeHistory.push_back(std::make_pair(cimg.timestamp, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()));
-        }
+        //std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        result = detectInArea(method, bwFrame, area, trackedPupil);
+        //runtimeHistory.push_back(std::make_pair(cimg.timestamp, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()));
     } catch (...) {
-        pupil.clear();
+        result.pupil.clear();
+        result.roi = area;
     }
 
-    // Shift the pupil center position to be in the coordinate of the whole image instead of the ROI
-    if(useROIPreProcessing) {
-        pupil.shift(roi.tl());
-    }
+    Pupil &pupil = result.pupil;
 
     // Undistort the pupil contour points to get an undistorted pupil size
     if(usePupilUndistort && !useImageUndistort) {
@@ -232,38 +382,123 @@ void PupilDetection::onNewImage(const CameraImage &cimg) {
         pupil.undistortedDiameter = pupil.diameter();
     }
 
-    pupil.algorithmName = pupilDetectionMethods[pupilDetectionIndex]->title();
+    pupil.algorithmName = method->title();
+    pupil.frameNumber = cimg.frameNumber;
+
+    return result;
+}
+
+// Pupil detection on the grayscale image of the given area of the camera image, the whole image or the ROI area selection
+// In tracking ROI mode, only a window around the previous pupil is processed first, using the ROI interface of the algorithm,
+// the whole area is processed if no pupil is found in the window or there is no previous pupil
+// In automatic ROI mode, the region of the coarse pupil locations is processed first, the whole area if no pupil is found in the region
+// Returns the pupil and the processed region in coordinates of the whole camera image
+PupilDetection::DetectionResult PupilDetection::detectInArea(PupilDetectionMethod *method, const cv::Mat &frame, const cv::Rect &area, const Pupil &previous) {
+
+    DetectionResult result;
+    Pupil &pupil = result.pupil;
+    result.roi = cv::Rect(0, 0, frame.cols, frame.rows);
+
+    bool tracked = false;
+
+    if(useTrackingROI && !method->hasOwnTracking() && isTrackable(previous)) {
+        Pupil areaPupil = previous;
+        areaPupil.shift(-cv::Point2f(area.tl()));
+        cv::Rect window = trackingWindow(areaPupil, result.roi);
+
+        if(window.width >= trackingMinWindowSize && window.height >= trackingMinWindowSize) {
+            float diameter = std::max(previous.size.width, previous.size.height);
+
+            if(useOutlineConfidence) {
+                method->runWithConfidence(frame, window, pupil, trackingMinDiameterScale * diameter, trackingMaxDiameterScale * diameter);
+            } else {
+                method->run(frame, window, pupil, trackingMinDiameterScale * diameter, trackingMaxDiameterScale * diameter);
+            }
+
+            tracked = isTrackable(pupil);
+            if(tracked)
+                result.roi = window;
+        }
+    }
+
+    // Pupil lost or not tracked, process the coarse pupil region first
+    bool located = false;
+    if(!tracked && useAutoROI && !method->hasOwnTracking()) {
+        cv::Rect coarse = PupilDetectionMethod::coarsePupilDetection(frame);
+
+        if(coarse != result.roi) {
+            if(useOutlineConfidence) {
+                method->runWithConfidence(frame, coarse, pupil);
+            } else {
+                method->run(frame, coarse, pupil, -1, -1);
+            }
+
+            located = isTrackable(pupil);
+            if(located)
+                result.roi = coarse;
+        }
+    }
+
+    // Process the whole area, also if no pupil is found in the coarse region, as the coarse location may be wrong
+    if(!tracked && !located) {
+        if(useOutlineConfidence) {
+            method->runWithConfidence(frame, pupil);
+        } else {
+            method->run(frame, pupil);
+        }
+    }
+
+    // Shift the pupil center position to be in the coordinate of the whole image instead of the area
+    pupil.shift(area.tl());
+    result.roi += area.tl();
+
+    return result;
+}
+
+// A pupil is tracked if it is valid and, for algorithms or outline computation providing a confidence, confident enough
+bool PupilDetection::isTrackable(const Pupil &pupil) {
+
+    if(!pupil.valid(-2.0))
+        return false;
+
+    if(pupil.confidence == NO_CONFIDENCE && pupil.outline_confidence == NO_CONFIDENCE)
+        return true;
+
+    return pupil.valid(trackingMinConfidence);
+}
 
-    // Drawing of pupil detections on the image is only performed at ~30fps
+// Square window around the pupil with the size of a multiple of the pupil diameter, restricted to the given bounds
+cv::Rect PupilDetection::trackingWindow(const Pupil &pupil, const cv::Rect &bounds) {
+
+    float halfSide = 0.5f * trackingWindowScale * std::max(pupil.size.width, pupil.size.height);
+    cv::Point2f delta(halfSide, halfSide);
+
+    return cv::Rect(pupil.center - delta, pupil.center + delta) & bounds;
+}
+
+// Emits the pupil detection result of a single camera image, executed in the thread of this object
+void PupilDetection::publishPupil(const CameraImage &cimg, DetectionResult &result) {
+
+    const Pupil &pupil = result.pupil;
+    const cv::Rect &roi = result.roi;
+
+    // Processed images are only emitted at ~30fps, the views draw the pupil detection on top of the unmodified camera image
     if (trackingOn && drawTimer.elapsed() > drawDelay) {
         drawTimer.start();
 
         CameraImage mimg = cimg;
-        mimg.img = cimg.img.clone();
 
         if(!usePupilUndistort && useImageUndistort) {
             mimg.img = singleCalibration->undistortImage(cimg.img);
-        } else {
-            mimg.img = cimg.img.clone();
         }
 
-        if (mimg.img.channels() == 1) {
-            cv::cvtColor(mimg.img, mimg.img, cv::COLOR_GRAY2BGR);
-        }
+        PupilOverlay overlay;
+        overlay.pupil = pupil;
+        overlay.roi = roi;
+        overlay.showROI = showROI;
+        overlay.showPupilCenter = showPupilCenter;
 
-        if(showROI)
-            cv::rectangle(mimg.img, roi, cv::Scalar(255, 0, 255 ), 3);
-
-        if(pupil.valid(-2.0)) {
-            cv::ellipse(mimg.img, pupil, cv::Scalar( 0, 0, 255 ), 1);
-            if(showPupilCenter)
-                cv::circle(mimg.img, pupil.center, 1, CV_RGB(255,0,0),3);
-        } else {
-            cv::putText(mimg.img, "NO PUPIL FOUND", cv::Point(static_cast<int>(0.25 * mimg.img.cols),
-                                                              static_cast<int>(0.25 * mimg.img.rows)), cv::FONT_HERSHEY_PLAIN, 4, cv::Scalar(255, 0, 255), 4);
-        }
-
-        emit processedImage(mimg);
+        emit processedImage(mimg, overlay);
     }
 
     emit processedPupilData(cimg.timestamp, pupil, QString::fromStdString(cimg.filename));
@@ -303,39 +538,31 @@ void PupilDetection::onNewStereoImage(const CameraImage &simg) {
     }
 
     // We execute pupil detection for main and secondary images concurrently using treads, we execute both in separate threads, then wait till both are finished
-    QFutureSynchronizer<Pupil> synchronizer;
+    // Pupils are returned in the original image coordinates, roi and roiSecondary become the processed regions (tracking windows)
+    QFutureSynchronizer<DetectionResult> synchronizer;
     Pupil pupil;
     Pupil pupilSecondary;
 
     try {
         //std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
-        if(useOutlineConfidence) {
-            synchronizer.addFuture(QtConcurrent::run(pupilDetectionMethods[pupilDetectionIndex], &PupilDetectionMethod::runWithConfidence, bwFrame));
-            synchronizer.addFuture(QtConcurrent::run(pupilDetectionMethodsSecondary[pupilDetectionIndex], &PupilDetectionMethod::runWithConfidence, bwFrameSecondary));
-        } else {
-            synchronizer.addFuture(QtConcurrent::run(pupilDetectionMethods[pupilDetectionIndex], &PupilDetectionMethod::run, bwFrame));
-            synchronizer.addFuture(QtConcurrent::run(pupilDetectionMethodsSecondary[pupilDetectionIndex], &PupilDetectionMethod::run, bwFrameSecondary));
-
-//            std::function<Pupil(const cv::Mat&)> run = [&](const cv::Mat &img){ return pupilDetectionMethods[pupilDetectionIndex]->run(img); };
-//            std::function<Pupil(const cv::Mat&)> runSecondary = [&](const cv::Mat &img){ return pupilDetectionMethodsSecondary[pupilDetectionIndex]->run(img); };
-//            synchronizer.addFuture(QtConcurrent::run(run, bwFrame));
-//            synchronizer.addFuture(QtConcurrent::run(runSecondary, bwFrameSecondary));
-        }
+        synchronizer.addFuture(QtConcurrent::run(this, &PupilDetection::detectInArea, pupilDetectionMethods[pupilDetectionIndex], bwFrame, roi, trackedPupil));
+        synchronizer.addFuture(QtConcurrent::run(this, &PupilDetection::detectInArea, pupilDetectionMethodsSecondary[pupilDetectionIndex], bwFrameSecondary, roiSecondary, trackedPupilSecondary));
         synchronizer.waitForFinished();
         // Unhandled exceptions in the QtConcurrent::run function are thrown at the result() call
-        pupil = synchronizer.futures().at(0).result();
-        pupilSecondary = synchronizer.futures().at(1).result();
+        DetectionResult result = synchronizer.futures().at(0).result();
+        DetectionResult resultSecondary = synchronizer.futures().at(1).result();
+        pupil = result.pupil;
+        pupilSecondary = resultSecondary.pupil;
+        roi = result.roi;
+        roiSecondary = resultSecondary.roi;
     } catch (...) {
         pupil.clear();
         pupilSecondary.clear();
     }
     //runtimeHistory.push_back(std::make_pair(simg.timestamp, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()));
 
-    // Shift the pupil position back to the original image coordinates instead of ROI
-    if(useROIPreProcessing) {
-        pupil.shift(roi.tl());
-        pupilSecondary.shift(roiSecondary.tl());
-    }
+    trackedPupil = pupil;
+    trackedPupilSecondary = pupilSecondary;
 
     if(usePupilUndistort && !useImageUndistort) {
         //std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
@@ -350,70 +577,32 @@ void PupilDetection::onNewStereoImage(const CameraImage &simg) {
 
     pupil.algorithmName = pupilDetectionMethods[pupilDetectionIndex]->title();
     pupilSecondary.algorithmName = pupil.algorithmName;
+    pupil.frameNumber = simg.frameNumber;
+    pupilSecondary.frameNumber = simg.frameNumber;
 
     // If both pupil detections are valid and the camera is calibrated, we can perform unit conversion to absolute measure
     if(pupil.valid(-2.0) && pupilSecondary.valid(-2.0) && calibrated) {
         //std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-        Pupil rotPupil(pupil);
-        rotPupil.angle += 360-rotPupil.angle;
-        Pupil rotPupilSecondary(pupilSecondary);
-        rotPupilSecondary.angle += 360-rotPupilSecondary.angle;
-
         // convert pupil detection from pixel into mm through stereo calibration
-        // Select the top left and top right corner of the bounding rects of the pupils as the points we triangulate
-        cv::Point2f mainPointsArr[4]; // rotatedRect points in order: bottomLeft, topLeft, topRight, bottomRight
-        rotPupil.points(mainPointsArr);
-        int secondPoint = rotPupil.size.width > rotPupil.size.height ? 2 : 0; // if the pupil major axis is horizontal use topLeft and topRight, else topLeft and bottomLeft
-        //cv::line(mimg.img,mainPointsArr[1], mainPointsArr[secondPoint], cv::Scalar(255, 0, 0));
-
-        cv::Point2f secondaryPointsArr[4];
-        rotPupilSecondary.points(secondaryPointsArr);
-        //cv::line(mimg.imgSecondary,secondaryPointsArr[1], secondaryPointsArr[secondPoint], cv::Scalar(255, 0, 0));
-
-        std::vector<cv::Point2f> mainPoints{mainPointsArr[1], mainPointsArr[secondPoint]}, secondaryPoints{secondaryPointsArr[1], secondaryPointsArr[secondPoint]};
-        std::vector<cv::Point3f> worldPoints = stereoCalibration->convertPointsTo3D(mainPoints, secondaryPoints);
-
-        pupil.physicalDiameter = static_cast<float>(cv::norm(worldPoints[0] - worldPoints[1]));
+        pupil.physicalDiameter = stereoCalibration->physicalPupilDiameter(pupil, pupilSecondary);
         pupilSecondary.physicalDiameter = pupil.physicalDiameter;
         //runtimeHistory.push_back(std::make_pair(simg.timestamp, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()));
     }
 
+    // Processed images are only emitted at ~30fps, the views draw the pupil detections on top of the unmodified camera images
     if (trackingOn && drawTimer.elapsed() > drawDelay) {
         drawTimer.start();
-        CameraImage mimg = simg;
-        mimg.img = simg.img.clone();
-        mimg.imgSecondary = simg.imgSecondary.clone();
-
-        if (mimg.img.channels() == 1) {
-            cv::cvtColor(mimg.img, mimg.img, cv::COLOR_GRAY2BGR);
-            cv::cvtColor(mimg.imgSecondary, mimg.imgSecondary, cv::COLOR_GRAY2BGR);
-        }
 
-        if(showROI) {
-            cv::rectangle(mimg.img, roi, cv::Scalar(255, 0, 255 ), 3);
-            cv::rectangle(mimg.imgSecondary, roiSecondary, cv::Scalar(255, 0, 255 ), 3);
-        }
-
-        if(pupil.valid(-2.0)) {
-            cv::ellipse(mimg.img, pupil, cv::Scalar( 0, 0, 255 ), 1);
-            if(showPupilCenter)
-                cv::circle(mimg.img, pupil.center, 1, CV_RGB(255,0,0),3);
-        } else {
-            cv::putText(mimg.img, "NO PUPIL FOUND", cv::Point(static_cast<int>(0.25 * mimg.img.cols),
-                                                              static_cast<int>(0.25 * mimg.img.rows)), cv::FONT_HERSHEY_PLAIN, 4, cv::Scalar(255, 0, 255), 4);
-        }
-
-        if(pupilSecondary.valid(-2.0)) {
-            cv::ellipse(mimg.imgSecondary, pupilSecondary, cv::Scalar( 0, 0, 255 ), 1);
-            if(showPupilCenter)
-                cv::circle(mimg.imgSecondary, pupilSecondary.center, 1, CV_RGB(255,0,0),3);
-        } else {
-            cv::putText(mimg.imgSecondary, "NO PUPIL FOUND", cv::Point(static_cast<int>(0.25 * mimg.img.cols),
-                                                                       static_cast<int>(0.25 * mimg.img.rows)), cv::FONT_HERSHEY_PLAIN, 4, cv::Scalar(255, 0, 255), 4);
-        }
+        PupilOverlay overlay;
+        overlay.pupil = pupil;
+        overlay.pupilSecondary = pupilSecondary;
+        overlay.roi = roi;
+        overlay.roiSecondary = roiSecondary;
+        overlay.showROI = showROI;
+        overlay.showPupilCenter = showPupilCenter;
 
-        emit processedImage(mimg);
+        emit processedImage(simg, overlay);
     }
 
     emit processedStereoPupilData(simg.timestamp, pupil, pupilSecondary, QString::fromStdString(simg.filename));
@@ -451,12 +640,12 @@ template <typename T> void PupilDetection::writeVectorCSV(std::vector<std::pair<
     }
 }
 
-// Draws the ROI rectangle on the processed image
+// Draws the ROI rectangle on top of the processed image
 void PupilDetection::onShowROI(bool value) {
     showROI = value;
 }
 
-// Draws the pupil center on the processed image
+// Draws the pupil center on top of the processed image
 void PupilDetection::onShowPupilCenter(bool value) {
     showPupilCenter = value;
 }
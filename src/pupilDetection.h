@@ -9,18 +9,60 @@
 #include <QtCore/QObject>
 #include <QtCore/QMutex>
 #include <QtCore/QRect>
+#include <QtCore/QFuture>
+#include <QtCore/QThread>
+#include <atomic>
+#include <deque>
+#include <memory>
 #include "devices/camera.h"
+#include "frameQueue.h"
 #include "pupil-detection-methods/PupilDetectionMethod.h"
 #include "devices/singleCamera.h"
 #include "stereoCameraCalibration.h"
 
 Q_DECLARE_METATYPE(Pupil)
 
+/**
+    Pupil detection result of a camera image, drawn by the camera views as vector items on top of the image
+
+    For single camera images, only the main pupil and ROI are set
+*/
+struct PupilOverlay {
+    Pupil pupil;
+    Pupil pupilSecondary;
+    cv::Rect roi;
+    cv::Rect roiSecondary;
+    bool showROI = true;
+    bool showPupilCenter = false;
+};
+
+Q_DECLARE_METATYPE(PupilOverlay)
+
 /**
     Object that performs the pupil detection on images, should be executed in an own thread
 
     Supports single and stereo camera pupil detection
 
+    Camera images are not queued in the Qt event loop but in a bounded FrameQueue, its policy decides which images are dropped
+    when the detection is slower than the camera. The queue is drained in the thread of this object.
+
+    For single camera images and stateless algorithms (see PupilDetectionMethod::isStateless()), multiple frames are detected
+    concurrently, each worker thread using its own algorithm instance. Results are published in the order the frames were received.
+    Stateful algorithms i.e. tracking based ones are executed sequentially on the primary instance. The additional instances are
+    only created for the selected algorithm when it is first detected in parallel, and take over the parameters of the primary
+    instance before each drain (see PupilDetectionMethod::copyParameters()). Besides their own algorithm instance, the workers
+    only share the single camera calibration, whose undistortion functions are thread-safe (see CameraCalibration::undistortLock).
+
+    In tracking ROI mode, each image is only processed in a window of about three times the size of the previous valid pupil,
+    using the ROI interface of the algorithms with a pupil diameter range around the previous diameter. If no pupil is found
+    in the window or the previous pupil was lost, the whole image (or ROI area selection) is processed. As every image depends
+    on the previous one, tracking ROI mode is executed sequentially. Algorithms with their own tracking (PuReST, Swirski3D)
+    always process the whole image.
+
+    In automatic ROI mode, images without tracked pupil are processed first only in the region of the best coarse pupil locations,
+    found by the shared coarse pupil locator (see CoarsePupilLocator). If no pupil is found in that region, the whole image
+    (or ROI area selection) is processed.
+
 slots:
 
     onNewImage(): on each new camera image, pupil detection is performed
@@ -32,13 +74,14 @@ slots:
 
 signals:
 
-    processedImage(): Outputs camera images with rendered pupil detection results
+    processedImage(): Outputs the processed camera images (not copied) and the pupil detection results to draw on top of them
     processedPupilData(): Pupil measurements of the pupil detection, in form of a Pupil class object
 
     processingStarted(): signal to notify pupil detection start
     processingFinished(): signal to notify pupil detection end
 
     fps(double fps): processing frame rate of the pupil detection
+    droppedFPS(double fps): images per second dropped by the frame queue as the detection could not keep up
     algorithmChanged(): signal to notify pupil detection algorithm change, used for interface updates
 */
 class PupilDetection : public QObject {
@@ -85,6 +128,18 @@ public:
         return nullptr;
     }
 
+    int getDetectionThreads() {
+        return detectionThreads;
+    }
+
+    void setDetectionThreads(int value) {
+        detectionThreads = std::max(1, std::min(value, getMaxDetectionThreads()));
+    }
+
+    int getMaxDetectionThreads() {
+        return std::max(1, QThread::idealThreadCount());
+    }
+
     bool isStereo() {
         return stereoMode;
     }
@@ -109,6 +164,22 @@ public:
         useROIPreProcessing = value;
     }
 
+    bool isTrackingROIEnabled() {
+        return useTrackingROI;
+    }
+
+    void enableTrackingROI(bool value) {
+        useTrackingROI = value;
+    }
+
+    bool isAutoROIEnabled() {
+        return useAutoROI;
+    }
+
+    void enableAutoROI(bool value) {
+        useAutoROI = value;
+    }
+
     bool isPupilUndistortionEnabled() {
         return usePupilUndistort;
     }
@@ -125,6 +196,22 @@ public:
         useImageUndistort = value;
     }
 
+    FrameQueuePolicy getFrameQueuePolicy() {
+        return frameQueue->getPolicy();
+    }
+
+    void setFrameQueuePolicy(FrameQueuePolicy policy) {
+        frameQueue->setPolicy(policy);
+    }
+
+    int getFrameQueueSize() {
+        return frameQueue->getCapacity();
+    }
+
+    void setFrameQueueSize(int size) {
+        frameQueue->setCapacity(size);
+    }
+
     void setCamera(Camera *m_camera);
 
     bool hasCamera() {
@@ -144,11 +231,19 @@ private:
 
     std::vector<PupilDetectionMethod*> pupilDetectionMethods;
     std::vector<PupilDetectionMethod*> pupilDetectionMethodsSecondary;
+    // Instances of the selected algorithm for the additional parallel detection workers, the first worker uses the primary instance
+    // Created on demand, workerMethodsIndex is the algorithm index of the instances
+    std::vector<std::unique_ptr<PupilDetectionMethod>> pupilDetectionMethodsWorker;
+    int workerMethodsIndex;
 
     int pupilDetectionIndex;
+    std::atomic<int> detectionThreads;
     QString currentConfigLabel;
 
     FrameRateCounter *frameCounter;
+    FrameQueue *frameQueue;
+    std::atomic<bool> drainPending;
+
     cv::Rect ROI;
     cv::Rect ROISecondary;
 
@@ -161,9 +256,11 @@ private:
 
     bool stereoMode;
     bool calibrated;
-    bool trackingOn;
+    std::atomic<bool> trackingOn;
     bool useOutlineConfidence;
     bool useROIPreProcessing;
+    bool useTrackingROI;
+    bool useAutoROI;
     bool usePupilUndistort;
     bool useImageUndistort;
     bool showROI;
@@ -171,10 +268,50 @@ private:
 
     std::vector<std::pair<uint64_t, long>> runtimeHistory;
 
+    // Result of the detection on a single camera image, roi is the processed image region
+    struct DetectionResult {
+        Pupil pupil;
+        cv::Rect roi;
+    };
+
+    // Single camera image currently processed by a parallel detection worker
+    struct PendingDetection {
+        CameraImage cimg;
+        QFuture<DetectionResult> future;
+        size_t worker;
+    };
+
+    std::deque<PendingDetection> pendingDetections;
+
+    // Last pupils of the main and secondary camera image, define the tracking window of the next image
+    Pupil trackedPupil;
+    Pupil trackedPupilSecondary;
+
+    static std::vector<PupilDetectionMethod*> createMethods();
+    static PupilDetectionMethod* createMethod(const std::string &title);
+
+    void createWorkerMethods(int count);
+
+    DetectionResult detectPupil(PupilDetectionMethod *method, const CameraImage &cimg);
+    DetectionResult detectInArea(PupilDetectionMethod *method, const cv::Mat &frame, const cv::Rect &area, const Pupil &previous);
+
+    static bool isTrackable(const Pupil &pupil);
+    static cv::Rect trackingWindow(const Pupil &pupil, const cv::Rect &bounds);
+    void publishPupil(const CameraImage &cimg, DetectionResult &result);
+
+    bool useParallelDetection(int threads);
+    void processQueueParallel(int threads, int count);
+
     template<typename T> void writeVectorCSV(std::vector<std::pair<uint64_t , T>> data, const std::string &header, const std::string &filename);
 
+private slots:
+
+    void processQueue();
+
 public slots:
 
+    void enqueueImage(const CameraImage &img);
+
     void onNewImage(const CameraImage &img);
     void onNewStereoImage(const CameraImage &simg);
 
@@ -190,7 +327,7 @@ public slots:
 
 signals:
 
-    void processedImage(const CameraImage &image);
+    void processedImage(const CameraImage &image, const PupilOverlay &overlay);
     void processedPupilData(quint64 timestamp, const Pupil &pupil, const QString &filename);
     void processedStereoPupilData(quint64 timestamp, const Pupil &pupil, const Pupil &pupilSec, const QString &filename);
 
@@ -198,6 +335,7 @@ signals:
     void processingFinished();
 
     void fps(double fps);
+    void droppedFPS(double fps);
     void algorithmChanged();
     void configChanged(QString config);
 
@@ -0,0 +1,250 @@
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include "pupilDetectionBenchmark.h"
+#include "batchProcessor.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Number of heap allocations, counted by the replaced global operator new of the benchmark executable
+static std::atomic<uint64_t> allocationCount(0);
+// Number of cv::Mat buffer allocations, these use OpenCV's own allocator and are not seen by operator new
+static std::atomic<uint64_t> matAllocationCount(0);
+
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if(void *ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if(void *ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    std::free(ptr);
+}
+
+// Counts the cv::Mat buffer allocations and forwards them to the standard OpenCV allocator
+class CountingMatAllocator : public cv::MatAllocator {
+
+public:
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override {
+        if(!data)
+            matAllocationCount.fetch_add(1, std::memory_order_relaxed);
+        return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override {
+        return cv::Mat::getStdAllocator()->allocate(data, accessFlags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData* data) const override {
+        cv::Mat::getStdAllocator()->deallocate(data);
+    }
+};
+
+// Loads the images of the given directory as grayscale, at most maxImages if maxImages is larger than zero
+PupilDetectionBenchmark::PupilDetectionBenchmark(const std::string &directory, int maxImages) :
+        warmupFrames(10),
+        roiScale(0.5f) {
+
+    static CountingMatAllocator matAllocator;
+    cv::Mat::setDefaultAllocator(&matAllocator);
+
+    std::vector<std::string> filenames;
+    cv::glob(directory, filenames, false);
+
+    for(const std::string &filename: filenames) {
+        if(maxImages > 0 && images.size() >= static_cast<size_t>(maxImages))
+            break;
+
+        cv::Mat img = cv::imread(filename, cv::IMREAD_GRAYSCALE);
+        if(!img.data) {
+            std::cerr << "PupilDetectionBenchmark: Image could not be read, skipping: " << filename << std::endl;
+            continue;
+        }
+        images.push_back(img);
+    }
+
+    std::cout << "PupilDetectionBenchmark: loaded " << images.size() << " images." << std::endl;
+}
+
+// Resizes all images to the given resolution, used by the following runs
+// Resizing is done once before the measurements, so that it is not part of the detection time
+void PupilDetectionBenchmark::setResolution(const cv::Size &value) {
+
+    resolution = value;
+    resizedImages.clear();
+    resizedImages.reserve(images.size());
+
+    for(const cv::Mat &img: images) {
+        cv::Mat resized;
+        int interpolation = img.cols > resolution.width ? cv::INTER_AREA : cv::INTER_LINEAR;
+        cv::resize(img, resized, resolution, 0, 0, interpolation);
+        resizedImages.push_back(resized);
+    }
+}
+
+// Measures the given algorithm on all images in the current resolution
+// The first warmupFrames images are processed before the measurement to exclude first-call initialization
+BenchmarkResult PupilDetectionBenchmark::run(const std::string &algorithm, bool outlineConfidence, bool roi) {
+
+    BenchmarkResult result;
+    result.algorithm = algorithm;
+    result.resolution = resolution;
+    result.outlineConfidence = outlineConfidence;
+    result.roi = roi;
+
+    PupilDetectionMethod *method = BatchProcessor::createMethod(algorithm);
+    if(!method || resizedImages.empty()) {
+        delete method;
+        return result;
+    }
+
+    cv::Rect roiRect(0, 0, resolution.width, resolution.height);
+    if(roi) {
+        cv::Size roiSize(static_cast<int>(resolution.width * roiScale), static_cast<int>(resolution.height * roiScale));
+        roiRect = cv::Rect(cv::Point((resolution.width - roiSize.width) / 2, (resolution.height - roiSize.height) / 2), roiSize);
+    }
+
+    std::vector<double> latencies;
+    latencies.reserve(resizedImages.size());
+
+    uint64_t allocations = 0;
+    uint64_t matAllocations = 0;
+
+    Pupil pupil;
+
+    for(int i = -warmupFrames; i < static_cast<int>(resizedImages.size()); i++) {
+        // Warmup frames are taken from the start of the sequence
+        size_t index = i < 0 ? static_cast<size_t>(i + warmupFrames) % resizedImages.size() : static_cast<size_t>(i);
+        const cv::Mat &img = resizedImages[index];
+        cv::Mat frame = roi ? img(roiRect) : img;
+
+        uint64_t allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+        uint64_t matAllocationsBefore = matAllocationCount.load(std::memory_order_relaxed);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        try {
+            if(outlineConfidence) {
+                method->runWithConfidence(frame, pupil);
+            } else {
+                method->run(frame, pupil);
+            }
+        } catch (...) {
+            pupil.clear();
+        }
+
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        if(i < 0)
+            continue;
+
+        latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1e6);
+        allocations += allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+        matAllocations += matAllocationCount.load(std::memory_order_relaxed) - matAllocationsBefore;
+
+        if(pupil.valid(-2.0))
+            result.detections++;
+    }
+
+    delete method;
+
+    result.frames = latencies.size();
+
+    double total = 0.0;
+    for(double latency: latencies)
+        total += latency;
+
+    std::sort(latencies.begin(), latencies.end());
+
+    result.meanLatency = total / result.frames;
+    result.p50Latency = percentile(latencies, 0.50);
+    result.p95Latency = percentile(latencies, 0.95);
+    result.p99Latency = percentile(latencies, 0.99);
+    result.maxLatency = latencies.back();
+    result.throughput = total > 0 ? result.frames / (total / 1000.0) : 0.0;
+    result.allocationsPerFrame = static_cast<double>(allocations) / result.frames;
+    result.matAllocationsPerFrame = static_cast<double>(matAllocations) / result.frames;
+    result.peakRSS = peakRSS();
+
+    return result;
+}
+
+// Nearest-rank percentile of the sorted values
+double PupilDetectionBenchmark::percentile(const std::vector<double> &sorted, double p) {
+
+    if(sorted.empty())
+        return 0.0;
+
+    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<size_t>(1, rank)) - 1];
+}
+
+nlohmann::json PupilDetectionBenchmark::toJson(const BenchmarkResult &result) {
+
+    nlohmann::json j;
+    j["algorithm"] = result.algorithm;
+    j["width"] = result.resolution.width;
+    j["height"] = result.resolution.height;
+    j["outlineConfidence"] = result.outlineConfidence;
+    j["roi"] = result.roi;
+    j["frames"] = result.frames;
+    j["detections"] = result.detections;
+    j["latencyMs"] = {
+            {"mean", result.meanLatency},
+            {"p50", result.p50Latency},
+            {"p95", result.p95Latency},
+            {"p99", result.p99Latency},
+            {"max", result.maxLatency}
+    };
+    j["throughputFPS"] = result.throughput;
+    j["allocationsPerFrame"] = result.allocationsPerFrame;
+    j["matAllocationsPerFrame"] = result.matAllocationsPerFrame;
+    j["peakRSSKB"] = result.peakRSS;
+
+    return j;
+}
+
+// Peak resident set size of the process in KB
+long PupilDetectionBenchmark::peakRSS() {
+
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return static_cast<long>(counters.PeakWorkingSetSize / 1024);
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    // macOS reports bytes, Linux reports KB
+    return static_cast<long>(usage.ru_maxrss / 1024);
+#else
+    return static_cast<long>(usage.ru_maxrss);
+#endif
+#endif
+}
@@ -0,0 +1,101 @@
+
+#ifndef PUPILEXT_PUPILDETECTIONBENCHMARK_H
+#define PUPILEXT_PUPILDETECTIONBENCHMARK_H
+
+/**
+    @author Moritz Lode
+*/
+
+#include <opencv2/core/mat.hpp>
+#include <string>
+#include <vector>
+#include "subwindows/pupil-detection-methods/json.h"
+
+
+// Measurements of a single benchmark configuration (algorithm, resolution, confidence, ROI)
+struct BenchmarkResult {
+    std::string algorithm;
+    cv::Size resolution;
+    bool outlineConfidence = false;
+    bool roi = false;
+
+    size_t frames = 0;
+    size_t detections = 0;
+
+    // Latency per frame in milliseconds
+    double meanLatency = 0.0;
+    double p50Latency = 0.0;
+    double p95Latency = 0.0;
+    double p99Latency = 0.0;
+    double maxLatency = 0.0;
+
+    // Frames per second of pure detection time
+    double throughput = 0.0;
+
+    // Heap allocations through operator new and through the OpenCV cv::Mat allocator
+    double allocationsPerFrame = 0.0;
+    double matAllocationsPerFrame = 0.0;
+
+    // Peak resident set size of the process after the configuration, in KB
+    long peakRSS = 0;
+};
+
+
+/**
+    Micro-benchmark of the pupil detection algorithms on a directory of eye images
+
+    The images are read as grayscale and resized to each benchmark resolution before the measurement, only the detection call
+    itself is timed (run or runWithConfidence). The images are processed in order, thus tracking algorithms (PuReST) behave
+    as on a recording.
+
+    ROI pre-processing uses a centered region of interest of roiScale times the image size, passed as an image view without
+    copy the same way as the pupil detection of the GUI does
+
+    CAUTION:
+    Peak RSS is the peak of the whole process since its start, it only increases over the configurations. For an isolated
+    value per algorithm run a single algorithm per process.
+
+    run(): measures a single configuration over all loaded images
+    toJson(): converts results to JSON for comparison between builds
+*/
+class PupilDetectionBenchmark {
+
+public:
+
+    explicit PupilDetectionBenchmark(const std::string &directory, int maxImages = 0);
+
+    size_t getImageCount() {
+        return images.size();
+    }
+
+    void setWarmupFrames(int value) {
+        warmupFrames = std::max(0, value);
+    }
+
+    void setROIScale(float value) {
+        roiScale = std::min(1.0f, std::max(0.05f, value));
+    }
+
+    void setResolution(const cv::Size &resolution);
+
+    BenchmarkResult run(const std::string &algorithm, bool outlineConfidence, bool roi);
+
+    static nlohmann::json toJson(const BenchmarkResult &result);
+
+    static long peakRSS();
+
+private:
+
+    std::vector<cv::Mat> images;
+    std::vector<cv::Mat> resizedImages;
+    cv::Size resolution;
+
+    int warmupFrames;
+    float roiScale;
+
+    static double percentile(const std::vector<double> &sorted, double p);
+
+};
+
+
+#endif //PUPILEXT_PUPILDETECTIONBENCHMARK_H
@@ -0,0 +1,221 @@
+
+#include <QtCore/QFileInfo>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include "pupilLog.h"
+#include "dataWriter.h"
+
+static const char logMagic[8] = {'P', 'X', 'P', 'U', 'P', 'L', 'O', 'G'};
+static const uint32_t logVersion = 1;
+
+// Column names of the pupil values of a camera, in the order of PupilLogCamera
+static const char *cameraColumnNames[] = {"center_x", "center_y", "width_px", "height_px", "angle_deg", "confidence", "outlineConfidence", "undistortedDiameter_px"};
+
+static PupilLogColumn column(const std::string &name, PupilLogColumnType type, size_t offset, size_t size) {
+
+    PupilLogColumn c;
+    std::memset(&c, 0, sizeof(c));
+    std::strncpy(c.name, name.c_str(), sizeof(c.name) - 1);
+    c.type = type;
+    c.offset = static_cast<uint32_t>(offset);
+    c.size = static_cast<uint32_t>(size);
+    return c;
+}
+
+static void cameraColumns(std::vector<PupilLogColumn> &columns, size_t offset, const std::string &suffix) {
+    for(size_t i = 0; i < sizeof(cameraColumnNames) / sizeof(cameraColumnNames[0]); i++) {
+        columns.push_back(column(std::string(cameraColumnNames[i]) + suffix, FLOAT32, offset + i * sizeof(float), sizeof(float)));
+    }
+}
+
+// Copies the string into the fixed-size field, truncated and always terminated
+static void copyString(char *field, size_t size, const std::string &value) {
+    std::memset(field, 0, size);
+    std::memcpy(field, value.data(), std::min(size - 1, value.size()));
+}
+
+static std::string readString(const char *field, size_t size) {
+    return std::string(field, strnlen(field, size));
+}
+
+// Binary logs are recognized by their file extension
+bool PupilLog::isPupilLog(const QString &filename) {
+    return QFileInfo(filename).suffix().compare(PUPILLOG_EXTENSION, Qt::CaseInsensitive) == 0;
+}
+
+// Returns header and column schema for a new log file with the given write mode
+std::string PupilLog::createHeader(int mode) {
+
+    std::vector<PupilLogColumn> columns;
+    size_t recordSize;
+
+    if(mode == WriteMode::STEREO) {
+        recordSize = sizeof(PupilLogStereoRecord);
+        columns.push_back(column("timestamp_ms", UINT64, offsetof(PupilLogStereoRecord, timestamp), sizeof(uint64_t)));
+        columns.push_back(column("frameNumber", UINT64, offsetof(PupilLogStereoRecord, frameNumber), sizeof(uint64_t)));
+        cameraColumns(columns, offsetof(PupilLogStereoRecord, main), "Main");
+        cameraColumns(columns, offsetof(PupilLogStereoRecord, secondary), "Sec");
+        columns.push_back(column("physicalDiameter_mm", FLOAT32, offsetof(PupilLogStereoRecord, physicalDiameter), sizeof(float)));
+        columns.push_back(column("algorithm", CHARS, offsetof(PupilLogStereoRecord, algorithm), sizeof(PupilLogStereoRecord::algorithm)));
+        columns.push_back(column("filename", CHARS, offsetof(PupilLogStereoRecord, filename), sizeof(PupilLogStereoRecord::filename)));
+    } else {
+        recordSize = sizeof(PupilLogRecord);
+        columns.push_back(column("timestamp_ms", UINT64, offsetof(PupilLogRecord, timestamp), sizeof(uint64_t)));
+        columns.push_back(column("frameNumber", UINT64, offsetof(PupilLogRecord, frameNumber), sizeof(uint64_t)));
+        cameraColumns(columns, offsetof(PupilLogRecord, main), "");
+        columns.push_back(column("physicalDiameter_mm", FLOAT32, offsetof(PupilLogRecord, physicalDiameter), sizeof(float)));
+        columns.push_back(column("algorithm", CHARS, offsetof(PupilLogRecord, algorithm), sizeof(PupilLogRecord::algorithm)));
+        columns.push_back(column("filename", CHARS, offsetof(PupilLogRecord, filename), sizeof(PupilLogRecord::filename)));
+    }
+
+    PupilLogHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, logMagic, sizeof(header.magic));
+    header.version = logVersion;
+    header.mode = static_cast<uint32_t>(mode);
+    header.recordSize = static_cast<uint32_t>(recordSize);
+    header.columnCount = static_cast<uint32_t>(columns.size());
+    header.headerSize = static_cast<uint32_t>(sizeof(header) + columns.size() * sizeof(PupilLogColumn));
+
+    std::string out(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.append(reinterpret_cast<const char*>(columns.data()), columns.size() * sizeof(PupilLogColumn));
+    return out;
+}
+
+// Reads and validates the header of an opened log file, returns false if the file is not a supported binary pupil log
+bool PupilLog::readHeader(QFile &file, PupilLogHeader &header) {
+
+    if(file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header))
+        return false;
+
+    size_t expectedSize = header.mode == WriteMode::STEREO ? sizeof(PupilLogStereoRecord) : sizeof(PupilLogRecord);
+
+    return std::memcmp(header.magic, logMagic, sizeof(header.magic)) == 0
+           && header.version == logVersion
+           && (header.mode == WriteMode::SINGLE || header.mode == WriteMode::STEREO)
+           && header.recordSize == expectedSize
+           && header.headerSize == sizeof(header) + header.columnCount * sizeof(PupilLogColumn);
+}
+
+void PupilLog::writeCamera(PupilLogCamera &camera, const Pupil &pupil) {
+    camera.centerX = pupil.center.x;
+    camera.centerY = pupil.center.y;
+    camera.width = pupil.size.width;
+    camera.height = pupil.size.height;
+    camera.angle = pupil.angle;
+    camera.confidence = pupil.confidence;
+    camera.outlineConfidence = pupil.outline_confidence;
+    camera.undistortedDiameter = pupil.undistortedDiameter;
+}
+
+Pupil PupilLog::readCamera(const PupilLogCamera &camera) {
+    Pupil pupil;
+    pupil.center = cv::Point2f(camera.centerX, camera.centerY);
+    pupil.size = cv::Size2f(camera.width, camera.height);
+    pupil.angle = camera.angle;
+    pupil.confidence = camera.confidence;
+    pupil.outline_confidence = camera.outlineConfidence;
+    pupil.undistortedDiameter = camera.undistortedDiameter;
+    return pupil;
+}
+
+// Appends the record of a single camera pupil detection to the given buffer
+void PupilLog::appendRecord(std::string &out, quint64 timestamp, const Pupil &pupil, const QString &filepath) {
+
+    PupilLogRecord record;
+    record.timestamp = timestamp;
+    record.frameNumber = pupil.frameNumber;
+    writeCamera(record.main, pupil);
+    record.physicalDiameter = pupil.physicalDiameter;
+    copyString(record.algorithm, sizeof(record.algorithm), pupil.algorithmName);
+    copyString(record.filename, sizeof(record.filename), filepath.isEmpty() ? std::string() : QFileInfo(filepath).fileName().toStdString());
+
+    out.append(reinterpret_cast<const char*>(&record), sizeof(record));
+}
+
+// Appends the record of a stereo pupil detection to the given buffer
+void PupilLog::appendStereoRecord(std::string &out, quint64 timestamp, const Pupil &pupil, const Pupil &pupilSec, const QString &filepath) {
+
+    PupilLogStereoRecord record;
+    record.timestamp = timestamp;
+    record.frameNumber = pupil.frameNumber;
+    writeCamera(record.main, pupil);
+    writeCamera(record.secondary, pupilSec);
+    record.physicalDiameter = pupil.physicalDiameter;
+    copyString(record.algorithm, sizeof(record.algorithm), pupil.algorithmName);
+    copyString(record.filename, sizeof(record.filename), filepath.isEmpty() ? std::string() : QFileInfo(filepath).fileName().toStdString());
+
+    out.append(reinterpret_cast<const char*>(&record), sizeof(record));
+}
+
+// Converts the binary log into a CSV file written by the DataWriter, thus with exactly the CSV layout of a CSV recording
+// The output file must not exist, returns the number of converted records or -1 on error
+qint64 PupilLog::toCSV(const QString &input, const QString &output) {
+
+    if(QFileInfo::exists(output)) {
+        std::cerr << "PupilLog: Output file already exists: " << output.toStdString() << std::endl;
+        return -1;
+    }
+
+    try {
+        PupilLogReader reader(input);
+        DataWriter writer(output, reader.getMode());
+        if(!writer.isOpen()) {
+            std::cerr << "PupilLog: Output file could not be opened: " << output.toStdString() << std::endl;
+            return -1;
+        }
+
+        for(size_t i = 0; i < reader.getRecordCount(); i++) {
+            if(reader.getMode() == WriteMode::STEREO) {
+                const PupilLogStereoRecord &record = reader.getStereoRecord(i);
+                Pupil pupil = readCamera(record.main);
+                Pupil pupilSec = readCamera(record.secondary);
+                pupil.algorithmName = readString(record.algorithm, sizeof(record.algorithm));
+                pupil.frameNumber = record.frameNumber;
+                pupil.physicalDiameter = record.physicalDiameter;
+                writer.newStereoPupilData(record.timestamp, pupil, pupilSec, QString::fromStdString(readString(record.filename, sizeof(record.filename))));
+            } else {
+                const PupilLogRecord &record = reader.getRecord(i);
+                Pupil pupil = readCamera(record.main);
+                pupil.algorithmName = readString(record.algorithm, sizeof(record.algorithm));
+                pupil.frameNumber = record.frameNumber;
+                pupil.physicalDiameter = record.physicalDiameter;
+                writer.newPupilData(record.timestamp, pupil, QString::fromStdString(readString(record.filename, sizeof(record.filename))));
+            }
+        }
+
+        return static_cast<qint64>(reader.getRecordCount());
+    } catch(std::exception &e) {
+        std::cerr << "PupilLog: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
+
+// Opens and memory maps the given log file, throws std::invalid_argument if it is not a valid binary pupil log
+PupilLogReader::PupilLogReader(const QString &filename) : file(filename), data(nullptr), recordCount(0) {
+
+    if(!file.open(QIODevice::ReadOnly)) {
+        throw std::invalid_argument( "Pupil log could not be opened." );
+    }
+
+    if(!PupilLog::readHeader(file, header) || static_cast<uint64_t>(file.size()) < header.headerSize) {
+        throw std::invalid_argument( "File is not a supported binary pupil log." );
+    }
+
+    recordCount = static_cast<size_t>((file.size() - header.headerSize) / header.recordSize);
+
+    data = file.map(0, file.size());
+    if(!data) {
+        throw std::invalid_argument( "Pupil log could not be memory mapped." );
+    }
+}
+
+PupilLogReader::~PupilLogReader() {
+    if(data)
+        file.unmap(data);
+}
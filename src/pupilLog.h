@@ -0,0 +1,160 @@
+
+#ifndef PUPILEXT_PUPILLOG_H
+#define PUPILEXT_PUPILLOG_H
+
+/**
+    @author Moritz Lode
+*/
+
+#include <QtCore/QFile>
+#include <QtCore/QString>
+#include <cstdint>
+#include <string>
+#include "pupil-detection-methods/Pupil.h"
+
+
+// File extension of the binary pupil log, log files with this extension are written binary by the DataWriter
+#define PUPILLOG_EXTENSION "pxl"
+
+/*
+    File layout of the binary pupil log, all values are little-endian
+
+    [PupilLogHeader]
+    [PupilLogColumn] x columnCount         (schema of the records, name, type, offset and size of each column)
+    [PupilLogRecord or PupilLogStereoRecord] (fixed-width records until the end of the file, append-only)
+
+    The records start at headerSize and have a fixed size of recordSize, thus the file can be memory mapped as array of records,
+    i.e. in numpy through a structured dtype built from the column schema and np.memmap(file, dtype, offset=headerSize).
+    An incomplete last record (i.e. crash during recording) is ignored.
+*/
+struct PupilLogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t mode;
+    uint32_t recordSize;
+    uint32_t columnCount;
+    uint32_t headerSize;
+    uint8_t reserved[36];
+};
+
+enum PupilLogColumnType { UINT64 = 0, FLOAT32 = 1, CHARS = 2 };
+
+struct PupilLogColumn {
+    char name[32];
+    uint32_t type;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t reserved;
+};
+
+// Pupil values of a single camera, the CSV values (diameter, axis ratio, circumference) are derived from these
+struct PupilLogCamera {
+    float centerX;
+    float centerY;
+    float width;
+    float height;
+    float angle;
+    float confidence;
+    float outlineConfidence;
+    float undistortedDiameter;
+};
+
+struct PupilLogRecord {
+    uint64_t timestamp;
+    uint64_t frameNumber;
+    PupilLogCamera main;
+    float physicalDiameter;
+    char algorithm[12];
+    char filename[40];
+};
+
+struct PupilLogStereoRecord {
+    uint64_t timestamp;
+    uint64_t frameNumber;
+    PupilLogCamera main;
+    PupilLogCamera secondary;
+    float physicalDiameter;
+    char algorithm[12];
+    char filename[40];
+};
+
+static_assert(sizeof(PupilLogHeader) == 64, "PupilLogHeader must be 64 bytes");
+static_assert(sizeof(PupilLogColumn) == 48, "PupilLogColumn must be 48 bytes");
+static_assert(sizeof(PupilLogRecord) == 104, "PupilLogRecord must be 104 bytes");
+static_assert(sizeof(PupilLogStereoRecord) == 136, "PupilLogStereoRecord must be 136 bytes");
+
+
+/**
+    Binary pupil log, fixed-width records of the pupil detections as alternative to the CSV output of the DataWriter
+
+    Compared to CSV, no number formatting is needed for writing and no parsing for loading, a record is about a third of a CSV row
+
+    CAUTION: Filenames are stored without directory and truncated to 39 bytes, algorithm names to 11 bytes
+
+    isPupilLog(): checks the file extension
+    createHeader(): header and column schema of a new log file for the given write mode (single or stereo)
+    appendRecord(): appends the binary record of a pupil detection to the given buffer
+    toCSV(): converts a binary log into the CSV format of the DataWriter
+*/
+class PupilLog {
+
+public:
+
+    static bool isPupilLog(const QString &filename);
+
+    static std::string createHeader(int mode);
+    static bool readHeader(QFile &file, PupilLogHeader &header);
+
+    static void appendRecord(std::string &out, quint64 timestamp, const Pupil &pupil, const QString &filepath);
+    static void appendStereoRecord(std::string &out, quint64 timestamp, const Pupil &pupil, const Pupil &pupilSec, const QString &filepath);
+
+    static qint64 toCSV(const QString &input, const QString &output);
+
+private:
+
+    static void writeCamera(PupilLogCamera &camera, const Pupil &pupil);
+    static Pupil readCamera(const PupilLogCamera &camera);
+
+};
+
+
+/**
+    Memory mapped reader of binary pupil logs, records are accessed without copy
+
+    getRecord(), getStereoRecord(): returns the record with the given index, depending on the mode of the log
+*/
+class PupilLogReader {
+
+public:
+
+    explicit PupilLogReader(const QString &filename);
+    ~PupilLogReader();
+
+    int getMode() {
+        return static_cast<int>(header.mode);
+    }
+
+    size_t getRecordCount() {
+        return recordCount;
+    }
+
+    const PupilLogRecord& getRecord(size_t index) {
+        return reinterpret_cast<const PupilLogRecord*>(data + header.headerSize)[index];
+    }
+
+    const PupilLogStereoRecord& getStereoRecord(size_t index) {
+        return reinterpret_cast<const PupilLogStereoRecord*>(data + header.headerSize)[index];
+    }
+
+private:
+
+    QFile file;
+    uchar *data;
+
+    PupilLogHeader header;
+    size_t recordCount;
+
+};
+
+
+#endif //PUPILEXT_PUPILLOG_H
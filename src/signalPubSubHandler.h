@@ -15,6 +15,8 @@
     Signals are connected to the camera signals directly to forward them.
 
     Problem which is solved is that the camera object may change while windows stay open, invalidating signal connections.
+
+    Camera images are not distributed by this handler, consumers subscribe to the FrameBus of the camera
 */
 class SignalPubSubHandler : public QObject {
     Q_OBJECT
@@ -29,8 +31,6 @@ public:
 
 signals:
 
-    void onNewGrabResult(CameraImage grabResult);
-
     void cameraFPS(double fps);
     void cameraFramecount(int framecount);
 
@@ -538,6 +538,29 @@ std::vector<cv::Point3f> StereoCameraCalibration::convertPointsTo3D(const std::v
     return worldPoints;
 }
 
+// Converts a stereo pupil detection from pixel into the physical pupil diameter in mm through triangulation
+// Only valid for valid pupil detections of both cameras and a calibrated stereo camera
+float StereoCameraCalibration::physicalPupilDiameter(const Pupil &pupil, const Pupil &pupilSecondary) {
+
+    Pupil rotPupil(pupil);
+    rotPupil.angle += 360-rotPupil.angle;
+    Pupil rotPupilSecondary(pupilSecondary);
+    rotPupilSecondary.angle += 360-rotPupilSecondary.angle;
+
+    // Select the top left and top right corner of the bounding rects of the pupils as the points we triangulate
+    cv::Point2f mainPointsArr[4]; // rotatedRect points in order: bottomLeft, topLeft, topRight, bottomRight
+    rotPupil.points(mainPointsArr);
+    int secondPoint = rotPupil.size.width > rotPupil.size.height ? 2 : 0; // if the pupil major axis is horizontal use topLeft and topRight, else topLeft and bottomLeft
+
+    cv::Point2f secondaryPointsArr[4];
+    rotPupilSecondary.points(secondaryPointsArr);
+
+    std::vector<cv::Point2f> mainPoints{mainPointsArr[1], mainPointsArr[secondPoint]}, secondaryPoints{secondaryPointsArr[1], secondaryPointsArr[secondPoint]};
+    std::vector<cv::Point3f> worldPoints = convertPointsTo3D(mainPoints, secondaryPoints);
+
+    return static_cast<float>(cv::norm(worldPoints[0] - worldPoints[1]));
+}
+
 // Undistort pupil detections sizes based on the undistortion of pupil contour points
 // This only undistorts pixel values, not physical measures which are already undistorted by design
 std::pair<double, double> StereoCameraCalibration::undistortPupilDiameters(const Pupil &pupil, const Pupil &pupilSecondary) {
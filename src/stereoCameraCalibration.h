@@ -178,6 +178,8 @@ public:
 
     std::pair<double, double> undistortPupilDiameters(const Pupil &pupil, const Pupil &pupilSecondary);
 
+    float physicalPupilDiameter(const Pupil &pupil, const Pupil &pupilSecondary);
+
 private:
 
     QMutex mutex;
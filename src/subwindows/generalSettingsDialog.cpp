@@ -4,6 +4,7 @@
 #include <QtWidgets/QGroupBox>
 #include <QtWidgets/qformlayout.h>
 #include <QtWidgets/QSpinBox>
+#include <QtCore/QThread>
 #include <iostream>
 #include "generalSettingsDialog.h"
 
@@ -12,6 +13,8 @@
 GeneralSettingsDialog::GeneralSettingsDialog(QWidget *parent) :
         QDialog(parent),
         playbackSpeed(30),
+        prefetchDepth(8),
+        decoderThreads(std::max(2, QThread::idealThreadCount() / 2)),
         writerFormat("tiff"),
         applicationSettings(new QSettings(QSettings::IniFormat, QSettings::UserScope, QCoreApplication::organizationName(), QCoreApplication::applicationName(), parent)) {
 
@@ -23,6 +26,8 @@ GeneralSettingsDialog::GeneralSettingsDialog(QWidget *parent) :
 
     connect(playbackSpeedInputBox, SIGNAL(valueChanged(int)), this, SLOT(setPlaybackSpeed(int)));
     connect(playbackLoopBox, SIGNAL(stateChanged(int)), this, SLOT(setPlaybackLoop(int)));
+    connect(prefetchDepthInputBox, SIGNAL(valueChanged(int)), this, SLOT(setPrefetchDepth(int)));
+    connect(decoderThreadsInputBox, SIGNAL(valueChanged(int)), this, SLOT(setDecoderThreads(int)));
 
     connect(formatBox, SIGNAL(currentIndexChanged(int)), this, SLOT(onFormatChange(int)));
 
@@ -45,6 +50,18 @@ void GeneralSettingsDialog::readSettings() {
         playbackLoop = (bool) m_playbackLoop.toInt();
     }
 
+    const QByteArray m_prefetchDepth = applicationSettings->value("playbackPrefetchDepth", QByteArray()).toByteArray();
+
+    if (!m_prefetchDepth.isEmpty()) {
+        prefetchDepth = m_prefetchDepth.toInt();
+    }
+
+    const QByteArray m_decoderThreads = applicationSettings->value("playbackDecoderThreads", QByteArray()).toByteArray();
+
+    if (!m_decoderThreads.isEmpty()) {
+        decoderThreads = m_decoderThreads.toInt();
+    }
+
     const QString m_writerFormat = applicationSettings->value("writerFormat", QByteArray()).toString();
 
     if (!m_writerFormat.isEmpty()) {
@@ -55,6 +72,8 @@ void GeneralSettingsDialog::readSettings() {
 void GeneralSettingsDialog::updateForm() {
 
     playbackSpeedInputBox->setValue(playbackSpeed);
+    prefetchDepthInputBox->setValue(prefetchDepth);
+    decoderThreadsInputBox->setValue(decoderThreads);
     formatBox->setCurrentText(writerFormat);
 }
 
@@ -63,6 +82,8 @@ void GeneralSettingsDialog::saveSettings() {
 
     applicationSettings->setValue("playbackSpeed", playbackSpeed);
     applicationSettings->setValue("playbackLoop", playbackLoop);
+    applicationSettings->setValue("playbackPrefetchDepth", prefetchDepth);
+    applicationSettings->setValue("playbackDecoderThreads", decoderThreads);
 
     applicationSettings->setValue("writerFormat", writerFormat);
 }
@@ -80,6 +101,7 @@ void GeneralSettingsDialog::createForm() {
     formatBox->addItem(QString("tiff [very CPU heavy]"), QString("tiff"));
     formatBox->addItem(QString("jpg [CPU heavy]"), QString("jpg"));
     formatBox->addItem(QString("bmp [fastest]"), QString("bmp"));
+    formatBox->addItem(QString("pxr [raw container, single file]"), QString("pxr"));
     formatBox->setCurrentText(writerFormat);
 
     writerLayout->addRow(formatLabel, formatBox);
@@ -108,6 +130,26 @@ void GeneralSettingsDialog::createForm() {
 
     playerLayout->addRow(playbackLoopLabel, playbackLoopBox);
 
+    QLabel *prefetchDepthLabel = new QLabel(tr("Prefetched images"));
+    prefetchDepthLabel->setAccessibleDescription("Number of images read ahead of the playback, applied on the next playback start.");
+    prefetchDepthInputBox = new QSpinBox();
+    prefetchDepthInputBox->setMinimum(1);
+    prefetchDepthInputBox->setMaximum(256);
+    prefetchDepthInputBox->setSingleStep(1);
+    prefetchDepthInputBox->setValue(prefetchDepth);
+
+    playerLayout->addRow(prefetchDepthLabel, prefetchDepthInputBox);
+
+    QLabel *decoderThreadsLabel = new QLabel(tr("Image decoder threads"));
+    decoderThreadsLabel->setAccessibleDescription("Number of threads reading and decoding images ahead of the playback.");
+    decoderThreadsInputBox = new QSpinBox();
+    decoderThreadsInputBox->setMinimum(1);
+    decoderThreadsInputBox->setMaximum(std::max(1, QThread::idealThreadCount()));
+    decoderThreadsInputBox->setSingleStep(1);
+    decoderThreadsInputBox->setValue(decoderThreads);
+
+    playerLayout->addRow(decoderThreadsLabel, decoderThreadsInputBox);
+
     playerGroup->setLayout(playerLayout);
     mainLayout->addWidget(playerGroup);
 
@@ -156,6 +198,16 @@ bool GeneralSettingsDialog::getPlaybackLoop() const {
     return playbackLoop;
 }
 
+// Returns the number of images read ahead of the playback
+int GeneralSettingsDialog::getPrefetchDepth() const {
+    return prefetchDepth;
+}
+
+// Returns the number of threads decoding images ahead of the playback
+int GeneralSettingsDialog::getDecoderThreads() const {
+    return decoderThreads;
+}
+
 // Returns the current writer format setting i.e. tiff, jpg, bmp
 QString GeneralSettingsDialog::getWriterFormat() const {
     return writerFormat;
@@ -171,6 +223,16 @@ void GeneralSettingsDialog::setPlaybackLoop(int m_state) {
     playbackLoop = (bool) m_state;
 }
 
+// Set the number of images read ahead of the playback
+void GeneralSettingsDialog::setPrefetchDepth(int m_prefetchDepth) {
+    prefetchDepth = m_prefetchDepth;
+}
+
+// Set the number of threads decoding images ahead of the playback
+void GeneralSettingsDialog::setDecoderThreads(int m_decoderThreads) {
+    decoderThreads = m_decoderThreads;
+}
+
 // Set the image writer format, all formats supported by OpenCV's imwrite can be specified
 // Choices in the settings window are tiff, jpg, and bmp
 void GeneralSettingsDialog::setWriterFormat(const QString &m_writerFormat) {
@@ -26,6 +26,8 @@ public:
 
     int getPlaybackSpeed() const;
     bool getPlaybackLoop() const;
+    int getPrefetchDepth() const;
+    int getDecoderThreads() const;
 
     QString getWriterFormat() const;
 
@@ -36,6 +38,8 @@ private:
 
     int playbackSpeed;
     bool playbackLoop;
+    int prefetchDepth;
+    int decoderThreads;
 
     QString writerFormat;
 
@@ -45,6 +49,8 @@ private:
     QComboBox *formatBox;
     QSpinBox *playbackSpeedInputBox;
     QCheckBox *playbackLoopBox;
+    QSpinBox *prefetchDepthInputBox;
+    QSpinBox *decoderThreadsInputBox;
 
     void createForm();
     void saveSettings();
@@ -59,6 +65,8 @@ private slots:
     void setPlaybackSpeed(int playbackSpeed);
     void setWriterFormat(const QString &writerFormat);
     void setPlaybackLoop(int m_state);
+    void setPrefetchDepth(int prefetchDepth);
+    void setDecoderThreads(int decoderThreads);
 
 signals:
 
@@ -77,8 +77,10 @@ public:
 
     ~ElSeSettings() override = default;
 
+    // Further instances configured the same way as the main instance i.e. for stereo and parallel detection
     void addSecondary(ElSe *s_else) {
-        secondaryElse = s_else;
+        if(s_else)
+            secondaryElses.push_back(s_else);
     }
 
     QMap<QString, QList<float>> getParameter() {
@@ -128,9 +130,9 @@ public slots:
         configParameters[parameterConfigs->currentText()][0] = minAreaRatio;
         configParameters[parameterConfigs->currentText()][1] = maxAreaRatio;
 
-        if(secondaryElse) {
-            secondaryElse->minAreaRatio = minAreaRatio;
-            secondaryElse->maxAreaRatio = maxAreaRatio;
+        for(auto secondary: secondaryElses) {
+            secondary->minAreaRatio = minAreaRatio;
+            secondary->maxAreaRatio = maxAreaRatio;
         }
 
         emit onConfigChange(parameterConfigs->currentText());
@@ -142,7 +144,7 @@ public slots:
 private:
 
     ElSe *p_else;
-    ElSe *secondaryElse = nullptr;
+    std::vector<ElSe*> secondaryElses;
 
     QDoubleSpinBox *minAreaBox;
     QDoubleSpinBox *maxAreaBox;
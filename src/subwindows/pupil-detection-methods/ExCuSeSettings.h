@@ -76,8 +76,10 @@ public:
 
     ~ExCuSeSettings() override = default;
 
+    // Further instances configured the same way as the main instance i.e. for stereo and parallel detection
     void addSecondary(ExCuSe *s_excuse) {
-        secondaryExcuse = s_excuse;
+        if(s_excuse)
+            secondaryExcuses.push_back(s_excuse);
     }
 
     QMap<QString, QList<float>> getParameter() {
@@ -127,9 +129,9 @@ public slots:
         configParameters[parameterConfigs->currentText()][0] = max_ellipse_radi;
         configParameters[parameterConfigs->currentText()][1] = good_ellipse_threshold;
 
-        if(secondaryExcuse) {
-            secondaryExcuse->max_ellipse_radi = max_ellipse_radi;
-            secondaryExcuse->good_ellipse_threshold = good_ellipse_threshold;
+        for(auto secondary: secondaryExcuses) {
+            secondary->max_ellipse_radi = max_ellipse_radi;
+            secondary->good_ellipse_threshold = good_ellipse_threshold;
         }
 
         emit onConfigChange(parameterConfigs->currentText());
@@ -141,7 +143,7 @@ public slots:
 private:
 
     ExCuSe *p_excuse;
-    ExCuSe *secondaryExcuse = nullptr;
+    std::vector<ExCuSe*> secondaryExcuses;
 
     QSpinBox *maxRadiBox;
     QSpinBox *ellipseThresholdBox;
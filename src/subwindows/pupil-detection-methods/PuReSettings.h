@@ -74,8 +74,10 @@ public:
 
     ~PuReSettings() override = default;
 
+    // Further instances configured the same way as the main instance i.e. for stereo and parallel detection
     void addSecondary(PuRe *s_pure) {
-        secondaryPure = s_pure;
+        if(s_pure)
+            secondaryPures.push_back(s_pure);
     }
 
     QMap<QString, QList<float>> getParameter() {
@@ -135,12 +137,12 @@ public slots:
         configParameters[parameterConfigs->currentText()][3] = minPupilDiameterMM;
         configParameters[parameterConfigs->currentText()][4] = maxPupilDiameterMM;
 
-        if(secondaryPure) {
-            secondaryPure->baseSize = cv::Size(baseWidth, baseHeight);
+        for(auto secondary: secondaryPures) {
+            secondary->baseSize = cv::Size(baseWidth, baseHeight);
 
-            secondaryPure->meanCanthiDistanceMM = meanCanthiDistanceMM;
-            secondaryPure->maxPupilDiameterMM = maxPupilDiameterMM;
-            secondaryPure->minPupilDiameterMM = minPupilDiameterMM;
+            secondary->meanCanthiDistanceMM = meanCanthiDistanceMM;
+            secondary->maxPupilDiameterMM = maxPupilDiameterMM;
+            secondary->minPupilDiameterMM = minPupilDiameterMM;
         }
 
         emit onConfigChange(parameterConfigs->currentText());
@@ -152,7 +154,7 @@ public slots:
 private:
 
     PuRe *pure;
-    PuRe *secondaryPure = nullptr;
+    std::vector<PuRe*> secondaryPures;
 
     QSpinBox *imageWidthBox;
     QSpinBox *imageHeightBox;
@@ -72,6 +72,18 @@ void PupilDetectionSettingsDialog::createForm() {
     roiPreprocessingBox->setChecked(pupilDetection->isROIPreProcessingEnabled());
     optionsLayout->addRow(roiPreprocessingLabel, roiPreprocessingBox);
 
+    QLabel *trackingROILabel = new QLabel(tr("Track Pupil in Dynamic ROI:"));
+    trackingROIBox = new QCheckBox();
+    trackingROIBox->setToolTip(tr("Only process a window around the previous pupil, falls back to the whole image if the pupil is lost. Detection is then performed sequentially."));
+    trackingROIBox->setChecked(pupilDetection->isTrackingROIEnabled());
+    optionsLayout->addRow(trackingROILabel, trackingROIBox);
+
+    QLabel *autoROILabel = new QLabel(tr("Automatic ROI from Coarse Pupil Location:"));
+    autoROIBox = new QCheckBox();
+    autoROIBox->setToolTip(tr("If no pupil is tracked, process the region of the best coarse pupil locations first, the whole image only if no pupil is found there."));
+    autoROIBox->setChecked(pupilDetection->isAutoROIEnabled());
+    optionsLayout->addRow(autoROILabel, autoROIBox);
+
     QLabel *outlineConfidenceLabel = new QLabel(tr("Compute Additional Outline Confidence:"));
     outlineConfidenceBox = new QCheckBox();
     outlineConfidenceBox->setChecked(pupilDetection->isOutlineConfidenceEnabled());
@@ -100,6 +112,32 @@ void PupilDetectionSettingsDialog::createForm() {
     optionsLayout->addRow(imageUndistortionLabel, imageUndistortionBox);
     connect(imageUndistortionBox, SIGNAL(stateChanged(int)), this, SLOT(onImageUndistortionClick(int)));
 
+    // Images arriving faster than the detection can process are buffered in a bounded queue, the policy decides which image is dropped when it is full
+    QLabel *frameQueuePolicyLabel = new QLabel(tr("Frame Queue Policy:"));
+    frameQueuePolicyBox = new QComboBox();
+    frameQueuePolicyBox->addItem(QString("Drop oldest [live camera]"), FrameQueuePolicy::DROP_OLDEST);
+    frameQueuePolicyBox->addItem(QString("Drop newest"), FrameQueuePolicy::DROP_NEWEST);
+    frameQueuePolicyBox->addItem(QString("Block [file playback]"), FrameQueuePolicy::BLOCK);
+    frameQueuePolicyBox->setCurrentIndex(frameQueuePolicyBox->findData(pupilDetection->getFrameQueuePolicy()));
+    optionsLayout->addRow(frameQueuePolicyLabel, frameQueuePolicyBox);
+
+    QLabel *frameQueueSizeLabel = new QLabel(tr("Frame Queue Size [images]:"));
+    frameQueueSizeBox = new QSpinBox();
+    frameQueueSizeBox->setMinimum(1);
+    frameQueueSizeBox->setMaximum(1024);
+    frameQueueSizeBox->setSingleStep(1);
+    frameQueueSizeBox->setValue(pupilDetection->getFrameQueueSize());
+    optionsLayout->addRow(frameQueueSizeLabel, frameQueueSizeBox);
+
+    // Only used for single camera images and algorithms which keep no state between frames
+    QLabel *detectionThreadsLabel = new QLabel(tr("Parallel Detection Threads:"));
+    detectionThreadsBox = new QSpinBox();
+    detectionThreadsBox->setMinimum(1);
+    detectionThreadsBox->setMaximum(pupilDetection->getMaxDetectionThreads());
+    detectionThreadsBox->setSingleStep(1);
+    detectionThreadsBox->setValue(pupilDetection->getDetectionThreads());
+    optionsLayout->addRow(detectionThreadsLabel, detectionThreadsBox);
+
     optionsGroup->setLayout(optionsLayout);
     mainLayout->addWidget(optionsGroup);
 
@@ -216,11 +254,17 @@ void PupilDetectionSettingsDialog::updateForm() {
 
     algorithmBox->setCurrentText(QString::fromStdString(pupilDetection->getCurrentMethod()->title()));
     roiPreprocessingBox->setChecked(pupilDetection->isROIPreProcessingEnabled());
+    trackingROIBox->setChecked(pupilDetection->isTrackingROIEnabled());
+    autoROIBox->setChecked(pupilDetection->isAutoROIEnabled());
     outlineConfidenceBox->setChecked(pupilDetection->isOutlineConfidenceEnabled());
 
     pupilUndistortionBox->setChecked(pupilDetection->isPupilUndistortionEnabled());
     imageUndistortionBox->setChecked(pupilDetection->isImageUndistortionEnabled());
 
+    frameQueuePolicyBox->setCurrentIndex(frameQueuePolicyBox->findData(pupilDetection->getFrameQueuePolicy()));
+    frameQueueSizeBox->setValue(pupilDetection->getFrameQueueSize());
+    detectionThreadsBox->setValue(pupilDetection->getDetectionThreads());
+
     pupilMethodSettings[algorithmBox->currentIndex()]->updateSettings();
 }
 
@@ -243,8 +287,13 @@ void PupilDetectionSettingsDialog::loadSettings() {
     pupilDetection->setAlgorithm(applicationSettings->value("PupilDetectionSettingsDialog.algorithm", algorithmBox->currentText()).toString());
     pupilDetection->enableOutlineConfidence(applicationSettings->value("PupilDetectionSettingsDialog.outlineConfidence", outlineConfidenceBox->isChecked()).toBool());
     pupilDetection->enableROIPreProcessing(applicationSettings->value("PupilDetectionSettingsDialog.processROI", roiPreprocessingBox->isChecked()).toBool());
+    pupilDetection->enableTrackingROI(applicationSettings->value("PupilDetectionSettingsDialog.trackingROI", trackingROIBox->isChecked()).toBool());
+    pupilDetection->enableAutoROI(applicationSettings->value("PupilDetectionSettingsDialog.autoROI", autoROIBox->isChecked()).toBool());
     pupilDetection->enablePupilUndistortion(applicationSettings->value("PupilDetectionSettingsDialog.undistortPupilSize", pupilUndistortionBox->isChecked()).toBool());
     pupilDetection->enableImageUndistortion(applicationSettings->value("PupilDetectionSettingsDialog.undistortImage", imageUndistortionBox->isChecked()).toBool());
+    pupilDetection->setFrameQueuePolicy((FrameQueuePolicy) applicationSettings->value("PupilDetectionSettingsDialog.frameQueuePolicy", frameQueuePolicyBox->currentData()).toInt());
+    pupilDetection->setFrameQueueSize(applicationSettings->value("PupilDetectionSettingsDialog.frameQueueSize", frameQueueSizeBox->value()).toInt());
+    pupilDetection->setDetectionThreads(applicationSettings->value("PupilDetectionSettingsDialog.detectionThreads", detectionThreadsBox->value()).toInt());
 
     pupilMethodSettings[algorithmBox->currentIndex()]->loadSettings();
 
@@ -257,8 +306,13 @@ void PupilDetectionSettingsDialog::saveSettings() {
     applicationSettings->setValue("PupilDetectionSettingsDialog.algorithm", algorithmBox->currentText());
     applicationSettings->setValue("PupilDetectionSettingsDialog.outlineConfidence", outlineConfidenceBox->isChecked());
     applicationSettings->setValue("PupilDetectionSettingsDialog.processROI", roiPreprocessingBox->isChecked());
+    applicationSettings->setValue("PupilDetectionSettingsDialog.trackingROI", trackingROIBox->isChecked());
+    applicationSettings->setValue("PupilDetectionSettingsDialog.autoROI", autoROIBox->isChecked());
     applicationSettings->setValue("PupilDetectionSettingsDialog.undistortPupilSize", pupilUndistortionBox->isChecked());
     applicationSettings->setValue("PupilDetectionSettingsDialog.undistortImage", imageUndistortionBox->isChecked());
+    applicationSettings->setValue("PupilDetectionSettingsDialog.frameQueuePolicy", frameQueuePolicyBox->currentData());
+    applicationSettings->setValue("PupilDetectionSettingsDialog.frameQueueSize", frameQueueSizeBox->value());
+    applicationSettings->setValue("PupilDetectionSettingsDialog.detectionThreads", detectionThreadsBox->value());
 }
 
 // Show and hide the algorithm specific settings depending on the current algorithm selection
@@ -283,8 +337,13 @@ void PupilDetectionSettingsDialog::applyButtonClick() {
     pupilDetection->setAlgorithm(algorithmBox->currentText());
     pupilDetection->enableOutlineConfidence(outlineConfidenceBox->isChecked());
     pupilDetection->enableROIPreProcessing(roiPreprocessingBox->isChecked());
+    pupilDetection->enableTrackingROI(trackingROIBox->isChecked());
+    pupilDetection->enableAutoROI(autoROIBox->isChecked());
     pupilDetection->enablePupilUndistortion(pupilUndistortionBox->isChecked());
     pupilDetection->enableImageUndistortion(imageUndistortionBox->isChecked());
+    pupilDetection->setFrameQueuePolicy((FrameQueuePolicy) frameQueuePolicyBox->currentData().toInt());
+    pupilDetection->setFrameQueueSize(frameQueueSizeBox->value());
+    pupilDetection->setDetectionThreads(detectionThreadsBox->value());
 
     pupilMethodSettings[algorithmBox->currentIndex()]->updateSettings();
 
@@ -10,6 +10,7 @@
 #include <QtWidgets/QComboBox>
 #include <QtCore/qdir.h>
 #include <QtWidgets/QPushButton>
+#include <QtWidgets/QSpinBox>
 #include "../pupilDetection.h"
 #include "pupil-detection-methods/PupilMethodSetting.h"
 
@@ -52,8 +53,13 @@ private:
     QComboBox *algorithmBox;
     QCheckBox *outlineConfidenceBox;
     QCheckBox *roiPreprocessingBox;
+    QCheckBox *trackingROIBox;
+    QCheckBox *autoROIBox;
     QCheckBox *pupilUndistortionBox;
     QCheckBox *imageUndistortionBox;
+    QComboBox *frameQueuePolicyBox;
+    QSpinBox *frameQueueSizeBox;
+    QSpinBox *detectionThreadsBox;
 
     void createForm();
     void updateForm();
@@ -143,7 +143,10 @@ SingleCameraCalibrationView::SingleCameraCalibrationView(SingleCamera *camera, Q
     connect(verifyButton, SIGNAL(clicked()), this, SLOT(onVerifyClick()));
     connect(stopButton, SIGNAL(clicked()), this, SLOT(onStopClick()));
 
-    connect(camera, SIGNAL(onNewGrabResult(CameraImage)), calibrationWorker, SLOT(onNewImage(CameraImage)));
+    // The subscription lives in the thread of the worker, thus only the latest camera image is queued for it
+    cameraSubscription = new FrameSubscription(camera->getFrameBus(), FrameSubscriptionMode::LATEST);
+    cameraSubscription->moveToThread(calibrationWorker->thread());
+    connect(cameraSubscription, SIGNAL(onNewGrabResult(CameraImage)), calibrationWorker, SLOT(onNewImage(CameraImage)));
     //connect(this, SIGNAL(onNewImage(CameraImage)), calibrationWorker, SLOT(onNewImage(CameraImage)));
     connect(calibrationWorker, SIGNAL(processedImage(CameraImage)), this, SLOT(updateView(CameraImage)));
     connect(calibrationWorker, SIGNAL (finishedCalibration()), this, SLOT (onCalibrationFinished()));
@@ -155,7 +158,7 @@ SingleCameraCalibrationView::SingleCameraCalibrationView(SingleCamera *camera, Q
 }
 
 SingleCameraCalibrationView::~SingleCameraCalibrationView() {
-
+    cameraSubscription->deleteLater();
 }
 
 // Update the cameraview widget in the window
@@ -242,7 +245,7 @@ void SingleCameraCalibrationView::onLoadClick() {
 // This file is again loaded upon reopening of the window through loadConfigFile()
 void SingleCameraCalibrationView::closeEvent(QCloseEvent *event) {
 
-    disconnect(camera, SIGNAL(onNewGrabResult(CameraImage)), calibrationWorker, SLOT(onNewImage(CameraImage)));
+    disconnect(cameraSubscription, SIGNAL(onNewGrabResult(CameraImage)), calibrationWorker, SLOT(onNewImage(CameraImage)));
 
     if(calibrationWorker->isCalibrated()) {
         QString configFile = camera->getCalibrationFilename();
@@ -12,6 +12,7 @@
 #include "videoView.h"
 #include "../cameraCalibration.h"
 #include "../devices/singleCamera.h"
+#include "../frameBus.h"
 #include "calibrationHelpDialog.h"
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -37,6 +38,7 @@ public:
 private:
 
     SingleCamera *camera;
+    FrameSubscription *cameraSubscription;
 
     QDir settingsDirectory;
     CalibrationHelpDialog *calibrationHelpDialog;
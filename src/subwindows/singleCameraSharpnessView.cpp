@@ -103,12 +103,15 @@ SingleCameraSharpnessView::SingleCameraSharpnessView(SingleCamera *camera, QWidg
 
     connect(camera, SIGNAL(fps(double)), this, SLOT(updateCameraFPS(double)));
 
-    connect(camera, SIGNAL(onNewGrabResult(CameraImage)), sharpnessWorker, SLOT(onNewImage(CameraImage)));
+    // The subscription lives in the thread of the worker, thus only the latest camera image is queued for it
+    cameraSubscription = new FrameSubscription(camera->getFrameBus(), FrameSubscriptionMode::LATEST);
+    cameraSubscription->moveToThread(sharpnessWorker->thread());
+    connect(cameraSubscription, SIGNAL(onNewGrabResult(CameraImage)), sharpnessWorker, SLOT(onNewImage(CameraImage)));
     connect(sharpnessWorker, SIGNAL(processedImage(CameraImage)), this, SLOT(updateView(CameraImage)));
 }
 
 SingleCameraSharpnessView::~SingleCameraSharpnessView() {
-
+    cameraSubscription->deleteLater();
 }
 
 void SingleCameraSharpnessView::onShowHelpDialog() {
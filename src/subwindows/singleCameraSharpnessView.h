@@ -11,6 +11,7 @@
 
 #include "videoView.h"
 #include "../devices/singleCamera.h"
+#include "../frameBus.h"
 #include "../pupilDetection.h"
 #include "../sharpnessCalculation.h"
 #include "calibrationHelpDialog.h"
@@ -37,6 +38,7 @@ public:
 private:
 
     Camera *camera;
+    FrameSubscription *cameraSubscription;
     CameraCalibration *cameraCalibration;
 
     SharpnessCalculation *sharpnessWorker;
@@ -129,11 +129,15 @@ SingleCameraView::SingleCameraView(Camera *camera, PupilDetection *pupilDetectio
     processingConfigLabel = new QLabel();
     QLabel *processingFPSLabel = new QLabel("Processing FPS:");
     processingFPSValue = new QLabel();
+    QLabel *droppedFPSLabel = new QLabel("Dropped FPS:");
+    droppedFPSValue = new QLabel();
 
     statusBarProcessingLayout->addWidget(processingConfigLabel);
     statusBarProcessingLayout->addWidget(processingAlgorithmLabel);
     statusBarProcessingLayout->addWidget(processingFPSLabel);
     statusBarProcessingLayout->addWidget(processingFPSValue);
+    statusBarProcessingLayout->addWidget(droppedFPSLabel);
+    statusBarProcessingLayout->addWidget(droppedFPSValue);
     statusProcessingFPSWidget->setLayout(statusBarProcessingLayout);
 
     layout->addWidget(statusBar);
@@ -149,12 +153,15 @@ SingleCameraView::SingleCameraView(Camera *camera, PupilDetection *pupilDetectio
     connect(pupilDetection, SIGNAL(processingStarted()), this, SLOT(onPupilDetectionStart()));
     connect(pupilDetection, SIGNAL(processingFinished()), this, SLOT(onPupilDetectionStop()));
     connect(pupilDetection, SIGNAL(fps(double)), this, SLOT(updateProcessingFPS(double)));
+    connect(pupilDetection, SIGNAL(droppedFPS(double)), this, SLOT(updateDroppedFPS(double)));
 
     pupilDetection->setUpdateFPS(1000/updateDelay);
 
+    cameraSubscription = new FrameSubscription(camera->getFrameBus(), FrameSubscriptionMode::LATEST, this);
+
     // In the normal state, images are shown from the camera directly, when pupil detection is activated,
     // this signal is stopped and images from the detection are displayed
-    connect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(updateView(CameraImage)));
+    connect(cameraSubscription, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(updateView(CameraImage)));
     connect(camera, SIGNAL(fps(double)), this, SLOT(updateCameraFPS(double)));
 
     connect(videoView, SIGNAL (onROISelection(QRectF)), pupilDetection, SLOT (setROI(QRectF)));
@@ -217,9 +224,9 @@ void SingleCameraView::onPupilDetectionStart() {
     processingConfigLabel->setText(pupilDetection->getCurrentConfigLabel());
     processingAlgorithmLabel->setText(QString::fromStdString(pupilDetection->getCurrentMethod()->title()));
 
-    disconnect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(updateView(CameraImage)));
+    disconnect(cameraSubscription, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(updateView(CameraImage)));
     
-    connect(pupilDetection, SIGNAL(processedImage(CameraImage)), this, SLOT(updateView(CameraImage)));
+    connect(pupilDetection, SIGNAL(processedImage(CameraImage, PupilOverlay)), this, SLOT(updateProcessedView(CameraImage, PupilOverlay)));
     connect(pupilDetection, SIGNAL(processedPupilData(quint64, Pupil, QString)), this, SLOT(updatePupilView(quint64, Pupil, QString)));
 
 }
@@ -230,10 +237,12 @@ void SingleCameraView::onPupilDetectionStop() {
 
     statusBar->removeWidget(statusProcessingFPSWidget);
 
-    disconnect(pupilDetection, SIGNAL(processedImage(CameraImage)), this, SLOT(updateView(CameraImage)));
+    disconnect(pupilDetection, SIGNAL(processedImage(CameraImage, PupilOverlay)), this, SLOT(updateProcessedView(CameraImage, PupilOverlay)));
     disconnect(pupilDetection, SIGNAL(processedPupilData(quint64, Pupil, QString)), this, SLOT(updatePupilView(quint64, Pupil, QString)));
 
-    connect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(updateView(CameraImage)));
+    videoView->clearOverlay();
+
+    connect(cameraSubscription, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(updateView(CameraImage)));
 }
 
 void SingleCameraView::updateView(const CameraImage &cimg) {
@@ -249,6 +258,15 @@ void SingleCameraView::updateView(const CameraImage &cimg) {
     }
 }
 
+// Displays a processed image of the pupil detection, the detection result is drawn on top of the image by the video view
+void SingleCameraView::updateProcessedView(const CameraImage &cimg, const PupilOverlay &overlay) {
+
+    if(timer.elapsed() > updateDelay && !cimg.img.empty()) {
+        updateView(cimg);
+        videoView->updateOverlay(overlay.pupil, overlay.roi, overlay.showROI, overlay.showPupilCenter);
+    }
+}
+
 void SingleCameraView::updateCameraFPS(double fps) {
     currentCameraFPS = fps;
     cameraFPSValue->setText(QString::number(fps));
@@ -264,6 +282,16 @@ void SingleCameraView::updateProcessingFPS(double fps) {
     processingFPSValue->setText(QString::number(fps));
 }
 
+// Images dropped by the frame queue as the detection could not keep up, colored red if any are dropped
+void SingleCameraView::updateDroppedFPS(double fps) {
+    if(fps > 0) {
+        droppedFPSValue->setStyleSheet("color: red;");
+    } else {
+        droppedFPSValue->setStyleSheet("color: black;");
+    }
+    droppedFPSValue->setText(QString::number(fps));
+}
+
 void SingleCameraView::updateAlgorithmLabel() {
     processingAlgorithmLabel->setText(QString::fromStdString(pupilDetection->getCurrentMethod()->title()));
 }
@@ -11,6 +11,7 @@
 
 #include "videoView.h"
 #include "../devices/singleCamera.h"
+#include "../frameBus.h"
 #include "../pupilDetection.h"
 
 /**
@@ -39,6 +40,7 @@ public:
 private:
 
     Camera *camera;
+    FrameSubscription *cameraSubscription;
     PupilDetection *pupilDetection;
 
     QSettings *applicationSettings;
@@ -66,6 +68,7 @@ private:
     QLabel *cameraFPSValue;
     QLabel *processingAlgorithmLabel;
     QLabel *processingFPSValue;
+    QLabel *droppedFPSValue;
     QWidget *statusProcessingFPSWidget;
     QLabel *processingConfigLabel;
 
@@ -88,8 +91,10 @@ public slots:
     void saveROISelection(QRectF roi);
 
     void updateView(const CameraImage &img);
+    void updateProcessedView(const CameraImage &img, const PupilOverlay &overlay);
     void updateCameraFPS(double fps);
     void updateProcessingFPS(double fps);
+    void updateDroppedFPS(double fps);
     void updatePupilView(quint64 timestamp, const Pupil &pupil, const QString &filename);
     void updateAlgorithmLabel();
 
@@ -152,8 +152,11 @@ StereoCameraCalibrationView::StereoCameraCalibrationView(StereoCamera *camera, Q
     connect(verifyButton, SIGNAL(clicked()), this, SLOT(onVerifyClick()));
     connect(stopButton, SIGNAL(clicked()), this, SLOT(onStopClick()));
 
+    // The subscription lives in the thread of the worker, thus only the latest camera image is queued for it
+    cameraSubscription = new FrameSubscription(camera->getFrameBus(), FrameSubscriptionMode::LATEST);
+    cameraSubscription->moveToThread(calibrationWorker->thread());
     // Propagate images to the calibration process
-    connect(camera, SIGNAL(onNewGrabResult(CameraImage)), calibrationWorker, SLOT(onNewImage(CameraImage)));
+    connect(cameraSubscription, SIGNAL(onNewGrabResult(CameraImage)), calibrationWorker, SLOT(onNewImage(CameraImage)));
     //connect(this, SIGNAL(onNewImage(CameraImage)), calibrationWorker, SLOT(onNewImage(CameraImage)));
     // Show the processed calibration images in the live-view
     connect(calibrationWorker, SIGNAL(processedImage(CameraImage)), this, SLOT(updateView(CameraImage)));
@@ -166,7 +169,7 @@ StereoCameraCalibrationView::StereoCameraCalibrationView(StereoCamera *camera, Q
 }
 
 StereoCameraCalibrationView::~StereoCameraCalibrationView() {
-
+    cameraSubscription->deleteLater();
 }
 
 // Received image signals from the calibration process
@@ -254,7 +257,7 @@ void StereoCameraCalibrationView::onLoadClick() {
 
 void StereoCameraCalibrationView::closeEvent(QCloseEvent *event) {
 
-    disconnect(camera, SIGNAL(onNewGrabResult(CameraImage)), calibrationWorker, SLOT(onNewImage(CameraImage)));
+    disconnect(cameraSubscription, SIGNAL(onNewGrabResult(CameraImage)), calibrationWorker, SLOT(onNewImage(CameraImage)));
 
     if(calibrationWorker->isCalibrated()) {
         QString configFile = camera->getCalibrationFilename();
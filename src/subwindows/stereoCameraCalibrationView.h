@@ -12,6 +12,7 @@
 #include "videoView.h"
 #include "../cameraCalibration.h"
 #include "../devices/stereoCamera.h"
+#include "../frameBus.h"
 #include "calibrationHelpDialog.h"
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -39,6 +40,7 @@ public:
 private:
 
     StereoCamera *camera;
+    FrameSubscription *cameraSubscription;
 
     QDir settingsDirectory;
     CalibrationHelpDialog *calibrationHelpDialog;
@@ -133,11 +133,15 @@ StereoCameraView::StereoCameraView(Camera *camera, PupilDetection *pupilDetectio
 
     QLabel *processingFPSLabel = new QLabel("Processing FPS:");
     processingFPSValue = new QLabel();
+    QLabel *droppedFPSLabel = new QLabel("Dropped FPS:");
+    droppedFPSValue = new QLabel();
 
     statusBarProcessingLayout->addWidget(processingConfigLabel);
     statusBarProcessingLayout->addWidget(processingAlgorithmLabel);
     statusBarProcessingLayout->addWidget(processingFPSLabel);
     statusBarProcessingLayout->addWidget(processingFPSValue);
+    statusBarProcessingLayout->addWidget(droppedFPSLabel);
+    statusBarProcessingLayout->addWidget(droppedFPSValue);
     statusProcessingFPSWidget->setLayout(statusBarProcessingLayout);
 
     layout->addWidget(statusBar);
@@ -153,12 +157,15 @@ StereoCameraView::StereoCameraView(Camera *camera, PupilDetection *pupilDetectio
     connect(pupilDetection, SIGNAL(processingStarted()), this, SLOT(onPupilDetectionStart()));
     connect(pupilDetection, SIGNAL(processingFinished()), this, SLOT(onPupilDetectionStop()));
     connect(pupilDetection, SIGNAL(fps(double)), this, SLOT(updateProcessingFPS(double)));
+    connect(pupilDetection, SIGNAL(droppedFPS(double)), this, SLOT(updateDroppedFPS(double)));
     connect(pupilDetection, SIGNAL (algorithmChanged()), this, SLOT (updateAlgorithmLabel()));
     connect(pupilDetection, SIGNAL (configChanged(QString)), this, SLOT (updateConfigLabel(QString)));
 
     pupilDetection->setUpdateFPS(1000/updateDelay);
 
-    connect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(updateView(CameraImage)));
+    cameraSubscription = new FrameSubscription(camera->getFrameBus(), FrameSubscriptionMode::LATEST, this);
+
+    connect(cameraSubscription, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(updateView(CameraImage)));
     connect(camera, SIGNAL(fps(double)), this, SLOT(updateCameraFPS(double)));
 
     connect(mainVideoView, SIGNAL (onROISelection(QRectF)), pupilDetection, SLOT (setROI(QRectF)));
@@ -229,9 +236,9 @@ void StereoCameraView::onPupilDetectionStart() {
     processingConfigLabel->setText(pupilDetection->getCurrentConfigLabel());
     processingAlgorithmLabel->setText(QString::fromStdString(pupilDetection->getCurrentMethod()->title()));
 
-    disconnect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(updateView(CameraImage)));
+    disconnect(cameraSubscription, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(updateView(CameraImage)));
 
-    connect(pupilDetection, SIGNAL(processedImage(CameraImage)), this, SLOT(updateView(CameraImage)));
+    connect(pupilDetection, SIGNAL(processedImage(CameraImage, PupilOverlay)), this, SLOT(updateProcessedView(CameraImage, PupilOverlay)));
     connect(pupilDetection, SIGNAL(processedStereoPupilData(quint64, Pupil, Pupil, QString)), this, SLOT(updatePupilView(quint64, Pupil, Pupil, QString)));
 }
 
@@ -240,10 +247,13 @@ void StereoCameraView::onPupilDetectionStop() {
 
     statusBar->removeWidget(statusProcessingFPSWidget);
 
-    disconnect(pupilDetection, SIGNAL(processedImage(CameraImage)), this, SLOT(updateView(CameraImage)));
+    disconnect(pupilDetection, SIGNAL(processedImage(CameraImage, PupilOverlay)), this, SLOT(updateProcessedView(CameraImage, PupilOverlay)));
     disconnect(pupilDetection, SIGNAL(processedStereoPupilData(quint64, Pupil, Pupil, QString)), this, SLOT(updatePupilView(quint64, Pupil, Pupil, QString)));
 
-    connect(camera, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(updateView(CameraImage)));
+    mainVideoView->clearOverlay();
+    secondaryVideoView->clearOverlay();
+
+    connect(cameraSubscription, SIGNAL(onNewGrabResult(CameraImage)), this, SLOT(updateView(CameraImage)));
 }
 
 // Update the live-view with images from the current update stream (either processed images or camera images)
@@ -261,6 +271,16 @@ void StereoCameraView::updateView(const CameraImage &cimg) {
     }
 }
 
+// Displays a processed stereo image of the pupil detection, the detection results are drawn on top of the images by the video views
+void StereoCameraView::updateProcessedView(const CameraImage &cimg, const PupilOverlay &overlay) {
+
+    if(timer.elapsed() > updateDelay && !cimg.img.empty()) {
+        updateView(cimg);
+        mainVideoView->updateOverlay(overlay.pupil, overlay.roi, overlay.showROI, overlay.showPupilCenter);
+        secondaryVideoView->updateOverlay(overlay.pupilSecondary, overlay.roiSecondary, overlay.showROI, overlay.showPupilCenter);
+    }
+}
+
 void StereoCameraView::updateCameraFPS(double fps) {
     currentCameraFPS = fps;
     cameraFPSValue->setText(QString::number(fps));
@@ -278,6 +298,16 @@ void StereoCameraView::updateProcessingFPS(double fps) {
     processingFPSValue->setText(QString::number(fps));
 }
 
+// Images dropped by the frame queue as the detection could not keep up, colored red if any are dropped
+void StereoCameraView::updateDroppedFPS(double fps) {
+    if(fps > 0) {
+        droppedFPSValue->setStyleSheet("color: red;");
+    } else {
+        droppedFPSValue->setStyleSheet("color: black;");
+    }
+    droppedFPSValue->setText(QString::number(fps));
+}
+
 // Updates the label displaying the current pupil detection algorithm used
 void StereoCameraView::updateAlgorithmLabel() {
     processingAlgorithmLabel->setText(QString::fromStdString(pupilDetection->getCurrentMethod()->title()));
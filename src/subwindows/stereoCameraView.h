@@ -15,6 +15,7 @@
 #include "videoView.h"
 #include "../pupilDetection.h"
 #include "../devices/stereoCamera.h"
+#include "../frameBus.h"
 
 /**
     Main view showing the two camera images side-by-side for a stereo camera, at the same time displays results of the pupil detection rendered
@@ -43,6 +44,7 @@ public:
 private:
 
     Camera *camera;
+    FrameSubscription *cameraSubscription;
     PupilDetection *pupilDetection;
 
     QSettings *applicationSettings;
@@ -70,6 +72,7 @@ private:
     QLabel *cameraFPSValue;
     QLabel *processingAlgorithmLabel;
     QLabel *processingFPSValue;
+    QLabel *droppedFPSValue;
     QWidget *statusProcessingFPSWidget;
     QLabel *processingConfigLabel;
     QElapsedTimer pupilViewTimer;
@@ -93,8 +96,10 @@ public slots:
     void saveSecondaryROISelection(QRectF roi);
 
     void updateView(const CameraImage &img);
+    void updateProcessedView(const CameraImage &img, const PupilOverlay &overlay);
     void updateCameraFPS(double fps);
     void updateProcessingFPS(double fps);
+    void updateDroppedFPS(double fps);
     void updatePupilView(quint64 timestamp, const Pupil &pupil, const Pupil &pupilSec, const QString &filename);
 
     void onFitClick();
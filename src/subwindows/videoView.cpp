@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <QtWidgets/QHBoxLayout>
 #include <QResizeEvent>
 #include <ctime>
@@ -26,6 +27,30 @@ VideoView::VideoView(QWidget *parent) : QWidget(parent), graphicsScene(new QGrap
     currentImage = new ImageGraphicsItem();
     graphicsScene->addItem(currentImage);
 
+    // Pupil detection overlay, drawn above the image but below the ROI selection
+    pupilEllipse = new QGraphicsEllipseItem();
+    pupilEllipse->setPen(QPen(QColor(255, 0, 0), 1));
+    pupilEllipse->setZValue(10);
+    graphicsScene->addItem(pupilEllipse);
+
+    pupilCenter = new QGraphicsEllipseItem(-1, -1, 2, 2);
+    pupilCenter->setPen(QPen(QColor(255, 0, 0), 3));
+    pupilCenter->setBrush(QColor(255, 0, 0));
+    pupilCenter->setZValue(11);
+    graphicsScene->addItem(pupilCenter);
+
+    processedROI = new QGraphicsRectItem();
+    processedROI->setPen(QPen(QColor(255, 0, 255), 3));
+    processedROI->setZValue(10);
+    graphicsScene->addItem(processedROI);
+
+    noPupilText = new QGraphicsSimpleTextItem("NO PUPIL FOUND");
+    noPupilText->setBrush(QColor(255, 0, 255));
+    noPupilText->setZValue(10);
+    graphicsScene->addItem(noPupilText);
+
+    clearOverlay();
+
     QGridLayout* layout = new QGridLayout(this);
     layout->setContentsMargins(0,0,0,0);
     layout->addWidget(graphicsView, 0, 0);
@@ -94,6 +119,42 @@ void VideoView::updateView(const cv::Mat &img) {
     }
 }
 
+// Updates the pupil detection overlay, coordinates are in image pixels which equal the scene coordinates
+// The ellipse is rotated around the pupil center, cv::RotatedRect and QGraphicsItem both rotate clockwise in degrees
+void VideoView::updateOverlay(const Pupil &pupil, const cv::Rect &roi, bool showROI, bool showPupilCenter) {
+
+    processedROI->setRect(roi.x, roi.y, roi.width, roi.height);
+    processedROI->setVisible(showROI && !roi.empty());
+
+    if(pupil.valid(-2.0)) {
+        pupilEllipse->setRect(-0.5 * pupil.size.width, -0.5 * pupil.size.height, pupil.size.width, pupil.size.height);
+        pupilEllipse->setPos(pupil.center.x, pupil.center.y);
+        pupilEllipse->setRotation(pupil.angle);
+        pupilEllipse->setVisible(true);
+
+        pupilCenter->setPos(pupil.center.x, pupil.center.y);
+        pupilCenter->setVisible(showPupilCenter);
+
+        noPupilText->setVisible(false);
+    } else {
+        pupilEllipse->setVisible(false);
+        pupilCenter->setVisible(false);
+
+        QFont font = noPupilText->font();
+        font.setPixelSize(std::max(12, imageSize.height / 16));
+        noPupilText->setFont(font);
+        noPupilText->setPos(0.25 * imageSize.width, 0.25 * imageSize.height);
+        noPupilText->setVisible(true);
+    }
+}
+
+void VideoView::clearOverlay() {
+    pupilEllipse->setVisible(false);
+    pupilCenter->setVisible(false);
+    processedROI->setVisible(false);
+    noPupilText->setVisible(false);
+}
+
 // Fit the image scene to the window size
 void VideoView::fitView() {
     if(mode!=FIT) {
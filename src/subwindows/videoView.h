@@ -16,6 +16,7 @@
 #include <QtWidgets/qrubberband.h>
 #include <QtWidgets/qsizegrip.h>
 #include "../devices/camera.h"
+#include "../pupil-detection-methods/Pupil.h"
 #include "imageGraphicsItem.h"
 #include "ResizableRectItem.h"
 #include <QtWidgets/QHBoxLayout>
@@ -29,6 +30,12 @@ enum ViewMode {FIT = 0, FULL = 1, ZOOM = 2};
 
     Also renders and handles the ROI selection by the user, rendered over the camera image, returns ROI results through a signal
 
+    Pupil detection results are drawn as vector items (ellipse, center, processed ROI) on top of the image, thus the image
+    itself is never modified and the overlay stays sharp independent of the zoom
+
+    updateOverlay(): shows the given pupil detection result on top of the current image
+    clearOverlay(): hides the pupil detection result, i.e. when the detection stops
+
 signals:
     void onROISelection(QRectF roi): Signalling a ROI selection by the user, transporting the ROI rect
 
@@ -120,6 +127,11 @@ private:
     ResizableRectItem *roiSelection;
     QRect ROI;
 
+    QGraphicsEllipseItem *pupilEllipse;
+    QGraphicsEllipseItem *pupilCenter;
+    QGraphicsRectItem *processedROI;
+    QGraphicsSimpleTextItem *noPupilText;
+
     bool initialFit;
     cv::Size imageSize;
     double scaleFactor;
@@ -134,6 +146,9 @@ public slots:
 
     void updateView(const cv::Mat &img);
 
+    void updateOverlay(const Pupil &pupil, const cv::Rect &roi, bool showROI, bool showPupilCenter);
+    void clearOverlay();
+
     void updatePupilView(const QRect &rect);
     void enablePupilView(bool value);
 